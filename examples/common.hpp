@@ -14,6 +14,8 @@
 #include <three/utils/conversion.hpp>
 #include <three/utils/template.hpp>
 
+#include <chrono>
+
 namespace three {
 
 struct ExampleSession {
@@ -42,6 +44,63 @@ private:
   three::GLRenderer::Ptr renderer;
 };
 
+// Renders frames and logs what they cost once a second: time spent in
+// GLRenderer::render and bytes sent to GL per frame, under the particle
+// sort mode. For examples that double as benchmarks of that setting.
+
+class RenderMeter {
+public:
+
+  explicit RenderMeter( three::GLRenderer& renderer, float interval = 1.f )
+    : renderer( renderer ), interval( interval ), elapsed( 0 ), frames( 0 ), milliseconds( 0 ), bytes( 0 ) { }
+
+  // Switches between drawing particles through a sorted index buffer and
+  // repacking every attribute in sorted order
+  void toggleParticleSort() {
+    renderer.sortParticlesByIndex = !renderer.sortParticlesByIndex;
+    elapsed = 0;
+    frames = 0;
+    milliseconds = 0;
+    bytes = 0;
+  }
+
+  void render( three::Scene& scene, three::Camera& camera, float dt ) {
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+    const auto start = Clock::now();
+    renderer.render( scene, camera );
+    milliseconds += std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+
+    bytes += renderer.info().upload.bytes;
+    ++frames;
+
+    elapsed += dt;
+    if ( elapsed < interval )
+      return;
+
+    three::console().log() << ( renderer.sortParticlesByIndex ? "sorted by index" : "sorted by repacking" )
+                           << ": " << milliseconds / frames << " ms/render, "
+                           << bytes / frames / 1024 << " KB uploaded/frame";
+
+    elapsed = 0;
+    frames = 0;
+    milliseconds = 0;
+    bytes = 0;
+
+  }
+
+private:
+  RenderMeter( RenderMeter& );
+  RenderMeter& operator=( RenderMeter& );
+
+  three::GLRenderer& renderer;
+  float interval, elapsed;
+  int frames;
+  double milliseconds;
+  size_t bytes;
+};
+
 } // namespace three
 
 #endif // THREE_EXAMPLES_COMMON_HPP
\ No newline at end of file
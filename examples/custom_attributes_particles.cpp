@@ -82,7 +82,8 @@ void shader( GLRenderer::Ptr renderer ) {
 
   auto sphere = ParticleSystem::create( geometry, shaderMaterial );
   sphere->geometry->dynamic = true;
-  sphere->sortParticles = false;
+  // Additive blending does not need sorting; this is here to be measured
+  sphere->sortParticles = true;
 
   std::vector<float> values_size( pointCount );
   std::vector<Color> values_color( pointCount );
@@ -109,12 +110,20 @@ void shader( GLRenderer::Ptr renderer ) {
 
   /////////////////////////////////////////////////////////////////////////
 
+  // 'i' switches how particles are sorted, see RenderMeter
+
+  RenderMeter meter( *renderer );
+
+  /////////////////////////////////////////////////////////////////////////
+
   auto running = true, renderStats = true;
   sdl::addEventListener( SDL_KEYDOWN, [&]( const sdl::Event& e ) {
     switch (e.key.keysym.sym) {
     case SDLK_q:
     case SDLK_ESCAPE:
       running = false; break;
+    case SDLK_i:
+      meter.toggleParticleSort(); break;
     default:
       renderStats = !renderStats; break;
     };
@@ -146,7 +155,7 @@ void shader( GLRenderer::Ptr renderer ) {
     }
     size.needsUpdate = true;
 
-    renderer->render( *scene, *camera );
+    meter.render( *scene, *camera, dt );
 
     stats.update( dt, renderStats );
 
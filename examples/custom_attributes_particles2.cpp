@@ -107,12 +107,20 @@ void shader( GLRenderer::Ptr renderer ) {
 
   /////////////////////////////////////////////////////////////////////////
 
+  // 'i' switches how particles are sorted, see RenderMeter
+
+  RenderMeter meter( *renderer );
+
+  /////////////////////////////////////////////////////////////////////////
+
   auto running = true, renderStats = true;
   sdl::addEventListener( SDL_KEYDOWN, [&]( const sdl::Event& e ) {
     switch (e.key.keysym.sym) {
     case SDLK_q:
     case SDLK_ESCAPE:
       running = false; break;
+    case SDLK_i:
+      meter.toggleParticleSort(); break;
     default:
       renderStats = !renderStats; break;
     };
@@ -146,7 +154,7 @@ void shader( GLRenderer::Ptr renderer ) {
     }
     size.needsUpdate = true;
 
-    renderer->render( *scene, *camera );
+    meter.render( *scene, *camera, dt );
 
     stats.update( dt, renderStats );
 
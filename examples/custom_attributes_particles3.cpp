@@ -132,6 +132,7 @@ void custom_attributes_particles3( GLRenderer::Ptr renderer ) {
 
   auto object = ParticleSystem::create( geometry, shaderMaterial );
   object->geometry->dynamic = true;
+  object->sortParticles = true;
 
   const auto& vertices = object->geometry->vertices;
   const auto vertexCount = vertices.size();
@@ -167,12 +168,20 @@ void custom_attributes_particles3( GLRenderer::Ptr renderer ) {
 
   /////////////////////////////////////////////////////////////////////////
 
+  // 'i' switches how particles are sorted, see RenderMeter
+
+  RenderMeter meter( *renderer );
+
+  /////////////////////////////////////////////////////////////////////////
+
   auto running = true, renderStats = true;
   sdl::addEventListener( SDL_KEYDOWN, [&]( const sdl::Event& e ) {
     switch (e.key.keysym.sym) {
     case SDLK_q:
     case SDLK_ESCAPE:
       running = false; break;
+    case SDLK_i:
+      meter.toggleParticleSort(); break;
     default:
       renderStats = !renderStats; break;
     };
@@ -206,7 +215,7 @@ void custom_attributes_particles3( GLRenderer::Ptr renderer ) {
     }
     size.needsUpdate = true;
 
-    renderer->render( *scene, *camera );
+    meter.render( *scene, *camera, dt );
 
     stats.update( dt, renderStats );
 
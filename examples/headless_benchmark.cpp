@@ -0,0 +1,109 @@
+#include <three/cameras/perspective_camera.hpp>
+#include <three/core/geometry.hpp>
+#include <three/lights/directional_light.hpp>
+#include <three/materials/mesh_lambert_material.hpp>
+#include <three/objects/mesh.hpp>
+#include <three/renderers/renderer_parameters.hpp>
+#include <three/renderers/gl_recorder.hpp>
+#include <three/renderers/gl_renderer.hpp>
+#include <three/scenes/scene.hpp>
+
+#include <three/extras/geometries/cube_geometry.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace three;
+
+// Renders geometry_hierarchy's scene against GLRecorder, without a window or
+// GL context, and reports the renderer's CPU time and the GL traffic.
+// Needs a build with THREE_GL_DISPATCH.
+
+void headless_benchmark( GLRenderer::Ptr renderer, GLRecorder& recorder, int frames ) {
+
+  auto camera = PerspectiveCamera::create(
+    60, ( float )renderer->width() / renderer->height(), 1, 10000
+  );
+  camera->position.z = 1000;
+
+  auto scene = Scene::create();
+
+  auto material = MeshLambertMaterial::create();
+  auto geometry = CubeGeometry::create( 100, 100, 100 );
+
+  auto group = Object3D::create();
+  for ( int i = 0; i < 1000; i ++ ) {
+
+    auto mesh = Mesh::create( geometry, material );
+    mesh->position.x = Math::random() * 2000 - 1000;
+    mesh->position.y = Math::random() * 2000 - 1000;
+    mesh->position.z = Math::random() * 2000 - 1000;
+
+    mesh->rotation.x = Math::random() * 2 * Math::PI();
+    mesh->rotation.y = Math::random() * 2 * Math::PI();
+
+    group->add( mesh );
+
+  }
+  scene->add( group );
+
+  auto light = DirectionalLight::create( 0xFFFFFF );
+  light->target = group;
+  scene->add( light );
+
+  /////////////////////////////////////////////////////////////////////////
+
+  typedef std::chrono::high_resolution_clock Clock;
+
+  auto milliseconds = []( Clock::duration d ) {
+    return std::chrono::duration<double, std::milli>( d ).count();
+  };
+
+  auto start = Clock::now();
+  renderer->render( *scene, *camera );
+  auto first = milliseconds( Clock::now() - start );
+
+  std::cout << "First frame:   " << first << " ms, "
+            << recorder.calls() << " GL calls, "
+            << recorder.uploadBytes() << " bytes uploaded" << std::endl;
+
+  recorder.reset();
+
+  start = Clock::now();
+  for ( int frame = 0; frame < frames; ++frame ) {
+    group->rotation.x = Math::sin( frame * 0.01f ) * 0.5f;
+    group->rotation.y = Math::sin( frame * 0.02f ) * 0.5f;
+    renderer->render( *scene, *camera );
+  }
+  auto total = milliseconds( Clock::now() - start );
+
+  std::cout << "Steady state:  " << total / frames << " ms/frame over " << frames << " frames" << std::endl
+            << "Per frame:     " << recorder.calls() / frames << " GL calls, "
+            << recorder.drawCalls() / frames << " draws, "
+            << recorder.stateChanges() / frames << " state changes, "
+            << recorder.uploadBytes() / frames << " bytes uploaded" << std::endl
+            << std::endl << recorder.report();
+
+}
+
+int main( int argc, char* argv[] ) {
+
+#if !defined(THREE_GL_DISPATCH)
+  std::cout << "headless_benchmark: rebuild with THREE_GL_DISPATCH enabled" << std::endl;
+  return 0;
+#endif
+
+  auto recorder = GLRecorder::create();
+  recorder->install();
+
+  RendererParameters parameters;
+  auto renderer = GLRenderer::create( parameters );
+  if ( !renderer ) {
+    return 0;
+  }
+
+  headless_benchmark( renderer, *recorder, argc > 1 ? std::atoi( argv[ 1 ] ) : 200 );
+
+  return 0;
+}
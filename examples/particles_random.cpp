@@ -8,9 +8,12 @@
 #include <three/renderers/gl_renderer.hpp>
 #include <three/scenes/fog_exp2.hpp>
 
+#include <algorithm>
+#include <cstdlib>
+
 using namespace three;
 
-void particles_random( const GLRenderer::Ptr& renderer ) {
+void particles_random( const GLRenderer::Ptr& renderer, int particleCount ) {
 
   auto camera = PerspectiveCamera::create(
     75, ( float )renderer->width() / renderer->height(), 1.f, 3000
@@ -22,7 +25,6 @@ void particles_random( const GLRenderer::Ptr& renderer ) {
 
   auto geometry = Geometry::create();
 
-  const auto particleCount = 20000;
   geometry->vertices.reserve( particleCount );
   std::generate_n( std::back_inserter( geometry->vertices ), particleCount,
                    [] { return Vector3( Math::random(-1000.f, 1000.f),
@@ -41,6 +43,7 @@ void particles_random( const GLRenderer::Ptr& renderer ) {
     material->color.setHSV( color[0], color[1], color[2] );
 
     auto particles = ParticleSystem::create( geometry, material );
+    particles->sortParticles = true;
 
     particles->rotation.x = Math::random() * 6;
     particles->rotation.y = Math::random() * 6;
@@ -64,12 +67,20 @@ void particles_random( const GLRenderer::Ptr& renderer ) {
 
   /////////////////////////////////////////////////////////////////////////
 
+  // 'i' switches how particles are sorted, see RenderMeter
+
+  RenderMeter meter( *renderer );
+
+  /////////////////////////////////////////////////////////////////////////
+
   auto running = true, renderStats = true;
   sdl::addEventListener( SDL_KEYDOWN, [&]( const sdl::Event& e ) {
     switch (e.key.keysym.sym) {
     case SDLK_q:
     case SDLK_ESCAPE:
       running = false; break;
+    case SDLK_i:
+      meter.toggleParticleSort(); break;
     default:
       renderStats = !renderStats; break;
     };
@@ -119,7 +130,7 @@ void particles_random( const GLRenderer::Ptr& renderer ) {
       materials[ i ]->color.setHSV( h, color[ 1 ], color[ 2 ] );
     }
 
-    renderer->render( *scene, *camera );
+    meter.render( *scene, *camera, dt );
 
     stats.update( dt, renderStats );
 
@@ -143,7 +154,8 @@ int main( int argc, char* argv[] ) {
     return 0;
   }
 
-  particles_random( renderer );
+  // The particle count may be given, e.g. to see how sorting scales
+  particles_random( renderer, argc > 1 ? std::max( std::atoi( argv[ 1 ] ), 1 ) : 20000 );
 
   return 0;
 }
\ No newline at end of file
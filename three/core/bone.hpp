@@ -1,6 +1,7 @@
 #ifndef THREE_BONE_HPP
 #define THREE_BONE_HPP
 
+#include <three/core/matrix4.hpp>
 #include <three/core/vector3.hpp>
 #include <three/core/quaternion.hpp>
 
@@ -8,26 +9,37 @@
 
 namespace three {
 
-// TODO:
+// A bone of a skeleton stored as a flat array: parent is the index of an
+// earlier bone, or -1 for a root. position, quaternion and scale are
+// relative to the parent.
+
 class Bone {
+public:
+
+  Bone()
+    : parent( -1 ),
+      scale( 1, 1, 1 ) { }
 
   Bone( std::string name,
+        int parent,
         Vector3 position,
         Quaternion quaternion,
-        bool useQuaternion = true,
         Vector3 scale = Vector3( 1, 1, 1 ) )
     : name( name ),
+      parent( parent ),
       position( position ),
       quaternion( quaternion ),
-      useQuaternion( useQuaternion ),
       scale( scale ) { }
 
   std::string name;
+  int parent;
   Vector3 position;
   Quaternion quaternion;
-  bool useQuaternion;
   Vector3 scale;
 
+  // Relative to the skinned mesh; see SkinnedMesh::updateBones()
+  Matrix4 skinMatrix;
+
 };
 
 } // namespace three
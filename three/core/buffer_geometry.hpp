@@ -17,7 +17,7 @@ public:
 
   typedef std::shared_ptr<BufferGeometry> Ptr;
 
-  Ptr create() { return make_shared<BufferGeometry>(); }
+  static Ptr create() { return make_shared<BufferGeometry>(); }
 
   virtual THREE::GeometryType type() const { return THREE::BufferGeometry; }
 
@@ -0,0 +1,327 @@
+#ifndef THREE_BVH_HPP
+#define THREE_BVH_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/geometry.hpp>
+#include <three/core/vector3.hpp>
+
+#include <three/utils/memory.hpp>
+#include <three/utils/noncopyable.hpp>
+
+#include <vector>
+
+namespace three {
+
+// Bounding volume hierarchy over axis-aligned boxes, built with a binned
+// surface area heuristic. Nodes are stored depth-first: the left child of an
+// interior node immediately follows it, the right child is at node.offset.
+
+class BVH {
+public:
+
+  struct Node {
+    Vector3  min;
+    unsigned offset; // leaf: first entry in indices; interior: right child
+    Vector3  max;
+    unsigned count;  // primitives in leaf, 0 for interior nodes
+
+    bool leaf() const { return count != 0; }
+  };
+
+  enum { MaxDepth = 64 };
+
+  std::vector<Node>     nodes;
+  std::vector<unsigned> indices;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  THREE_DECL void build( const std::vector<Box>& boxes );
+
+  // Recompute node bounds for moved primitives, keeping the topology
+  THREE_DECL void refit( const std::vector<Box>& boxes );
+
+  void clear() { nodes.clear(); indices.clear(); }
+  bool empty() const { return nodes.empty(); }
+
+  /////////////////////////////////////////////////////////////////////////
+
+  // Slab test; returns the entry distance, or far if the box is missed.
+  // A ray parallel to an axis and lying in one of the node's planes gives
+  // 0 * inf = NaN on that axis, which slab() leaves out of the interval.
+  static float intersectBox( const Node& node,
+                             const Vector3& origin, const Vector3& invDirection,
+                             float near, float far ) {
+
+    auto tmin = near, tmax = far;
+
+    slab( ( node.min.x - origin.x ) * invDirection.x, ( node.max.x - origin.x ) * invDirection.x, tmin, tmax );
+    slab( ( node.min.y - origin.y ) * invDirection.y, ( node.max.y - origin.y ) * invDirection.y, tmin, tmax );
+    slab( ( node.min.z - origin.z ) * invDirection.z, ( node.max.z - origin.z ) * invDirection.z, tmin, tmax );
+
+    return tmin <= tmax ? tmin : far;
+
+  }
+
+  // Narrows [tmin, tmax] to one axis; comparisons with NaN are false, so a
+  // NaN bound keeps the interval as it is
+  static void slab( float t1, float t2, float& tmin, float& tmax ) {
+    if ( t2 < t1 ) std::swap( t1, t2 );
+    if ( t1 > tmin ) tmin = t1;
+    if ( t2 < tmax ) tmax = t2;
+  }
+
+  // Front-to-back traversal. leaf( index, far ) tests primitive indices[i]
+  // and returns true to stop (any-hit); it may shrink far to cull farther
+  // nodes (closest-hit). Uses a fixed stack, so it never allocates.
+  template < typename F >
+  void traverse( const Vector3& origin, const Vector3& direction,
+                 float near, float& far, F&& leaf ) const {
+
+    if ( nodes.empty() )
+      return;
+
+    const Vector3 invDirection( 1.f / direction.x, 1.f / direction.y, 1.f / direction.z );
+
+    if ( intersectBox( nodes[ 0 ], origin, invDirection, near, far ) >= far )
+      return;
+
+    unsigned stack[ MaxDepth + 1 ];
+    unsigned top = 0;
+    unsigned current = 0;
+
+    for ( ;; ) {
+
+      const auto& node = nodes[ current ];
+
+      if ( node.leaf() ) {
+
+        for ( unsigned i = node.offset, il = node.offset + node.count; i < il; ++i ) {
+          if ( leaf( indices[ i ], far ) )
+            return;
+        }
+
+      } else {
+
+        auto left  = current + 1;
+        auto right = node.offset;
+
+        auto tLeft  = intersectBox( nodes[ left ],  origin, invDirection, near, far );
+        auto tRight = intersectBox( nodes[ right ], origin, invDirection, near, far );
+
+        if ( tLeft < far && tRight < far ) {
+          if ( tRight < tLeft ) std::swap( left, right );
+          stack[ top++ ] = right;
+          current = left;
+          continue;
+        }
+
+        if ( tLeft < far ) { current = left; continue; }
+        if ( tRight < far ) { current = right; continue; }
+
+      }
+
+      // Pop; nodes entered before far shrank may since have been culled
+
+      for ( ;; ) {
+        if ( top == 0 )
+          return;
+        current = stack[ --top ];
+        if ( intersectBox( nodes[ current ], origin, invDirection, near, far ) < far )
+          break;
+      }
+
+    }
+
+  }
+
+};
+
+/////////////////////////////////////////////////////////////////////////
+
+// Triangle BVH for a Geometry, in object space. Face4s are split into the
+// two triangles ( a, b, d ) and ( b, c, d ). Geometry::updateBVH() builds
+// it and refits it to follow the geometry's dirty flags; refit() also
+// follows a pose held elsewhere (e.g. a skinned mesh).
+
+class GeometryBVH : NonCopyable {
+public:
+
+  typedef std::shared_ptr<GeometryBVH> Ptr;
+
+  static Ptr create( const Geometry& geometry ) {
+    return three::make_shared<GeometryBVH>( geometry );
+  }
+
+  struct Triangle {
+    Vector3 a, ab, ac;
+    unsigned face;
+  };
+
+  struct Hit {
+    float distance;
+    unsigned face;
+  };
+
+  BVH tree;
+  std::vector<Triangle> triangles; // in leaf order
+
+  // Set once refit to vertices or elements still flagged for update, so
+  // Geometry::updateBVH() fits each flagged change once; the renderer
+  // resets it when it clears the flags
+  bool fitFlagged;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  // Closest (or, if any, first found) hit of origin + t * direction with
+  // near <= t <= far. material resolves the culled side per face; flip
+  // swaps front and back for mirrored transforms.
+  THREE_DECL bool intersect( const Vector3& origin, const Vector3& direction,
+                             float near, float far,
+                             const Geometry& geometry, const Material& material, bool flip,
+                             bool any, Hit& hit ) const;
+
+  // Every hit within [near, far], unsorted
+  THREE_DECL void intersectAll( const Vector3& origin, const Vector3& direction,
+                                float near, float far,
+                                const Geometry& geometry, const Material& material, bool flip,
+                                std::vector<Hit>& hits ) const;
+
+  // Moves the triangles to vertices, given in the geometry's vertex order,
+  // keeping the tree; it loses quality as the pose departs from the one
+  // it was built for. Returns false, leaving the tree as it was, if the
+  // geometry's triangle count changed.
+  THREE_DECL bool refit( const Geometry& geometry, const std::vector<Vertex>& vertices );
+
+  const BVH::Node& bounds() const { return tree.nodes[ 0 ]; }
+
+  // Side tested for face, from material (or its MeshFaceMaterial entry)
+  static THREE_DECL int faceSide( const Geometry& geometry, const Material& material, unsigned face, bool flip );
+
+protected:
+
+  THREE_DECL explicit GeometryBVH( const Geometry& geometry );
+
+private:
+
+  std::vector<unsigned> mOrder; // source triangle of each leaf slot
+
+  // refit() scratch, kept between calls
+  std::vector<Triangle> mSource;
+  std::vector<Box> mSourceBoxes, mBoxes;
+
+};
+
+/////////////////////////////////////////////////////////////////////////
+
+// Slots of the objects a SceneBVH was built over whose matrixWorld changed
+// since its last update(), reported by the objects themselves. Shared with
+// them, so either side may outlive the other.
+
+class SceneBVHMoves : NonCopyable {
+public:
+
+  SceneBVHMoves() : shared( false ) { }
+
+  std::vector<unsigned> slots;
+  std::vector<unsigned char> queued; // per slot
+
+  // Some of the objects were claimed by another index since the build, so
+  // they report there instead
+  bool shared;
+
+  void report( unsigned slot ) {
+    if ( slot < queued.size() && !queued[ slot ] ) {
+      queued[ slot ] = 1;
+      slots.push_back( slot );
+    }
+  }
+
+  void clear() {
+    for ( auto slot : slots ) queued[ slot ] = 0;
+    slots.clear();
+  }
+
+};
+
+/////////////////////////////////////////////////////////////////////////
+
+// Top-level hierarchy over the objects with geometry (and particles) below
+// a root, using world-space bounds. Serves both as the broad phase of Ray
+// queries and as a frustum culling index (see Scene::spatialIndex).
+//
+// update() keeps it current: objects whose matrixWorld changed since (as
+// reported to it, so unmoved objects cost nothing) get new bounds and only
+// their leaf-to-root path is refit; the tree is rebuilt after invalidate()
+// (hierarchy changes) or once refits have degraded it. An object reports
+// to the last index built over it; an older index then checks all of its
+// objects in update(). Bounds come from Geometry::boundingBox, so keep
+// that current, and invalidate() after changing it or frustumCulled.
+
+class SceneBVH : NonCopyable {
+public:
+
+  typedef std::shared_ptr<SceneBVH> Ptr;
+
+  static Ptr create() { return three::make_shared<SceneBVH>(); }
+
+  BVH tree;
+  std::vector<Object3D*> objects;
+  std::vector<Box> boxes;
+
+  bool needsRebuild;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  THREE_DECL void build( Object3D& root );
+  THREE_DECL void build( const std::vector<Object3D*>& objects );
+  THREE_DECL void update( Object3D& root );
+  THREE_DECL void refit();
+
+  void invalidate() { needsRebuild = true; }
+
+  void clear() { tree.clear(); objects.clear(); boxes.clear(); needsRebuild = true; }
+
+  // Appends the objects whose bounds touch the frustum, and those with
+  // frustumCulled unset. Subtrees fully inside are accepted without further
+  // tests, and planes a node is inside of are not tested again for its
+  // children.
+  THREE_DECL void cull( const Frustum& frustum, std::vector<Object3D*>& visible ) const;
+
+  // As above, but marks the objects instead: returns a fresh stamp that is
+  // written to Object3D::__cullStamp of every object in the frustum
+  THREE_DECL unsigned cull( const Frustum& frustum );
+
+  static THREE_DECL Box worldBounds( Object3D& object );
+
+protected:
+
+  THREE_DECL SceneBVH();
+
+  THREE_DECL bool refitObject( size_t index );
+  THREE_DECL void refitPath( unsigned node );
+
+private:
+
+  std::vector<unsigned> versions;
+  std::vector<unsigned> leaves;
+  std::vector<unsigned> parents;
+
+  std::vector<unsigned char> culled; // frustumCulled, as built
+  std::vector<unsigned> unculled;
+
+  std::shared_ptr<SceneBVHMoves> mMoves;
+
+  Object3D* mRoot;
+  size_t mMoved;
+  unsigned mStamp;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/core/impl/bvh.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_BVH_HPP
@@ -29,7 +29,7 @@ public:
     : a( a ), b( b ), c( c ), d( d ), normal( normal ), color( color ), materialIndex( materialIndex ), mType( THREE::Face4 ), mSize( 4 ) { }
 
   Face( int a, int b, int c, int d, const Vector3& n1, const Vector3& n2, const Vector3& n3, const Vector3& n4, const Color& color = Color(), int materialIndex = -1 )
-    : a( a ), b( b ), c( c ), d( d ), color( color ), materialIndex( materialIndex ), mType( THREE::Face4 ), mSize( 3 ) {
+    : a( a ), b( b ), c( c ), d( d ), color( color ), materialIndex( materialIndex ), mType( THREE::Face4 ), mSize( 4 ) {
     vertexNormals[0] = n1;
     vertexNormals[1] = n2;
     vertexNormals[2] = n3;
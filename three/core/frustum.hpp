@@ -5,6 +5,7 @@
 
 #include <three/utils/noncopyable.hpp>
 
+#include <three/core/geometry.hpp>
 #include <three/core/vector4.hpp>
 
 #include <array>
@@ -14,12 +15,51 @@ namespace three {
 class Frustum : public NonCopyable {
 public:
 
+  enum Containment {
+    Outside    = 0,
+    Intersects = 1,
+    Inside     = 2
+  };
+
+  enum { AllPlanes = 0x3F };
+
   Frustum() { }
   Frustum( const Matrix4& m ) { setFromMatrix( m ); }
 
   THREE_DECL void setFromMatrix( const Matrix4& m );
+
+  // False only if the object is certainly outside; objects without
+  // geometry are never culled.
   THREE_DECL bool contains( const Object3D& object ) const;
 
+  // Tests the geometry bounding box under matrixWorld (falling back to the
+  // bounding sphere if no box was computed). The plane that last rejected
+  // the object is tried first next time.
+  THREE_DECL Containment intersectsObject( const Object3D& object ) const;
+
+  THREE_DECL Containment intersectsSphere( const Vector3& center, float radius ) const;
+
+  // Oriented box: box in local space, transformed by matrix. Only planes set
+  // in planeMask are tested; planes the box is fully inside are cleared, so
+  // the returned mask can be passed down to bounded children. lastPlane is
+  // tested first and receives the rejecting plane.
+  THREE_DECL Containment intersectsBox( const Box& box, const Matrix4& matrix,
+                                        unsigned& planeMask, int& lastPlane ) const;
+  THREE_DECL Containment intersectsBox( const Box& box, unsigned& planeMask ) const;
+  THREE_DECL Containment intersectsBox( const Box& box ) const;
+
+  // World-space boxes, four (SSE) or eight (AVX) per step; writes one
+  // Containment per box. lastPlanes, if given, holds a plane per box (-1
+  // for none) that is tested first and receives the rejecting plane, as
+  // in intersectsBox.
+  THREE_DECL void intersectsBoxes( const Box* boxes, size_t count, unsigned char* results,
+                                   int* lastPlanes = nullptr ) const;
+
+  // World-space box around object's geometry; infinite without geometry
+  static THREE_DECL Box worldBox( const Object3D& object );
+  // ... and around geometry under matrix
+  static THREE_DECL Box worldBox( const Geometry& geometry, const Matrix4& matrix );
+
   std::array<Vector4, 6> planes;
 };
 
@@ -29,4 +69,4 @@ public:
 # include <three/core/impl/frustum.ipp>
 #endif // defined(THREE_HEADER_ONLY)
 
-#endif // THREE_FRUSTUM_HPP
\ No newline at end of file
+#endif // THREE_FRUSTUM_HPP
@@ -6,6 +6,7 @@
 #include <three/core/geometry_buffer.hpp>
 #include <three/core/geometry_group.hpp>
 
+#include <three/core/bone.hpp>
 #include <three/core/math.hpp>
 #include <three/core/color.hpp>
 #include <three/core/face.hpp>
@@ -29,6 +30,12 @@ struct MorphTarget {
   std::vector<Vertex> vertices;
 };
 
+// Normals of a morph target, one-to-one with faces
+struct MorphNormals {
+  std::vector<Vector3> faceNormals;
+  std::vector<std::array<Vector3, 4>> vertexNormals;
+};
+
 struct Box {
   Vector3 min;
   Vector3 max;
@@ -37,6 +44,10 @@ struct Box {
   Box( const Vector3& min, const Vector3& max )
     : min( min ), max( max ) { }
 
+  bool empty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
   void bound( const Vector3& pos ) {
     if ( pos.x < min.x ) {
       min.x = pos.x;
@@ -92,21 +103,25 @@ public:
 
   std::vector<MorphTarget> morphTargets;
   std::vector<Color> morphColors;
-  //std::vector<Vector3> morphNormals;
-  std::vector<Face> morphNormals;
+  std::vector<MorphNormals> morphNormals;
 
-  std::vector<Vector3> skinVerticesA;
-  std::vector<Vector3> skinVerticesB;
+  // Up to four bones per vertex, by index into bones, and their weights
   std::vector<Vector4> skinWeights;
   struct SkinIndices { int x, y, z, w; };
   std::vector<SkinIndices> skinIndices;
 
+  // Skeleton in its rest pose, parents before children (see SkinnedMesh)
+  std::vector<Bone> bones;
+
   struct Offset { int index, count, start; };
   std::vector<Offset> offsets;
 
   Box    boundingBox;
   Sphere boundingSphere;
 
+  // Triangle hierarchy used by Ray queries; kept current by updateBVH()
+  std::shared_ptr<GeometryBVH> bvh;
+
   bool hasTangents;
   bool dynamic;
 
@@ -121,6 +136,11 @@ public:
   bool tangentsNeedUpdate;
   bool colorsNeedUpdate;
 
+  // Set by the renderer when it clears verticesNeedUpdate or
+  // elementsNeedUpdate before updateBVH() saw the change. Set it too after
+  // editing vertices again while they are still flagged.
+  bool bvhNeedsUpdate;
+
   /////////////////////////////////////////////////////////////////////////
 
   virtual THREE_DECL void applyMatrix( const Matrix4& matrix );
@@ -128,9 +148,16 @@ public:
   virtual THREE_DECL void computeCentroids();
   virtual THREE_DECL void computeFaceNormals();
   virtual THREE_DECL void computeVertexNormals();
+  // Face and vertex normals of each morph target, for morphNormals materials
+  THREE_DECL void computeMorphNormals();
   virtual THREE_DECL void computeTangents();
   virtual THREE_DECL void computeBoundingBox();
   virtual THREE_DECL void computeBoundingSphere();
+  THREE_DECL void computeBVH();
+  // Builds bvh if missing; refits it once per flagged change of vertices
+  // or elements (or bvhNeedsUpdate), rebuilding if the triangle count
+  // changed
+  THREE_DECL void updateBVH();
 
   THREE_DECL void mergeVertices();
 
@@ -6,6 +6,7 @@
 #include <three/materials/attribute.hpp>
 #include <three/utils/noncopyable.hpp>
 
+#include <cstdint>
 #include <memory>
 
 namespace three {
@@ -44,8 +45,6 @@ public:
   GLBuffer __glLineBuffer;
   GLBuffer __glNormalBuffer;
   GLBuffer __glSkinIndicesBuffer;
-  GLBuffer __glSkinVertexABuffer;
-  GLBuffer __glSkinVertexBBuffer;
   GLBuffer __glSkinWeightsBuffer;
   GLBuffer __glTangentBuffer;
   GLBuffer __glUV2Buffer;
@@ -54,6 +53,28 @@ public:
 
   std::vector<GLBuffer> __glMorphNormalsBuffers;
   std::vector<GLBuffer> __glMorphTargetsBuffers;
+  // Bumped whenever the morph targets or the positions and normals they
+  // blend with are uploaded again
+  unsigned __glMorphVersion;
+
+  // Byte offsets of each attribute in __glVertexBuffer when the group's
+  // attributes are interleaved there (stride != 0); -1 if absent
+  struct InterleavedLayout {
+    InterleavedLayout()
+      : stride( 0 ), position( -1 ), normal( -1 ), tangent( -1 ),
+        color( -1 ), uv( -1 ), uv2( -1 ), packed( false ) { }
+    int stride;
+    int position, normal, tangent, color, uv, uv2;
+    bool packed;
+  } __glInterleaved;
+
+  // Indices uploaded as 32 bit, for groups with more than 65536 vertices
+  bool __glIndex32;
+
+  // Particles drawn through __glFaceBuffer, holding __sortArray
+  bool __glSortIndices;
+  // Particle attribute buffers uploaded in __sortArray order
+  bool __glSortedAttributes;
 
   int __glFaceCount;
   int __glLineCount;
@@ -67,33 +88,32 @@ public:
   std::vector<float> __normalArray;
   std::vector<float> __tangentArray;
   std::vector<float> __colorArray;
-  std::vector<std::pair<float, int>> __sortArray;
+  std::vector<uint32_t> __sortArray; // particle order of the last sort
 
   std::vector<float> __uvArray;
   std::vector<float> __uv2Array;
 
-  std::vector<float> __skinVertexAArray;
-  std::vector<float> __skinVertexBArray;
-  std::vector<int> __skinIndexArray;
+  std::vector<float> __skinIndexArray;
   std::vector<float> __skinWeightArray;
 
-  std::vector<uint16_t> __faceArray;
-  std::vector<uint16_t> __lineArray;
+  std::vector<uint32_t> __faceArray;
+  std::vector<uint32_t> __lineArray;
 
   bool __inittedArrays;
 
   void dispose() {
     __inittedArrays = false;
     __colorArray.clear();
-    __normalArray.clear();
     __tangentArray.clear();
     __uvArray.clear();
     __uv2Array.clear();
     __faceArray.clear();
-    __vertexArray.clear();
     __lineArray.clear();
-    __skinVertexAArray.clear();
-    __skinVertexBArray.clear();
+    // morph targets are blended from these on the CPU past the shader's limit
+    if ( numMorphTargets == 0 ) {
+      __normalArray.clear();
+      __vertexArray.clear();
+    }
     __skinIndexArray.clear();
     __skinWeightArray.clear();
   }
@@ -111,13 +131,15 @@ public:
       __glLineBuffer( 0 ),
       __glNormalBuffer( 0 ),
       __glSkinIndicesBuffer( 0 ),
-      __glSkinVertexABuffer( 0 ),
-      __glSkinVertexBBuffer( 0 ),
       __glSkinWeightsBuffer( 0 ),
       __glTangentBuffer( 0 ),
       __glUV2Buffer( 0 ),
       __glUVBuffer( 0 ),
       __glVertexBuffer( 0 ),
+      __glMorphVersion( 0 ),
+      __glIndex32( false ),
+      __glSortIndices( false ),
+      __glSortedAttributes( false ),
       __glFaceCount( 0 ),
       __glLineCount( 0 ),
       __glParticleCount( 0 ),
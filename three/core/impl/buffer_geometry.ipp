@@ -29,7 +29,7 @@ void BufferGeometry::applyMatrix( const Matrix4& matrix ) {
 
 void BufferGeometry::computeBoundingBox() {
 
-  Box bb;
+  Box bb( Vector3( Math::INF() ), Vector3( -Math::INF() ) );
 
   if ( auto positionsP = attributes.get( AttributeKey::position() ) ) {
 
@@ -40,7 +40,7 @@ void BufferGeometry::computeBoundingBox() {
       bb.min = bb.max = Vector3( positions[ 0 ], positions[ 1 ], positions[ 2 ] );
 
       for ( size_t i = 3, il = positions.size(); i < il; i += 3 ) {
-        boundingBox.bound( Vector3( positions[ i ], positions[ i + 1 ], positions[ i + 2 ] ) );
+        bb.bound( Vector3( positions[ i ], positions[ i + 1 ], positions[ i + 2 ] ) );
       }
     }
 
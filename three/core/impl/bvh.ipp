@@ -0,0 +1,756 @@
+#ifndef THREE_BVH_IPP
+#define THREE_BVH_IPP
+
+#include <three/core/bvh.hpp>
+
+#include <three/core/face.hpp>
+#include <three/core/frustum.hpp>
+#include <three/core/geometry.hpp>
+#include <three/core/object3d.hpp>
+
+#include <three/materials/material.hpp>
+
+#include <algorithm>
+
+namespace three {
+
+namespace detail {
+
+enum { BVHBins = 12, BVHMaxLeafSize = 4 };
+
+inline float surfaceArea( const Vector3& min, const Vector3& max ) {
+  auto dx = max.x - min.x, dy = max.y - min.y, dz = max.z - min.z;
+  return dx < 0.f ? 0.f : 2.f * ( dx * dy + dy * dz + dz * dx );
+}
+
+inline void growBox( Vector3& min, Vector3& max, const Vector3& bmin, const Vector3& bmax ) {
+  min.set( Math::min( min.x, bmin.x ), Math::min( min.y, bmin.y ), Math::min( min.z, bmin.z ) );
+  max.set( Math::max( max.x, bmax.x ), Math::max( max.y, bmax.y ), Math::max( max.z, bmax.z ) );
+}
+
+inline void emptyBox( Vector3& min, Vector3& max ) {
+  min.set( Math::INF(), Math::INF(), Math::INF() );
+  max.set( -Math::INF(), -Math::INF(), -Math::INF() );
+}
+
+struct BVHBin {
+  Vector3 min, max;
+  unsigned count;
+};
+
+} // namespace detail
+
+void BVH::build( const std::vector<Box>& boxes ) {
+
+  using namespace detail;
+
+  clear();
+
+  const auto count = ( unsigned )boxes.size();
+
+  if ( count == 0 )
+    return;
+
+  std::vector<Vector3> centroids( count );
+  indices.resize( count );
+
+  for ( unsigned i = 0; i < count; ++i ) {
+    centroids[ i ].add( boxes[ i ].min, boxes[ i ].max ).multiplyScalar( 0.5f );
+    indices[ i ] = i;
+  }
+
+  nodes.reserve( 2 * count / BVHMaxLeafSize + 1 );
+
+  struct Task {
+    unsigned begin, end, depth;
+    int parent; // interior node whose right child this is, or -1
+  };
+
+  std::vector<Task> tasks;
+  Task root = { 0, count, 0, -1 };
+  tasks.push_back( root );
+
+  while ( !tasks.empty() ) {
+
+    const auto task = tasks.back();
+    tasks.pop_back();
+
+    const auto index = ( unsigned )nodes.size();
+
+    if ( task.parent >= 0 ) {
+      nodes[ task.parent ].offset = index;
+    }
+
+    Node node;
+    emptyBox( node.min, node.max );
+
+    Vector3 cmin, cmax;
+    emptyBox( cmin, cmax );
+
+    for ( auto i = task.begin; i < task.end; ++i ) {
+      const auto& box = boxes[ indices[ i ] ];
+      growBox( node.min, node.max, box.min, box.max );
+      growBox( cmin, cmax, centroids[ indices[ i ] ], centroids[ indices[ i ] ] );
+    }
+
+    const auto n = task.end - task.begin;
+
+    node.offset = task.begin;
+    node.count  = n;
+    nodes.push_back( node );
+
+    if ( n <= 1 || task.depth + 1 >= MaxDepth )
+      continue;
+
+    // Binned SAH over all three axes
+
+    auto bestCost  = Math::INF();
+    auto bestAxis  = -1;
+    auto bestSplit = 0;
+
+    for ( int axis = 0; axis < 3; ++axis ) {
+
+      const auto extent = cmax[ axis ] - cmin[ axis ];
+
+      if ( extent <= 0.f )
+        continue;
+
+      BVHBin bins[ BVHBins ];
+
+      for ( auto& bin : bins ) {
+        emptyBox( bin.min, bin.max );
+        bin.count = 0;
+      }
+
+      const auto scale = BVHBins / extent;
+
+      for ( auto i = task.begin; i < task.end; ++i ) {
+        const auto p = indices[ i ];
+        auto b = ( int )( ( centroids[ p ][ axis ] - cmin[ axis ] ) * scale );
+        auto& bin = bins[ Math::min( b, ( int )BVHBins - 1 ) ];
+        growBox( bin.min, bin.max, boxes[ p ].min, boxes[ p ].max );
+        ++bin.count;
+      }
+
+      // Sweep from the right, then evaluate each plane sweeping from the left
+
+      float rightArea[ BVHBins ];
+      unsigned rightCount[ BVHBins ];
+
+      Vector3 rmin, rmax;
+      emptyBox( rmin, rmax );
+      unsigned rn = 0;
+
+      for ( int b = BVHBins - 1; b > 0; --b ) {
+        growBox( rmin, rmax, bins[ b ].min, bins[ b ].max );
+        rn += bins[ b ].count;
+        rightArea[ b ]  = surfaceArea( rmin, rmax );
+        rightCount[ b ] = rn;
+      }
+
+      Vector3 lmin, lmax;
+      emptyBox( lmin, lmax );
+      unsigned ln = 0;
+
+      for ( int b = 0; b < BVHBins - 1; ++b ) {
+        growBox( lmin, lmax, bins[ b ].min, bins[ b ].max );
+        ln += bins[ b ].count;
+        if ( ln == 0 || rightCount[ b + 1 ] == 0 )
+          continue;
+        const auto cost = surfaceArea( lmin, lmax ) * ln + rightArea[ b + 1 ] * rightCount[ b + 1 ];
+        if ( cost < bestCost ) {
+          bestCost  = cost;
+          bestAxis  = axis;
+          bestSplit = b + 1;
+        }
+      }
+
+    }
+
+    if ( bestAxis < 0 )
+      continue;
+
+    // Leaf cost is n intersections; traversal step costs about one
+
+    const auto leafCost = surfaceArea( node.min, node.max ) * n;
+
+    if ( n <= BVHMaxLeafSize && bestCost + surfaceArea( node.min, node.max ) >= leafCost )
+      continue;
+
+    const auto axis  = bestAxis;
+    const auto scale = BVHBins / ( cmax[ axis ] - cmin[ axis ] );
+    const auto split = bestSplit;
+
+    auto middle = std::partition( indices.begin() + task.begin, indices.begin() + task.end, [&]( unsigned p ) {
+      auto b = ( int )( ( centroids[ p ][ axis ] - cmin[ axis ] ) * scale );
+      return Math::min( b, ( int )BVHBins - 1 ) < split;
+    } );
+
+    const auto mid = ( unsigned )( middle - indices.begin() );
+
+    nodes[ index ].offset = 0;
+    nodes[ index ].count  = 0;
+
+    // Left is popped first, so it lands at index + 1
+
+    Task right = { mid, task.end, task.depth + 1, ( int )index };
+    Task left  = { task.begin, mid, task.depth + 1, -1 };
+    tasks.push_back( right );
+    tasks.push_back( left );
+
+  }
+
+}
+
+void BVH::refit( const std::vector<Box>& boxes ) {
+
+  // Children always follow their parent, so a reverse sweep is bottom-up
+
+  for ( auto i = ( int )nodes.size() - 1; i >= 0; --i ) {
+
+    auto& node = nodes[ i ];
+    detail::emptyBox( node.min, node.max );
+
+    if ( node.leaf() ) {
+      for ( unsigned p = node.offset; p < node.offset + node.count; ++p ) {
+        detail::growBox( node.min, node.max, boxes[ indices[ p ] ].min, boxes[ indices[ p ] ].max );
+      }
+    } else {
+      const auto& left  = nodes[ i + 1 ];
+      const auto& right = nodes[ node.offset ];
+      detail::growBox( node.min, node.max, left.min, left.max );
+      detail::growBox( node.min, node.max, right.min, right.max );
+    }
+
+  }
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+// Moller-Trumbore; returns t, or far on a miss. The sign of det tells the
+// facing: det > 0 when the ray hits the counter-clockwise (front) side.
+inline float intersectTriangle( const GeometryBVH::Triangle& tri,
+                                const Vector3& origin, const Vector3& direction,
+                                float near, float far, int side ) {
+
+  const auto& e1 = tri.ab;
+  const auto& e2 = tri.ac;
+
+  const Vector3 p( direction.y * e2.z - direction.z * e2.y,
+                   direction.z * e2.x - direction.x * e2.z,
+                   direction.x * e2.y - direction.y * e2.x );
+
+  const auto det = e1.dot( p );
+
+  if ( det == 0.f )
+    return far;
+  if ( side == THREE::FrontSide && det < 0.f )
+    return far;
+  if ( side == THREE::BackSide && det > 0.f )
+    return far;
+
+  const auto invDet = 1.f / det;
+
+  const Vector3 s( origin.x - tri.a.x, origin.y - tri.a.y, origin.z - tri.a.z );
+
+  const auto u = s.dot( p ) * invDet;
+  if ( u < 0.f || u > 1.f )
+    return far;
+
+  const Vector3 q( s.y * e1.z - s.z * e1.y,
+                   s.z * e1.x - s.x * e1.z,
+                   s.x * e1.y - s.y * e1.x );
+
+  const auto v = direction.dot( q ) * invDet;
+  if ( v < 0.f || u + v > 1.f )
+    return far;
+
+  const auto t = e2.dot( q ) * invDet;
+
+  return ( t >= near && t < far ) ? t : far;
+
+}
+
+} // namespace detail
+
+int GeometryBVH::faceSide( const Geometry& geometry, const Material& material, unsigned face, bool flip ) {
+
+  int side = material.side;
+
+  if ( material.type() == THREE::MeshFaceMaterial ) {
+    const auto& materials = geometry.materials;
+    const auto index = geometry.faces[ face ].materialIndex;
+    if ( index >= 0 && index < ( int )materials.size() && materials[ index ] )
+      side = materials[ index ]->side;
+  }
+
+  if ( flip && side != THREE::DoubleSide )
+    side = side == THREE::FrontSide ? THREE::BackSide : THREE::FrontSide;
+
+  return side;
+
+}
+
+namespace detail {
+
+// Triangles of geometry's faces over vertices, in face order
+inline void geometryTriangles( const Geometry& geometry, const std::vector<Vertex>& vertices,
+                               std::vector<GeometryBVH::Triangle>& triangles, std::vector<Box>& boxes ) {
+
+  triangles.clear();
+  boxes.clear();
+
+  triangles.reserve( geometry.faces.size() * 2 );
+  boxes.reserve( geometry.faces.size() * 2 );
+
+  auto addTriangle = [&]( const Vector3& a, const Vector3& b, const Vector3& c, unsigned face ) {
+    GeometryBVH::Triangle tri;
+    tri.a = a;
+    tri.ab.sub( b, a );
+    tri.ac.sub( c, a );
+    tri.face = face;
+    triangles.push_back( tri );
+
+    Box box( a, a );
+    box.bound( b );
+    box.bound( c );
+    boxes.push_back( box );
+  };
+
+  for ( size_t f = 0, fl = geometry.faces.size(); f < fl; ++f ) {
+
+    const auto& face = geometry.faces[ f ];
+
+    if ( face.type() == THREE::Face3 ) {
+      addTriangle( vertices[ face.a ], vertices[ face.b ], vertices[ face.c ], ( unsigned )f );
+    } else if ( face.type() == THREE::Face4 ) {
+      addTriangle( vertices[ face.a ], vertices[ face.b ], vertices[ face.d ], ( unsigned )f );
+      addTriangle( vertices[ face.b ], vertices[ face.c ], vertices[ face.d ], ( unsigned )f );
+    }
+
+  }
+
+}
+
+} // namespace detail
+
+GeometryBVH::GeometryBVH( const Geometry& geometry )
+  : fitFlagged( false ) {
+
+  detail::geometryTriangles( geometry, geometry.vertices, mSource, mSourceBoxes );
+
+  tree.build( mSourceBoxes );
+
+  // Store triangles in leaf order so each leaf reads a contiguous range
+
+  triangles.resize( mSource.size() );
+  mOrder.swap( tree.indices );
+  tree.indices.resize( mOrder.size() );
+
+  for ( size_t i = 0; i < mOrder.size(); ++i ) {
+    triangles[ i ] = mSource[ mOrder[ i ] ];
+    tree.indices[ i ] = ( unsigned )i;
+  }
+
+}
+
+bool GeometryBVH::refit( const Geometry& geometry, const std::vector<Vertex>& vertices ) {
+
+  detail::geometryTriangles( geometry, vertices, mSource, mSourceBoxes );
+
+  if ( mSource.size() != mOrder.size() )
+    return false;
+
+  mBoxes.resize( mOrder.size() );
+
+  for ( size_t i = 0; i < mOrder.size(); ++i ) {
+    triangles[ i ] = mSource[ mOrder[ i ] ];
+    mBoxes[ i ] = mSourceBoxes[ mOrder[ i ] ];
+  }
+
+  tree.refit( mBoxes );
+
+  return true;
+
+}
+
+bool GeometryBVH::intersect( const Vector3& origin, const Vector3& direction,
+                             float near, float far,
+                             const Geometry& geometry, const Material& material, bool flip,
+                             bool any, Hit& hit ) const {
+
+  auto found = false;
+
+  tree.traverse( origin, direction, near, far, [&]( unsigned index, float& tMax ) -> bool {
+
+    const auto& tri = triangles[ index ];
+    const auto side = faceSide( geometry, material, tri.face, flip );
+    const auto t = detail::intersectTriangle( tri, origin, direction, near, tMax, side );
+
+    if ( t < tMax ) {
+      tMax = t;
+      hit.distance = t;
+      hit.face = tri.face;
+      found = true;
+      return any;
+    }
+
+    return false;
+
+  } );
+
+  return found;
+
+}
+
+void GeometryBVH::intersectAll( const Vector3& origin, const Vector3& direction,
+                                float near, float far,
+                                const Geometry& geometry, const Material& material, bool flip,
+                                std::vector<Hit>& hits ) const {
+
+  tree.traverse( origin, direction, near, far, [&]( unsigned index, float& tMax ) -> bool {
+
+    const auto& tri = triangles[ index ];
+    const auto side = faceSide( geometry, material, tri.face, flip );
+    const auto t = detail::intersectTriangle( tri, origin, direction, near, tMax, side );
+
+    if ( t < tMax ) {
+      Hit h = { t, tri.face };
+      hits.push_back( h );
+    }
+
+    return false;
+
+  } );
+
+}
+
+void Geometry::computeBVH() {
+
+  bvh = GeometryBVH::create( *this );
+
+  bvhNeedsUpdate = false;
+
+}
+
+void Geometry::updateBVH() {
+
+  const auto flagged = verticesNeedUpdate || elementsNeedUpdate;
+
+  if ( bvh && ( bvhNeedsUpdate || ( flagged && !bvh->fitFlagged ) ) ) {
+    if ( !bvh->refit( *this, vertices ) ) {
+      bvh.reset();
+    }
+  }
+
+  if ( !bvh ) {
+    computeBVH();
+  }
+
+  bvh->fitFlagged = flagged;
+  bvhNeedsUpdate = false;
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+SceneBVH::SceneBVH()
+  : needsRebuild( true ),
+    mMoves( three::make_shared<SceneBVHMoves>() ),
+    mRoot( nullptr ),
+    mMoved( 0 ),
+    mStamp( 0 ) { }
+
+Box SceneBVH::worldBounds( Object3D& object ) {
+
+  if ( object.type() == THREE::Particle ) {
+    const auto position = object.matrixWorld.getPosition();
+    const Vector3 extent( object.scale.x );
+    return Box( Vector3().sub( position, extent ), Vector3().add( position, extent ) );
+  }
+
+  return Frustum::worldBox( object );
+
+}
+
+void SceneBVH::build( Object3D& root ) {
+
+  std::vector<Object3D*> list;
+  std::vector<Object3D*> stack( 1, &root );
+
+  while ( !stack.empty() ) {
+
+    auto object = stack.back();
+    stack.pop_back();
+
+    if ( object->type() == THREE::Particle || object->geometry ) {
+      list.push_back( object );
+    }
+
+    for ( auto& child : object->children ) {
+      stack.push_back( child.get() );
+    }
+
+  }
+
+  build( list );
+
+  mRoot = &root;
+
+}
+
+void SceneBVH::build( const std::vector<Object3D*>& list ) {
+
+  objects = list;
+  boxes.resize( objects.size() );
+  versions.resize( objects.size() );
+  culled.resize( objects.size() );
+  unculled.clear();
+
+  // Claim the objects, so they report their moves here
+
+  mMoves->clear();
+  mMoves->queued.assign( objects.size(), 0 );
+  mMoves->shared = false;
+
+  for ( size_t i = 0; i < objects.size(); ++i ) {
+
+    auto& object = *objects[ i ];
+
+    boxes[ i ]    = worldBounds( object );
+    versions[ i ] = object.matrixWorldVersion;
+    culled[ i ]   = object.frustumCulled;
+
+    if ( !object.frustumCulled ) {
+      unculled.push_back( ( unsigned )i );
+    }
+
+    if ( object.__spatialMoves && object.__spatialMoves != mMoves ) {
+      object.__spatialMoves->shared = true;
+    }
+
+    object.__spatialMoves = mMoves;
+    object.__spatialSlot  = ( unsigned )i;
+
+  }
+
+  tree.build( boxes );
+
+  // Links for partial refits
+
+  const auto nodeCount = tree.nodes.size();
+
+  parents.assign( nodeCount, 0 );
+  leaves.assign( objects.size(), 0 );
+
+  for ( unsigned n = 0; n < nodeCount; ++n ) {
+    const auto& node = tree.nodes[ n ];
+    if ( node.leaf() ) {
+      for ( unsigned i = node.offset; i < node.offset + node.count; ++i ) {
+        leaves[ tree.indices[ i ] ] = n;
+      }
+    } else {
+      parents[ n + 1 ] = n;
+      parents[ node.offset ] = n;
+    }
+  }
+
+  needsRebuild = false;
+  mRoot  = nullptr;
+  mMoved = 0;
+
+}
+
+void SceneBVH::update( Object3D& root ) {
+
+  if ( needsRebuild || mRoot != &root ) {
+    build( root );
+    return;
+  }
+
+  size_t moved = 0;
+
+  if ( mMoves->shared ) {
+    for ( size_t i = 0; i < objects.size(); ++i ) {
+      if ( refitObject( i ) ) ++moved;
+    }
+  } else {
+    for ( auto slot : mMoves->slots ) {
+      if ( refitObject( slot ) ) ++moved;
+    }
+  }
+
+  mMoves->clear();
+
+  // Refitting keeps the topology, which degrades as objects drift; rebuild
+  // once a quarter of the objects have moved since the last build
+
+  mMoved += moved;
+
+  if ( mMoved * 4 > objects.size() ) {
+    build( root );
+  }
+
+}
+
+bool SceneBVH::refitObject( size_t i ) {
+
+  auto& object = *objects[ i ];
+
+  if ( versions[ i ] == object.matrixWorldVersion )
+    return false;
+
+  versions[ i ] = object.matrixWorldVersion;
+
+  const auto box = worldBounds( object );
+  auto& current = boxes[ i ];
+
+  if ( box.min.x == current.min.x && box.min.y == current.min.y && box.min.z == current.min.z &&
+       box.max.x == current.max.x && box.max.y == current.max.y && box.max.z == current.max.z )
+    return false;
+
+  current = box;
+  refitPath( leaves[ i ] );
+
+  return true;
+
+}
+
+void SceneBVH::refitPath( unsigned n ) {
+
+  for ( ;; ) {
+
+    auto& node = tree.nodes[ n ];
+    const auto min = node.min, max = node.max;
+
+    detail::emptyBox( node.min, node.max );
+
+    if ( node.leaf() ) {
+      for ( unsigned i = node.offset; i < node.offset + node.count; ++i ) {
+        const auto& box = boxes[ tree.indices[ i ] ];
+        detail::growBox( node.min, node.max, box.min, box.max );
+      }
+    } else {
+      const auto& left  = tree.nodes[ n + 1 ];
+      const auto& right = tree.nodes[ node.offset ];
+      detail::growBox( node.min, node.max, left.min, left.max );
+      detail::growBox( node.min, node.max, right.min, right.max );
+    }
+
+    // Ancestors only change if this node did
+
+    if ( n == 0 ||
+         ( node.min.x == min.x && node.min.y == min.y && node.min.z == min.z &&
+           node.max.x == max.x && node.max.y == max.y && node.max.z == max.z ) )
+      return;
+
+    n = parents[ n ];
+
+  }
+
+}
+
+namespace detail {
+
+template < typename F >
+inline void cullSceneBVH( const SceneBVH& index, const Frustum& frustum, F&& accept ) {
+
+  const auto& tree = index.tree;
+
+  if ( tree.empty() )
+    return;
+
+  struct Entry {
+    unsigned node;
+    unsigned planes;
+  };
+
+  Entry stack[ BVH::MaxDepth + 1 ];
+  unsigned top = 0;
+
+  Entry root = { 0, Frustum::AllPlanes };
+  stack[ top++ ] = root;
+
+  while ( top > 0 ) {
+
+    auto entry = stack[ --top ];
+    const auto& node = tree.nodes[ entry.node ];
+
+    if ( entry.planes ) {
+      if ( frustum.intersectsBox( Box( node.min, node.max ), entry.planes ) == Frustum::Outside )
+        continue;
+    }
+
+    if ( node.leaf() ) {
+
+      for ( unsigned i = node.offset; i < node.offset + node.count; ++i ) {
+        const auto p = tree.indices[ i ];
+        auto planes = entry.planes;
+        if ( planes == 0 || node.count == 1 ||
+             frustum.intersectsBox( index.boxes[ p ], planes ) != Frustum::Outside ) {
+          accept( p );
+        }
+      }
+
+    } else {
+
+      Entry left  = { entry.node + 1, entry.planes };
+      Entry right = { node.offset, entry.planes };
+      stack[ top++ ] = right;
+      stack[ top++ ] = left;
+
+    }
+
+  }
+
+}
+
+} // namespace detail
+
+void SceneBVH::cull( const Frustum& frustum, std::vector<Object3D*>& visible ) const {
+
+  for ( auto i : unculled ) {
+    visible.push_back( objects[ i ] );
+  }
+
+  detail::cullSceneBVH( *this, frustum, [&]( unsigned i ) {
+    if ( culled[ i ] ) visible.push_back( objects[ i ] );
+  } );
+
+}
+
+unsigned SceneBVH::cull( const Frustum& frustum ) {
+
+  const auto stamp = ++mStamp;
+
+  for ( auto i : unculled ) {
+    objects[ i ]->__cullStamp = stamp;
+  }
+
+  detail::cullSceneBVH( *this, frustum, [&]( unsigned i ) {
+    objects[ i ]->__cullStamp = stamp;
+  } );
+
+  return stamp;
+
+}
+
+void SceneBVH::refit() {
+
+  for ( size_t i = 0; i < objects.size(); ++i ) {
+    boxes[ i ]    = worldBounds( *objects[ i ] );
+    versions[ i ] = objects[ i ]->matrixWorldVersion;
+  }
+
+  mMoves->clear();
+
+  tree.refit( boxes );
+
+}
+
+} // namespace three
+
+#endif // THREE_BVH_IPP
@@ -9,6 +9,8 @@
 
 #include <three/objects/mesh.hpp>
 
+#include <three/utils/simd.hpp>
+
 #include <array>
 
 namespace three {
@@ -37,21 +39,441 @@ void Frustum::setFromMatrix( const Matrix4& m ) {
 
 bool Frustum::contains( const Object3D& object ) const {
 
+  return intersectsObject( object ) != Outside;
+
+}
+
+Frustum::Containment Frustum::intersectsObject( const Object3D& object ) const {
+
   if ( !object.geometry )
-    return false;
+    return Intersects;
 
-  auto distance = 0.0f;
+  const auto& geometry = *object.geometry;
   const auto& matrix = object.matrixWorld;
+
+  if ( geometry.boundingBox.empty() ) {
+    return intersectsSphere( matrix.getPosition(),
+                             geometry.boundingSphere.radius * matrix.getMaxScaleOnAxis() );
+  }
+
+  unsigned planeMask = AllPlanes;
+  return intersectsBox( geometry.boundingBox, matrix, planeMask, object.__frustumPlane );
+
+}
+
+Frustum::Containment Frustum::intersectsSphere( const Vector3& center, float radius ) const {
+
+  auto result = Inside;
+
+  for ( const auto& plane : planes ) {
+    auto distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+    if ( distance <= -radius )
+      return Outside;
+    if ( distance < radius )
+      result = Intersects;
+  }
+
+  return result;
+
+}
+
+Frustum::Containment Frustum::intersectsBox( const Box& box, const Matrix4& matrix,
+                                             unsigned& planeMask, int& lastPlane ) const {
+
+  const auto& me = matrix.elements;
+
+  auto center = Vector3().add( box.min, box.max ).multiplyScalar( 0.5f );
+  matrix.multiplyVector3( center );
+  const auto half   = Vector3().sub( box.max, box.min ).multiplyScalar( 0.5f );
+
+  auto testPlane = [&]( int i ) -> Containment {
+
+    const auto& p = planes[ i ];
+
+    const auto distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+    const auto radius   = Math::abs( p.x * me[0] + p.y * me[1] + p.z * me[2] ) * half.x
+                        + Math::abs( p.x * me[4] + p.y * me[5] + p.z * me[6] ) * half.y
+                        + Math::abs( p.x * me[8] + p.y * me[9] + p.z * me[10] ) * half.z;
+
+    if ( distance + radius < 0 )
+      return Outside;
+    if ( distance - radius < 0 )
+      return Intersects;
+    return Inside;
+
+  };
+
+  // Plane coherency: an object rejected last frame is usually rejected by
+  // the same plane again
+
+  if ( lastPlane >= 0 && lastPlane < 6 && ( planeMask & ( 1u << lastPlane ) ) ) {
+    if ( testPlane( lastPlane ) == Outside )
+      return Outside;
+  }
+
+  auto result = Inside;
+
+  for ( int i = 0; i < 6; ++i ) {
+
+    const auto bit = 1u << i;
+
+    if ( !( planeMask & bit ) || i == lastPlane )
+      continue;
+
+    const auto side = testPlane( i );
+
+    if ( side == Outside ) {
+      lastPlane = i;
+      return Outside;
+    }
+
+    if ( side == Inside ) {
+      planeMask &= ~bit;
+    } else {
+      result = Intersects;
+    }
+
+  }
+
+  // lastPlane was tested first and not rejected; check whether it straddles
+
+  if ( lastPlane >= 0 && lastPlane < 6 && ( planeMask & ( 1u << lastPlane ) ) ) {
+    if ( testPlane( lastPlane ) == Inside ) {
+      planeMask &= ~( 1u << lastPlane );
+    } else {
+      result = Intersects;
+    }
+  }
+
+  return planeMask ? result : Inside;
+
+}
+
+Frustum::Containment Frustum::intersectsBox( const Box& box, unsigned& planeMask ) const {
+
+  static const Matrix4 identity;
+  int lastPlane = -1;
+
+  return intersectsBox( box, identity, planeMask, lastPlane );
+
+}
+
+Frustum::Containment Frustum::intersectsBox( const Box& box ) const {
+
+  unsigned planeMask = AllPlanes;
+
+  return intersectsBox( box, planeMask );
+
+}
+
+Box Frustum::worldBox( const Object3D& object ) {
+
+  if ( !object.geometry ) {
+    return Box( Vector3( -Math::INF() ), Vector3( Math::INF() ) );
+  }
+
+  return worldBox( *object.geometry, object.matrixWorld );
+
+}
+
+Box Frustum::worldBox( const Geometry& geometry, const Matrix4& matrix ) {
+
+  if ( geometry.boundingBox.empty() ) {
+    const auto center = matrix.getPosition();
+    const Vector3 radius( geometry.boundingSphere.radius * matrix.getMaxScaleOnAxis() );
+    return Box( Vector3().sub( center, radius ), Vector3().add( center, radius ) );
+  }
+
+  // Arvo: transform the center, sum the absolute extents
+
+  const auto& box = geometry.boundingBox;
   const auto& me = matrix.elements;
-  auto radius = -object.geometry->boundingSphere.radius * matrix.getMaxScaleOnAxis();
 
-  for ( int i = 0; i < 6; i ++ ) {
-    distance = planes[ i ].x * me[12] + planes[ i ].y * me[13] + planes[ i ].z * me[14] + planes[ i ].w;
-    if ( distance <= radius )
-      return false;
+  auto center = Vector3().add( box.min, box.max ).multiplyScalar( 0.5f );
+  matrix.multiplyVector3( center );
+  const auto half   = Vector3().sub( box.max, box.min ).multiplyScalar( 0.5f );
+
+  Vector3 extent;
+  for ( int i = 0; i < 3; ++i ) {
+    extent[ i ] = Math::abs( me[ i ] ) * half.x + Math::abs( me[ i + 4 ] ) * half.y + Math::abs( me[ i + 8 ] ) * half.z;
+  }
+
+  return Box( Vector3().sub( center, extent ), Vector3().add( center, extent ) );
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+namespace detail {
+
+inline unsigned char classifyBox( const std::array<Vector4, 6>& planes, const Box& box, int* lastPlane ) {
+
+  const auto center = Vector3().add( box.min, box.max ).multiplyScalar( 0.5f );
+  const auto half   = Vector3().sub( box.max, box.min ).multiplyScalar( 0.5f );
+
+  auto distance = [&]( const Vector4& p ) {
+    return p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+  };
+  auto radius = [&]( const Vector4& p ) {
+    return Math::abs( p.x ) * half.x + Math::abs( p.y ) * half.y + Math::abs( p.z ) * half.z;
+  };
+
+  if ( lastPlane && *lastPlane >= 0 && *lastPlane < 6 ) {
+    const auto& p = planes[ *lastPlane ];
+    if ( distance( p ) + radius( p ) < 0 )
+      return Frustum::Outside;
+  }
+
+  unsigned char result = Frustum::Inside;
+
+  for ( int i = 0; i < 6; ++i ) {
+    const auto d = distance( planes[ i ] );
+    const auto r = radius( planes[ i ] );
+    if ( d + r < 0 ) {
+      if ( lastPlane ) *lastPlane = i;
+      return Frustum::Outside;
+    }
+    if ( d - r < 0 )
+      result = Frustum::Intersects;
+  }
+
+  return result;
+
+}
+
+// The cached plane of each lane, or one that rejects nothing
+
+inline const Vector4& cachedPlane( const std::array<Vector4, 6>& planes, int plane ) {
+
+  static const Vector4 none( 0, 0, 0, 1 );
+  return plane >= 0 && plane < 6 ? planes[ plane ] : none;
+
+}
+
+#if THREE_SIMD_X86
+
+// Boxes are loaded as center/half-extent SoA; per plane, outside lanes have
+// d + r < 0 and straddling lanes d - r < 0. With lastPlanes, each lane's
+// cached plane is tested first and the planes stop once every lane is out.
+
+THREE_TARGET_SSE inline void classifyBoxesSSE( const std::array<Vector4, 6>& planes,
+                                               const Box* boxes, size_t count, unsigned char* results,
+                                               int* lastPlanes ) {
+
+  const auto half = _mm_set1_ps( 0.5f );
+  const auto absMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+
+  size_t i = 0;
+
+  for ( ; i + 4 <= count; i += 4 ) {
+
+    const auto& b0 = boxes[ i ];
+    const auto& b1 = boxes[ i + 1 ];
+    const auto& b2 = boxes[ i + 2 ];
+    const auto& b3 = boxes[ i + 3 ];
+
+    const auto minX = _mm_set_ps( b3.min.x, b2.min.x, b1.min.x, b0.min.x );
+    const auto minY = _mm_set_ps( b3.min.y, b2.min.y, b1.min.y, b0.min.y );
+    const auto minZ = _mm_set_ps( b3.min.z, b2.min.z, b1.min.z, b0.min.z );
+    const auto maxX = _mm_set_ps( b3.max.x, b2.max.x, b1.max.x, b0.max.x );
+    const auto maxY = _mm_set_ps( b3.max.y, b2.max.y, b1.max.y, b0.max.y );
+    const auto maxZ = _mm_set_ps( b3.max.z, b2.max.z, b1.max.z, b0.max.z );
+
+    const auto cx = _mm_mul_ps( _mm_add_ps( minX, maxX ), half );
+    const auto cy = _mm_mul_ps( _mm_add_ps( minY, maxY ), half );
+    const auto cz = _mm_mul_ps( _mm_add_ps( minZ, maxZ ), half );
+    const auto ex = _mm_mul_ps( _mm_sub_ps( maxX, minX ), half );
+    const auto ey = _mm_mul_ps( _mm_sub_ps( maxY, minY ), half );
+    const auto ez = _mm_mul_ps( _mm_sub_ps( maxZ, minZ ), half );
+
+    auto outside    = _mm_setzero_ps();
+    auto intersects = _mm_setzero_ps();
+
+    if ( lastPlanes ) {
+
+      const auto& p0 = cachedPlane( planes, lastPlanes[ i ] );
+      const auto& p1 = cachedPlane( planes, lastPlanes[ i + 1 ] );
+      const auto& p2 = cachedPlane( planes, lastPlanes[ i + 2 ] );
+      const auto& p3 = cachedPlane( planes, lastPlanes[ i + 3 ] );
+
+      const auto px = _mm_set_ps( p3.x, p2.x, p1.x, p0.x );
+      const auto py = _mm_set_ps( p3.y, p2.y, p1.y, p0.y );
+      const auto pz = _mm_set_ps( p3.z, p2.z, p1.z, p0.z );
+      const auto pw = _mm_set_ps( p3.w, p2.w, p1.w, p0.w );
+
+      const auto distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( px, cx ), _mm_mul_ps( py, cy ) ),
+                                        _mm_add_ps( _mm_mul_ps( pz, cz ), pw ) );
+      const auto radius   = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_and_ps( px, absMask ), ex ),
+                                                    _mm_mul_ps( _mm_and_ps( py, absMask ), ey ) ),
+                                        _mm_mul_ps( _mm_and_ps( pz, absMask ), ez ) );
+
+      outside = _mm_cmplt_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps() );
+
+    }
+
+    for ( int k = 0; k < 6 && _mm_movemask_ps( outside ) != 0xF; ++k ) {
+
+      const auto& p = planes[ k ];
+
+      const auto px = _mm_set1_ps( p.x ), py = _mm_set1_ps( p.y ), pz = _mm_set1_ps( p.z );
+
+      const auto distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( px, cx ), _mm_mul_ps( py, cy ) ),
+                                        _mm_add_ps( _mm_mul_ps( pz, cz ), _mm_set1_ps( p.w ) ) );
+      const auto radius   = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_and_ps( px, absMask ), ex ),
+                                                    _mm_mul_ps( _mm_and_ps( py, absMask ), ey ) ),
+                                        _mm_mul_ps( _mm_and_ps( pz, absMask ), ez ) );
+
+      const auto rejected = _mm_cmplt_ps( _mm_add_ps( distance, radius ), _mm_setzero_ps() );
+
+      if ( lastPlanes ) {
+        const auto fresh = _mm_movemask_ps( _mm_andnot_ps( outside, rejected ) );
+        for ( int j = 0; j < 4; ++j ) {
+          if ( ( fresh >> j ) & 1 ) lastPlanes[ i + j ] = k;
+        }
+      }
+
+      outside    = _mm_or_ps( outside,    rejected );
+      intersects = _mm_or_ps( intersects, _mm_cmplt_ps( _mm_sub_ps( distance, radius ), _mm_setzero_ps() ) );
+
+    }
+
+    const auto out = _mm_movemask_ps( outside );
+    const auto cut = _mm_movemask_ps( intersects );
+
+    for ( int j = 0; j < 4; ++j ) {
+      results[ i + j ] = ( out >> j ) & 1 ? Frustum::Outside
+                       : ( cut >> j ) & 1 ? Frustum::Intersects
+                       : Frustum::Inside;
+    }
+
+  }
+
+  for ( ; i < count; ++i ) {
+    results[ i ] = classifyBox( planes, boxes[ i ], lastPlanes ? &lastPlanes[ i ] : nullptr );
   }
 
-  return true;
+}
+
+THREE_TARGET_AVX inline void classifyBoxesAVX( const std::array<Vector4, 6>& planes,
+                                               const Box* boxes, size_t count, unsigned char* results,
+                                               int* lastPlanes ) {
+
+  const auto half = _mm256_set1_ps( 0.5f );
+  const auto absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+  const auto zero = _mm256_setzero_ps();
+
+  size_t i = 0;
+
+  for ( ; i + 8 <= count; i += 8 ) {
+
+    const auto* b = boxes + i;
+
+#define THREE_BOX_LANES( f ) _mm256_set_ps( b[7].f, b[6].f, b[5].f, b[4].f, b[3].f, b[2].f, b[1].f, b[0].f )
+    const auto minX = THREE_BOX_LANES( min.x );
+    const auto minY = THREE_BOX_LANES( min.y );
+    const auto minZ = THREE_BOX_LANES( min.z );
+    const auto maxX = THREE_BOX_LANES( max.x );
+    const auto maxY = THREE_BOX_LANES( max.y );
+    const auto maxZ = THREE_BOX_LANES( max.z );
+#undef THREE_BOX_LANES
+
+    const auto cx = _mm256_mul_ps( _mm256_add_ps( minX, maxX ), half );
+    const auto cy = _mm256_mul_ps( _mm256_add_ps( minY, maxY ), half );
+    const auto cz = _mm256_mul_ps( _mm256_add_ps( minZ, maxZ ), half );
+    const auto ex = _mm256_mul_ps( _mm256_sub_ps( maxX, minX ), half );
+    const auto ey = _mm256_mul_ps( _mm256_sub_ps( maxY, minY ), half );
+    const auto ez = _mm256_mul_ps( _mm256_sub_ps( maxZ, minZ ), half );
+
+    auto outside    = _mm256_setzero_ps();
+    auto intersects = _mm256_setzero_ps();
+
+    if ( lastPlanes ) {
+
+      const Vector4* p[ 8 ];
+      for ( int j = 0; j < 8; ++j ) {
+        p[ j ] = &cachedPlane( planes, lastPlanes[ i + j ] );
+      }
+
+#define THREE_PLANE_LANES( f ) _mm256_set_ps( p[7]->f, p[6]->f, p[5]->f, p[4]->f, p[3]->f, p[2]->f, p[1]->f, p[0]->f )
+      const auto px = THREE_PLANE_LANES( x );
+      const auto py = THREE_PLANE_LANES( y );
+      const auto pz = THREE_PLANE_LANES( z );
+      const auto pw = THREE_PLANE_LANES( w );
+#undef THREE_PLANE_LANES
+
+      const auto distance = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( px, cx ), _mm256_mul_ps( py, cy ) ),
+                                           _mm256_add_ps( _mm256_mul_ps( pz, cz ), pw ) );
+      const auto radius   = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( _mm256_and_ps( px, absMask ), ex ),
+                                                          _mm256_mul_ps( _mm256_and_ps( py, absMask ), ey ) ),
+                                           _mm256_mul_ps( _mm256_and_ps( pz, absMask ), ez ) );
+
+      outside = _mm256_cmp_ps( _mm256_add_ps( distance, radius ), zero, _CMP_LT_OQ );
+
+    }
+
+    for ( int k = 0; k < 6 && _mm256_movemask_ps( outside ) != 0xFF; ++k ) {
+
+      const auto& p = planes[ k ];
+
+      const auto px = _mm256_set1_ps( p.x ), py = _mm256_set1_ps( p.y ), pz = _mm256_set1_ps( p.z );
+
+      const auto distance = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( px, cx ), _mm256_mul_ps( py, cy ) ),
+                                           _mm256_add_ps( _mm256_mul_ps( pz, cz ), _mm256_set1_ps( p.w ) ) );
+      const auto radius   = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( _mm256_and_ps( px, absMask ), ex ),
+                                                          _mm256_mul_ps( _mm256_and_ps( py, absMask ), ey ) ),
+                                           _mm256_mul_ps( _mm256_and_ps( pz, absMask ), ez ) );
+
+      const auto rejected = _mm256_cmp_ps( _mm256_add_ps( distance, radius ), zero, _CMP_LT_OQ );
+
+      if ( lastPlanes ) {
+        const auto fresh = _mm256_movemask_ps( _mm256_andnot_ps( outside, rejected ) );
+        for ( int j = 0; j < 8; ++j ) {
+          if ( ( fresh >> j ) & 1 ) lastPlanes[ i + j ] = k;
+        }
+      }
+
+      outside    = _mm256_or_ps( outside,    rejected );
+      intersects = _mm256_or_ps( intersects, _mm256_cmp_ps( _mm256_sub_ps( distance, radius ), zero, _CMP_LT_OQ ) );
+
+    }
+
+    const auto out = _mm256_movemask_ps( outside );
+    const auto cut = _mm256_movemask_ps( intersects );
+
+    for ( int j = 0; j < 8; ++j ) {
+      results[ i + j ] = ( out >> j ) & 1 ? Frustum::Outside
+                       : ( cut >> j ) & 1 ? Frustum::Intersects
+                       : Frustum::Inside;
+    }
+
+  }
+
+  _mm256_zeroupper();
+
+  classifyBoxesSSE( planes, boxes + i, count - i, results + i, lastPlanes ? lastPlanes + i : nullptr );
+
+}
+
+#endif // THREE_SIMD_X86
+
+} // namespace detail
+
+void Frustum::intersectsBoxes( const Box* boxes, size_t count, unsigned char* results, int* lastPlanes ) const {
+
+#if THREE_SIMD_X86
+  if ( simd::level() >= simd::AVX ) {
+    detail::classifyBoxesAVX( planes, boxes, count, results, lastPlanes );
+    return;
+  }
+  if ( simd::level() >= simd::SSE ) {
+    detail::classifyBoxesSSE( planes, boxes, count, results, lastPlanes );
+    return;
+  }
+#endif
+
+  for ( size_t i = 0; i < count; ++i ) {
+    results[ i ] = detail::classifyBox( planes, boxes[ i ], lastPlanes ? &lastPlanes[ i ] : nullptr );
+  }
 
 }
 
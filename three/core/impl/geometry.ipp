@@ -3,6 +3,8 @@
 
 #include <three/core/geometry.hpp>
 
+#include <three/core/transform_kernels.hpp>
+
 namespace three {
 
 template <class T>
@@ -28,22 +30,26 @@ void Geometry::applyMatrix( const Matrix4& matrix ) {
   Matrix4 matrixRotation;
   matrixRotation.extractRotation( matrix );
 
-  for ( auto& vertex : vertices ) {
-    matrix.multiplyVector3( vertex );
-  }
+  matrix.multiplyVector3Array( vertices );
 
-  for ( auto& face : faces ) {
+  bvh.reset();
 
-    matrixRotation.multiplyVector3( face.normal );
+  if ( faces.empty() )
+    return;
 
-    for ( auto i = 0; i < face.size(); ++i ) {
-      matrixRotation.multiplyVector3( face.vertexNormals[i] );
-    }
+  // Face attributes are transformed in place as strided arrays over the face list
+
+  const auto stride = sizeof( Face );
 
-    matrix.multiplyVector3( face.centroid );
+  simd::transformDirections( matrixRotation, &faces[ 0 ].normal.x, stride, &faces[ 0 ].normal.x, stride, faces.size() );
 
+  for ( auto i = 0; i < 4; ++i ) {
+    auto normals = &faces[ 0 ].vertexNormals[ i ].x;
+    simd::transformDirections( matrixRotation, normals, stride, normals, stride, faces.size() );
   }
 
+  simd::transformPoints( matrix, &faces[ 0 ].centroid.x, stride, &faces[ 0 ].centroid.x, stride, faces.size() );
+
 }
 
 void Geometry::computeCentroids() {
@@ -115,6 +121,51 @@ void Geometry::computeVertexNormals() {
 
 }
 
+void Geometry::computeMorphNormals() {
+
+  // Computed in place with each target's vertices, keeping the geometry's
+  // own vertices and normals aside
+
+  std::vector<Vertex> original;
+  original.swap( vertices );
+
+  std::vector<Vector3> faceNormals( faces.size() );
+  std::vector<std::array<Vector3, 4>> vertexNormals( faces.size() );
+
+  for ( size_t f = 0; f < faces.size(); ++f ) {
+    faceNormals[ f ]   = faces[ f ].normal;
+    vertexNormals[ f ] = faces[ f ].vertexNormals;
+  }
+
+  morphNormals.resize( morphTargets.size() );
+
+  for ( size_t t = 0; t < morphTargets.size(); ++t ) {
+
+    vertices = morphTargets[ t ].vertices;
+
+    computeFaceNormals();
+    computeVertexNormals();
+
+    auto& target = morphNormals[ t ];
+    target.faceNormals.resize( faces.size() );
+    target.vertexNormals.resize( faces.size() );
+
+    for ( size_t f = 0; f < faces.size(); ++f ) {
+      target.faceNormals[ f ]   = faces[ f ].normal;
+      target.vertexNormals[ f ] = faces[ f ].vertexNormals;
+    }
+
+  }
+
+  vertices.swap( original );
+
+  for ( size_t f = 0; f < faces.size(); ++f ) {
+    faces[ f ].normal        = faceNormals[ f ];
+    faces[ f ].vertexNormals = vertexNormals[ f ];
+  }
+
+}
+
 void Geometry::computeTangents() {
 
     // based on http://www.terathon.com/code/tangent.html
@@ -294,6 +345,8 @@ void Geometry::mergeVertices() {
 
   vertices = std::move( unique );
 
+  bvh.reset();
+
 }
 
 /////////////////////////////////////////////////////////////////////////
@@ -301,6 +354,7 @@ void Geometry::mergeVertices() {
 Geometry::Geometry()
   : id( GeometryCount()++ ),
     faceVertexUvs( 2 ),
+    boundingBox( Vector3( Math::INF() ), Vector3( -Math::INF() ) ),
     hasTangents( false ),
     dynamic( true ),
     verticesNeedUpdate( false ),
@@ -309,7 +363,8 @@ Geometry::Geometry()
     uvsNeedUpdate( false ),
     normalsNeedUpdate( false ),
     tangentsNeedUpdate( false ),
-    colorsNeedUpdate( false ) { }
+    colorsNeedUpdate( false ),
+    bvhNeedsUpdate( false ) { }
 
 Geometry::~Geometry() { }
 
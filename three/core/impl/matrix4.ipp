@@ -3,6 +3,8 @@
 
 #include <three/core/matrix4.hpp>
 
+#include <three/core/transform_kernels.hpp>
+
 namespace three {
 
 Matrix4::Matrix4() {
@@ -232,25 +234,58 @@ Vector4 Matrix4::multiplyVector4( const Vector4& v ) const {
 
 std::vector<float>& Matrix4::multiplyVector3Array( std::vector<float>& a ) const {
 
-  Vector3 tmp;
+  simd::transformPoints( *this, a.data(), 3 * sizeof( float ), a.data(), 3 * sizeof( float ), a.size() / 3 );
+
+  return a;
+}
+
+std::vector<Vertex>& Matrix4::multiplyVector3Array( std::vector<Vertex>& a ) const {
+
+  if ( !a.empty() ) {
+    simd::transformPoints( *this, &a[ 0 ].x, sizeof( Vertex ), &a[ 0 ].x, sizeof( Vertex ), a.size() );
+  }
+
+  return a;
+}
 
-  for ( size_t i = 0, il = a.size(); i < il; i += 3 ) {
+std::vector<float>& Matrix4::multiplyDirection3Array( std::vector<float>& a ) const {
 
-    tmp.x = a[ i ];
-    tmp.y = a[ i + 1 ];
-    tmp.z = a[ i + 2 ];
+  simd::transformDirections( *this, a.data(), 3 * sizeof( float ), a.data(), 3 * sizeof( float ), a.size() / 3 );
 
-    multiplyVector3( tmp );
+  return a;
+}
 
-    a[ i ]     = tmp.x;
-    a[ i + 1 ] = tmp.y;
-    a[ i + 2 ] = tmp.z;
+std::vector<Vertex>& Matrix4::multiplyDirection3Array( std::vector<Vertex>& a ) const {
 
+  if ( !a.empty() ) {
+    simd::transformDirections( *this, &a[ 0 ].x, sizeof( Vertex ), &a[ 0 ].x, sizeof( Vertex ), a.size() );
   }
 
   return a;
 }
 
+std::vector<float>& Matrix4::projectVector3Array( const std::vector<float>& a, std::vector<float>& out ) const {
+
+  const auto count = a.size() / 3;
+
+  out.resize( count * 4 );
+
+  simd::projectPoints( *this, a.data(), 3 * sizeof( float ), out.data(), 4 * sizeof( float ), count );
+
+  return out;
+}
+
+std::vector<Vector4>& Matrix4::projectVector3Array( const std::vector<Vertex>& a, std::vector<Vector4>& out ) const {
+
+  out.resize( a.size() );
+
+  if ( !a.empty() ) {
+    simd::projectPoints( *this, &a[ 0 ].x, sizeof( Vertex ), &out[ 0 ].x, sizeof( Vector4 ), a.size() );
+  }
+
+  return out;
+}
+
 Vector3& Matrix4::rotateAxis( Vector3& v ) const {
 
   auto vx = v.x, vy = v.y, vz = v.z;
@@ -3,6 +3,9 @@
 
 #include <three/core/object3d.hpp>
 
+#include <three/core/bvh.hpp>
+#include <three/core/transform_store.hpp>
+
 #include <three/console.hpp>
 
 namespace three {
@@ -18,11 +21,14 @@ void Object3D::applyMatrix( const Matrix4& m ) {
 
   position = matrix.getPosition();
 
+  touch();
+
 }
 
 void Object3D::translate( float distance, Vector3 axis ) {
   matrix.rotateAxis( axis );
   position.addSelf( axis.multiplyScalar( distance ) );
+  touch();
 }
 
 void Object3D::translateX( float distance ) {
@@ -46,6 +52,8 @@ void Object3D::lookAt( const Vector3& vector ) {
     rotation = matrix.getEulerRotation( eulerOrder );
   }
 
+  touch();
+
 }
 
 void Object3D::add( const Object3D::Ptr& object ) {
@@ -65,6 +73,12 @@ void Object3D::add( const Object3D::Ptr& object ) {
   object->parent = this;
   children.push_back( object );
 
+  if ( __transformStore ) {
+    __transformStore->invalidate();
+  }
+
+  object->touch();
+
   // add to scene
 
   auto scene = this;
@@ -88,6 +102,10 @@ void Object3D::remove( const Object3D::Ptr& object ) {
     object->parent = nullptr;
     children.erase( index );
 
+    if ( __transformStore ) {
+      __transformStore->invalidate();
+    }
+
     // remove from scene
 
     auto scene = this;
@@ -127,6 +145,43 @@ Object3D::Ptr Object3D::getChildByName( const std::string& name, bool recursive
 
 }
 
+void Object3D::setPosition( const Vector3& value ) {
+  position = value;
+  touch();
+}
+
+void Object3D::setRotation( const Vector3& value ) {
+  rotation = value;
+  touch();
+}
+
+void Object3D::setScale( const Vector3& value ) {
+  scale = value;
+  touch();
+}
+
+void Object3D::setQuaternion( const Quaternion& value ) {
+  quaternion = value;
+  touch();
+}
+
+void Object3D::touch() {
+
+  __matrixDirty = true;
+
+  if ( __transformStore ) {
+    __transformStore->touch( __transformIndex );
+  }
+
+  // Flag the path to the root; stop at the first ancestor already flagged,
+  // as everything above it is flagged too.
+
+  for ( auto node = parent; node != nullptr && !node->__childrenDirty; node = node->parent ) {
+    node->__childrenDirty = true;
+  }
+
+}
+
 void Object3D::updateMatrix() {
 
   matrix.setPosition( position );
@@ -148,6 +203,16 @@ void Object3D::updateMatrix() {
 
 void Object3D::updateMatrixWorld( bool force /*= false*/ ) {
 
+  if ( transformStore ) {
+    transformStore->update( *this, force );
+    return;
+  }
+
+  if ( matrixDirtyTracking ) {
+    updateMatrixWorldTracked( force );
+    return;
+  }
+
   if ( matrixAutoUpdate ) updateMatrix();
 
   if ( matrixWorldNeedsUpdate || force ) {
@@ -158,11 +223,15 @@ void Object3D::updateMatrixWorld( bool force /*= false*/ ) {
       matrixWorld.copy( matrix );
     }
 
+    matrixWorldChanged();
     matrixWorldNeedsUpdate = false;
     force = true;
 
   }
 
+  __matrixDirty = false;
+  __childrenDirty = false;
+
   // update children
 
   for ( auto& child : children ) {
@@ -171,6 +240,58 @@ void Object3D::updateMatrixWorld( bool force /*= false*/ ) {
 
 }
 
+void Object3D::updateMatrixWorldTracked( bool force ) {
+
+  if ( __matrixDirty ) {
+
+    if ( matrixAutoUpdate ) {
+      updateMatrix();
+    } else {
+      matrixWorldNeedsUpdate = true;
+    }
+
+    __matrixDirty = false;
+
+  }
+
+  if ( matrixWorldNeedsUpdate || force ) {
+
+    if ( parent != nullptr ) {
+      matrixWorld.multiply( parent->matrixWorld, matrix );
+    } else {
+      matrixWorld.copy( matrix );
+    }
+
+    matrixWorldChanged();
+    matrixWorldNeedsUpdate = false;
+    force = true;
+
+  }
+
+  // only descend into subtrees that changed
+
+  if ( force || __childrenDirty ) {
+
+    __childrenDirty = false;
+
+    for ( auto& child : children ) {
+      child->updateMatrixWorldTracked( force );
+    }
+
+  }
+
+}
+
+void Object3D::matrixWorldChanged() {
+
+  ++matrixWorldVersion;
+
+  if ( __spatialMoves ) {
+    __spatialMoves->report( __spatialSlot );
+  }
+
+}
+
 Vector3 Object3D::worldToLocal( const Vector3& vector ) const {
   return Matrix4().getInverse( matrixWorld ).multiplyVector3( vector );
 }
@@ -206,6 +327,8 @@ Object3D::Object3D( const Material::Ptr& material /*= Material::Ptr()*/,
     rotationAutoUpdate( true ),
     matrixAutoUpdate( true ),
     matrixWorldNeedsUpdate( true ),
+    matrixDirtyTracking( false ),
+    matrixWorldVersion( 0 ),
     useQuaternion( false ),
     boundRadius( 0.0f ),
     boundRadiusScale( 1.0f ),
@@ -213,15 +336,32 @@ Object3D::Object3D( const Material::Ptr& material /*= Material::Ptr()*/,
     castShadow( false ),
     receiveShadow( false ),
     frustumCulled( true ),
+    batched( false ),
+    staticBatch( false ),
+    __frustumPlane( -1 ),
+    __cullStamp( 0 ),
     sortParticles( false ),
     useVertexTexture( false ),
     boneTextureWidth( 0 ),
     boneTextureHeight( 0 ),
     morphTargetBase( -1 ),
     material( material ),
-    geometry( geometry ) { }
+    geometry( geometry ),
+    __matrixDirty( true ),
+    __childrenDirty( false ),
+    __transformStore( nullptr ),
+    __transformIndex( -1 ),
+    __spatialSlot( 0 ) { }
+
+Object3D::~Object3D() {
 
-Object3D::~Object3D() { }
+  // The store holds a pointer to every node it flattened
+
+  if ( __transformStore ) {
+    __transformStore->invalidate();
+  }
+
+}
 
 void Object3D::__addObject( const Ptr& object ) { }
 
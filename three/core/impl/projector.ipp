@@ -7,12 +7,15 @@
 
 #include <three/core/math.hpp>
 
+#include <three/core/bvh.hpp>
 #include <three/core/frustum.hpp>
 #include <three/core/matrix4.hpp>
+#include <three/core/transform_kernels.hpp>
 
 #include <three/objects/line.hpp>
 #include <three/objects/mesh.hpp>
 #include <three/objects/particle.hpp>
+#include <three/objects/skinned_mesh.hpp>
 
 #include <three/renderers/renderables/renderable_vertex.hpp>
 #include <three/renderers/renderables/renderable_face.hpp>
@@ -21,53 +24,173 @@
 
 #include <three/scenes/scene.hpp>
 
+#include <three/utils/thread_pool.hpp>
+
+#include <algorithm>
 #include <functional>
 
 namespace three {
 
 namespace detail {
 
+// Renderables reused from frame to frame. Storage comes in fixed-size
+// chunks, so growing never moves earlier entries and references stay valid
+// for the whole frame. reset() keeps a decaying peak of chunks around:
+// steady scenes never allocate, and a one-off spike is released over the
+// following frames.
 template < typename Renderable >
 struct Renderables {
-  Renderables() : count( 0 ) { }
+  enum { ChunkShift = 10, ChunkSize = 1 << ChunkShift, ChunkMask = ChunkSize - 1 };
+
+  Renderables() : count( 0 ), peak( 0 ) { }
 
   Renderable& next() {
-    if ( count == (int)pool.size() ) {
-      pool.push_back( Renderable() );
-      ++count;
-      return pool.back();
-    } else {
-      return pool[ count++ ];
+    if ( count == chunks.size() * ChunkSize ) {
+      chunks.push_back( std::unique_ptr<Renderable[]>( new Renderable[ ChunkSize ] ) );
     }
+    return ( *this )[ count++ ];
   }
-  Renderable& current() {
-    return pool[ count ];
+  Renderable& operator[]( size_t i ) {
+    return chunks[ i >> ChunkShift ][ i & ChunkMask ];
   }
   void reset() {
+    const auto used = ( count + ChunkMask ) >> ChunkShift;
+    peak = Math::max( used, peak - ( peak + 15 ) / 16 );
+    if ( chunks.size() > peak ) {
+      chunks.resize( peak );
+    }
     count = 0;
   }
 
-  std::vector<Renderable> pool;
-  int count;
+  std::vector<std::unique_ptr<Renderable[]>> chunks;
+  size_t count;
+  size_t peak;
+};
+
+// Runs of renderables, each contiguous, e.g. a mesh's vertices for the
+// transform kernels. Runs are packed into chunks that never move, so
+// growing allocates a chunk instead of copying the pool; a run longer than
+// a chunk gets a chunk of its own. reset() keeps a decaying peak of chunks
+// like Renderables.
+template < typename Renderable >
+struct RenderableRuns {
+  enum { ChunkSize = 1 << 14 };
+
+  struct Chunk {
+    Chunk() : size( 0 ) { }
+    std::unique_ptr<Renderable[]> data;
+    size_t size;
+  };
+
+  RenderableRuns() : current( 0 ), used( 0 ), peak( 0 ) { }
+
+  Renderable* allocate( size_t count ) {
+    if ( used > 0 && used + count > chunks[ current ].size ) {
+      ++current;
+      used = 0;
+    }
+    if ( current == chunks.size() ) {
+      chunks.push_back( Chunk() );
+    }
+    auto& chunk = chunks[ current ];
+    if ( chunk.size < count ) {
+      chunk.size = Math::max( count, ( size_t )ChunkSize );
+      chunk.data.reset( new Renderable[ chunk.size ] );
+    }
+    auto run = chunk.data.get() + used;
+    used += count;
+    return run;
+  }
+  void reset() {
+    const auto inUse = used > 0 ? current + 1 : current;
+    peak = Math::max( inUse, peak - ( peak + 15 ) / 16 );
+    if ( chunks.size() > peak ) {
+      chunks.resize( peak );
+    }
+    current = 0;
+    used = 0;
+  }
+
+  std::vector<Chunk> chunks;
+  size_t current, used;
+  size_t peak;
+};
+
+// One unit of projectScene work. Meshes are split into vertex ranges, which
+// fill the shared vertex pool first, and face ranges that read it; lines
+// and sprite ranges are single jobs. A job records which worker's pool its
+// output landed in, so results are gathered in job order whichever thread
+// ran it.
+struct ProjectorJob {
+  enum Kind { MeshVertices, MeshFaces, Line, Sprites };
+
+  ProjectorJob( Kind kind, Object3D* object, size_t begin, size_t end, RenderableVertex* vertices = nullptr )
+    : kind( kind ), object( object ), begin( begin ), end( end ), vertices( vertices ),
+      worker( 0 ), first( 0 ), count( 0 ) { }
+
+  Kind kind;
+  Object3D* object;
+  size_t begin, end; // vertex, face or sprite range
+  RenderableVertex* vertices; // the mesh's run in the shared pool
+
+  size_t worker, first, count;
+};
+
+// Per-thread output pools
+struct ProjectorWorker {
+  Renderables<RenderableVertex>   _vertices;
+  Renderables<RenderableFace>     _faces;
+  Renderables<RenderableLine>     _lines;
+  Renderables<RenderableParticle> _particles;
+
+  Matrix4 _modelViewProjectionMatrix;
+
+  void reset() {
+    _vertices.reset();
+    _faces.reset();
+    _lines.reset();
+    _particles.reset();
+  }
 };
 
 } // namespace detail
 
 struct Projector::Impl : public NonCopyable {
 
-  detail::Renderables<RenderableObject>   _objects;
-  detail::Renderables<RenderableVertex>   _vertices;
-  detail::Renderables<RenderableFace>     _faces;
-  detail::Renderables<RenderableLine>     _lines;
-  detail::Renderables<RenderableParticle> _particles;
+  detail::Renderables<RenderableObject> _objects;
+  // Mesh vertices of all workers; allocated before the jobs run and
+  // contiguous per mesh for the transform kernels
+  detail::RenderableRuns<RenderableVertex> _vertices;
+
+  // One per thread, allocated separately so workers don't share cache lines
+  std::vector<std::unique_ptr<detail::ProjectorWorker>> _workers;
+  std::vector<detail::ProjectorJob>    _vertexJobs;
+  std::vector<detail::ProjectorJob>    _jobs;
+  std::vector<SkinnedMesh*>            _skinned;
+
+  ThreadPool _pool;
 
   Projector::RenderData _renderData;
 
   Matrix4 _viewProjectionMatrix;
-  Matrix4 _modelViewProjectionMatrix;
 
   Frustum _frustum;
 
+  // Set by projectScene when the scene has a spatial index: objects in the
+  // frustum carry _cullStamp
+  SceneBVH* _cullIndex;
+  unsigned _cullStamp;
+
+  Impl() : _cullIndex( nullptr ), _cullStamp( 0 ) {
+    _workers.emplace_back( new detail::ProjectorWorker );
+  }
+
+  bool inFrustum( const Object3D& object ) const {
+    if ( _cullIndex && object.geometry )
+      return object.__cullStamp == _cullStamp;
+    return _frustum.contains( object );
+  }
+
 };
 
 /////////////////////////////////////////////////////////////////////////
@@ -124,143 +247,154 @@ static bool clipLine( Vector4& s1, Vector4& s2 ) {
 
 /////////////////////////////////////////////////////////////////////////
 
+inline void projectVertices( Projector::Impl& p, const Camera& c, const ProjectorJob& job ) {
+
+  const auto& object   = *job.object;
+  const auto  skinned  = static_cast<const Mesh&>( object ).skinned();
+  const auto& vertices = skinned ? skinned->skinnedVertices() : object.geometry->vertices;
+
+  const auto count  = job.end - job.begin;
+  const auto stride = sizeof( RenderableVertex );
+
+  auto first = job.vertices + job.begin;
+
+  simd::transformPoints( object.matrixWorld, &vertices[ job.begin ].x, sizeof( Vertex ), &first->positionWorld.x, stride, count );
+  simd::transformHomogeneous( p._viewProjectionMatrix, &first->positionWorld.x, stride, &first->positionScreen.x, stride, count );
+
+  for ( auto vertex = first, end = first + count; vertex != end; ++vertex ) {
+
+    vertex->positionScreen.x /= vertex->positionScreen.w;
+    vertex->positionScreen.y /= vertex->positionScreen.w;
+
+    vertex->visible = vertex->positionScreen.z > c.near && vertex->positionScreen.z < c.far;
+
+  }
+
+}
+
 struct SceneVisitor : public ConstVisitor {
   Projector::Impl& p;
-  Camera& c;
-  Matrix4& modelMatrix;
-  Matrix4& viewProjectionMatrix;
+  ProjectorWorker& w;
+  ProjectorJob& job;
 
-  SceneVisitor( Projector::Impl& p, Camera& c, Matrix4& model, Matrix4& viewProjection )
-    : p( p ), c( c ), modelMatrix( model ), viewProjectionMatrix( viewProjection ) { }
+  SceneVisitor( Projector::Impl& p, ProjectorWorker& w, ProjectorJob& job )
+    : p( p ), w( w ), job( job ) { }
 
   virtual void operator()( const Particle& p ) { }
   virtual void operator()( const Mesh& object ) {
     const auto& geometry          = *object.geometry;
     const auto& geometryMaterials = geometry.materials;
-    const auto& vertices          = geometry.vertices;
     const auto& faces             = geometry.faces;
     const auto& faceVertexUvs     = geometry.faceVertexUvs;
 
-    auto rotationMatrix = object.matrixRotationWorld.extractRotation( modelMatrix );
-
-    auto isFaceMaterial = object.material->type() == THREE::MeshFaceMaterial;
-
-    for ( const auto& v : vertices ) {
+    const auto& modelMatrix    = object.matrixWorld;
+    const auto& rotationMatrix = object.matrixRotationWorld;
 
-      auto& vertex = p._vertices.next();
-      vertex.positionWorld.copy( v );
+    const auto vertices = job.vertices;
 
-      modelMatrix.multiplyVector3( vertex.positionWorld );
+    // A skinned pose brings its own face normals, centroids and vertex normals
+    const auto skinned = object.skinned();
+    const auto skinnedVertices = skinned ? skinned->skinnedVertices().data() : nullptr;
+    const auto skinnedNormals  = skinned ? skinned->skinnedNormals().data() : nullptr;
 
-      vertex.positionScreen.copy( vertex.positionWorld );
-      viewProjectionMatrix.multiplyVector4( vertex.positionScreen );
-
-      vertex.positionScreen.x /= vertex.positionScreen.w;
-      vertex.positionScreen.y /= vertex.positionScreen.w;
+    auto isFaceMaterial = object.material->type() == THREE::MeshFaceMaterial;
 
-      vertex.visible = vertex.positionScreen.z > c.near && vertex.positionScreen.z < c.far;
+    job.first = w._faces.count;
 
-    }
-
-    for ( size_t f = 0; f < faces.size(); ++f ) {
+    for ( size_t f = job.begin; f < job.end; ++f ) {
 
       auto& face = faces[ f ];
 
       bool visible = false;
 
-      auto material = isFaceMaterial ? geometryMaterials[ face.materialIndex ] : object.material;
+      const auto& material = isFaceMaterial ? geometryMaterials[ face.materialIndex ] : object.material;
 
       if ( material == nullptr ) continue;
 
       auto side = material->side;
 
-      if ( face.type() == THREE::Face3 ) {
+      RenderableFace* _face = nullptr;
 
-        const auto& v1 = p._vertices.pool[ face.a ];
-        const auto& v2 = p._vertices.pool[ face.b ];
-        const auto& v3 = p._vertices.pool[ face.c ];
-
-        if ( v1.visible && v2.visible && v3.visible ) {
-
-          const auto visible = ( ( v3.positionScreen.x - v1.positionScreen.x ) * ( v2.positionScreen.y - v1.positionScreen.y ) -
-                                 ( v3.positionScreen.y - v1.positionScreen.y ) * ( v2.positionScreen.x - v1.positionScreen.x ) ) < 0;
-
-          if ( side == THREE::DoubleSide || visible == ( side == THREE::FrontSide ) ) {
-
-            auto& face = p._faces.next();
-
-            face.v1.copy( v1 );
-            face.v2.copy( v2 );
-            face.v3.copy( v3 );
-
-          } else {
+      if ( face.type() == THREE::Face3 ) {
 
-            continue;
+        const auto& v1 = vertices[ face.a ];
+        const auto& v2 = vertices[ face.b ];
+        const auto& v3 = vertices[ face.c ];
 
-          }
+        if ( !v1.visible || !v2.visible || !v3.visible ) continue;
 
-        } else {
+        visible = ( ( v3.positionScreen.x - v1.positionScreen.x ) * ( v2.positionScreen.y - v1.positionScreen.y ) -
+                    ( v3.positionScreen.y - v1.positionScreen.y ) * ( v2.positionScreen.x - v1.positionScreen.x ) ) < 0;
 
-          continue;
+        if ( side != THREE::DoubleSide && visible != ( side == THREE::FrontSide ) ) continue;
 
-        }
+        _face = &w._faces.next();
 
       } else if ( face.type() == THREE::Face4 ) {
 
-        const auto& v1 = p._vertices.pool[ face.a ];
-        const auto& v2 = p._vertices.pool[ face.b ];
-        const auto& v3 = p._vertices.pool[ face.c ];
-        const auto& v4 = p._vertices.pool[ face.d ];
-
-        if ( v1.visible && v2.visible && v3.visible && v4.visible ) {
-
-          const auto visible = ( v4.positionScreen.x - v1.positionScreen.x ) * ( v2.positionScreen.y - v1.positionScreen.y ) -
-                               ( v4.positionScreen.y - v1.positionScreen.y ) * ( v2.positionScreen.x - v1.positionScreen.x ) < 0 ||
-                               ( v2.positionScreen.x - v3.positionScreen.x ) * ( v4.positionScreen.y - v3.positionScreen.y ) -
-                               ( v2.positionScreen.y - v3.positionScreen.y ) * ( v4.positionScreen.x - v3.positionScreen.x ) < 0;
+        const auto& v1 = vertices[ face.a ];
+        const auto& v2 = vertices[ face.b ];
+        const auto& v3 = vertices[ face.c ];
+        const auto& v4 = vertices[ face.d ];
 
+        if ( !v1.visible || !v2.visible || !v3.visible || !v4.visible ) continue;
 
-          if ( side == THREE::DoubleSide || visible == ( side == THREE::FrontSide ) ) {
+        visible = ( v4.positionScreen.x - v1.positionScreen.x ) * ( v2.positionScreen.y - v1.positionScreen.y ) -
+                  ( v4.positionScreen.y - v1.positionScreen.y ) * ( v2.positionScreen.x - v1.positionScreen.x ) < 0 ||
+                  ( v2.positionScreen.x - v3.positionScreen.x ) * ( v4.positionScreen.y - v3.positionScreen.y ) -
+                  ( v2.positionScreen.y - v3.positionScreen.y ) * ( v4.positionScreen.x - v3.positionScreen.x ) < 0;
 
-            auto& _face = p._faces.next();
+        if ( side != THREE::DoubleSide && visible != ( side == THREE::FrontSide ) ) continue;
 
-            _face.v1.copy( v1 );
-            _face.v2.copy( v2 );
-            _face.v3.copy( v3 );
-            _face.v4.copy( v4 );
+        _face = &w._faces.next();
 
-          } else {
+      } else {
 
-            continue;
+        continue;
 
-          }
+      }
 
-        } else {
+      _face->setType( face.type() );
+      _face->vertices = vertices;
+      _face->a = face.a;
+      _face->b = face.b;
+      _face->c = face.c;
+      _face->d = face.d;
+
+      if ( skinned ) {
+        const auto& vA = skinnedVertices[ face.a ];
+        const auto& vB = skinnedVertices[ face.b ];
+        const auto& vC = skinnedVertices[ face.c ];
+        auto normal = sub( vC, vB ).crossSelf( sub( vA, vB ) );
+        if ( !normal.isZero() ) normal.normalize();
+        _face->normalWorld.copy( normal );
+      } else {
+        _face->normalWorld.copy( face.normal );
+      }
 
-          continue;
+      if ( !visible && ( side == THREE::BackSide || side == THREE::DoubleSide ) ) _face->normalWorld.negate();
+      rotationMatrix.multiplyVector3( _face->normalWorld );
 
+      if ( skinned ) {
+        _face->centroidWorld.set( 0, 0, 0 );
+        for ( auto n = 0, nl = face.size(); n < nl; n++ ) {
+          _face->centroidWorld.addSelf( skinnedVertices[ face.abcd[ n ] ] );
         }
-
+        _face->centroidWorld.divideScalar( ( float )face.size() );
+      } else {
+        _face->centroidWorld.copy( face.centroid );
       }
+      modelMatrix.multiplyVector3( _face->centroidWorld );
 
-      auto& _face = p._faces.current();
-      _face.normalWorld.copy( face.normal );
-
-      if ( !visible && ( side == THREE::BackSide || side == THREE::DoubleSide ) ) _face.normalWorld.negate();
-      rotationMatrix.multiplyVector3( _face.normalWorld );
-
-      _face.centroidWorld.copy( face.centroid );
-      modelMatrix.multiplyVector3( _face.centroidWorld );
-
-      _face.centroidScreen.copy( _face.centroidWorld );
-      p._viewProjectionMatrix.multiplyVector3( _face.centroidScreen );
+      _face->centroidScreen.copy( _face->centroidWorld );
+      p._viewProjectionMatrix.multiplyVector3( _face->centroidScreen );
 
       auto& faceVertexNormals = face.vertexNormals;
 
       for ( auto n = 0, nl = face.size(); n < nl; n++ ) {
 
-        auto& normal = _face.vertexNormalsWorld[ n ];
-        normal.copy( faceVertexNormals[ n ] );
+        auto& normal = _face->vertexNormalsWorld[ n ];
+        normal.copy( skinned ? skinnedNormals[ face.abcd[ n ] ] : faceVertexNormals[ n ] );
 
         if ( !visible && ( side == THREE::BackSide || side == THREE::DoubleSide ) ) normal.negate();
 
@@ -268,50 +402,52 @@ struct SceneVisitor : public ConstVisitor {
 
       }
 
-      for ( int c = 0, cl = face.size(); c < cl; c ++ ) {
-
-        const auto& uvs = faceVertexUvs[ c ][ f ];
-
-        for ( size_t u = 0, ul = uvs.size(); u < ul; u ++ ) {
-
-          _face.uvs[ c ][ u ] = uvs[ u ];
+      for ( size_t c = 0, cl = _face->uvs.size(); c < cl; c ++ ) {
 
-        }
+        _face->uvs[ c ] = c < faceVertexUvs.size() && f < faceVertexUvs[ c ].size() ? &faceVertexUvs[ c ][ f ] : nullptr;
 
       }
 
-      _face.material = material.get();
-
-      _face.z = _face.centroidScreen.z;
+      _face->material = material.get();
 
-      // TODO: FIX!!!
-      p._renderData.elements.push_back( &_face );
+      _face->z = _face->centroidScreen.z;
 
     }
+
+    job.count = w._faces.count - job.first;
+
   }
 
   virtual void operator()( const Line& object ) {
 
-    p._modelViewProjectionMatrix.multiply( p._viewProjectionMatrix, modelMatrix );
+    const auto& modelMatrix = object.matrixWorld;
+
+    w._modelViewProjectionMatrix.multiply( p._viewProjectionMatrix, modelMatrix );
 
     auto& vertices = object.geometry->vertices;
 
-    auto& v1 = p._vertices.next();
+    job.first = w._lines.count;
+
+    if ( vertices.empty() ) return;
+
+    w._vertices.reset();
+
+    auto& v1 = w._vertices.next();
     v1.positionScreen.copy( vertices[ 0 ] );
-    p._modelViewProjectionMatrix.multiplyVector4( v1.positionScreen );
+    w._modelViewProjectionMatrix.multiplyVector4( v1.positionScreen );
 
     // Handle LineStrip and LinePieces
     auto step = object.lineType == THREE::LinePieces ? 2 : 1;
 
     for ( size_t v = 1, vl = vertices.size(); v < vl; v ++ ) {
 
-      auto& v1 = p._vertices.next();
+      auto& v1 = w._vertices.next();
       v1.positionScreen.copy( vertices[ v ] );
-      p._modelViewProjectionMatrix.multiplyVector4( v1.positionScreen );
+      w._modelViewProjectionMatrix.multiplyVector4( v1.positionScreen );
 
       if ( ( v + 1 ) % step > 0 ) continue;
 
-      auto& v2 = p._vertices.pool[ p._vertices.count - 2 ];
+      auto& v2 = w._vertices[ w._vertices.count - 2 ];
 
       auto _clippedVertex1PositionScreen = v1.positionScreen;
       auto _clippedVertex2PositionScreen = v2.positionScreen;
@@ -322,7 +458,7 @@ struct SceneVisitor : public ConstVisitor {
         _clippedVertex1PositionScreen.multiplyScalar( 1.f / _clippedVertex1PositionScreen.w );
         _clippedVertex2PositionScreen.multiplyScalar( 1.f / _clippedVertex2PositionScreen.w );
 
-        auto& _line = p._lines.next();
+        auto& _line = w._lines.next();
         _line.v1.positionScreen.copy( _clippedVertex1PositionScreen );
         _line.v2.positionScreen.copy( _clippedVertex2PositionScreen );
 
@@ -330,17 +466,18 @@ struct SceneVisitor : public ConstVisitor {
 
         _line.material = object.material.get();
 
-        p._renderData.elements.push_back( &_line );
-
       }
     }
+
+    job.count = w._lines.count - job.first;
+
   }
 };
 
 struct SpriteVisitor : public Visitor {
 
-  SpriteVisitor( Projector::Impl& p, Camera& c )
-    : p( p ), c( c ) { }
+  SpriteVisitor( Projector::Impl& p, ProjectorWorker& w, const Camera& c )
+    : p( p ), w( w ), c( c ) { }
 
   void operator()( Particle& object ) {
 
@@ -353,7 +490,7 @@ struct SpriteVisitor : public Visitor {
 
     if ( vector4.z > 0 && vector4.z < 1 ) {
 
-      auto& _particle = p._particles.next();
+      auto& _particle = w._particles.next();
       _particle.object = &object;
       _particle.x = vector4.x / vector4.w;
       _particle.y = vector4.y / vector4.w;
@@ -366,14 +503,13 @@ struct SpriteVisitor : public Visitor {
 
       _particle.material = object.material.get();
 
-      p._renderData.elements.push_back( &_particle );
-
     }
 
   }
 
   Projector::Impl& p;
-  Camera& c;
+  ProjectorWorker& w;
+  const Camera& c;
 
 };
 
@@ -385,6 +521,8 @@ struct SpriteVisitor : public Visitor {
 
 Projector::Projector() : impl( new Impl() ) { }
 
+Projector::~Projector() { }
+
 Vector3& Projector::projectVector( Vector3& vector, const Camera& camera ) {
 
   auto& d = *impl;
@@ -443,8 +581,8 @@ Projector::RenderData& Projector::projectGraph( Object3D& root, bool sort ) {
 
     if ( !object.visible ) return;
 
-    if ( ( object.type() == THREE::Mesh || object.type() == THREE::Line ) &&
-    ( !object.frustumCulled || d._frustum.contains( object ) ) ) {
+    if ( ( object.type() == THREE::Mesh || object.type() == THREE::Line ) && !object.batched &&
+    ( !object.frustumCulled || d.inFrustum( object ) ) ) {
 
       Vector3 vector3 = object.matrixWorld.getPosition();
       d._viewProjectionMatrix.multiplyVector3( vector3 );
@@ -496,10 +634,6 @@ Projector::RenderData& Projector::projectScene( Scene& scene, Camera& camera, bo
 
   auto& d = *impl;
 
-  d._faces.reset();
-  d._lines.reset();
-  d._particles.reset();
-
   d._renderData.elements.clear();
 
   scene.updateMatrixWorld();
@@ -512,44 +646,172 @@ Projector::RenderData& Projector::projectScene( Scene& scene, Camera& camera, bo
 
   d._frustum.setFromMatrix( d._viewProjectionMatrix );
 
+  if ( scene.spatialIndex ) {
+    d._cullIndex = scene.spatialIndex.get();
+    d._cullIndex->update( scene );
+    d._cullStamp = d._cullIndex->cull( d._frustum );
+  }
+
   d._renderData = projectGraph( scene, false );
 
+  d._cullIndex = nullptr;
+
+  // Split the work into jobs
+
+  typedef detail::ProjectorJob Job;
+
+  const size_t VertexChunk = 4096, FaceChunk = 2048, SpriteChunk = 512;
+
+  d._vertexJobs.clear();
+  d._jobs.clear();
+  d._vertices.reset();
+
+  d._skinned.clear();
+
   for ( auto& renderObject : d._renderData.objects ) {
 
     auto& object = *renderObject.object;
 
-    auto& modelMatrix = object.matrixWorld;
+    if ( object.geometry && object.type() == THREE::Mesh ) {
+      if ( auto skinned = static_cast<Mesh&>( object ).skinned() ) {
+        d._skinned.push_back( skinned );
+      }
+    }
+
+  }
+
+  // Skinned poses first, in parallel across meshes; the vertex jobs read them
+
+  SkinnedMesh::update( d._skinned.data(), d._skinned.size(), d._pool, true );
+
+  for ( auto& renderObject : d._renderData.objects ) {
+
+    auto& object = *renderObject.object;
+
+    if ( !object.geometry ) continue;
+
+    if ( object.type() == THREE::Mesh ) {
+
+      const auto vertices = object.geometry->vertices.size();
+      const auto faces    = object.geometry->faces.size();
+
+      object.matrixRotationWorld.extractRotation( object.matrixWorld );
+
+      const auto run = d._vertices.allocate( vertices );
+
+      for ( size_t v = 0; v < vertices; v += VertexChunk ) {
+        d._vertexJobs.push_back( Job( Job::MeshVertices, &object, v, Math::min( v + VertexChunk, vertices ), run ) );
+      }
+
+      for ( size_t f = 0; f < faces; f += FaceChunk ) {
+        d._jobs.push_back( Job( Job::MeshFaces, &object, f, Math::min( f + FaceChunk, faces ), run ) );
+      }
+
+    } else if ( object.type() == THREE::Line ) {
+
+      d._jobs.push_back( Job( Job::Line, &object, 0, 0 ) );
 
-    d._vertices.reset();
+    }
+
+  }
 
-    detail::SceneVisitor visitor( d, camera, modelMatrix, d._viewProjectionMatrix );
+  const auto sprites = d._renderData.sprites.size();
+
+  for ( size_t s = 0; s < sprites; s += SpriteChunk ) {
+    d._jobs.push_back( Job( Job::Sprites, nullptr, s, Math::min( s + SpriteChunk, sprites ) ) );
+  }
 
-    object.visit( visitor );
+  // Transform all mesh vertices, then project faces, lines and sprites
 
+  for ( auto& worker : d._workers ) {
+    worker->reset();
   }
 
-  Vector4 vector4;
+  d._pool.parallelFor( d._vertexJobs.size(), [&]( size_t index, size_t ) {
+    detail::projectVertices( d, camera, d._vertexJobs[ index ] );
+  } );
 
-  for ( auto& renderSprite : d._renderData.sprites ) {
+  d._pool.parallelFor( d._jobs.size(), [&]( size_t index, size_t thread ) {
 
-    auto& object = *renderSprite.object;
+    auto& job    = d._jobs[ index ];
+    auto& worker = *d._workers[ thread ];
 
-    detail::SpriteVisitor visitor( d, camera );
+    job.worker = thread;
 
-    object.visit( visitor );
+    if ( job.kind == Job::Sprites ) {
+
+      job.first = worker._particles.count;
+
+      detail::SpriteVisitor visitor( d, worker, camera );
+
+      for ( size_t s = job.begin; s < job.end; ++s ) {
+        d._renderData.sprites[ s ].object->visit( visitor );
+      }
+
+      job.count = worker._particles.count - job.first;
+
+    } else {
+
+      detail::SceneVisitor visitor( d, worker, job );
+
+      job.object->visit( visitor );
+
+    }
+
+  } );
+
+  // The pools are final now: gather the elements in job order, so the
+  // output does not depend on the thread count
+
+  for ( const auto& job : d._jobs ) {
+
+    auto& worker = *d._workers[ job.worker ];
+
+    for ( size_t i = job.first, il = job.first + job.count; i < il; ++i ) {
+      switch ( job.kind ) {
+      case Job::MeshFaces:
+        d._renderData.elements.push_back( &worker._faces[ i ] );
+        break;
+      case Job::Line:
+        d._renderData.elements.push_back( &worker._lines[ i ] );
+        break;
+      case Job::Sprites:
+        d._renderData.elements.push_back( &worker._particles[ i ] );
+        break;
+      default:
+        break;
+      }
+    }
 
   }
 
   if ( sort ) {
-    std::sort( d._renderData.elements.begin(),
-               d._renderData.elements.end(),
-               PainterSort() );
+    std::stable_sort( d._renderData.elements.begin(),
+                      d._renderData.elements.end(),
+                      PainterSort() );
   }
 
   return d._renderData;
 
 }
 
+void Projector::setThreads( size_t threads ) {
+
+  auto& d = *impl;
+
+  d._pool.resize( threads );
+  d._workers.resize( d._pool.size() );
+
+  for ( auto& worker : d._workers ) {
+    if ( !worker ) worker.reset( new detail::ProjectorWorker );
+  }
+
+}
+
+size_t Projector::threads() const {
+  return impl->_pool.size();
+}
+
 } // namespace three
 
 #endif // THREE_PROJECTOR_IPP
@@ -0,0 +1,448 @@
+#ifndef THREE_RAY_BATCH_IPP
+#define THREE_RAY_BATCH_IPP
+
+#include <three/core/ray_batch.hpp>
+
+#include <three/core/geometry.hpp>
+#include <three/core/object3d.hpp>
+
+#include <three/materials/material.hpp>
+#include <three/objects/skinned_mesh.hpp>
+
+#include <three/utils/simd.hpp>
+
+namespace three {
+
+namespace detail {
+
+inline void clearIntersection( Ray::Intersection& hit ) {
+  hit.distance  = Math::INF();
+  hit.point     = Vector3();
+  hit.face      = nullptr;
+  hit.faceIndex = 0;
+  hit.object    = nullptr;
+}
+
+#if THREE_SIMD_X86
+
+struct RayPacket4 {
+  __m128 ox, oy, oz;
+  __m128 dx, dy, dz;
+  __m128 ix, iy, iz;
+  __m128 near, far;
+  int active;
+  bool any;
+
+  Object3D* current;
+  bool flip;
+
+  unsigned face[ 4 ];
+  Object3D* object[ 4 ];
+};
+
+THREE_TARGET_SSE inline void setInverseDirection( RayPacket4& p ) {
+  const auto one = _mm_set1_ps( 1.f );
+  p.ix = _mm_div_ps( one, p.dx );
+  p.iy = _mm_div_ps( one, p.dy );
+  p.iz = _mm_div_ps( one, p.dz );
+}
+
+// Lanes whose ray enters the box before their current far distance
+THREE_TARGET_SSE inline int packetBox( const BVH::Node& node, const RayPacket4& p, __m128& entry ) {
+
+  const auto x1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.min.x ), p.ox ), p.ix );
+  const auto x2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.max.x ), p.ox ), p.ix );
+  const auto y1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.min.y ), p.oy ), p.iy );
+  const auto y2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.max.y ), p.oy ), p.iy );
+  const auto z1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.min.z ), p.oz ), p.iz );
+  const auto z2 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.max.z ), p.oz ), p.iz );
+
+  // As BVH::slab(): an axis with a NaN bound is left out. The unordered
+  // mask makes both of its bounds NaN, and min/max return their second
+  // operand when the first is NaN.
+
+  const auto nx = _mm_cmpunord_ps( x1, x2 );
+  const auto ny = _mm_cmpunord_ps( y1, y2 );
+  const auto nz = _mm_cmpunord_ps( z1, z2 );
+
+  auto tmin = _mm_max_ps( _mm_or_ps( _mm_min_ps( x1, x2 ), nx ), p.near );
+  tmin = _mm_max_ps( _mm_or_ps( _mm_min_ps( y1, y2 ), ny ), tmin );
+  tmin = _mm_max_ps( _mm_or_ps( _mm_min_ps( z1, z2 ), nz ), tmin );
+
+  auto tmax = _mm_min_ps( _mm_or_ps( _mm_max_ps( x1, x2 ), nx ), p.far );
+  tmax = _mm_min_ps( _mm_or_ps( _mm_max_ps( y1, y2 ), ny ), tmax );
+  tmax = _mm_min_ps( _mm_or_ps( _mm_max_ps( z1, z2 ), nz ), tmax );
+
+  entry = tmin;
+
+  return _mm_movemask_ps( _mm_and_ps( _mm_cmple_ps( tmin, tmax ), _mm_cmplt_ps( tmin, p.far ) ) ) & p.active;
+
+}
+
+THREE_TARGET_SSE inline float nearestEntry( __m128 entry, int mask ) {
+  float t[ 4 ];
+  _mm_storeu_ps( t, entry );
+  auto nearest = Math::INF();
+  for ( int i = 0; i < 4; ++i ) {
+    if ( mask & ( 1 << i ) ) nearest = Math::min( nearest, t[ i ] );
+  }
+  return nearest;
+}
+
+// Coherent traversal: a node is entered if any active lane hits it, and
+// children are visited nearest-first by their closest lane entry.
+template < typename Leaf >
+THREE_TARGET_SSE void traversePacket( const BVH& tree, RayPacket4& p, Leaf& leaf ) {
+
+  const auto& nodes = tree.nodes;
+
+  if ( nodes.empty() )
+    return;
+
+  __m128 entry, entryRight;
+
+  if ( !packetBox( nodes[ 0 ], p, entry ) )
+    return;
+
+  unsigned stack[ BVH::MaxDepth + 1 ];
+  unsigned top = 0;
+  unsigned current = 0;
+
+  for ( ;; ) {
+
+    const auto& node = nodes[ current ];
+
+    if ( node.leaf() ) {
+
+      for ( unsigned i = node.offset, il = node.offset + node.count; i < il; ++i ) {
+        leaf( tree.indices[ i ], p );
+        if ( !p.active )
+          return;
+      }
+
+    } else {
+
+      auto left  = current + 1;
+      auto right = node.offset;
+
+      const auto maskLeft  = packetBox( nodes[ left ],  p, entry );
+      const auto maskRight = packetBox( nodes[ right ], p, entryRight );
+
+      if ( maskLeft && maskRight ) {
+        if ( nearestEntry( entryRight, maskRight ) < nearestEntry( entry, maskLeft ) ) {
+          std::swap( left, right );
+        }
+        stack[ top++ ] = right;
+        current = left;
+        continue;
+      }
+
+      if ( maskLeft )  { current = left;  continue; }
+      if ( maskRight ) { current = right; continue; }
+
+    }
+
+    for ( ;; ) {
+      if ( top == 0 )
+        return;
+      current = stack[ --top ];
+      if ( packetBox( nodes[ current ], p, entry ) )
+        break;
+    }
+
+  }
+
+}
+
+// One triangle against four rays (Moller-Trumbore, as in GeometryBVH)
+struct TriangleLeaf {
+
+  const GeometryBVH& bvh;
+  const Geometry& geometry;
+  const Material& material;
+
+  TriangleLeaf( const GeometryBVH& bvh, const Geometry& geometry, const Material& material )
+    : bvh( bvh ), geometry( geometry ), material( material ) { }
+
+  THREE_TARGET_SSE void operator()( unsigned index, RayPacket4& p ) {
+
+    const auto& tri = bvh.triangles[ index ];
+    const auto side = GeometryBVH::faceSide( geometry, material, tri.face, p.flip );
+
+    const auto e1x = _mm_set1_ps( tri.ab.x ), e1y = _mm_set1_ps( tri.ab.y ), e1z = _mm_set1_ps( tri.ab.z );
+    const auto e2x = _mm_set1_ps( tri.ac.x ), e2y = _mm_set1_ps( tri.ac.y ), e2z = _mm_set1_ps( tri.ac.z );
+
+    // pv = d x e2
+    const auto px = _mm_sub_ps( _mm_mul_ps( p.dy, e2z ), _mm_mul_ps( p.dz, e2y ) );
+    const auto py = _mm_sub_ps( _mm_mul_ps( p.dz, e2x ), _mm_mul_ps( p.dx, e2z ) );
+    const auto pz = _mm_sub_ps( _mm_mul_ps( p.dx, e2y ), _mm_mul_ps( p.dy, e2x ) );
+
+    const auto det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+
+    const auto zero = _mm_setzero_ps();
+    const auto one  = _mm_set1_ps( 1.f );
+
+    __m128 valid;
+    if ( side == THREE::FrontSide ) {
+      valid = _mm_cmpgt_ps( det, zero );
+    } else if ( side == THREE::BackSide ) {
+      valid = _mm_cmplt_ps( det, zero );
+    } else {
+      valid = _mm_cmpneq_ps( det, zero );
+    }
+
+    if ( !( _mm_movemask_ps( valid ) & p.active ) )
+      return;
+
+    const auto invDet = _mm_div_ps( one, det );
+
+    const auto sx = _mm_sub_ps( p.ox, _mm_set1_ps( tri.a.x ) );
+    const auto sy = _mm_sub_ps( p.oy, _mm_set1_ps( tri.a.y ) );
+    const auto sz = _mm_sub_ps( p.oz, _mm_set1_ps( tri.a.z ) );
+
+    const auto u = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( sx, px ), _mm_mul_ps( sy, py ) ), _mm_mul_ps( sz, pz ) ), invDet );
+
+    // q = s x e1
+    const auto qx = _mm_sub_ps( _mm_mul_ps( sy, e1z ), _mm_mul_ps( sz, e1y ) );
+    const auto qy = _mm_sub_ps( _mm_mul_ps( sz, e1x ), _mm_mul_ps( sx, e1z ) );
+    const auto qz = _mm_sub_ps( _mm_mul_ps( sx, e1y ), _mm_mul_ps( sy, e1x ) );
+
+    const auto v = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( p.dx, qx ), _mm_mul_ps( p.dy, qy ) ), _mm_mul_ps( p.dz, qz ) ), invDet );
+    const auto t = _mm_mul_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) ), invDet );
+
+    valid = _mm_and_ps( valid, _mm_cmpge_ps( u, zero ) );
+    valid = _mm_and_ps( valid, _mm_cmple_ps( u, one ) );
+    valid = _mm_and_ps( valid, _mm_cmpge_ps( v, zero ) );
+    valid = _mm_and_ps( valid, _mm_cmple_ps( _mm_add_ps( u, v ), one ) );
+    valid = _mm_and_ps( valid, _mm_cmpge_ps( t, p.near ) );
+    valid = _mm_and_ps( valid, _mm_cmplt_ps( t, p.far ) );
+
+    const auto mask = _mm_movemask_ps( valid ) & p.active;
+
+    if ( !mask )
+      return;
+
+    const auto lanes = _mm_castsi128_ps( _mm_set_epi32( -( ( mask >> 3 ) & 1 ), -( ( mask >> 2 ) & 1 ),
+                                                        -( ( mask >> 1 ) & 1 ), -( mask & 1 ) ) );
+
+    p.far = _mm_or_ps( _mm_and_ps( lanes, t ), _mm_andnot_ps( lanes, p.far ) );
+
+    for ( int i = 0; i < 4; ++i ) {
+      if ( mask & ( 1 << i ) ) {
+        p.face[ i ]   = tri.face;
+        p.object[ i ] = p.current;
+      }
+    }
+
+    if ( p.any ) {
+      p.active &= ~mask;
+    }
+
+  }
+
+};
+
+struct ObjectLeaf {
+
+  const SceneBVH& scene;
+  Ray* rays;
+  Ray::Intersection* intersections;
+
+  ObjectLeaf( const SceneBVH& scene, Ray* rays, Ray::Intersection* intersections )
+    : scene( scene ), rays( rays ), intersections( intersections ) { }
+
+  THREE_TARGET_SSE void operator()( unsigned index, RayPacket4& p ) {
+
+    auto& object = *scene.objects[ index ];
+
+    if ( object.type() == THREE::Mesh ) {
+      if ( object.geometry && object.material && !object.staticBatch )
+        mesh( object, p );
+    } else {
+      scalar( object, p );
+    }
+
+  }
+
+  // The packet is carried into object space; t is preserved, so far and
+  // the recorded distances stay in world units.
+  THREE_TARGET_SSE void mesh( Object3D& object, RayPacket4& p ) {
+
+    auto& geometry = *object.geometry;
+
+    const GeometryBVH* bvh = nullptr;
+
+    if ( auto skinned = static_cast<Mesh&>( object ).skinned() ) {
+      bvh = &skinned->skinnedBVH();
+    } else {
+      geometry.updateBVH();
+      bvh = geometry.bvh.get();
+    }
+
+    Matrix4 inverse;
+    inverse.getInverse( object.matrixWorld );
+    const auto& e = inverse.elements;
+
+    RayPacket4 local = p;
+
+    local.ox = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[0] ), p.ox ), _mm_mul_ps( _mm_set1_ps( e[4] ), p.oy ) ),
+                           _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[8] ), p.oz ), _mm_set1_ps( e[12] ) ) );
+    local.oy = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[1] ), p.ox ), _mm_mul_ps( _mm_set1_ps( e[5] ), p.oy ) ),
+                           _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[9] ), p.oz ), _mm_set1_ps( e[13] ) ) );
+    local.oz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[2] ), p.ox ), _mm_mul_ps( _mm_set1_ps( e[6] ), p.oy ) ),
+                           _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[10] ), p.oz ), _mm_set1_ps( e[14] ) ) );
+
+    local.dx = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[0] ), p.dx ), _mm_mul_ps( _mm_set1_ps( e[4] ), p.dy ) ),
+                           _mm_mul_ps( _mm_set1_ps( e[8] ), p.dz ) );
+    local.dy = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[1] ), p.dx ), _mm_mul_ps( _mm_set1_ps( e[5] ), p.dy ) ),
+                           _mm_mul_ps( _mm_set1_ps( e[9] ), p.dz ) );
+    local.dz = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( e[2] ), p.dx ), _mm_mul_ps( _mm_set1_ps( e[6] ), p.dy ) ),
+                           _mm_mul_ps( _mm_set1_ps( e[10] ), p.dz ) );
+
+    setInverseDirection( local );
+
+    local.current = &object;
+    local.flip = object.matrixWorld.determinant() < 0;
+
+    TriangleLeaf leaf( *bvh, geometry, *object.material );
+    traversePacket( bvh->tree, local, leaf );
+
+    p.far    = local.far;
+    p.active = local.active;
+
+    for ( int i = 0; i < 4; ++i ) {
+      p.face[ i ]   = local.face[ i ];
+      p.object[ i ] = local.object[ i ];
+    }
+
+  }
+
+  // Particles keep the single-ray semantics of Ray
+  THREE_TARGET_SSE void scalar( Object3D& object, RayPacket4& p ) {
+
+    float far[ 4 ];
+    _mm_storeu_ps( far, p.far );
+
+    for ( int i = 0; i < 4; ++i ) {
+
+      if ( !( p.active & ( 1 << i ) ) )
+        continue;
+
+      auto& ray = rays[ i ];
+      const auto rayFar = ray.far;
+      ray.far = far[ i ];
+
+      Ray::Intersection hit;
+      if ( ray.intersectClosest( object, hit, false ) ) {
+        intersections[ i ] = hit;
+        far[ i ] = hit.distance;
+        p.object[ i ] = nullptr; // already resolved
+        if ( p.any ) p.active &= ~( 1 << i );
+      }
+
+      ray.far = rayFar;
+
+    }
+
+    p.far = _mm_loadu_ps( far );
+
+  }
+
+};
+
+THREE_TARGET_SSE inline void intersectPacket( const SceneBVH& scene, Ray* rays, Ray::Intersection* intersections, size_t count, bool any ) {
+
+  float v[ 8 ][ 4 ];
+
+  for ( size_t i = 0; i < 4; ++i ) {
+    const auto& ray = rays[ i < count ? i : 0 ];
+    v[ 0 ][ i ] = ray.origin.x;    v[ 1 ][ i ] = ray.origin.y;    v[ 2 ][ i ] = ray.origin.z;
+    v[ 3 ][ i ] = ray.direction.x; v[ 4 ][ i ] = ray.direction.y; v[ 5 ][ i ] = ray.direction.z;
+    v[ 6 ][ i ] = ray.near;        v[ 7 ][ i ] = ray.far;
+  }
+
+  RayPacket4 p;
+  p.ox = _mm_loadu_ps( v[ 0 ] ); p.oy = _mm_loadu_ps( v[ 1 ] ); p.oz = _mm_loadu_ps( v[ 2 ] );
+  p.dx = _mm_loadu_ps( v[ 3 ] ); p.dy = _mm_loadu_ps( v[ 4 ] ); p.dz = _mm_loadu_ps( v[ 5 ] );
+  p.near = _mm_loadu_ps( v[ 6 ] );
+  p.far  = _mm_loadu_ps( v[ 7 ] );
+  setInverseDirection( p );
+
+  p.active  = ( 1 << count ) - 1;
+  p.any     = any;
+  p.current = nullptr;
+  p.flip    = false;
+
+  for ( int i = 0; i < 4; ++i ) {
+    p.face[ i ]   = 0;
+    p.object[ i ] = nullptr;
+  }
+
+  ObjectLeaf leaf( scene, rays, intersections );
+  traversePacket( scene.tree, p, leaf );
+
+  float far[ 4 ];
+  _mm_storeu_ps( far, p.far );
+
+  for ( size_t i = 0; i < count; ++i ) {
+
+    auto object = p.object[ i ];
+
+    if ( !object )
+      continue;
+
+    auto& hit = intersections[ i ];
+    hit.distance  = far[ i ];
+    hit.point     = add( rays[ i ].origin, Vector3( rays[ i ].direction ).multiplyScalar( far[ i ] ) );
+    hit.face      = &object->geometry->faces[ p.face[ i ] ];
+    hit.faceIndex = ( int )p.face[ i ];
+    hit.object    = object;
+
+  }
+
+}
+
+#endif // THREE_SIMD_X86
+
+} // namespace detail
+
+void RayBatch::intersectClosest( const SceneBVH& scene ) {
+  intersect( scene, false );
+}
+
+void RayBatch::intersectAny( const SceneBVH& scene ) {
+  intersect( scene, true );
+}
+
+void RayBatch::intersect( const SceneBVH& scene, bool any ) {
+
+  const auto count = rays.size();
+
+  intersections.resize( count );
+
+  for ( auto& hit : intersections ) {
+    detail::clearIntersection( hit );
+  }
+
+#if THREE_SIMD_X86
+  if ( simd::level() >= simd::SSE ) {
+    for ( size_t i = 0; i < count; i += 4 ) {
+      detail::intersectPacket( scene, &rays[ i ], &intersections[ i ], Math::min<size_t>( 4, count - i ), any );
+    }
+    return;
+  }
+#endif
+
+  for ( size_t i = 0; i < count; ++i ) {
+    if ( any ) {
+      rays[ i ].intersectAny( scene, intersections[ i ] );
+    } else {
+      rays[ i ].intersectClosest( scene, intersections[ i ] );
+    }
+  }
+
+}
+
+} // namespace three
+
+#endif // THREE_RAY_BATCH_IPP
@@ -0,0 +1,673 @@
+#ifndef THREE_TRANSFORM_KERNELS_IPP
+#define THREE_TRANSFORM_KERNELS_IPP
+
+#include <three/core/transform_kernels.hpp>
+
+#include <three/core/matrix4.hpp>
+
+#include <algorithm>
+#include <type_traits>
+
+namespace three {
+
+namespace simd {
+
+namespace detail {
+
+enum TransformMode {
+  Points,      // xyz, perspective divide
+  Affine,      // xyz, no divide
+  Directions,  // xyz, upper 3x3 only
+  Homogeneous, // xyzw, no divide
+  Project      // xyzw, xyz divided by w
+};
+
+template < int Mode >
+inline bool hasTranslation() { return Mode != Directions; }
+
+template < int Mode >
+inline bool hasDivide() { return Mode == Points || Mode == Project; }
+
+template < int Mode >
+inline bool writesW() { return Mode == Homogeneous || Mode == Project; }
+
+template < typename T >
+inline T* advance( T* p, size_t bytes ) {
+  return reinterpret_cast<T*>( reinterpret_cast<typename std::conditional<std::is_const<T>::value, const char, char>::type*>( p ) + bytes );
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+template < int Mode >
+void transformScalar( const float* te,
+                      const float* in, size_t inStride,
+                      float* out, size_t outStride,
+                      size_t count ) {
+
+  for ( size_t i = 0; i < count; ++i, in = advance( in, inStride ), out = advance( out, outStride ) ) {
+
+    const float vx = in[0], vy = in[1], vz = in[2];
+
+    float x = te[0] * vx + te[4] * vy + te[8]  * vz;
+    float y = te[1] * vx + te[5] * vy + te[9]  * vz;
+    float z = te[2] * vx + te[6] * vy + te[10] * vz;
+    float w = 1.f;
+
+    if ( hasTranslation<Mode>() ) {
+      x += te[12];
+      y += te[13];
+      z += te[14];
+    }
+
+    if ( hasDivide<Mode>() || writesW<Mode>() ) {
+      w = te[3] * vx + te[7] * vy + te[11] * vz + te[15];
+    }
+
+    if ( hasDivide<Mode>() ) {
+      const float d = 1.f / w;
+      x *= d;
+      y *= d;
+      z *= d;
+    }
+
+    out[0] = x;
+    out[1] = y;
+    out[2] = z;
+
+    if ( writesW<Mode>() ) {
+      out[3] = w;
+    }
+
+  }
+
+}
+
+#if THREE_SIMD_X86
+
+/////////////////////////////////////////////////////////////////////////
+// SSE
+
+THREE_TARGET_SSE inline void store3( float* out, __m128 r ) {
+  _mm_storel_pi( reinterpret_cast<__m64*>( out ), r );
+  _mm_store_ss( out + 2, _mm_movehl_ps( r, r ) );
+}
+
+template < int Mode >
+THREE_TARGET_SSE void transformSSE( const float* te,
+                                    const float* in, size_t inStride,
+                                    float* out, size_t outStride,
+                                    size_t count ) {
+
+  size_t i = 0;
+
+  // Packed path: contiguous input, contiguous output, 4 points per iteration in SoA form
+
+  if ( inStride == 3 * sizeof( float ) && outStride == ( writesW<Mode>() ? 4 : 3 ) * sizeof( float ) ) {
+
+    __m128 m[16];
+    for ( int k = 0; k < 16; ++k ) m[k] = _mm_set1_ps( te[k] );
+
+    for ( ; i + 4 <= count; i += 4, in += 12, out += writesW<Mode>() ? 16 : 12 ) {
+
+      __m128 vx, vy, vz;
+      unpackXYZ( _mm_loadu_ps( in ), _mm_loadu_ps( in + 4 ), _mm_loadu_ps( in + 8 ), vx, vy, vz );
+
+      __m128 x = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[0], vx ), _mm_mul_ps( m[4], vy ) ), _mm_mul_ps( m[8],  vz ) );
+      __m128 y = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[1], vx ), _mm_mul_ps( m[5], vy ) ), _mm_mul_ps( m[9],  vz ) );
+      __m128 z = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[2], vx ), _mm_mul_ps( m[6], vy ) ), _mm_mul_ps( m[10], vz ) );
+      __m128 w = _mm_set1_ps( 1.f );
+
+      if ( hasTranslation<Mode>() ) {
+        x = _mm_add_ps( x, m[12] );
+        y = _mm_add_ps( y, m[13] );
+        z = _mm_add_ps( z, m[14] );
+      }
+
+      if ( hasDivide<Mode>() || writesW<Mode>() ) {
+        w = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[3], vx ), _mm_mul_ps( m[7], vy ) ),
+                        _mm_add_ps( _mm_mul_ps( m[11], vz ), m[15] ) );
+      }
+
+      if ( hasDivide<Mode>() ) {
+        const __m128 d = _mm_div_ps( _mm_set1_ps( 1.f ), w );
+        x = _mm_mul_ps( x, d );
+        y = _mm_mul_ps( y, d );
+        z = _mm_mul_ps( z, d );
+      }
+
+      if ( writesW<Mode>() ) {
+        _MM_TRANSPOSE4_PS( x, y, z, w );
+        _mm_storeu_ps( out,      x );
+        _mm_storeu_ps( out + 4,  y );
+        _mm_storeu_ps( out + 8,  z );
+        _mm_storeu_ps( out + 12, w );
+      } else {
+        __m128 a, b, c;
+        packXYZ( x, y, z, a, b, c );
+        _mm_storeu_ps( out,     a );
+        _mm_storeu_ps( out + 4, b );
+        _mm_storeu_ps( out + 8, c );
+      }
+
+    }
+
+  }
+
+  // Strided path: one point per iteration, matrix columns kept in registers
+
+  const __m128 c0 = _mm_loadu_ps( te );
+  const __m128 c1 = _mm_loadu_ps( te + 4 );
+  const __m128 c2 = _mm_loadu_ps( te + 8 );
+  const __m128 c3 = _mm_loadu_ps( te + 12 );
+
+  for ( ; i < count; ++i, in = advance( in, inStride ), out = advance( out, outStride ) ) {
+
+    __m128 r = _mm_add_ps( _mm_add_ps( _mm_mul_ps( c0, _mm_set1_ps( in[0] ) ),
+                                       _mm_mul_ps( c1, _mm_set1_ps( in[1] ) ) ),
+                                       _mm_mul_ps( c2, _mm_set1_ps( in[2] ) ) );
+
+    if ( hasTranslation<Mode>() ) {
+      r = _mm_add_ps( r, c3 );
+    }
+
+    if ( hasDivide<Mode>() ) {
+      const __m128 w = _mm_shuffle_ps( r, r, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+      const __m128 d = _mm_div_ps( _mm_set1_ps( 1.f ), w );
+      if ( writesW<Mode>() ) {
+        _mm_storeu_ps( out, _mm_mul_ps( r, d ) );
+        _mm_store_ss( out + 3, w );
+      } else {
+        store3( out, _mm_mul_ps( r, d ) );
+      }
+    } else if ( writesW<Mode>() ) {
+      _mm_storeu_ps( out, r );
+    } else {
+      store3( out, r );
+    }
+
+  }
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+// AVX: same algorithm as the packed SSE path, with two groups of four
+// points in the two 128-bit lanes (8 points per iteration)
+
+THREE_TARGET_AVX inline __m256 load2x4( const float* lo, const float* hi ) {
+  return _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( lo ) ), _mm_loadu_ps( hi ), 1 );
+}
+
+THREE_TARGET_AVX inline void store2x4( float* lo, float* hi, __m256 v ) {
+  _mm_storeu_ps( lo, _mm256_castps256_ps128( v ) );
+  _mm_storeu_ps( hi, _mm256_extractf128_ps( v, 1 ) );
+}
+
+template < int Mode >
+THREE_TARGET_AVX void transformAVX( const float* te,
+                                    const float* in, size_t inStride,
+                                    float* out, size_t outStride,
+                                    size_t count ) {
+
+  const size_t outFloats = writesW<Mode>() ? 4 : 3;
+
+  if ( inStride != 3 * sizeof( float ) || outStride != outFloats * sizeof( float ) ) {
+    transformSSE<Mode>( te, in, inStride, out, outStride, count );
+    return;
+  }
+
+  __m256 m[16];
+  for ( int k = 0; k < 16; ++k ) m[k] = _mm256_set1_ps( te[k] );
+
+  size_t i = 0;
+
+  for ( ; i + 8 <= count; i += 8, in += 24, out += 8 * outFloats ) {
+
+    const __m256 a = load2x4( in,     in + 12 );
+    const __m256 b = load2x4( in + 4, in + 16 );
+    const __m256 c = load2x4( in + 8, in + 20 );
+
+    const __m256 vx = _mm256_shuffle_ps( _mm256_shuffle_ps( a, a, _MM_SHUFFLE( 3, 0, 3, 0 ) ),
+                                         _mm256_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 1, 0 ) );
+    const __m256 vy = _mm256_shuffle_ps( _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ),
+                                         _mm256_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+    const __m256 vz = _mm256_shuffle_ps( _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ),
+                                         _mm256_shuffle_ps( c, c, _MM_SHUFFLE( 3, 0, 3, 0 ) ), _MM_SHUFFLE( 1, 0, 2, 0 ) );
+
+    __m256 x = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[0], vx ), _mm256_mul_ps( m[4], vy ) ), _mm256_mul_ps( m[8],  vz ) );
+    __m256 y = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[1], vx ), _mm256_mul_ps( m[5], vy ) ), _mm256_mul_ps( m[9],  vz ) );
+    __m256 z = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[2], vx ), _mm256_mul_ps( m[6], vy ) ), _mm256_mul_ps( m[10], vz ) );
+    __m256 w = _mm256_set1_ps( 1.f );
+
+    if ( hasTranslation<Mode>() ) {
+      x = _mm256_add_ps( x, m[12] );
+      y = _mm256_add_ps( y, m[13] );
+      z = _mm256_add_ps( z, m[14] );
+    }
+
+    if ( hasDivide<Mode>() || writesW<Mode>() ) {
+      w = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[3], vx ), _mm256_mul_ps( m[7], vy ) ),
+                         _mm256_add_ps( _mm256_mul_ps( m[11], vz ), m[15] ) );
+    }
+
+    if ( hasDivide<Mode>() ) {
+      const __m256 d = _mm256_div_ps( _mm256_set1_ps( 1.f ), w );
+      x = _mm256_mul_ps( x, d );
+      y = _mm256_mul_ps( y, d );
+      z = _mm256_mul_ps( z, d );
+    }
+
+    if ( writesW<Mode>() ) {
+
+      const __m256 t0 = _mm256_unpacklo_ps( x, y );
+      const __m256 t1 = _mm256_unpacklo_ps( z, w );
+      const __m256 t2 = _mm256_unpackhi_ps( x, y );
+      const __m256 t3 = _mm256_unpackhi_ps( z, w );
+
+      store2x4( out,      out + 16, _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+      store2x4( out + 4,  out + 20, _mm256_shuffle_ps( t0, t1, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+      store2x4( out + 8,  out + 24, _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+      store2x4( out + 12, out + 28, _mm256_shuffle_ps( t2, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+
+    } else {
+
+      store2x4( out,     out + 12, _mm256_shuffle_ps( _mm256_shuffle_ps( x, y, _MM_SHUFFLE( 0, 0, 0, 0 ) ),
+                                                      _mm256_shuffle_ps( z, x, _MM_SHUFFLE( 1, 1, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+      store2x4( out + 4, out + 16, _mm256_shuffle_ps( _mm256_shuffle_ps( y, z, _MM_SHUFFLE( 1, 1, 1, 1 ) ),
+                                                      _mm256_shuffle_ps( x, y, _MM_SHUFFLE( 2, 2, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+      store2x4( out + 8, out + 20, _mm256_shuffle_ps( _mm256_shuffle_ps( z, x, _MM_SHUFFLE( 3, 3, 2, 2 ) ),
+                                                      _mm256_shuffle_ps( y, z, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+
+    }
+
+  }
+
+  _mm256_zeroupper();
+
+  transformSSE<Mode>( te, in, inStride, out, outStride, count - i );
+
+}
+
+#endif // THREE_SIMD_X86
+
+/////////////////////////////////////////////////////////////////////////
+
+template < int Mode >
+void transform( const Matrix4& m,
+                const float* in, size_t inStride,
+                float* out, size_t outStride,
+                size_t count ) {
+
+  if ( count == 0 )
+    return;
+
+#if THREE_SIMD_X86
+  switch ( level() ) {
+  case AVX:
+    transformAVX<Mode>( m.elements, in, inStride, out, outStride, count );
+    return;
+  case SSE:
+    transformSSE<Mode>( m.elements, in, inStride, out, outStride, count );
+    return;
+  default:
+    break;
+  }
+#endif // THREE_SIMD_X86
+
+  transformScalar<Mode>( m.elements, in, inStride, out, outStride, count );
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Blends, as base * baseWeight plus each array times its weight. Arrays
+// are read from offset; base and out start at it.
+
+enum { BlendBlock = 2048 }; // floats of out kept in cache across the arrays
+
+inline void blendScalar( const float* base, float baseWeight,
+                         const float* const* arrays, const float* weights, size_t arrayCount,
+                         size_t offset, float* out, size_t count ) {
+
+  for ( size_t i = 0; i < count; ++i ) {
+    out[ i ] = base[ i ] * baseWeight;
+  }
+
+  for ( size_t a = 0; a < arrayCount; ++a ) {
+    const auto src = arrays[ a ] + offset;
+    const auto w = weights[ a ];
+    for ( size_t i = 0; i < count; ++i ) {
+      out[ i ] += src[ i ] * w;
+    }
+  }
+
+}
+
+#if THREE_SIMD_X86
+
+THREE_TARGET_SSE void blendSSE( const float* base, float baseWeight,
+                                const float* const* arrays, const float* weights, size_t arrayCount,
+                                size_t offset, float* out, size_t count ) {
+
+  const auto body = count & ~size_t( 3 );
+
+  const auto bw = _mm_set1_ps( baseWeight );
+
+  for ( size_t i = 0; i < body; i += 4 ) {
+    _mm_storeu_ps( out + i, _mm_mul_ps( _mm_loadu_ps( base + i ), bw ) );
+  }
+
+  for ( auto i = body; i < count; ++i ) {
+    out[ i ] = base[ i ] * baseWeight;
+  }
+
+  for ( size_t a = 0; a < arrayCount; ++a ) {
+
+    const auto src = arrays[ a ] + offset;
+    const auto w = _mm_set1_ps( weights[ a ] );
+
+    for ( size_t i = 0; i < body; i += 4 ) {
+      _mm_storeu_ps( out + i, _mm_add_ps( _mm_loadu_ps( out + i ), _mm_mul_ps( _mm_loadu_ps( src + i ), w ) ) );
+    }
+
+    for ( auto i = body; i < count; ++i ) {
+      out[ i ] += src[ i ] * weights[ a ];
+    }
+
+  }
+
+}
+
+THREE_TARGET_AVX void blendAVX( const float* base, float baseWeight,
+                                const float* const* arrays, const float* weights, size_t arrayCount,
+                                size_t offset, float* out, size_t count ) {
+
+  const auto body = count & ~size_t( 7 );
+
+  const auto bw = _mm256_set1_ps( baseWeight );
+
+  for ( size_t i = 0; i < body; i += 8 ) {
+    _mm256_storeu_ps( out + i, _mm256_mul_ps( _mm256_loadu_ps( base + i ), bw ) );
+  }
+
+  for ( auto i = body; i < count; ++i ) {
+    out[ i ] = base[ i ] * baseWeight;
+  }
+
+  for ( size_t a = 0; a < arrayCount; ++a ) {
+
+    const auto src = arrays[ a ] + offset;
+    const auto w = _mm256_set1_ps( weights[ a ] );
+
+    for ( size_t i = 0; i < body; i += 8 ) {
+      _mm256_storeu_ps( out + i, _mm256_add_ps( _mm256_loadu_ps( out + i ), _mm256_mul_ps( _mm256_loadu_ps( src + i ), w ) ) );
+    }
+
+    for ( auto i = body; i < count; ++i ) {
+      out[ i ] += src[ i ] * weights[ a ];
+    }
+
+  }
+
+}
+
+#endif // THREE_SIMD_X86
+
+inline void blend( const float* base, float baseWeight,
+                   const float* const* arrays, const float* weights, size_t arrayCount,
+                   size_t offset, float* out, size_t count ) {
+
+#if THREE_SIMD_X86
+  switch ( level() ) {
+  case AVX:
+    blendAVX( base, baseWeight, arrays, weights, arrayCount, offset, out, count );
+    return;
+  case SSE:
+    blendSSE( base, baseWeight, arrays, weights, arrayCount, offset, out, count );
+    return;
+  default:
+    break;
+  }
+#endif // THREE_SIMD_X86
+
+  blendScalar( base, baseWeight, arrays, weights, arrayCount, offset, out, count );
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+// Skinning: the palette matrices of a vertex are blended first, then the
+// blend transforms the position (and normal) once
+
+inline bool skinInfluence( const int* indices, const float* weights, int k, size_t bones ) {
+  return weights[ k ] != 0.f && indices[ k ] >= 0 && ( size_t )indices[ k ] < bones;
+}
+
+inline void skinScalar( const Matrix4* palette, size_t bones,
+                        const int* indices, const float* weights,
+                        const float* in, size_t inStride,
+                        float* out, size_t outStride,
+                        const float* normals, size_t normalStride,
+                        float* outNormals, size_t outNormalStride,
+                        size_t count ) {
+
+  for ( size_t i = 0; i < count; ++i, indices += 4, weights += 4, in = advance( in, inStride ), out = advance( out, outStride ) ) {
+
+    // Rows 0-2 of the four columns
+    float m[12] = { 0 };
+
+    for ( int k = 0; k < 4; ++k ) {
+      if ( !skinInfluence( indices, weights, k, bones ) ) continue;
+      const auto te = palette[ indices[ k ] ].elements;
+      const auto w = weights[ k ];
+      for ( int c = 0; c < 4; ++c ) {
+        m[ c * 3 ]     += te[ c * 4 ]     * w;
+        m[ c * 3 + 1 ] += te[ c * 4 + 1 ] * w;
+        m[ c * 3 + 2 ] += te[ c * 4 + 2 ] * w;
+      }
+    }
+
+    const float vx = in[0], vy = in[1], vz = in[2];
+
+    out[0] = m[0] * vx + m[3] * vy + m[6] * vz + m[9];
+    out[1] = m[1] * vx + m[4] * vy + m[7] * vz + m[10];
+    out[2] = m[2] * vx + m[5] * vy + m[8] * vz + m[11];
+
+    if ( normals ) {
+      const float nx = normals[0], ny = normals[1], nz = normals[2];
+      outNormals[0] = m[0] * nx + m[3] * ny + m[6] * nz;
+      outNormals[1] = m[1] * nx + m[4] * ny + m[7] * nz;
+      outNormals[2] = m[2] * nx + m[5] * ny + m[8] * nz;
+      normals = advance( normals, normalStride );
+      outNormals = advance( outNormals, outNormalStride );
+    }
+
+  }
+
+}
+
+#if THREE_SIMD_X86
+
+THREE_TARGET_SSE void skinSSE( const Matrix4* palette, size_t bones,
+                               const int* indices, const float* weights,
+                               const float* in, size_t inStride,
+                               float* out, size_t outStride,
+                               const float* normals, size_t normalStride,
+                               float* outNormals, size_t outNormalStride,
+                               size_t count ) {
+
+  for ( size_t i = 0; i < count; ++i, indices += 4, weights += 4, in = advance( in, inStride ), out = advance( out, outStride ) ) {
+
+    __m128 c0 = _mm_setzero_ps(), c1 = c0, c2 = c0, c3 = c0;
+
+    for ( int k = 0; k < 4; ++k ) {
+      if ( !skinInfluence( indices, weights, k, bones ) ) continue;
+      const auto te = palette[ indices[ k ] ].elements;
+      const auto w = _mm_set1_ps( weights[ k ] );
+      c0 = _mm_add_ps( c0, _mm_mul_ps( _mm_loadu_ps( te ),      w ) );
+      c1 = _mm_add_ps( c1, _mm_mul_ps( _mm_loadu_ps( te + 4 ),  w ) );
+      c2 = _mm_add_ps( c2, _mm_mul_ps( _mm_loadu_ps( te + 8 ),  w ) );
+      c3 = _mm_add_ps( c3, _mm_mul_ps( _mm_loadu_ps( te + 12 ), w ) );
+    }
+
+    store3( out, _mm_add_ps( _mm_add_ps( _mm_mul_ps( c0, _mm_set1_ps( in[0] ) ), _mm_mul_ps( c1, _mm_set1_ps( in[1] ) ) ),
+                             _mm_add_ps( _mm_mul_ps( c2, _mm_set1_ps( in[2] ) ), c3 ) ) );
+
+    if ( normals ) {
+      store3( outNormals, _mm_add_ps( _mm_add_ps( _mm_mul_ps( c0, _mm_set1_ps( normals[0] ) ),
+                                                  _mm_mul_ps( c1, _mm_set1_ps( normals[1] ) ) ),
+                                                  _mm_mul_ps( c2, _mm_set1_ps( normals[2] ) ) ) );
+      normals = advance( normals, normalStride );
+      outNormals = advance( outNormals, outNormalStride );
+    }
+
+  }
+
+}
+
+// lo in the low lane, hi in the high lane
+THREE_TARGET_AVX inline __m256 broadcast2( float lo, float hi ) {
+  return _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_set1_ps( lo ) ), _mm_set1_ps( hi ), 1 );
+}
+
+// Columns 0|1 and 2|3 share a register each, halving the blend
+THREE_TARGET_AVX void skinAVX( const Matrix4* palette, size_t bones,
+                               const int* indices, const float* weights,
+                               const float* in, size_t inStride,
+                               float* out, size_t outStride,
+                               const float* normals, size_t normalStride,
+                               float* outNormals, size_t outNormalStride,
+                               size_t count ) {
+
+  for ( size_t i = 0; i < count; ++i, indices += 4, weights += 4, in = advance( in, inStride ), out = advance( out, outStride ) ) {
+
+    __m256 c01 = _mm256_setzero_ps(), c23 = c01;
+
+    for ( int k = 0; k < 4; ++k ) {
+      if ( !skinInfluence( indices, weights, k, bones ) ) continue;
+      const auto te = palette[ indices[ k ] ].elements;
+      const auto w = _mm256_set1_ps( weights[ k ] );
+      c01 = _mm256_add_ps( c01, _mm256_mul_ps( _mm256_loadu_ps( te ),     w ) );
+      c23 = _mm256_add_ps( c23, _mm256_mul_ps( _mm256_loadu_ps( te + 8 ), w ) );
+    }
+
+    const __m256 p = _mm256_add_ps( _mm256_mul_ps( c01, broadcast2( in[0], in[1] ) ),
+                                    _mm256_mul_ps( c23, broadcast2( in[2], 1.f ) ) );
+
+    store3( out, _mm_add_ps( _mm256_castps256_ps128( p ), _mm256_extractf128_ps( p, 1 ) ) );
+
+    if ( normals ) {
+      const __m256 n = _mm256_add_ps( _mm256_mul_ps( c01, broadcast2( normals[0], normals[1] ) ),
+                                      _mm256_mul_ps( c23, broadcast2( normals[2], 0.f ) ) );
+      store3( outNormals, _mm_add_ps( _mm256_castps256_ps128( n ), _mm256_extractf128_ps( n, 1 ) ) );
+      normals = advance( normals, normalStride );
+      outNormals = advance( outNormals, outNormalStride );
+    }
+
+  }
+
+  _mm256_zeroupper();
+
+}
+
+#endif // THREE_SIMD_X86
+
+inline bool isAffine( const Matrix4& m ) {
+  const auto& te = m.elements;
+  return te[3] == 0.f && te[7] == 0.f && te[11] == 0.f && te[15] == 1.f;
+}
+
+} // namespace detail
+
+/////////////////////////////////////////////////////////////////////////
+
+void transformPoints( const Matrix4& m,
+                      const float* in, size_t inStride,
+                      float* out, size_t outStride,
+                      size_t count ) {
+
+  if ( detail::isAffine( m ) ) {
+    detail::transform<detail::Affine>( m, in, inStride, out, outStride, count );
+  } else {
+    detail::transform<detail::Points>( m, in, inStride, out, outStride, count );
+  }
+
+}
+
+void transformDirections( const Matrix4& m,
+                          const float* in, size_t inStride,
+                          float* out, size_t outStride,
+                          size_t count ) {
+
+  detail::transform<detail::Directions>( m, in, inStride, out, outStride, count );
+
+}
+
+void transformHomogeneous( const Matrix4& m,
+                           const float* in, size_t inStride,
+                           float* out, size_t outStride,
+                           size_t count ) {
+
+  detail::transform<detail::Homogeneous>( m, in, inStride, out, outStride, count );
+
+}
+
+void projectPoints( const Matrix4& m,
+                    const float* in, size_t inStride,
+                    float* out, size_t outStride,
+                    size_t count ) {
+
+  detail::transform<detail::Project>( m, in, inStride, out, outStride, count );
+
+}
+
+void blendArrays( const float* base,
+                  const float* const* arrays, const float* weights, size_t arrayCount,
+                  float* out, size_t count ) {
+
+  auto baseWeight = 1.f;
+
+  for ( size_t a = 0; a < arrayCount; ++a ) {
+    baseWeight -= weights[ a ];
+  }
+
+  for ( size_t offset = 0; offset < count; offset += detail::BlendBlock ) {
+    const auto n = std::min<size_t>( detail::BlendBlock, count - offset );
+    detail::blend( base + offset, baseWeight, arrays, weights, arrayCount, offset, out + offset, n );
+  }
+
+}
+
+void skinVertices( const Matrix4* palette, size_t bones,
+                   const int* indices, const float* weights,
+                   const float* in, size_t inStride,
+                   float* out, size_t outStride,
+                   const float* normals, size_t normalStride,
+                   float* outNormals, size_t outNormalStride,
+                   size_t count ) {
+
+  if ( count == 0 )
+    return;
+
+#if THREE_SIMD_X86
+  switch ( level() ) {
+  case AVX:
+    detail::skinAVX( palette, bones, indices, weights, in, inStride, out, outStride,
+                     normals, normalStride, outNormals, outNormalStride, count );
+    return;
+  case SSE:
+    detail::skinSSE( palette, bones, indices, weights, in, inStride, out, outStride,
+                     normals, normalStride, outNormals, outNormalStride, count );
+    return;
+  default:
+    break;
+  }
+#endif // THREE_SIMD_X86
+
+  detail::skinScalar( palette, bones, indices, weights, in, inStride, out, outStride,
+                      normals, normalStride, outNormals, outNormalStride, count );
+
+}
+
+} // namespace simd
+
+} // namespace three
+
+#endif // THREE_TRANSFORM_KERNELS_IPP
@@ -0,0 +1,151 @@
+#ifndef THREE_TRANSFORM_STORE_IPP
+#define THREE_TRANSFORM_STORE_IPP
+
+#include <three/core/transform_store.hpp>
+
+#include <three/core/object3d.hpp>
+
+namespace three {
+
+TransformStore::TransformStore()
+  : mRoot( nullptr ) { }
+
+TransformStore::~TransformStore() {
+  invalidate();
+}
+
+void TransformStore::touch( int index ) {
+
+  if ( index < 0 || index >= (int)dirty.size() || dirty[ index ] )
+    return;
+
+  dirty[ index ] = 1;
+  mTouched.push_back( index );
+
+}
+
+void TransformStore::invalidate() {
+
+  for ( auto object : objects ) {
+    object->__transformStore = nullptr;
+    object->__transformIndex = -1;
+  }
+
+  local.clear();
+  world.clear();
+  parents.clear();
+  dirty.clear();
+  objects.clear();
+  mTouched.clear();
+
+  mRoot = nullptr;
+
+}
+
+void TransformStore::rebuild( Object3D& root ) {
+
+  invalidate();
+
+  mRoot = &root;
+
+  // Breadth-first flatten: the queue is the object array itself
+
+  objects.push_back( &root );
+  parents.push_back( -1 );
+
+  for ( size_t i = 0; i < objects.size(); ++i ) {
+    for ( auto& child : objects[ i ]->children ) {
+      objects.push_back( child.get() );
+      parents.push_back( (int)i );
+    }
+  }
+
+  const auto count = objects.size();
+
+  local.resize( count );
+  world.resize( count );
+  dirty.assign( count, 1 );
+
+  for ( size_t i = 0; i < count; ++i ) {
+    auto& object = *objects[ i ];
+    object.__transformStore = this;
+    object.__transformIndex = (int)i;
+    mTouched.push_back( (int)i );
+  }
+
+}
+
+void TransformStore::update( Object3D& root, bool force /*= false*/ ) {
+
+  if ( mRoot != &root ) {
+    rebuild( root );
+  }
+
+  if ( mTouched.empty() && !force )
+    return;
+
+  // Gather: rebuild local matrices for touched nodes only
+
+  for ( auto index : mTouched ) {
+
+    auto& object = *objects[ index ];
+
+    if ( object.matrixAutoUpdate ) {
+      object.updateMatrix();
+    }
+
+    local[ index ].copy( object.matrix );
+
+  }
+
+  mTouched.clear();
+
+  // Linear pass: parents precede children, so dirtiness propagates in one sweep
+
+  const auto count = objects.size();
+
+  for ( size_t i = 0; i < count; ++i ) {
+
+    const auto parent = parents[ i ];
+
+    if ( parent >= 0 ) {
+
+      dirty[ i ] |= dirty[ parent ];
+
+      if ( dirty[ i ] || force ) {
+        world[ i ].multiply( world[ parent ], local[ i ] );
+      }
+
+    } else if ( dirty[ i ] || force ) {
+
+      if ( root.parent != nullptr ) {
+        world[ i ].multiply( root.parent->matrixWorld, local[ i ] );
+      } else {
+        world[ i ].copy( local[ i ] );
+      }
+
+    }
+
+  }
+
+  // Scatter results back to the objects
+
+  for ( size_t i = 0; i < count; ++i ) {
+
+    if ( !dirty[ i ] && !force )
+      continue;
+
+    auto& object = *objects[ i ];
+    object.matrixWorld.copy( world[ i ] );
+    object.matrixWorldNeedsUpdate = false;
+    object.matrixWorldChanged();
+
+    dirty[ i ] = 0;
+
+  }
+
+}
+
+} // namespace three
+
+#endif // THREE_TRANSFORM_STORE_IPP
@@ -8,6 +8,8 @@
 #include <three/core/vector3.hpp>
 #include <three/core/vector4.hpp>
 
+#include <vector>
+
 namespace three {
 
 class Matrix4 {
@@ -49,6 +51,11 @@ public:
   THREE_DECL void multiplyVector3( Vector3& v ) const;
   THREE_DECL void multiplyVector4( Vector4& v ) const;
   THREE_DECL std::vector<float>& multiplyVector3Array( std::vector<float>& a ) const;
+  THREE_DECL std::vector<Vertex>& multiplyVector3Array( std::vector<Vertex>& a ) const;
+  THREE_DECL std::vector<float>& multiplyDirection3Array( std::vector<float>& a ) const;
+  THREE_DECL std::vector<Vertex>& multiplyDirection3Array( std::vector<Vertex>& a ) const;
+  THREE_DECL std::vector<float>& projectVector3Array( const std::vector<float>& a, std::vector<float>& out ) const;
+  THREE_DECL std::vector<Vector4>& projectVector3Array( const std::vector<Vertex>& a, std::vector<Vector4>& out ) const;
 
   THREE_DECL Vector3& rotateAxis( Vector3& v ) const;
   THREE_DECL Vector4 crossVector( Vector4 a ) const;
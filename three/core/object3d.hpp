@@ -19,6 +19,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #define THREE_IMPL_OBJECT(NAME)                                       \
@@ -73,6 +74,19 @@ public:
   bool matrixAutoUpdate;
   bool matrixWorldNeedsUpdate;
 
+  // Dirty tracking: when set on the object updateMatrixWorld() is called on,
+  // only subtrees containing touched nodes are visited and local matrices are
+  // rebuilt only for touched nodes. Mutate transforms through the set*()
+  // helpers (or call touch() after writing position/rotation/scale directly).
+  bool matrixDirtyTracking;
+
+  // Incremented whenever matrixWorld is recomputed
+  unsigned matrixWorldVersion;
+
+  // Optional flat transform storage for the hierarchy rooted here; when set,
+  // updateMatrixWorld() on this object updates through the store.
+  std::shared_ptr<TransformStore> transformStore;
+
   Quaternion quaternion;
   bool useQuaternion;
 
@@ -86,6 +100,17 @@ public:
 
   bool frustumCulled;
 
+  // Static batching (see StaticBatcher): renderers skip objects that are
+  // drawn as part of a batch, and picking skips the batches themselves
+  bool batched;
+  bool staticBatch;
+
+  // Frustum plane that last culled this object, tested first next time
+  mutable int __frustumPlane;
+
+  // Last SceneBVH::cull stamp that found this object in the frustum
+  unsigned __cullStamp;
+
   bool sortParticles;
 
   bool useVertexTexture;
@@ -94,24 +119,59 @@ public:
   Texture::Ptr boneTexture;
   int boneTextureWidth, boneTextureHeight;
 
+  // Morph target drawn in place of the vertices, -1 for the vertices
   int morphTargetBase;
+  // Targets to draw, in this order, instead of the most influential ones
   std::vector<int> morphTargetForcedOrder;
+  // Weight of each of the geometry's morph targets
+  std::vector<float> morphTargetInfluences;
 
   Material::Ptr material;
   Geometry::Ptr geometry;
 
   struct GLData {
-    GLData() : __glInit( false ), __glActive( false ) { }
+    GLData() : __glInit( false ), __glActive( false ), __glObjectsBegin( 0 ), __glObjectsCount( 0 ) { }
 
     bool __glInit;
     bool __glActive;
+
+    // The object's entries in Scene::__glObjects, which are contiguous
+    size_t __glObjectsBegin;
+    size_t __glObjectsCount;
     Matrix4 _modelViewMatrix;
     Matrix3 _normalMatrix;
 
     std::vector<float> _normalMatrixArray;
     std::vector<float> _modelViewMatrixArray;
     std::vector<float> _modelMatrixArray;
-    std::vector<int>   __glMorphTargetInfluences;
+
+    // Morph targets bound to each slot of the program, per geometry group
+    // id. Kept while the influences stay the same; targets beyond the
+    // program's slots are blended on the CPU into buffers of their own.
+    struct MorphState {
+      MorphState()
+        : base( -1 ), version( 0 ), slots( 0 ), morphNormals( false ), blendExcess( false ),
+          residualVersion( 0 ), __glResidualBuffer( 0 ), __glResidualNormalBuffer( 0 ) { }
+
+      std::vector<float> influences; // as last selected
+      int base;
+      unsigned version;              // GeometryBuffer::__glMorphVersion
+      int slots;
+      bool morphNormals;
+      bool blendExcess;              // GLRenderer::blendExcessMorphTargets
+
+      std::vector<int> targets;      // per slot; Unused or Residual if negative
+      std::vector<float> weights;    // per slot, the morphTargetInfluences uniform
+
+      std::vector<std::pair<int, float>> residual; // targets blended on the CPU
+      unsigned residualVersion;
+      std::vector<float> residualArray, residualNormalArray;
+      Buffer __glResidualBuffer, __glResidualNormalBuffer;
+
+      enum { Unused = -1, Residual = -2 };
+    };
+
+    std::unordered_map<int, MorphState> __glMorphStates;
 
     void clear() {
       __glInit = false;
@@ -121,7 +181,7 @@ public:
       _normalMatrixArray.clear();
       _modelViewMatrixArray.clear();
       _modelMatrixArray.clear();
-      __glMorphTargetInfluences.clear();
+      __glMorphStates.clear();
     }
   } glData;
 
@@ -154,6 +214,12 @@ public:
 
   THREE_DECL Ptr getChildByName( const std::string& name, bool recursive );
 
+  THREE_DECL void setPosition( const Vector3& value );
+  THREE_DECL void setRotation( const Vector3& value );
+  THREE_DECL void setScale( const Vector3& value );
+  THREE_DECL void setQuaternion( const Quaternion& value );
+  THREE_DECL void touch();
+
   THREE_DECL void updateMatrix();
   THREE_DECL void updateMatrixWorld( bool force = false );
 
@@ -175,6 +241,23 @@ protected:
 
 private:
 
+  THREE_DECL void updateMatrixWorldTracked( bool force );
+
+  bool __matrixDirty;
+  bool __childrenDirty;
+
+  friend class TransformStore;
+  TransformStore* __transformStore;
+  int __transformIndex;
+
+  // Bumps matrixWorldVersion and reports the change to the SceneBVH
+  // indexing this object
+  THREE_DECL void matrixWorldChanged();
+
+  friend class SceneBVH;
+  std::shared_ptr<SceneBVHMoves> __spatialMoves;
+  unsigned __spatialSlot;
+
   static int& Object3DCount() {
     static int sObject3DCount = 0;
     return sObject3DCount;
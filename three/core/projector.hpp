@@ -18,6 +18,7 @@ class Projector : public NonCopyable {
 public:
 
   THREE_DECL Projector();
+  THREE_DECL ~Projector();
 
   THREE_DECL Vector3& projectVector( Vector3& vector, const Camera& camera );
   THREE_DECL Vector3& unprojectVector( Vector3& vector, const Camera& camera );
@@ -35,6 +36,12 @@ public:
   THREE_DECL RenderData& projectGraph( Object3D& root, bool sort );
   THREE_DECL RenderData& projectScene( Scene& scene, Camera& camera, bool sort );
 
+  // Worker threads used by projectScene; 1 (the default) projects on the
+  // calling thread, 0 uses every hardware thread. Meshes are split into
+  // face ranges, and the output is the same for any thread count.
+  THREE_DECL void setThreads( size_t threads );
+  THREE_DECL size_t threads() const;
+
   struct Impl;
 
 protected:
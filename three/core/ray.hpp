@@ -2,9 +2,12 @@
 #define THREE_RAY_HPP
 
 #include <three/common.hpp>
+#include <three/console.hpp>
 
+#include <three/core/bvh.hpp>
 #include <three/core/math.hpp>
 #include <three/objects/mesh.hpp>
+#include <three/objects/skinned_mesh.hpp>
 
 namespace three {
 
@@ -62,164 +65,235 @@ public:
 
     std::vector<Intersection> intersects;
 
-    if ( recursive ) {
+    collectIntersections( object, recursive, intersects );
 
-      for ( const auto& child : object.children ) {
-        auto iter_intersects = intersectObject( *child, recursive );
-        intersects.insert( intersects.end(), iter_intersects.begin(), iter_intersects.end() );
-      }
+    std::sort( intersects.begin(), intersects.end(), descSort );
 
-    }
+    return intersects;
 
-    if ( object.type() == THREE::Particle ) {
+  }
 
-      auto distance = distanceFromIntersection( origin, direction, object.matrixWorld.getPosition() );
+  std::vector<Intersection> intersectObjects( const std::vector<Object3D*>& objects, bool recursive ) {
 
-      if ( distance > object.scale.x ) {
-        return std::vector<Intersection>();//intersects;
-      }
+    std::vector<Intersection> intersects;
 
-      Intersection i = { distance, object.position, nullptr, 0, &object };
-      intersects.push_back( i );
+    for ( const auto& object : objects ) {
+      collectIntersections( *object, recursive, intersects );
+    }
 
-    } else if ( object.type() == THREE::Mesh ) {
+    std::sort( intersects.begin(), intersects.end(), descSort );
 
-      if ( !object.geometry || !object.material ) {
-        console().warn( "Error extracting mesh geometry/material." );
-        return std::vector<Intersection>();
-      }
+    return intersects;
 
-      const auto& geometry = *object.geometry;
-      const auto& material = *object.material;
+  }
 
-      // Checking boundingSphere
+  /////////////////////////////////////////////////////////////////////////
 
-      auto scale = Vector3( object.matrixWorld.getColumnX().length(),
-                            object.matrixWorld.getColumnY().length(),
-                            object.matrixWorld.getColumnZ().length() );
-      auto scaledRadius = geometry.boundingSphere.radius * Math::max( scale.x, Math::max( scale.y, scale.z ) );
+  // Nearest intersection only; does not allocate (beyond building a
+  // missing Geometry::bvh, or a skinned mesh's BVH, on first use).
 
-      // Checking distance to ray
+  bool intersectClosest( Object3D& object, Intersection& hit, bool recursive = true ) {
+    auto limit = far;
+    return intersectHierarchy( object, recursive, false, limit, hit );
+  }
 
-      auto distance = distanceFromIntersection( origin, direction, object.matrixWorld.getPosition() );
+  bool intersectClosest( const SceneBVH& scene, Intersection& hit ) {
+    return intersectScene( scene, false, hit );
+  }
 
-      if ( distance > scaledRadius ) {
-        return intersects;
-      }
+  // True as soon as any intersection is found (e.g. occlusion tests)
 
-      // Checking faces
+  bool intersectAny( Object3D& object, bool recursive = true ) {
+    auto limit = far;
+    Intersection hit;
+    return intersectHierarchy( object, recursive, true, limit, hit );
+  }
 
-      const auto& vertices = geometry.vertices;
-      const auto& geometryMaterials = geometry.materials;
-      auto isFaceMaterial = material.type() == THREE::MeshFaceMaterial;
+  bool intersectAny( const SceneBVH& scene ) {
+    Intersection hit;
+    return intersectAny( scene, hit );
+  }
 
-      object.matrixRotationWorld.extractRotation( object.matrixWorld );
+  bool intersectAny( const SceneBVH& scene, Intersection& hit ) {
+    return intersectScene( scene, true, hit );
+  }
 
-      Vector3 vector, normal, intersectPoint;
+  void setPrecision( float value ) {
+    precision = value;
+  }
 
-      for ( size_t f = 0, fl = geometry.faces.size(); f < fl; f++ ) {
+private:
 
-        const auto& face = geometry.faces[ f ];
+  bool intersectParticle( Object3D& object, float limit, Intersection& hit ) {
 
-        const auto& face_material = isFaceMaterial ? geometryMaterials[ face.materialIndex ].get() : &material;
-        //if ( !face_material ) continue;
+    auto distance = distanceFromIntersection( origin, direction, object.matrixWorld.getPosition() );
 
-        auto side = face_material->side;
+    if ( distance > object.scale.x || distance >= limit ) {
+      return false;
+    }
 
-        Vector3 originCopy( origin );
-        Vector3 directionCopy( direction );
+    Intersection i = { distance, object.position, nullptr, 0, &object };
+    hit = i;
+    return true;
 
-        const auto& objMatrix = object.matrixWorld;
+  }
 
-        // determine if ray intersects the plane of the face
-        // note: this works regardless of the direction of the face normal
+  // Casts the ray in object space: t is unchanged by the transform, so hit
+  // distances stay in world units. Returns the mesh's triangle BVH, of the
+  // skinned pose for skinned meshes.
+  const GeometryBVH* prepareMesh( Object3D& object, Vector3& localOrigin, Vector3& localDirection, bool& flip ) {
 
-        vector = objMatrix.multiplyVector3( face.centroid ).subSelf( originCopy );
-        normal = object.matrixRotationWorld.multiplyVector3( face.normal );
-        auto d = directionCopy.dot( normal );
+    if ( !object.geometry || !object.material ) {
+      console().warn( "Error extracting mesh geometry/material." );
+      return nullptr;
+    }
 
-        // bail if ray and plane are parallel
+    const GeometryBVH* bvh = nullptr;
 
-        if ( Math::abs( d ) < precision ) continue;
+    if ( auto skinned = static_cast<Mesh&>( object ).skinned() ) {
+      bvh = &skinned->skinnedBVH();
+    } else {
+      object.geometry->updateBVH();
+      bvh = object.geometry->bvh.get();
+    }
 
-        // calc distance to plane
+    Matrix4 inverse;
+    inverse.getInverse( object.matrixWorld );
 
-        auto scalar = normal.dot( vector ) / d;
+    const auto& e = inverse.elements;
 
-        // if negative distance, then plane is behind ray
+    localOrigin = origin;
+    inverse.multiplyVector3( localOrigin );
+    localDirection.set( e[0] * direction.x + e[4] * direction.y + e[8] * direction.z,
+                        e[1] * direction.x + e[5] * direction.y + e[9] * direction.z,
+                        e[2] * direction.x + e[6] * direction.y + e[10] * direction.z );
 
-        if ( scalar < 0 ) continue;
+    flip = object.matrixWorld.determinant() < 0;
 
-        if ( side == THREE::DoubleSide || ( side == THREE::FrontSide ? dot < 0 : dot > 0 ) ) {
+    return bvh;
 
-          intersectPoint.add( originCopy, directionCopy.multiplyScalar( scalar ) );
+  }
 
-          auto distance = originCopy.distanceTo( intersectPoint );
+  Intersection meshIntersection( Object3D& object, const GeometryBVH::Hit& h ) const {
+    Intersection i = { h.distance,
+                       add( origin, Vector3( direction ).multiplyScalar( h.distance ) ),
+                       &object.geometry->faces[ h.face ],
+                       ( int )h.face,
+                       &object };
+    return i;
+  }
 
-          if ( distance < near ) continue;
-          if ( distance > far ) continue;
+  bool intersectSingle( Object3D& object, float limit, bool any, Intersection& hit ) {
 
-          if ( face.type() == THREE::Face3 ) {
+    if ( object.type() == THREE::Particle ) {
+      return intersectParticle( object, limit, hit );
+    }
 
-            auto a = objMatrix.multiplyVector3( vertices[ face.a ] );
-            auto b = objMatrix.multiplyVector3( vertices[ face.b ] );
-            auto c = objMatrix.multiplyVector3( vertices[ face.c ] );
+    if ( object.type() != THREE::Mesh || object.staticBatch ) {
+      return false;
+    }
 
-            if ( pointInFace3( intersectPoint, a, b, c ) ) {
+    Vector3 localOrigin, localDirection;
+    bool flip;
 
-              Intersection i = { distance, intersectPoint, &face, ( int )f, &object };
-              intersects.push_back( i );
+    const auto bvh = prepareMesh( object, localOrigin, localDirection, flip );
 
-            }
+    if ( !bvh ) {
+      return false;
+    }
 
-          } else if ( face.type() == THREE::Face4 ) {
+    GeometryBVH::Hit h;
 
-            auto a = objMatrix.multiplyVector3( vertices[ face.a ] );
-            auto b = objMatrix.multiplyVector3( vertices[ face.b ] );
-            auto c = objMatrix.multiplyVector3( vertices[ face.c ] );
-            auto d = objMatrix.multiplyVector3( vertices[ face.d ] );
+    if ( !bvh->intersect( localOrigin, localDirection, near, limit,
+                          *object.geometry, *object.material, flip, any, h ) ) {
+      return false;
+    }
 
-            if ( pointInFace3( intersectPoint, a, b, d ) || pointInFace3( intersectPoint, b, c, d ) ) {
+    hit = meshIntersection( object, h );
+    return true;
 
-              Intersection i = { distance, intersectPoint, &face, ( int )f, &object };
-              intersects.push_back( i );
+  }
 
-            }
+  bool intersectHierarchy( Object3D& object, bool recursive, bool any, float& limit, Intersection& hit ) {
 
-          }
+    auto found = intersectSingle( object, limit, any, hit );
 
+    if ( found ) {
+      if ( any ) return true;
+      limit = hit.distance;
+    }
+
+    if ( recursive ) {
+      for ( const auto& child : object.children ) {
+        if ( intersectHierarchy( *child, recursive, any, limit, hit ) ) {
+          if ( any ) return true;
+          found = true;
         }
+      }
+    }
+
+    return found;
+
+  }
+
+  bool intersectScene( const SceneBVH& scene, bool any, Intersection& hit ) {
+
+    auto found = false;
+    auto limit = far;
 
+    scene.tree.traverse( origin, direction, near, limit, [&]( unsigned index, float& tMax ) -> bool {
+
+      if ( intersectSingle( *scene.objects[ index ], tMax, any, hit ) ) {
+        tMax = hit.distance;
+        found = true;
+        return any;
       }
 
-    }
+      return false;
 
-    std::sort( intersects.begin(), intersects.end(), descSort );
+    } );
 
-    return intersects;
+    return found;
 
   }
 
-  std::vector<Intersection> intersectObjects( const std::vector<Object3D*>& objects, bool recursive ) {
-
-    std::vector<Intersection> intersects;
+  void collectIntersections( Object3D& object, bool recursive, std::vector<Intersection>& intersects ) {
 
-    for ( const auto& object : objects ) {
-      auto iter_intersects = intersectObject( *object, recursive );
-      intersects.insert( intersects.end(), iter_intersects.begin(), iter_intersects.end() );
+    if ( recursive ) {
+      for ( const auto& child : object.children ) {
+        collectIntersections( *child, recursive, intersects );
+      }
     }
 
-    std::sort( intersects.begin(), intersects.end(), descSort );
+    if ( object.type() == THREE::Particle ) {
 
-    return intersects;
+      Intersection hit;
+      if ( intersectParticle( object, Math::INF(), hit ) ) {
+        intersects.push_back( hit );
+      }
 
-  }
+    } else if ( object.type() == THREE::Mesh && !object.staticBatch ) {
 
-  void setPrecision( float value ) {
-    precision = value;
-  }
+      Vector3 localOrigin, localDirection;
+      bool flip;
 
-private:
+      const auto bvh = prepareMesh( object, localOrigin, localDirection, flip );
+
+      if ( !bvh ) {
+        return;
+      }
+
+      mHits.clear();
+      bvh->intersectAll( localOrigin, localDirection, near, far,
+                         *object.geometry, *object.material, flip, mHits );
+
+      for ( const auto& h : mHits ) {
+        intersects.push_back( meshIntersection( object, h ) );
+      }
+
+    }
+
+  }
 
   float distanceFromIntersection( const Vector3& origin, const Vector3& direction, const Vector3& position ) {
 
@@ -233,8 +307,10 @@ private:
 
   float precision;
 
+  std::vector<GeometryBVH::Hit> mHits;
+
 };
 
 } // namespace three
 
-#endif // THREE
+#endif // THREE_RAY_HPP
@@ -0,0 +1,50 @@
+#ifndef THREE_RAY_BATCH_HPP
+#define THREE_RAY_BATCH_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/bvh.hpp>
+#include <three/core/ray.hpp>
+
+#include <vector>
+
+namespace three {
+
+// Batched ray queries against a SceneBVH. Rays are traced in packets of
+// four that share one walk of the scene and geometry hierarchies, with the
+// box and triangle tests done four rays at a time (SSE; falls back to one
+// Ray query per ray on other targets). Keep the batch around between
+// frames: intersections is only resized when the ray count grows.
+
+class RayBatch {
+public:
+
+  std::vector<Ray> rays;
+
+  // One entry per ray; object is nullptr when the ray hit nothing
+  std::vector<Ray::Intersection> intersections;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  THREE_DECL void intersectClosest( const SceneBVH& scene );
+
+  // Any hit per ray (line-of-sight); for hits, distance and face are those
+  // of the first intersection found, not necessarily the nearest
+  THREE_DECL void intersectAny( const SceneBVH& scene );
+
+  size_t size() const { return rays.size(); }
+  void clear() { rays.clear(); }
+
+private:
+
+  THREE_DECL void intersect( const SceneBVH& scene, bool any );
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/core/impl/ray_batch.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_RAY_BATCH_HPP
@@ -0,0 +1,72 @@
+#ifndef THREE_TRANSFORM_KERNELS_HPP
+#define THREE_TRANSFORM_KERNELS_HPP
+
+#include <three/common.hpp>
+
+#include <three/utils/simd.hpp>
+
+#include <cstddef>
+
+namespace three {
+
+namespace simd {
+
+// Batch transforms over strided float triples. Strides are in bytes, so the
+// same kernels serve flat float arrays (stride 12), std::vector<Vertex> and
+// fields embedded in larger structs (e.g. Face::normal, RenderableVertex).
+// Input and output may alias exactly (in-place), but must not partially overlap.
+
+// out.xyz = ( M * (x,y,z,1) ).xyz / w, matching Matrix4::multiplyVector3.
+// Affine matrices skip the divide.
+THREE_DECL void transformPoints( const Matrix4& m,
+                                 const float* in, size_t inStride,
+                                 float* out, size_t outStride,
+                                 size_t count );
+
+// out.xyz = M3x3 * (x,y,z); use for normals/directions (no translation).
+THREE_DECL void transformDirections( const Matrix4& m,
+                                     const float* in, size_t inStride,
+                                     float* out, size_t outStride,
+                                     size_t count );
+
+// out.xyzw = M * (x,y,z,1); clip-space output without perspective divide.
+THREE_DECL void transformHomogeneous( const Matrix4& m,
+                                      const float* in, size_t inStride,
+                                      float* out, size_t outStride,
+                                      size_t count );
+
+// out.xyzw = ( (M * (x,y,z,1)).xyz / w, w ); full projection to NDC.
+THREE_DECL void projectPoints( const Matrix4& m,
+                               const float* in, size_t inStride,
+                               float* out, size_t outStride,
+                               size_t count );
+
+// out = base + sum of weights[ i ] * ( arrays[ i ] - base ) over count
+// floats; blends morph targets. out may alias base.
+THREE_DECL void blendArrays( const float* base,
+                             const float* const* arrays, const float* weights, size_t arrayCount,
+                             float* out, size_t count );
+
+// Linear blend skinning: out = sum over the four influences of a vertex of
+// weights[ k ] * palette[ indices[ k ] ] * (x,y,z,1), and likewise for
+// normals without the translation (pass null normals to skip them).
+// indices and weights hold four entries per vertex; zero weights and
+// indices outside the palette are skipped. Palettes are taken as affine,
+// and blended normals are not renormalized.
+THREE_DECL void skinVertices( const Matrix4* palette, size_t bones,
+                              const int* indices, const float* weights,
+                              const float* in, size_t inStride,
+                              float* out, size_t outStride,
+                              const float* normals, size_t normalStride,
+                              float* outNormals, size_t outNormalStride,
+                              size_t count );
+
+} // namespace simd
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/core/impl/transform_kernels.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_TRANSFORM_KERNELS_HPP
@@ -0,0 +1,77 @@
+#ifndef THREE_TRANSFORM_STORE_HPP
+#define THREE_TRANSFORM_STORE_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/matrix4.hpp>
+
+#include <three/utils/memory.hpp>
+#include <three/utils/noncopyable.hpp>
+
+#include <vector>
+
+namespace three {
+
+// Flat storage for the transforms of a scene graph. Local/world matrices,
+// parent indices and dirty bits live in contiguous arrays in breadth-first
+// order (parents always precede their children), so a world matrix update
+// is a single linear pass instead of a recursive pointer chase.
+//
+// Attach to the root of a hierarchy with
+//   scene->transformStore = TransformStore::create();
+// after which scene->updateMatrixWorld() goes through the store. Only
+// nodes flagged with Object3D::touch() (or the set*() helpers) have their
+// local matrices rebuilt; results are written back to Object3D::matrixWorld,
+// so each matrix is kept twice and Object3D itself is no more compact.
+
+class TransformStore : NonCopyable {
+public:
+
+  typedef std::shared_ptr<TransformStore> Ptr;
+
+  static Ptr create() { return three::make_shared<TransformStore>(); }
+
+  THREE_DECL ~TransformStore();
+
+  /////////////////////////////////////////////////////////////////////////
+
+  std::vector<Matrix4>   local;
+  std::vector<Matrix4>   world;
+  std::vector<int>       parents;
+  std::vector<unsigned char> dirty;
+  std::vector<Object3D*> objects;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  THREE_DECL void update( Object3D& root, bool force = false );
+
+  // Flag slot index as modified
+  THREE_DECL void touch( int index );
+
+  // Drop all handles; the hierarchy is flattened again on the next update.
+  // Adding, removing or destroying a node of the hierarchy calls this.
+  THREE_DECL void invalidate();
+
+  size_t size() const { return objects.size(); }
+  bool valid() const { return mRoot != nullptr; }
+
+protected:
+
+  THREE_DECL TransformStore();
+
+  THREE_DECL void rebuild( Object3D& root );
+
+private:
+
+  Object3D* mRoot;
+  std::vector<int> mTouched;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/core/impl/transform_store.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_TRANSFORM_STORE_HPP
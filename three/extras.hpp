@@ -8,7 +8,10 @@
 #include <three/extras/geometries/sphere_geometry.hpp>
 #include <three/extras/geometries/torus_geometry.hpp>
 
+#include <three/extras/geometry_utils.hpp>
 #include <three/extras/image_utils.hpp>
 #include <three/extras/scene_utils.hpp>
+#include <three/extras/static_batcher.hpp>
+#include <three/extras/particle_engine.hpp>
 
 #endif // THREE_EXTRAS_HPP
\ No newline at end of file
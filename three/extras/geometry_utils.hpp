@@ -1,8 +1,14 @@
 #ifndef THREE_GEOMETRY_UTILS_HPP
 #define THREE_GEOMETRY_UTILS_HPP
 
+#include <three/common.hpp>
+
 #include <three/core/face3.hpp>
 #include <three/core/face4.hpp>
+#include <three/core/geometry.hpp>
+#include <three/core/object3d.hpp>
+
+#include <three/utils/template.hpp>
 
 namespace three {
 
@@ -130,10 +136,45 @@ public:
 
   }
 
+  // Post-transform vertex cache
+
+  // Cache behaviour of the triangles a geometry is drawn with: faces grouped
+  // by material, triangles before quads, as GLRenderer uploads them.
+  // Vertices are identified by index, as after welding.
+  struct VertexCacheStats {
+    VertexCacheStats() : triangles( 0 ), vertices( 0 ), transforms( 0 ) { }
+
+    int triangles;
+    int vertices;   // distinct vertices, counted per material group
+    int transforms; // misses in a FIFO cache
+
+    // Average cache miss ratio: transforms per triangle, 0.5 at best
+    float acmr() const { return triangles ? ( float )transforms / triangles : 0.f; }
+    // Average transform to vertex ratio, 1 at best
+    float atvr() const { return vertices ? ( float )transforms / vertices : 0.f; }
+  };
+
+  struct VertexCacheReport {
+    VertexCacheStats before, after;
+  };
+
+  THREE_DECL static VertexCacheStats vertexCacheStats( const Geometry& geometry, int cacheSize = 16 );
+
+  // Reorders faces for a FIFO vertex cache of cacheSize entries (Tipsify)
+  // and vertices by first use, for fetch locality. With reduceOverdraw, the
+  // clusters the ordering breaks into are drawn outward-facing first.
+  // Call at load time, before the geometry is first rendered; geometries
+  // with morph normals are left as they are.
+  THREE_DECL static VertexCacheReport optimizeVertexCache( Geometry& geometry, int cacheSize = 16, bool reduceOverdraw = true );
+
 }; // GeometryUtils
 
 } // namespace three
 
+#if defined(THREE_HEADER_ONLY)
+# include <three/extras/impl/geometry_utils.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
 #endif // THREE_GEOMETRY_UTILS_HPP
 
 
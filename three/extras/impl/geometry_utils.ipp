@@ -0,0 +1,434 @@
+#ifndef THREE_GEOMETRY_UTILS_IPP
+#define THREE_GEOMETRY_UTILS_IPP
+
+#include <three/extras/geometry_utils.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace three {
+
+namespace detail {
+
+typedef GeometryUtils::VertexCacheStats VertexCacheStats;
+
+inline int corners( const Face& face ) {
+  return face.type() == THREE::Face4 ? 4 : 3;
+}
+
+// Faces in the order GLRenderer draws them: a run per material, in order
+// of first use, each with its triangles before its quads
+
+inline std::vector<std::vector<int>> drawOrder( const Geometry& geometry ) {
+
+  std::vector<int> materials;
+  std::vector<std::vector<int>> runs;
+
+  for ( int f = 0, fl = ( int )geometry.faces.size(); f < fl; ++f ) {
+
+    const auto& face = geometry.faces[ f ];
+
+    auto material = std::find( materials.begin(), materials.end(), face.materialIndex );
+    if ( material == materials.end() ) {
+      materials.push_back( face.materialIndex );
+      runs.resize( runs.size() + 2 );
+      material = materials.end() - 1;
+    }
+
+    const auto run = 2 * ( material - materials.begin() ) + ( corners( face ) == 4 ? 1 : 0 );
+    runs[ run ].push_back( f );
+
+  }
+
+  runs.erase( std::remove_if( runs.begin(), runs.end(), []( const std::vector<int>& run ) {
+    return run.empty();
+  } ), runs.end() );
+
+  return runs;
+
+}
+
+// FIFO cache over vertex indices, timestamped by miss count
+
+class VertexCacheSim {
+public:
+
+  VertexCacheSim( int vertices, int cacheSize )
+    : stamps( vertices, -1 ), seen( vertices, -1 ), size( cacheSize ), time( 0 ), base( 0 ), run( 0 ) { }
+
+  // Empty cache, e.g. between draw calls
+  void flush() { base = time; ++run; }
+
+  void triangle( int a, int b, int c, VertexCacheStats& stats ) {
+    access( a, stats );
+    access( b, stats );
+    access( c, stats );
+    ++stats.triangles;
+  }
+
+  void face( const Face& face, VertexCacheStats& stats ) {
+    if ( corners( face ) == 4 ) {
+      triangle( face.a, face.b, face.d, stats );
+      triangle( face.b, face.c, face.d, stats );
+    } else {
+      triangle( face.a, face.b, face.c, stats );
+    }
+  }
+
+private:
+
+  void access( int v, VertexCacheStats& stats ) {
+    if ( seen[ v ] != run ) {
+      seen[ v ] = run;
+      ++stats.vertices;
+    }
+    if ( stamps[ v ] < base || time - stamps[ v ] >= size ) {
+      stamps[ v ] = time++;
+      ++stats.transforms;
+    }
+  }
+
+  std::vector<int> stamps, seen;
+  int size, time, base, run;
+
+};
+
+// Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"): fans around the most recently cached
+// vertex that can still take its remaining faces. Appends the faces of run
+// to order, and the positions in order where the cache was cold to clusters.
+
+inline void tipsify( const Geometry& geometry, const std::vector<int>& run, int cacheSize,
+                     std::vector<int>& local, std::vector<int>& order, std::vector<size_t>& clusters ) {
+
+  const auto& faces = geometry.faces;
+
+  // Vertices of the run, renumbered in first use order
+  std::vector<int> vertices;
+  for ( auto f : run ) {
+    for ( int i = 0; i < corners( faces[ f ] ); ++i ) {
+      auto& v = local[ faces[ f ].abcd[ i ] ];
+      if ( v < 0 ) {
+        v = ( int )vertices.size();
+        vertices.push_back( faces[ f ].abcd[ i ] );
+      }
+    }
+  }
+
+  const int n = ( int )vertices.size();
+
+  // Faces around each vertex
+  std::vector<int> offsets( n + 1, 0 );
+  for ( auto f : run ) {
+    for ( int i = 0; i < corners( faces[ f ] ); ++i )
+      ++offsets[ local[ faces[ f ].abcd[ i ] ] + 1 ];
+  }
+  for ( int v = 0; v < n; ++v ) {
+    offsets[ v + 1 ] += offsets[ v ];
+  }
+
+  std::vector<int> live( n ), adjacency( offsets[ n ] );
+  for ( int t = 0; t < ( int )run.size(); ++t ) {
+    const auto& face = faces[ run[ t ] ];
+    for ( int i = 0; i < corners( face ); ++i ) {
+      const auto v = local[ face.abcd[ i ] ];
+      adjacency[ offsets[ v ] + live[ v ]++ ] = t;
+    }
+  }
+
+  std::vector<int> stamps( n, 0 ), deadEnd, candidates;
+  std::vector<char> emitted( run.size(), 0 );
+
+  int time = cacheSize + 1, cursor = 1;
+
+  clusters.push_back( order.size() );
+
+  for ( int fan = 0; fan >= 0; ) {
+
+    candidates.clear();
+
+    for ( int a = offsets[ fan ]; a < offsets[ fan + 1 ]; ++a ) {
+
+      const auto t = adjacency[ a ];
+      if ( emitted[ t ] ) continue;
+
+      emitted[ t ] = 1;
+      order.push_back( run[ t ] );
+
+      const auto& face = faces[ run[ t ] ];
+      for ( int i = 0; i < corners( face ); ++i ) {
+        const auto v = local[ face.abcd[ i ] ];
+        deadEnd.push_back( v );
+        candidates.push_back( v );
+        --live[ v ];
+        if ( time - stamps[ v ] > cacheSize ) {
+          stamps[ v ] = time++;
+        }
+      }
+
+    }
+
+    // Prefer the oldest cached vertex whose remaining faces still fit
+    int next = -1, best = -1;
+    for ( auto v : candidates ) {
+      if ( live[ v ] == 0 ) continue;
+      const auto age = time - stamps[ v ];
+      const auto priority = age + 2 * live[ v ] <= cacheSize ? age : 0;
+      if ( priority > best ) {
+        best = priority;
+        next = v;
+      }
+    }
+
+    if ( next < 0 ) {
+
+      while ( !deadEnd.empty() && next < 0 ) {
+        const auto v = deadEnd.back();
+        deadEnd.pop_back();
+        if ( live[ v ] > 0 ) next = v;
+      }
+
+      for ( ; next < 0 && cursor < n; ++cursor ) {
+        if ( live[ cursor ] > 0 ) next = cursor;
+      }
+
+      if ( next >= 0 && time - stamps[ next ] > cacheSize ) {
+        clusters.push_back( order.size() );
+      }
+
+    }
+
+    fan = next;
+
+  }
+
+  for ( auto v : vertices ) {
+    local[ v ] = -1;
+  }
+
+}
+
+// Splits clusters further wherever the miss ratio since the cluster began
+// is no worse than the run's as a whole, so reordering them costs little
+
+inline void splitClusters( const Geometry& geometry, const std::vector<int>& order, size_t begin, size_t end,
+                           int cacheSize, std::vector<size_t>& clusters ) {
+
+  VertexCacheStats run;
+  {
+    VertexCacheSim sim( ( int )geometry.vertices.size(), cacheSize );
+    for ( auto i = begin; i < end; ++i )
+      sim.face( geometry.faces[ order[ i ] ], run );
+  }
+
+  std::vector<size_t> split;
+
+  auto hard = std::lower_bound( clusters.begin(), clusters.end(), begin );
+
+  VertexCacheSim sim( ( int )geometry.vertices.size(), cacheSize );
+  VertexCacheStats cluster;
+
+  for ( auto i = begin; i < end; ++i ) {
+
+    if ( hard != clusters.end() && *hard == i ) {
+      if ( split.empty() || split.back() != i ) split.push_back( i );
+      ++hard;
+      sim.flush();
+      cluster = VertexCacheStats();
+    }
+
+    sim.face( geometry.faces[ order[ i ] ], cluster );
+
+    if ( i + 1 < end && cluster.triangles >= 2 * cacheSize &&
+         ( long long )cluster.transforms * run.triangles <= ( long long )run.transforms * cluster.triangles ) {
+      split.push_back( i + 1 );
+      sim.flush();
+      cluster = VertexCacheStats();
+    }
+
+  }
+
+  // Replace this run's clusters with the split ones
+  auto first = std::lower_bound( clusters.begin(), clusters.end(), begin );
+  auto last  = std::lower_bound( clusters.begin(), clusters.end(), end );
+  clusters.insert( clusters.erase( first, last ), split.begin(), split.end() );
+
+}
+
+// Sorts the clusters of order[ begin, end ) by how far they face away from
+// the run's centroid, outermost first, so they tend to occlude the rest
+
+inline void sortClusters( const Geometry& geometry, std::vector<int>& order, size_t begin, size_t end,
+                          const std::vector<size_t>& clusters ) {
+
+  const auto& faces = geometry.faces;
+  const auto& vertices = geometry.vertices;
+
+  auto centroidOf = [&]( const Face& face ) {
+    Vector3 centroid;
+    for ( int i = 0; i < corners( face ); ++i )
+      centroid.addSelf( vertices[ face.abcd[ i ] ] );
+    return centroid.divideScalar( ( float )corners( face ) );
+  };
+
+  Vector3 center;
+  for ( auto i = begin; i < end; ++i )
+    center.addSelf( centroidOf( faces[ order[ i ] ] ) );
+  center.divideScalar( ( float )( end - begin ) );
+
+  struct Cluster {
+    size_t begin, end;
+    float facing;
+  };
+
+  std::vector<Cluster> sorted;
+
+  auto first = std::lower_bound( clusters.begin(), clusters.end(), begin );
+  auto last  = std::lower_bound( clusters.begin(), clusters.end(), end );
+
+  for ( auto c = first; c != last; ++c ) {
+
+    Cluster cluster = { *c, c + 1 != last ? *( c + 1 ) : end, 0.f };
+
+    Vector3 centroid, normal;
+    for ( auto i = cluster.begin; i < cluster.end; ++i ) {
+      const auto& face = faces[ order[ i ] ];
+      const auto& a = vertices[ face.a ];
+      centroid.addSelf( centroidOf( face ) );
+      // Area weighted, over both halves of a quad
+      for ( int j = 2; j < corners( face ); ++j ) {
+        normal.addSelf( Vector3().cross( sub( vertices[ face.abcd[ j - 1 ] ], a ), sub( vertices[ face.abcd[ j ] ], a ) ) );
+      }
+    }
+    centroid.divideScalar( ( float )( cluster.end - cluster.begin ) );
+
+    const auto length = normal.length();
+    cluster.facing = length > 0 ? centroid.subSelf( center ).dot( normal ) / length : 0.f;
+
+    sorted.push_back( cluster );
+
+  }
+
+  std::stable_sort( sorted.begin(), sorted.end(), []( const Cluster& a, const Cluster& b ) {
+    return a.facing > b.facing;
+  } );
+
+  std::vector<int> reordered;
+  reordered.reserve( end - begin );
+  for ( const auto& cluster : sorted ) {
+    reordered.insert( reordered.end(), order.begin() + cluster.begin, order.begin() + cluster.end );
+  }
+
+  std::copy( reordered.begin(), reordered.end(), order.begin() + begin );
+
+}
+
+template < typename T >
+inline void permute( std::vector<T>& items, const std::vector<int>& from ) {
+  if ( items.size() != from.size() ) return;
+  std::vector<T> permuted;
+  permuted.reserve( items.size() );
+  for ( auto i : from )
+    permuted.push_back( items[ i ] );
+  items.swap( permuted );
+}
+
+} // namespace detail
+
+GeometryUtils::VertexCacheStats GeometryUtils::vertexCacheStats( const Geometry& geometry, int cacheSize ) {
+
+  VertexCacheStats stats;
+  detail::VertexCacheSim sim( ( int )geometry.vertices.size(), cacheSize );
+
+  for ( const auto& run : detail::drawOrder( geometry ) ) {
+    sim.flush();
+    for ( auto f : run )
+      sim.face( geometry.faces[ f ], stats );
+  }
+
+  return stats;
+
+}
+
+GeometryUtils::VertexCacheReport GeometryUtils::optimizeVertexCache( Geometry& geometry, int cacheSize, bool reduceOverdraw ) {
+
+  VertexCacheReport report;
+  report.before = report.after = vertexCacheStats( geometry, cacheSize );
+
+  if ( geometry.faces.empty() || !geometry.morphNormals.empty() )
+    return report;
+
+  // Faces
+
+  std::vector<int> local( geometry.vertices.size(), -1 );
+  std::vector<int> order;
+  std::vector<size_t> clusters;
+
+  order.reserve( geometry.faces.size() );
+
+  for ( const auto& run : detail::drawOrder( geometry ) ) {
+
+    const auto begin = order.size();
+
+    detail::tipsify( geometry, run, cacheSize, local, order, clusters );
+
+    if ( reduceOverdraw ) {
+      detail::splitClusters( geometry, order, begin, order.size(), cacheSize, clusters );
+      detail::sortClusters( geometry, order, begin, order.size(), clusters );
+    }
+
+  }
+
+  detail::permute( geometry.faces, order );
+
+  for ( auto& uvs : geometry.faceUvs )
+    detail::permute( uvs, order );
+  for ( auto& uvs : geometry.faceVertexUvs )
+    detail::permute( uvs, order );
+
+  // Vertices, in first use order; unused ones keep their order at the end
+
+  std::vector<int> from, to( geometry.vertices.size(), -1 );
+  from.reserve( geometry.vertices.size() );
+
+  for ( const auto& face : geometry.faces ) {
+    for ( int i = 0; i < detail::corners( face ); ++i ) {
+      auto& v = to[ face.abcd[ i ] ];
+      if ( v < 0 ) {
+        v = ( int )from.size();
+        from.push_back( face.abcd[ i ] );
+      }
+    }
+  }
+
+  for ( int v = 0; v < ( int )to.size(); ++v ) {
+    if ( to[ v ] < 0 ) {
+      to[ v ] = ( int )from.size();
+      from.push_back( v );
+    }
+  }
+
+  for ( auto& face : geometry.faces ) {
+    for ( int i = 0; i < detail::corners( face ); ++i )
+      face.abcd[ i ] = to[ face.abcd[ i ] ];
+  }
+
+  detail::permute( geometry.vertices, from );
+  detail::permute( geometry.colors, from );
+  detail::permute( geometry.skinWeights, from );
+  detail::permute( geometry.skinIndices, from );
+
+  for ( auto& morphTarget : geometry.morphTargets )
+    detail::permute( morphTarget.vertices, from );
+
+  geometry.bvh.reset();
+
+  report.after = vertexCacheStats( geometry, cacheSize );
+
+  return report;
+
+}
+
+} // namespace three
+
+#endif // THREE_GEOMETRY_UTILS_IPP
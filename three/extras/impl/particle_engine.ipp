@@ -0,0 +1,606 @@
+#ifndef THREE_PARTICLE_ENGINE_IPP
+#define THREE_PARTICLE_ENGINE_IPP
+
+#include <three/extras/particle_engine.hpp>
+
+#include <three/core/vector4.hpp>
+
+#include <three/utils/simd.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace three {
+
+namespace detail {
+
+enum { ParticleChunk = 1 << 14 };
+
+// What one update() does to every particle
+struct ParticleStep {
+  float dt;
+  float damping;              // velocity kept, after drag
+  float ax, ay, az;           // constant acceleration
+  const Vector4* attractors;  // xyz, strength
+  const float* softening;     // radius^2 per attractor
+  size_t attractorCount;
+};
+
+struct ParticleArrays {
+  float* f[ 16 ];             // ParticleEngine::Field order
+  float* positions;           // xyz per particle
+  float* colors;              // rgb per particle
+  float* sizes;               // optional
+};
+
+enum { PX, PY, PZ, VX, VY, VZ, Age, Life, Size, SizeRate, R, G, B, RRate, GRate, BRate };
+
+inline void integrateScalar( const ParticleStep& s, const ParticleArrays& p,
+                             size_t begin, size_t end, std::vector<std::uint32_t>& dead ) {
+
+  auto f = p.f;
+
+  for ( auto i = begin; i < end; ++i ) {
+
+    auto ax = s.ax, ay = s.ay, az = s.az;
+
+    for ( size_t a = 0; a < s.attractorCount; ++a ) {
+      const auto& attractor = s.attractors[ a ];
+      const auto dx = attractor.x - f[PX][i], dy = attractor.y - f[PY][i], dz = attractor.z - f[PZ][i];
+      const auto inv = 1.f / std::sqrt( dx * dx + dy * dy + dz * dz + s.softening[ a ] );
+      const auto pull = attractor.w * inv * inv * inv;
+      ax += dx * pull;
+      ay += dy * pull;
+      az += dz * pull;
+    }
+
+    const auto vx = ( f[VX][i] + ax * s.dt ) * s.damping;
+    const auto vy = ( f[VY][i] + ay * s.dt ) * s.damping;
+    const auto vz = ( f[VZ][i] + az * s.dt ) * s.damping;
+
+    f[VX][i] = vx;
+    f[VY][i] = vy;
+    f[VZ][i] = vz;
+
+    const auto x = f[PX][i] += vx * s.dt;
+    const auto y = f[PY][i] += vy * s.dt;
+    const auto z = f[PZ][i] += vz * s.dt;
+
+    const auto size = f[Size][i] += f[SizeRate][i] * s.dt;
+    const auto r = f[R][i] += f[RRate][i] * s.dt;
+    const auto g = f[G][i] += f[GRate][i] * s.dt;
+    const auto b = f[B][i] += f[BRate][i] * s.dt;
+
+    p.positions[ i * 3 ]     = x;
+    p.positions[ i * 3 + 1 ] = y;
+    p.positions[ i * 3 + 2 ] = z;
+
+    p.colors[ i * 3 ]     = r;
+    p.colors[ i * 3 + 1 ] = g;
+    p.colors[ i * 3 + 2 ] = b;
+
+    if ( p.sizes ) p.sizes[ i ] = size;
+
+    if ( ( f[Age][i] += s.dt ) >= f[Life][i] ) {
+      dead.push_back( ( std::uint32_t )i );
+    }
+
+  }
+
+}
+
+#if THREE_SIMD_X86
+
+/////////////////////////////////////////////////////////////////////////
+// SSE
+
+THREE_TARGET_SSE inline __m128 advanceSSE( float* field, const float* rate, size_t i, __m128 dt ) {
+  const auto v = _mm_add_ps( _mm_loadu_ps( field + i ), _mm_mul_ps( _mm_loadu_ps( rate + i ), dt ) );
+  _mm_storeu_ps( field + i, v );
+  return v;
+}
+
+THREE_TARGET_SSE inline void storeXYZ( float* out, __m128 x, __m128 y, __m128 z ) {
+  __m128 a, b, c;
+  simd::packXYZ( x, y, z, a, b, c );
+  _mm_storeu_ps( out, a );
+  _mm_storeu_ps( out + 4, b );
+  _mm_storeu_ps( out + 8, c );
+}
+
+// 1 / sqrt, refined once from the estimate
+THREE_TARGET_SSE inline __m128 rsqrtSSE( __m128 x ) {
+  const auto y = _mm_rsqrt_ps( x );
+  return _mm_mul_ps( _mm_mul_ps( _mm_set1_ps( .5f ), y ),
+                     _mm_sub_ps( _mm_set1_ps( 3.f ), _mm_mul_ps( _mm_mul_ps( x, y ), y ) ) );
+}
+
+THREE_TARGET_SSE void integrateSSE( const ParticleStep& s, const ParticleArrays& p,
+                                    size_t begin, size_t end, std::vector<std::uint32_t>& dead ) {
+
+  auto f = p.f;
+
+  const auto dt = _mm_set1_ps( s.dt );
+  const auto damping = _mm_set1_ps( s.damping );
+
+  auto i = begin;
+
+  for ( ; i + 4 <= end; i += 4 ) {
+
+    auto ax = _mm_set1_ps( s.ax ), ay = _mm_set1_ps( s.ay ), az = _mm_set1_ps( s.az );
+
+    auto x = _mm_loadu_ps( f[PX] + i ), y = _mm_loadu_ps( f[PY] + i ), z = _mm_loadu_ps( f[PZ] + i );
+
+    for ( size_t a = 0; a < s.attractorCount; ++a ) {
+      const auto& attractor = s.attractors[ a ];
+      const auto dx = _mm_sub_ps( _mm_set1_ps( attractor.x ), x );
+      const auto dy = _mm_sub_ps( _mm_set1_ps( attractor.y ), y );
+      const auto dz = _mm_sub_ps( _mm_set1_ps( attractor.z ), z );
+      const auto d2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ),
+                                  _mm_add_ps( _mm_mul_ps( dz, dz ), _mm_set1_ps( s.softening[ a ] ) ) );
+      const auto inv = rsqrtSSE( d2 );
+      const auto pull = _mm_mul_ps( _mm_set1_ps( attractor.w ), _mm_mul_ps( inv, _mm_mul_ps( inv, inv ) ) );
+      ax = _mm_add_ps( ax, _mm_mul_ps( dx, pull ) );
+      ay = _mm_add_ps( ay, _mm_mul_ps( dy, pull ) );
+      az = _mm_add_ps( az, _mm_mul_ps( dz, pull ) );
+    }
+
+    const auto vx = _mm_mul_ps( _mm_add_ps( _mm_loadu_ps( f[VX] + i ), _mm_mul_ps( ax, dt ) ), damping );
+    const auto vy = _mm_mul_ps( _mm_add_ps( _mm_loadu_ps( f[VY] + i ), _mm_mul_ps( ay, dt ) ), damping );
+    const auto vz = _mm_mul_ps( _mm_add_ps( _mm_loadu_ps( f[VZ] + i ), _mm_mul_ps( az, dt ) ), damping );
+
+    _mm_storeu_ps( f[VX] + i, vx );
+    _mm_storeu_ps( f[VY] + i, vy );
+    _mm_storeu_ps( f[VZ] + i, vz );
+
+    x = _mm_add_ps( x, _mm_mul_ps( vx, dt ) );
+    y = _mm_add_ps( y, _mm_mul_ps( vy, dt ) );
+    z = _mm_add_ps( z, _mm_mul_ps( vz, dt ) );
+
+    _mm_storeu_ps( f[PX] + i, x );
+    _mm_storeu_ps( f[PY] + i, y );
+    _mm_storeu_ps( f[PZ] + i, z );
+
+    storeXYZ( p.positions + i * 3, x, y, z );
+
+    const auto size = advanceSSE( f[Size], f[SizeRate], i, dt );
+
+    storeXYZ( p.colors + i * 3, advanceSSE( f[R], f[RRate], i, dt ),
+                                advanceSSE( f[G], f[GRate], i, dt ),
+                                advanceSSE( f[B], f[BRate], i, dt ) );
+
+    if ( p.sizes ) _mm_storeu_ps( p.sizes + i, size );
+
+    const auto age = _mm_add_ps( _mm_loadu_ps( f[Age] + i ), dt );
+    _mm_storeu_ps( f[Age] + i, age );
+
+    auto expired = _mm_movemask_ps( _mm_cmpge_ps( age, _mm_loadu_ps( f[Life] + i ) ) );
+
+    for ( std::uint32_t lane = 0; expired; ++lane, expired >>= 1 ) {
+      if ( expired & 1 ) dead.push_back( ( std::uint32_t )i + lane );
+    }
+
+  }
+
+  integrateScalar( s, p, i, end, dead );
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+// AVX
+
+THREE_TARGET_AVX inline __m256 advanceAVX( float* field, const float* rate, size_t i, __m256 dt ) {
+  const auto v = _mm256_add_ps( _mm256_loadu_ps( field + i ), _mm256_mul_ps( _mm256_loadu_ps( rate + i ), dt ) );
+  _mm256_storeu_ps( field + i, v );
+  return v;
+}
+
+// Eight triples as two packed halves
+THREE_TARGET_AVX inline void storeXYZ( float* out, __m256 x, __m256 y, __m256 z ) {
+  __m128 a, b, c;
+  simd::packXYZ( _mm256_castps256_ps128( x ), _mm256_castps256_ps128( y ), _mm256_castps256_ps128( z ), a, b, c );
+  _mm_storeu_ps( out, a );
+  _mm_storeu_ps( out + 4, b );
+  _mm_storeu_ps( out + 8, c );
+  simd::packXYZ( _mm256_extractf128_ps( x, 1 ), _mm256_extractf128_ps( y, 1 ), _mm256_extractf128_ps( z, 1 ), a, b, c );
+  _mm_storeu_ps( out + 12, a );
+  _mm_storeu_ps( out + 16, b );
+  _mm_storeu_ps( out + 20, c );
+}
+
+THREE_TARGET_AVX inline __m256 rsqrtAVX( __m256 x ) {
+  const auto y = _mm256_rsqrt_ps( x );
+  return _mm256_mul_ps( _mm256_mul_ps( _mm256_set1_ps( .5f ), y ),
+                        _mm256_sub_ps( _mm256_set1_ps( 3.f ), _mm256_mul_ps( _mm256_mul_ps( x, y ), y ) ) );
+}
+
+THREE_TARGET_AVX void integrateAVX( const ParticleStep& s, const ParticleArrays& p,
+                                    size_t begin, size_t end, std::vector<std::uint32_t>& dead ) {
+
+  auto f = p.f;
+
+  const auto dt = _mm256_set1_ps( s.dt );
+  const auto damping = _mm256_set1_ps( s.damping );
+
+  auto i = begin;
+
+  for ( ; i + 8 <= end; i += 8 ) {
+
+    auto ax = _mm256_set1_ps( s.ax ), ay = _mm256_set1_ps( s.ay ), az = _mm256_set1_ps( s.az );
+
+    auto x = _mm256_loadu_ps( f[PX] + i ), y = _mm256_loadu_ps( f[PY] + i ), z = _mm256_loadu_ps( f[PZ] + i );
+
+    for ( size_t a = 0; a < s.attractorCount; ++a ) {
+      const auto& attractor = s.attractors[ a ];
+      const auto dx = _mm256_sub_ps( _mm256_set1_ps( attractor.x ), x );
+      const auto dy = _mm256_sub_ps( _mm256_set1_ps( attractor.y ), y );
+      const auto dz = _mm256_sub_ps( _mm256_set1_ps( attractor.z ), z );
+      const auto d2 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ),
+                                     _mm256_add_ps( _mm256_mul_ps( dz, dz ), _mm256_set1_ps( s.softening[ a ] ) ) );
+      const auto inv = rsqrtAVX( d2 );
+      const auto pull = _mm256_mul_ps( _mm256_set1_ps( attractor.w ), _mm256_mul_ps( inv, _mm256_mul_ps( inv, inv ) ) );
+      ax = _mm256_add_ps( ax, _mm256_mul_ps( dx, pull ) );
+      ay = _mm256_add_ps( ay, _mm256_mul_ps( dy, pull ) );
+      az = _mm256_add_ps( az, _mm256_mul_ps( dz, pull ) );
+    }
+
+    const auto vx = _mm256_mul_ps( _mm256_add_ps( _mm256_loadu_ps( f[VX] + i ), _mm256_mul_ps( ax, dt ) ), damping );
+    const auto vy = _mm256_mul_ps( _mm256_add_ps( _mm256_loadu_ps( f[VY] + i ), _mm256_mul_ps( ay, dt ) ), damping );
+    const auto vz = _mm256_mul_ps( _mm256_add_ps( _mm256_loadu_ps( f[VZ] + i ), _mm256_mul_ps( az, dt ) ), damping );
+
+    _mm256_storeu_ps( f[VX] + i, vx );
+    _mm256_storeu_ps( f[VY] + i, vy );
+    _mm256_storeu_ps( f[VZ] + i, vz );
+
+    x = _mm256_add_ps( x, _mm256_mul_ps( vx, dt ) );
+    y = _mm256_add_ps( y, _mm256_mul_ps( vy, dt ) );
+    z = _mm256_add_ps( z, _mm256_mul_ps( vz, dt ) );
+
+    _mm256_storeu_ps( f[PX] + i, x );
+    _mm256_storeu_ps( f[PY] + i, y );
+    _mm256_storeu_ps( f[PZ] + i, z );
+
+    storeXYZ( p.positions + i * 3, x, y, z );
+
+    const auto size = advanceAVX( f[Size], f[SizeRate], i, dt );
+
+    storeXYZ( p.colors + i * 3, advanceAVX( f[R], f[RRate], i, dt ),
+                                advanceAVX( f[G], f[GRate], i, dt ),
+                                advanceAVX( f[B], f[BRate], i, dt ) );
+
+    if ( p.sizes ) _mm256_storeu_ps( p.sizes + i, size );
+
+    const auto age = _mm256_add_ps( _mm256_loadu_ps( f[Age] + i ), dt );
+    _mm256_storeu_ps( f[Age] + i, age );
+
+    auto expired = _mm256_movemask_ps( _mm256_cmp_ps( age, _mm256_loadu_ps( f[Life] + i ), _CMP_GE_OQ ) );
+
+    for ( std::uint32_t lane = 0; expired; ++lane, expired >>= 1 ) {
+      if ( expired & 1 ) dead.push_back( ( std::uint32_t )i + lane );
+    }
+
+  }
+
+  integrateScalar( s, p, i, end, dead );
+
+}
+
+#endif // THREE_SIMD_X86
+
+inline void integrateParticles( const ParticleStep& s, const ParticleArrays& p,
+                                size_t begin, size_t end, std::vector<std::uint32_t>& dead ) {
+
+#if THREE_SIMD_X86
+  switch ( simd::level() ) {
+  case simd::AVX:
+    integrateAVX( s, p, begin, end, dead );
+    return;
+  case simd::SSE:
+    integrateSSE( s, p, begin, end, dead );
+    return;
+  default:
+    break;
+  }
+#endif // THREE_SIMD_X86
+
+  integrateScalar( s, p, begin, end, dead );
+
+}
+
+} // namespace detail
+
+/////////////////////////////////////////////////////////////////////////
+
+ParticleEngine::ParticleEngine( const Material::Ptr& material, size_t capacity )
+  : mGeometry( BufferGeometry::create() ),
+    mCount( 0 ),
+    mCapacity( capacity ),
+    mSeed( 0x9e3779b9u ) {
+
+  static_assert( Fields == 16, "detail::ParticleArrays holds one pointer per field" );
+
+  for ( auto& field : mFields ) {
+    field.resize( capacity );
+  }
+
+  auto& attributes = mGeometry->attributes;
+
+  auto& position = attributes[ AttributeKey::position() ] = Attribute( THREE::v3 );
+  position.itemSize = 3;
+
+  auto& color = attributes[ AttributeKey::color() ] = Attribute( THREE::c );
+  color.itemSize = 3;
+
+  if ( material && material->attributes.contains( "size" ) ) {
+    attributes[ "size" ] = Attribute( THREE::f );
+  }
+
+  mGeometry->dynamic = true;
+
+  system = ParticleSystem::create( mGeometry, material );
+
+}
+
+void ParticleEngine::setThreads( size_t threads ) {
+  mPool.resize( threads );
+}
+
+void ParticleEngine::update( float dt ) {
+
+  mOwed.resize( emitters.size(), 0.f );
+
+  for ( size_t e = 0; e < emitters.size(); ++e ) {
+
+    const auto& emitter = emitters[ e ];
+
+    if ( ! emitter.enabled ) {
+      mOwed[ e ] = 0;
+      continue;
+    }
+
+    mOwed[ e ] += emitter.rate * dt;
+
+    const auto due = ( size_t )mOwed[ e ];
+    mOwed[ e ] -= ( float )due;
+
+    spawn( emitter, due );
+
+  }
+
+  resizeArrays();
+
+  integrate( dt );
+
+  compact();
+
+  resizeArrays();
+
+  mGeometry->verticesNeedUpdate = true;
+  mGeometry->colorsNeedUpdate = true;
+
+  if ( auto sizes = mGeometry->attributes.get( "size" ) ) {
+    sizes->needsUpdate = true;
+  }
+
+}
+
+size_t ParticleEngine::emit( const Emitter& emitter, size_t count ) {
+
+  const auto before = mCount;
+  spawn( emitter, count );
+  return mCount - before;
+
+}
+
+void ParticleEngine::clear() {
+
+  mCount = 0;
+  std::fill( mOwed.begin(), mOwed.end(), 0.f );
+
+  resizeArrays();
+
+  mGeometry->verticesNeedUpdate = true;
+  mGeometry->colorsNeedUpdate = true;
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+void ParticleEngine::spawn( const Emitter& emitter, size_t count ) {
+
+  count = std::min( count, mCapacity - mCount );
+
+  auto f = mFields;
+
+  for ( auto i = mCount; i < mCount + count; ++i ) {
+
+    f[PX][i] = random( emitter.position.x, emitter.positionSpread.x );
+    f[PY][i] = random( emitter.position.y, emitter.positionSpread.y );
+    f[PZ][i] = random( emitter.position.z, emitter.positionSpread.z );
+
+    f[VX][i] = random( emitter.velocity.x, emitter.velocitySpread.x );
+    f[VY][i] = random( emitter.velocity.y, emitter.velocitySpread.y );
+    f[VZ][i] = random( emitter.velocity.z, emitter.velocitySpread.z );
+
+    const auto life = std::max( random( emitter.life, emitter.lifeSpread ), 1e-3f );
+
+    f[Age][i]  = 0;
+    f[Life][i] = life;
+
+    // Sizes and colors change at a constant rate to reach their end values
+    // at the end of the particle's life
+
+    f[Size][i]     = emitter.size;
+    f[SizeRate][i] = ( emitter.sizeEnd - emitter.size ) / life;
+
+    f[R][i] = emitter.color.r;
+    f[G][i] = emitter.color.g;
+    f[B][i] = emitter.color.b;
+
+    f[RRate][i] = ( emitter.colorEnd.r - emitter.color.r ) / life;
+    f[GRate][i] = ( emitter.colorEnd.g - emitter.color.g ) / life;
+    f[BRate][i] = ( emitter.colorEnd.b - emitter.color.b ) / life;
+
+  }
+
+  mCount += count;
+
+}
+
+void ParticleEngine::integrate( float dt ) {
+
+  // Forces reduced to one acceleration, one damping factor and attractors
+
+  detail::ParticleStep step;
+  step.dt = dt;
+  step.ax = step.ay = step.az = 0;
+
+  float drag = 0;
+  std::vector<Vector4> attractors;
+  std::vector<float> softening;
+
+  for ( const auto& force : forces ) {
+    switch ( force.type ) {
+    case Force::Acceleration:
+      step.ax += force.vector.x;
+      step.ay += force.vector.y;
+      step.az += force.vector.z;
+      break;
+    case Force::Drag:
+      drag += force.strength;
+      break;
+    case Force::Attractor:
+      attractors.push_back( Vector4( force.vector.x, force.vector.y, force.vector.z, force.strength ) );
+      softening.push_back( force.radius * force.radius );
+      break;
+    }
+  }
+
+  step.damping = std::max( 0.f, 1.f - drag * dt );
+  step.attractors = attractors.data();
+  step.softening = softening.data();
+  step.attractorCount = attractors.size();
+
+  detail::ParticleArrays arrays;
+
+  for ( int field = 0; field < Fields; ++field ) {
+    arrays.f[ field ] = mFields[ field ].data();
+  }
+
+  auto& attributes = mGeometry->attributes;
+  auto sizes = attributes.get( "size" );
+
+  arrays.positions = attributes[ AttributeKey::position() ].array.data();
+  arrays.colors    = attributes[ AttributeKey::color() ].array.data();
+  arrays.sizes     = sizes ? sizes->array.data() : nullptr;
+
+  const auto count = mCount;
+  const auto chunks = ( count + detail::ParticleChunk - 1 ) / detail::ParticleChunk;
+
+  if ( mDead.size() < chunks ) {
+    mDead.resize( chunks );
+  }
+
+  mPool.parallelFor( chunks, [&]( size_t chunk, size_t ) {
+
+    const auto begin = chunk * detail::ParticleChunk;
+    const auto end = std::min( count, begin + detail::ParticleChunk );
+
+    auto& dead = mDead[ chunk ];
+    dead.clear();
+
+    detail::integrateParticles( step, arrays, begin, end, dead );
+
+  } );
+
+  for ( auto chunk = chunks; chunk < mDead.size(); ++chunk ) {
+    mDead[ chunk ].clear();
+  }
+
+}
+
+// Fills each expired particle's slot with the last live particle. Chunks
+// list their expired particles in order, so the slots are visited front to
+// back and the live range shrinks from the back.
+
+void ParticleEngine::compact() {
+
+  const auto& age  = mFields[ Age ];
+  const auto& life = mFields[ Life ];
+
+  auto live = mCount;
+
+  for ( const auto& dead : mDead ) {
+
+    for ( auto slot : dead ) {
+
+      if ( slot >= live ) {
+        mCount = live;
+        return;
+      }
+
+      // skip expired particles at the back
+      do {
+        --live;
+      } while ( live > slot && age[ live ] >= life[ live ] );
+
+      if ( live > slot ) {
+        move( live, slot );
+      }
+
+    }
+
+  }
+
+  mCount = live;
+
+}
+
+void ParticleEngine::move( size_t from, size_t to ) {
+
+  for ( auto& field : mFields ) {
+    field[ to ] = field[ from ];
+  }
+
+  for ( auto& a : mGeometry->attributes ) {
+
+    auto& array = a.second.array;
+    const auto size = ( size_t )a.second.itemSize;
+
+    std::copy( array.begin() + from * size, array.begin() + ( from + 1 ) * size, array.begin() + to * size );
+
+  }
+
+}
+
+// The renderer draws as many particles as the arrays hold
+
+void ParticleEngine::resizeArrays() {
+
+  for ( auto& a : mGeometry->attributes ) {
+    a.second.array.resize( mCount * a.second.itemSize );
+  }
+
+}
+
+// xorshift32; spawning needs fast numbers more than good ones
+
+float ParticleEngine::random() {
+
+  mSeed ^= mSeed << 13;
+  mSeed ^= mSeed >> 17;
+  mSeed ^= mSeed << 5;
+
+  return ( mSeed >> 8 ) * ( 1.f / 16777216.f );
+
+}
+
+float ParticleEngine::random( float center, float spread ) {
+
+  return spread == 0 ? center : center + spread * ( 2.f * random() - 1.f );
+
+}
+
+} // namespace three
+
+#endif // THREE_PARTICLE_ENGINE_IPP
@@ -0,0 +1,395 @@
+#ifndef THREE_STATIC_BATCHER_IPP
+#define THREE_STATIC_BATCHER_IPP
+
+#include <three/extras/static_batcher.hpp>
+
+#include <three/core/frustum.hpp>
+#include <three/core/transform_kernels.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace three {
+
+namespace detail {
+
+// Appends source, under matrix, to the faces and vertices of batch
+
+inline void bakeGeometry( Geometry& batch, const Geometry& source, const Matrix4& matrix ) {
+
+  const auto vertexOffset = batch.vertices.size();
+  const auto faceOffset   = batch.faces.size();
+
+  const auto vertexCount = source.vertices.size();
+  const auto faceCount   = source.faces.size();
+
+  if ( faceCount == 0 )
+    return;
+
+  batch.vertices.resize( vertexOffset + vertexCount );
+
+  if ( vertexCount > 0 ) {
+    simd::transformPoints( matrix, &source.vertices[ 0 ].x, sizeof( Vertex ),
+                           &batch.vertices[ vertexOffset ].x, sizeof( Vertex ), vertexCount );
+  }
+
+  batch.faces.insert( batch.faces.end(), source.faces.begin(), source.faces.end() );
+
+  const auto offset = ( int )vertexOffset;
+
+  for ( auto f = faceOffset; f < batch.faces.size(); ++f ) {
+    auto& face = batch.faces[ f ];
+    face.a += offset;
+    face.b += offset;
+    face.c += offset;
+    if ( face.type() == THREE::Face4 ) face.d += offset;
+    // the batch draws with one material
+    face.materialIndex = -1;
+  }
+
+  // Normals by the inverse transpose, tangents as directions on the surface
+
+  Matrix4 normalMatrix;
+  normalMatrix.getInverse( matrix ).transpose();
+
+  const auto stride = sizeof( Face );
+  auto faces = &batch.faces[ faceOffset ];
+
+  simd::transformDirections( normalMatrix, &faces->normal.x, stride, &faces->normal.x, stride, faceCount );
+
+  for ( auto i = 0; i < 4; ++i ) {
+    auto normals = &faces->vertexNormals[ i ].x;
+    simd::transformDirections( normalMatrix, normals, stride, normals, stride, faceCount );
+  }
+
+  if ( source.hasTangents ) {
+    for ( auto i = 0; i < 4; ++i ) {
+      auto tangents = &faces->vertexTangents[ i ].x;
+      simd::transformDirections( matrix, tangents, stride, tangents, stride, faceCount );
+    }
+    batch.hasTangents = true;
+  }
+
+  simd::transformPoints( matrix, &faces->centroid.x, stride, &faces->centroid.x, stride, faceCount );
+
+  // Uv layers stay one-to-one with faces; sources without one get zeros
+
+  for ( size_t layer = 0; layer < batch.faceVertexUvs.size() && layer < source.faceVertexUvs.size(); ++layer ) {
+
+    const auto& uvs = source.faceVertexUvs[ layer ];
+    auto& batchUvs  = batch.faceVertexUvs[ layer ];
+
+    if ( uvs.empty() )
+      continue;
+
+    batchUvs.resize( faceOffset );
+    batchUvs.insert( batchUvs.end(), uvs.begin(), uvs.begin() + std::min( uvs.size(), faceCount ) );
+
+  }
+
+}
+
+} // namespace detail
+
+/////////////////////////////////////////////////////////////////////////
+
+StaticBatcher::StaticBatcher( float cellSize )
+  : batches( Object3D::create() ),
+    mCellSize( cellSize ),
+    mStamp( 0 ) { }
+
+StaticBatcher::~StaticBatcher() {
+
+  clear();
+
+}
+
+void StaticBatcher::update( Object3D& root ) {
+
+  ++mStamp;
+  mStats.rebuilt = 0;
+
+  collect( root );
+
+  // drop the meshes that were not found again
+
+  for ( auto it = mSources.begin(); it != mSources.end(); ) {
+    if ( it->second.stamp != mStamp ) {
+      erase( it->second );
+      it = mSources.erase( it );
+    } else {
+      ++it;
+    }
+  }
+
+  for ( const auto& key : mDirty ) {
+    rebuild( key );
+  }
+
+  mDirty.clear();
+
+  mStats.sources = ( int )mSources.size();
+  mStats.batches = ( int )mCells.size();
+
+}
+
+void StaticBatcher::invalidate( Object3D& object ) {
+
+  auto source = mSources.find( &object );
+
+  if ( source != mSources.end() ) {
+    source->second.invalid = true;
+  }
+
+}
+
+void StaticBatcher::clear() {
+
+  for ( auto& source : mSources ) {
+    source.second.object->batched = false;
+  }
+
+  for ( auto& cell : mCells ) {
+    release( cell.second.batch );
+  }
+
+  mSources.clear();
+  mCells.clear();
+  mDirty.clear();
+
+  mStats = Stats();
+
+}
+
+/////////////////////////////////////////////////////////////////////////
+
+bool StaticBatcher::batchable( const Object3D& object ) const {
+
+  if ( object.type() != THREE::Mesh || object.matrixAutoUpdate || !object.visible || object.staticBatch )
+    return false;
+
+  if ( const_cast<Mesh&>( static_cast<const Mesh&>( object ) ).instanced() ||
+       static_cast<const Mesh&>( object ).skinned() )
+    return false;
+
+  if ( !object.geometry || !object.material )
+    return false;
+
+  const auto& geometry = *object.geometry;
+  const auto& material = *object.material;
+
+  return geometry.type() == THREE::Geometry &&
+         geometry.morphTargets.empty() &&
+         material.type() != THREE::MeshFaceMaterial &&
+         material.type() != THREE::ShaderMaterial &&
+         !material.transparent &&
+         !material.skinning &&
+         !material.morphTargets;
+
+}
+
+// The cell holding the center of the object's world bounds
+
+StaticBatcher::CellKey StaticBatcher::cellOf( const Object3D& object ) const {
+
+  const auto box = Frustum::worldBox( object );
+  const auto center = Vector3().add( box.min, box.max ).multiplyScalar( 0.5f / mCellSize );
+
+  CellKey key = { object.material.get(),
+                  ( int )std::floor( center.x ),
+                  ( int )std::floor( center.y ),
+                  ( int )std::floor( center.z ),
+                  object.castShadow,
+                  object.receiveShadow };
+  return key;
+
+}
+
+void StaticBatcher::collect( Object3D& root ) {
+
+  for ( const auto& child : root.children ) {
+
+    if ( child == batches )
+      continue;
+
+    visit( child );
+    collect( *child );
+
+  }
+
+}
+
+void StaticBatcher::visit( const Object3D::Ptr& ptr ) {
+
+  auto& object = *ptr;
+
+  if ( !batchable( object ) )
+    return;
+
+  auto found = mSources.find( &object );
+
+  if ( found == mSources.end() ) {
+
+    auto& source = mSources[ &object ];
+    source.object = ptr;
+    source.stamp = mStamp;
+    insert( source );
+    return;
+
+  }
+
+  auto& source = found->second;
+  source.stamp = mStamp;
+
+  // A new matrixWorldVersion need not mean a new matrix: parents with
+  // matrixAutoUpdate recompute their children's every frame
+
+  const auto moved = source.version != object.matrixWorldVersion &&
+                     std::memcmp( source.matrix.elements, object.matrixWorld.elements, sizeof( source.matrix.elements ) ) != 0;
+
+  source.version = object.matrixWorldVersion;
+
+  if ( moved || source.invalid ||
+       source.geometry != object.geometry ||
+       source.material != object.material ||
+       source.cell.castShadow != object.castShadow ||
+       source.cell.receiveShadow != object.receiveShadow ) {
+    erase( source );
+    insert( source );
+  }
+
+}
+
+void StaticBatcher::insert( Source& source ) {
+
+  auto& object = *source.object;
+
+  source.geometry = object.geometry;
+  source.material = object.material;
+  source.matrix   = object.matrixWorld;
+  source.version  = object.matrixWorldVersion;
+  source.invalid  = false;
+  source.cell     = cellOf( object );
+
+  auto& cell = mCells[ source.cell ];
+  cell.sources.push_back( &object );
+  markDirty( source.cell, cell );
+
+  object.batched = true;
+
+}
+
+void StaticBatcher::erase( Source& source ) {
+
+  auto& cell = mCells[ source.cell ];
+  auto& sources = cell.sources;
+
+  auto it = std::find( sources.begin(), sources.end(), source.object.get() );
+
+  if ( it != sources.end() ) {
+    *it = sources.back();
+    sources.pop_back();
+  }
+
+  markDirty( source.cell, cell );
+
+  source.object->batched = false;
+
+}
+
+void StaticBatcher::markDirty( const CellKey& key, Cell& cell ) {
+
+  if ( !cell.dirty ) {
+    cell.dirty = true;
+    mDirty.push_back( key );
+  }
+
+}
+
+void StaticBatcher::rebuild( const CellKey& key ) {
+
+  auto found = mCells.find( key );
+
+  if ( found == mCells.end() )
+    return;
+
+  auto& cell = found->second;
+
+  release( cell.batch );
+
+  if ( cell.sources.empty() ) {
+    mCells.erase( found );
+    return;
+  }
+
+  cell.dirty = false;
+
+  // Bake relative to the cell's center, which keeps coordinates small and
+  // gives the batch a position to be depth sorted by
+
+  const Vector3 center( ( key.x + .5f ) * mCellSize,
+                        ( key.y + .5f ) * mCellSize,
+                        ( key.z + .5f ) * mCellSize );
+
+  size_t vertices = 0, faces = 0;
+
+  for ( auto object : cell.sources ) {
+    vertices += object->geometry->vertices.size();
+    faces    += object->geometry->faces.size();
+  }
+
+  auto geometry = Geometry::create();
+  geometry->dynamic = false;
+  geometry->vertices.reserve( vertices );
+  geometry->faces.reserve( faces );
+
+  for ( auto object : cell.sources ) {
+
+    Matrix4 matrix( object->matrixWorld );
+    matrix.elements[ 12 ] -= center.x;
+    matrix.elements[ 13 ] -= center.y;
+    matrix.elements[ 14 ] -= center.z;
+
+    detail::bakeGeometry( *geometry, *object->geometry, matrix );
+
+  }
+
+  for ( auto& uvs : geometry->faceVertexUvs ) {
+    if ( !uvs.empty() ) uvs.resize( geometry->faces.size() );
+  }
+
+  cell.batch = Mesh::create( geometry, cell.sources.front()->material );
+
+  auto& batch = *cell.batch;
+  batch.staticBatch = true;
+  batch.castShadow = key.castShadow;
+  batch.receiveShadow = key.receiveShadow;
+  batch.matrixAutoUpdate = false;
+  batch.position.copy( center );
+  batch.matrix.setPosition( center );
+
+  batches->add( cell.batch );
+
+  ++mStats.rebuilt;
+
+}
+
+void StaticBatcher::release( Mesh::Ptr& batch ) {
+
+  if ( !batch )
+    return;
+
+  batches->remove( batch );
+
+  if ( onRelease ) {
+    onRelease( *batch );
+  }
+
+  batch.reset();
+
+}
+
+} // namespace three
+
+#endif // THREE_STATIC_BATCHER_IPP
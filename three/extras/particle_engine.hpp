@@ -0,0 +1,156 @@
+#ifndef THREE_PARTICLE_ENGINE_HPP
+#define THREE_PARTICLE_ENGINE_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/buffer_geometry.hpp>
+#include <three/core/color.hpp>
+#include <three/core/vector3.hpp>
+#include <three/objects/particle_system.hpp>
+
+#include <three/utils/memory.hpp>
+#include <three/utils/noncopyable.hpp>
+#include <three/utils/thread_pool.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace three {
+
+// Simulates particles on the CPU and draws them as one ParticleSystem.
+// Positions, velocities, ages, sizes and colors are kept as separate arrays
+// and integrated a SIMD register at a time, split across threads if asked.
+// update() writes positions, colors and sizes straight into the arrays of
+// the system's BufferGeometry, which the renderer uploads as they are.
+//
+// Emitters spawn particles, forces move them, and particles whose life has
+// run out are replaced by the last live ones so the arrays stay packed; the
+// system draws as many points as there are particles. Emitters and forces
+// work in the system's local space.
+//
+// Sizes go to a "size" attribute if the material declares one (see
+// ShaderMaterial); ParticleBasicMaterial shows the colors with vertexColors.
+
+class ParticleEngine : NonCopyable {
+public:
+
+  typedef std::shared_ptr<ParticleEngine> Ptr;
+
+  static Ptr create( const Material::Ptr& material, size_t capacity ) {
+    return three::make_shared<ParticleEngine>( material, capacity );
+  }
+
+  /////////////////////////////////////////////////////////////////////////
+
+  struct Emitter {
+    Emitter()
+      : rate( 100 ), life( 1 ), lifeSpread( 0 ), size( 1 ), sizeEnd( 1 ),
+        color( 0xffffff ), colorEnd( 0xffffff ), enabled( true ) { }
+
+    // Particles start uniformly within position +- positionSpread, and
+    // likewise for velocity
+    Vector3 position, positionSpread;
+    Vector3 velocity, velocitySpread;
+
+    float rate;             // particles per second
+    float life, lifeSpread; // seconds
+    float size, sizeEnd;    // at birth and at death, linear in between
+    Color color, colorEnd;
+
+    bool enabled;
+  };
+
+  struct Force {
+    enum Type { Acceleration, Drag, Attractor };
+
+    // A constant acceleration, e.g. gravity
+    static Force acceleration( const Vector3& acceleration ) {
+      return Force( Acceleration, acceleration, 0, 0 );
+    }
+
+    // Velocity lost per second, as a fraction
+    static Force drag( float coefficient ) {
+      return Force( Drag, Vector3(), coefficient, 0 );
+    }
+
+    // Pulls toward position with strength / distance^2, or pushes away for
+    // a negative strength; the pull stops growing inside radius
+    static Force attractor( const Vector3& position, float strength, float radius = 1 ) {
+      return Force( Attractor, position, strength, radius );
+    }
+
+    Type type;
+    Vector3 vector;
+    float strength;
+    float radius;
+
+  private:
+    Force( Type type, const Vector3& vector, float strength, float radius )
+      : type( type ), vector( vector ), strength( strength ), radius( radius ) { }
+  };
+
+  // Add to the scene to draw the particles
+  ParticleSystem::Ptr system;
+
+  std::vector<Emitter> emitters;
+  std::vector<Force> forces;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  // Spawns, moves and retires particles for dt seconds, and writes them to
+  // the system's geometry
+  THREE_DECL void update( float dt );
+
+  // Spawns count particles from emitter now, as many as there is room for;
+  // they are drawn from the next update()
+  THREE_DECL size_t emit( const Emitter& emitter, size_t count );
+
+  THREE_DECL void clear();
+
+  size_t count() const { return mCount; }
+  size_t capacity() const { return mCapacity; }
+
+  // Worker threads for update(); 1 (the default) runs on the calling
+  // thread, 0 uses every hardware thread
+  THREE_DECL void setThreads( size_t threads );
+  size_t threads() const { return mPool.size(); }
+
+protected:
+
+  THREE_DECL ParticleEngine( const Material::Ptr& material, size_t capacity );
+
+private:
+
+  THREE_DECL void spawn( const Emitter& emitter, size_t count );
+  THREE_DECL void integrate( float dt );
+  THREE_DECL void compact();
+  THREE_DECL void move( size_t from, size_t to );
+  THREE_DECL void resizeArrays();
+
+  THREE_DECL float random();
+  THREE_DECL float random( float center, float spread );
+
+  BufferGeometry::Ptr mGeometry;
+
+  // One entry per particle in each
+  enum Field { PX, PY, PZ, VX, VY, VZ, Age, Life, Size, SizeRate, R, G, B, RRate, GRate, BRate, Fields };
+  std::vector<float> mFields[ Fields ];
+
+  size_t mCount;
+  size_t mCapacity;
+
+  std::vector<float> mOwed; // per emitter, fractions of a particle
+  std::vector<std::vector<std::uint32_t>> mDead; // per chunk, by update()
+
+  ThreadPool mPool;
+  std::uint32_t mSeed;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/extras/impl/particle_engine.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_PARTICLE_ENGINE_HPP
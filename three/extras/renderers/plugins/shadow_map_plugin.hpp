@@ -217,7 +217,9 @@ class ShadowMapPlugin : public IPlugin {
 
         glObject.render = false;
 
-        if ( object.visible && object.castShadow ) {
+        // sources in a static batch are drawn by it
+
+        if ( object.visible && object.castShadow && !object.batched ) {
 
           if ( !( object instanceof THREE.Mesh ) || !( object.frustumCulled ) || _frustum.contains( object ) ) {
             object._modelViewMatrix.multiply( shadowCamera.matrixWorldInverse, object.matrixWorld );
@@ -0,0 +1,158 @@
+#ifndef THREE_STATIC_BATCHER_HPP
+#define THREE_STATIC_BATCHER_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/object3d.hpp>
+#include <three/objects/mesh.hpp>
+
+#include <three/utils/memory.hpp>
+#include <three/utils/noncopyable.hpp>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace three {
+
+// Draws static meshes that share a material and shadow flags as one merged
+// mesh per cell of a uniform grid. Meshes with matrixAutoUpdate == false are baked with their
+// world transforms into the geometry of a batch mesh under 'batches', which
+// is placed at the center of its cell. The sources stay in the scene,
+// flagged Object3D::batched: renderers skip them, while picking still
+// reports them (and skips the batches).
+//
+// update() finds what changed since the last call - meshes added, removed,
+// hidden, moved or given another geometry, material or shadow flags - and
+// rebuilds only the cells involved. Edits to the contents of a source's
+// geometry are not seen; call invalidate() for the mesh.
+//
+// Meshes with transparent, skinned, morphed or per-face materials, buffer
+// geometries and instanced meshes are left to be drawn on their own.
+
+class StaticBatcher : NonCopyable {
+public:
+
+  typedef std::shared_ptr<StaticBatcher> Ptr;
+
+  typedef std::function<void( Object3D& )> Callback;
+
+  static Ptr create( float cellSize = 100.f ) {
+    return three::make_shared<StaticBatcher>( cellSize );
+  }
+
+  THREE_DECL ~StaticBatcher();
+
+  /////////////////////////////////////////////////////////////////////////
+
+  struct Stats {
+    Stats() : sources( 0 ), batches( 0 ), rebuilt( 0 ) { }
+
+    int sources; // meshes drawn through batches
+    int batches;
+    int rebuilt; // batches rebuilt by the last update()
+  };
+
+  // Parent of the batch meshes. Add it to an untransformed node (usually
+  // the scene) that update() is given or that contains it.
+  Object3D::Ptr batches;
+
+  // Called with each batch mesh that is dropped, e.g. to free its buffers
+  // with GLRenderer::deallocateObject
+  Callback onRelease;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  // Batches the static meshes under root; world matrices must be current
+  THREE_DECL void update( Object3D& root );
+
+  // Bakes object again on the next update(), e.g. after its geometry changed
+  THREE_DECL void invalidate( Object3D& object );
+
+  // Drops all batches; their sources are drawn on their own again
+  THREE_DECL void clear();
+
+  float cellSize() const { return mCellSize; }
+
+  const Stats& stats() const { return mStats; }
+
+protected:
+
+  THREE_DECL explicit StaticBatcher( float cellSize );
+
+private:
+
+  struct CellKey {
+    const Material* material;
+    int x, y, z;
+    bool castShadow, receiveShadow;
+
+    bool operator==( const CellKey& other ) const {
+      return material == other.material && x == other.x && y == other.y && z == other.z &&
+             castShadow == other.castShadow && receiveShadow == other.receiveShadow;
+    }
+  };
+
+  struct CellKeyHash {
+    size_t operator()( const CellKey& key ) const {
+      size_t seed = std::hash<const Material*>()( key.material );
+      seed ^= ( size_t )key.x * 73856093u;
+      seed ^= ( size_t )key.y * 19349663u;
+      seed ^= ( size_t )key.z * 83492791u;
+      seed ^= ( size_t )( key.castShadow + 2 * key.receiveShadow ) * 2654435761u;
+      return seed;
+    }
+  };
+
+  struct Source {
+    Source() : version( 0 ), stamp( 0 ), invalid( false ) { }
+
+    Object3D::Ptr object;
+    Geometry::Ptr geometry;
+    Material::Ptr material;
+    Matrix4 matrix;     // matrixWorld as baked
+    unsigned version;   // matrixWorldVersion as baked
+    unsigned stamp;     // last update() that found the object
+    bool invalid;
+    CellKey cell;
+  };
+
+  struct Cell {
+    Cell() : dirty( false ) { }
+
+    std::vector<Object3D*> sources;
+    Mesh::Ptr batch;
+    bool dirty;
+  };
+
+  typedef std::unordered_map<CellKey, Cell, CellKeyHash> Cells;
+
+  THREE_DECL bool batchable( const Object3D& object ) const;
+  THREE_DECL CellKey cellOf( const Object3D& object ) const;
+
+  THREE_DECL void collect( Object3D& root );
+  THREE_DECL void visit( const Object3D::Ptr& object );
+  THREE_DECL void insert( Source& source );
+  THREE_DECL void erase( Source& source );
+  THREE_DECL void markDirty( const CellKey& key, Cell& cell );
+  THREE_DECL void rebuild( const CellKey& key );
+  THREE_DECL void release( Mesh::Ptr& batch );
+
+  float mCellSize;
+  unsigned mStamp;
+
+  std::unordered_map<Object3D*, Source> mSources;
+  Cells mCells;
+  std::vector<CellKey> mDirty;
+
+  Stats mStats;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/extras/impl/static_batcher.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_STATIC_BATCHER_HPP
@@ -11,6 +11,8 @@ class Scene;
 class Particle;
 class Sprite;
 class Mesh;
+class InstancedMesh;
+class SkinnedMesh;
 class Face;
 class Line;
 class Rectangle;
@@ -21,7 +23,12 @@ class Vector4;
 class Matrix4;
 class Quaternion;
 class Ray;
+class RayBatch;
 class Frustum;
+class TransformStore;
+class GeometryBVH;
+class SceneBVH;
+class SceneBVHMoves;
 
 class Visitor;
 class ConstVisitor;
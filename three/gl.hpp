@@ -32,6 +32,8 @@
 #  include <GL/gl.h>
 #endif
 
+#include <three/gl_dispatch.hpp>
+
 #include <three/console.hpp>
 
 namespace three {
@@ -0,0 +1,315 @@
+#ifndef THREE_GL_DISPATCH_HPP
+#define THREE_GL_DISPATCH_HPP
+
+// Included from <three/gl.hpp>, after the GL headers.
+//
+// Every GL entry point the library uses, as a table of function pointers.
+// The default table calls the real functions. Building with
+// THREE_GL_DISPATCH redirects the gl* names below through the current
+// table, so the whole renderer can be pointed at another backend (e.g.
+// GLRecorder) at runtime; without it, calls go straight to GL.
+
+#define THREE_GL_FUNCTIONS( X ) \
+  X( void,   ActiveTexture,            ( GLenum texture ), ( texture ) ) \
+  X( void,   AttachShader,             ( GLuint program, GLuint shader ), ( program, shader ) ) \
+  X( void,   BindBuffer,               ( GLenum target, GLuint buffer ), ( target, buffer ) ) \
+  X( void,   BindFramebuffer,          ( GLenum target, GLuint framebuffer ), ( target, framebuffer ) ) \
+  X( void,   BindRenderbuffer,         ( GLenum target, GLuint renderbuffer ), ( target, renderbuffer ) ) \
+  X( void,   BindTexture,              ( GLenum target, GLuint texture ), ( target, texture ) ) \
+  X( void,   BlendEquation,            ( GLenum mode ), ( mode ) ) \
+  X( void,   BlendEquationSeparate,    ( GLenum modeRGB, GLenum modeAlpha ), ( modeRGB, modeAlpha ) ) \
+  X( void,   BlendFunc,                ( GLenum sfactor, GLenum dfactor ), ( sfactor, dfactor ) ) \
+  X( void,   BlendFuncSeparate,        ( GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha ), ( srcRGB, dstRGB, srcAlpha, dstAlpha ) ) \
+  X( void,   BufferData,               ( GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage ), ( target, size, data, usage ) ) \
+  X( void,   BufferSubData,            ( GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data ), ( target, offset, size, data ) ) \
+  X( void,   Clear,                    ( GLbitfield mask ), ( mask ) ) \
+  X( void,   ClearColor,               ( GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha ), ( red, green, blue, alpha ) ) \
+  X( void,   ClearDepth,               ( GLclampd depth ), ( depth ) ) \
+  X( void,   ClearStencil,             ( GLint s ), ( s ) ) \
+  X( void,   CompileShader,            ( GLuint shader ), ( shader ) ) \
+  X( GLuint, CreateProgram,            ( ), ( ) ) \
+  X( GLuint, CreateShader,             ( GLenum type ), ( type ) ) \
+  X( void,   CullFace,                 ( GLenum mode ), ( mode ) ) \
+  X( void,   DeleteBuffers,            ( GLsizei n, const GLuint* buffers ), ( n, buffers ) ) \
+  X( void,   DeleteFramebuffers,       ( GLsizei n, const GLuint* framebuffers ), ( n, framebuffers ) ) \
+  X( void,   DeleteProgram,            ( GLuint program ), ( program ) ) \
+  X( void,   DeleteRenderbuffers,      ( GLsizei n, const GLuint* renderbuffers ), ( n, renderbuffers ) ) \
+  X( void,   DeleteShader,             ( GLuint shader ), ( shader ) ) \
+  X( void,   DeleteTextures,           ( GLsizei n, const GLuint* textures ), ( n, textures ) ) \
+  X( void,   DepthFunc,                ( GLenum func ), ( func ) ) \
+  X( void,   DepthMask,                ( GLboolean flag ), ( flag ) ) \
+  X( void,   Disable,                  ( GLenum cap ), ( cap ) ) \
+  X( void,   DisableVertexAttribArray, ( GLuint index ), ( index ) ) \
+  X( void,   DrawArrays,               ( GLenum mode, GLint first, GLsizei count ), ( mode, first, count ) ) \
+  X( void,   DrawElements,             ( GLenum mode, GLsizei count, GLenum type, const GLvoid* indices ), ( mode, count, type, indices ) ) \
+  X( void,   DrawElementsInstanced,    ( GLenum mode, GLsizei count, GLenum type, const GLvoid* indices, GLsizei primcount ), ( mode, count, type, indices, primcount ) ) \
+  X( void,   Enable,                   ( GLenum cap ), ( cap ) ) \
+  X( void,   EnableVertexAttribArray,  ( GLuint index ), ( index ) ) \
+  X( void,   Finish,                   ( ), ( ) ) \
+  X( void,   FramebufferRenderbuffer,  ( GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer ), ( target, attachment, renderbuffertarget, renderbuffer ) ) \
+  X( void,   FramebufferTexture2D,     ( GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level ), ( target, attachment, textarget, texture, level ) ) \
+  X( void,   FrontFace,                ( GLenum mode ), ( mode ) ) \
+  X( void,   GenBuffers,               ( GLsizei n, GLuint* buffers ), ( n, buffers ) ) \
+  X( void,   GenFramebuffers,          ( GLsizei n, GLuint* framebuffers ), ( n, framebuffers ) ) \
+  X( void,   GenRenderbuffers,         ( GLsizei n, GLuint* renderbuffers ), ( n, renderbuffers ) ) \
+  X( void,   GenTextures,              ( GLsizei n, GLuint* textures ), ( n, textures ) ) \
+  X( void,   GenerateMipmap,           ( GLenum target ), ( target ) ) \
+  X( GLint,  GetAttribLocation,        ( GLuint program, const GLchar* name ), ( program, name ) ) \
+  X( GLenum, GetError,                 ( ), ( ) ) \
+  X( void,   GetFloatv,                ( GLenum pname, GLfloat* params ), ( pname, params ) ) \
+  X( void,   GetIntegerv,              ( GLenum pname, GLint* params ), ( pname, params ) ) \
+  X( void,   GetProgramInfoLog,        ( GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog ), ( program, bufSize, length, infoLog ) ) \
+  X( void,   GetProgramiv,             ( GLuint program, GLenum pname, GLint* param ), ( program, pname, param ) ) \
+  X( void,   GetShaderInfoLog,         ( GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog ), ( shader, bufSize, length, infoLog ) ) \
+  X( void,   GetShaderiv,              ( GLuint shader, GLenum pname, GLint* param ), ( shader, pname, param ) ) \
+  X( void,   GetTexParameterfv,        ( GLenum target, GLenum pname, GLfloat* params ), ( target, pname, params ) ) \
+  X( void,   GetTexParameteriv,        ( GLenum target, GLenum pname, GLint* params ), ( target, pname, params ) ) \
+  X( GLint,  GetUniformLocation,       ( GLuint program, const GLchar* name ), ( program, name ) ) \
+  X( void,   LineWidth,                ( GLfloat width ), ( width ) ) \
+  X( void,   LinkProgram,              ( GLuint program ), ( program ) ) \
+  X( void,   PixelStorei,              ( GLenum pname, GLint param ), ( pname, param ) ) \
+  X( void,   PolygonOffset,            ( GLfloat factor, GLfloat units ), ( factor, units ) ) \
+  X( void,   RenderbufferStorage,      ( GLenum target, GLenum internalformat, GLsizei width, GLsizei height ), ( target, internalformat, width, height ) ) \
+  X( void,   Scissor,                  ( GLint x, GLint y, GLsizei width, GLsizei height ), ( x, y, width, height ) ) \
+  X( void,   ShaderSource,             ( GLuint shader, GLsizei count, const GLchar** strings, const GLint* lengths ), ( shader, count, strings, lengths ) ) \
+  X( void,   TexEnvi,                  ( GLenum target, GLenum pname, GLint param ), ( target, pname, param ) ) \
+  X( void,   TexImage2D,               ( GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid* pixels ), ( target, level, internalformat, width, height, border, format, type, pixels ) ) \
+  X( void,   TexParameterf,            ( GLenum target, GLenum pname, GLfloat param ), ( target, pname, param ) ) \
+  X( void,   TexParameteri,            ( GLenum target, GLenum pname, GLint param ), ( target, pname, param ) ) \
+  X( void,   Uniform1f,                ( GLint location, GLfloat v0 ), ( location, v0 ) ) \
+  X( void,   Uniform1fv,               ( GLint location, GLsizei count, const GLfloat* value ), ( location, count, value ) ) \
+  X( void,   Uniform1i,                ( GLint location, GLint v0 ), ( location, v0 ) ) \
+  X( void,   Uniform1iv,               ( GLint location, GLsizei count, const GLint* value ), ( location, count, value ) ) \
+  X( void,   Uniform2f,                ( GLint location, GLfloat v0, GLfloat v1 ), ( location, v0, v1 ) ) \
+  X( void,   Uniform2fv,               ( GLint location, GLsizei count, const GLfloat* value ), ( location, count, value ) ) \
+  X( void,   Uniform3f,                ( GLint location, GLfloat v0, GLfloat v1, GLfloat v2 ), ( location, v0, v1, v2 ) ) \
+  X( void,   Uniform3fv,               ( GLint location, GLsizei count, const GLfloat* value ), ( location, count, value ) ) \
+  X( void,   Uniform3iv,               ( GLint location, GLsizei count, const GLint* value ), ( location, count, value ) ) \
+  X( void,   Uniform4f,                ( GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3 ), ( location, v0, v1, v2, v3 ) ) \
+  X( void,   Uniform4fv,               ( GLint location, GLsizei count, const GLfloat* value ), ( location, count, value ) ) \
+  X( void,   UniformMatrix3fv,         ( GLint location, GLsizei count, GLboolean transpose, const GLfloat* value ), ( location, count, transpose, value ) ) \
+  X( void,   UniformMatrix4fv,         ( GLint location, GLsizei count, GLboolean transpose, const GLfloat* value ), ( location, count, transpose, value ) ) \
+  X( void,   UseProgram,               ( GLuint program ), ( program ) ) \
+  X( void,   VertexAttribDivisor,      ( GLuint index, GLuint divisor ), ( index, divisor ) ) \
+  X( void,   VertexAttribPointer,      ( GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer ), ( index, size, type, normalized, stride, pointer ) ) \
+  X( void,   Viewport,                 ( GLint x, GLint y, GLsizei width, GLsizei height ), ( x, y, width, height ) )
+
+namespace three {
+
+struct GLDispatch {
+#define THREE_GL_POINTER( ret, name, params, args ) ret ( *name ) params;
+  THREE_GL_FUNCTIONS( THREE_GL_POINTER )
+#undef THREE_GL_POINTER
+};
+
+namespace detail {
+namespace native_gl {
+
+// Looked up at call time, so GLEW may be initialized after the table
+#define THREE_GL_THUNK( ret, name, params, args ) inline ret name params { return gl##name args; }
+THREE_GL_FUNCTIONS( THREE_GL_THUNK )
+#undef THREE_GL_THUNK
+
+} // namespace native_gl
+
+inline const GLDispatch& nativeGLDispatch() {
+#define THREE_GL_ENTRY( ret, name, params, args ) &native_gl::name,
+  static const GLDispatch dispatch = { THREE_GL_FUNCTIONS( THREE_GL_ENTRY ) };
+#undef THREE_GL_ENTRY
+  return dispatch;
+}
+
+inline const GLDispatch*& currentGLDispatch() {
+  static const GLDispatch* dispatch = &nativeGLDispatch();
+  return dispatch;
+}
+
+} // namespace detail
+
+inline const GLDispatch& glDispatch() {
+  return *detail::currentGLDispatch();
+}
+
+// nullptr restores the native table. Only affects calls made through the
+// gl* names in builds with THREE_GL_DISPATCH.
+inline void setGLDispatch( const GLDispatch* dispatch ) {
+  detail::currentGLDispatch() = dispatch ? dispatch : &detail::nativeGLDispatch();
+}
+
+} // namespace three
+
+#if defined(THREE_GL_DISPATCH)
+
+#define THREE_GL_DISPATCHED( name ) ( ::three::glDispatch().name )
+
+#undef glActiveTexture
+#undef glAttachShader
+#undef glBindBuffer
+#undef glBindFramebuffer
+#undef glBindRenderbuffer
+#undef glBindTexture
+#undef glBlendEquation
+#undef glBlendEquationSeparate
+#undef glBlendFunc
+#undef glBlendFuncSeparate
+#undef glBufferData
+#undef glBufferSubData
+#undef glClear
+#undef glClearColor
+#undef glClearDepth
+#undef glClearStencil
+#undef glCompileShader
+#undef glCreateProgram
+#undef glCreateShader
+#undef glCullFace
+#undef glDeleteBuffers
+#undef glDeleteFramebuffers
+#undef glDeleteProgram
+#undef glDeleteRenderbuffers
+#undef glDeleteShader
+#undef glDeleteTextures
+#undef glDepthFunc
+#undef glDepthMask
+#undef glDisable
+#undef glDisableVertexAttribArray
+#undef glDrawArrays
+#undef glDrawElements
+#undef glDrawElementsInstanced
+#undef glEnable
+#undef glEnableVertexAttribArray
+#undef glFinish
+#undef glFramebufferRenderbuffer
+#undef glFramebufferTexture2D
+#undef glFrontFace
+#undef glGenBuffers
+#undef glGenFramebuffers
+#undef glGenRenderbuffers
+#undef glGenTextures
+#undef glGenerateMipmap
+#undef glGetAttribLocation
+#undef glGetError
+#undef glGetFloatv
+#undef glGetIntegerv
+#undef glGetProgramInfoLog
+#undef glGetProgramiv
+#undef glGetShaderInfoLog
+#undef glGetShaderiv
+#undef glGetTexParameterfv
+#undef glGetTexParameteriv
+#undef glGetUniformLocation
+#undef glLineWidth
+#undef glLinkProgram
+#undef glPixelStorei
+#undef glPolygonOffset
+#undef glRenderbufferStorage
+#undef glScissor
+#undef glShaderSource
+#undef glTexEnvi
+#undef glTexImage2D
+#undef glTexParameterf
+#undef glTexParameteri
+#undef glUniform1f
+#undef glUniform1fv
+#undef glUniform1i
+#undef glUniform1iv
+#undef glUniform2f
+#undef glUniform2fv
+#undef glUniform3f
+#undef glUniform3fv
+#undef glUniform3iv
+#undef glUniform4f
+#undef glUniform4fv
+#undef glUniformMatrix3fv
+#undef glUniformMatrix4fv
+#undef glUseProgram
+#undef glVertexAttribDivisor
+#undef glVertexAttribPointer
+#undef glViewport
+
+#define glActiveTexture            THREE_GL_DISPATCHED( ActiveTexture )
+#define glAttachShader             THREE_GL_DISPATCHED( AttachShader )
+#define glBindBuffer               THREE_GL_DISPATCHED( BindBuffer )
+#define glBindFramebuffer          THREE_GL_DISPATCHED( BindFramebuffer )
+#define glBindRenderbuffer         THREE_GL_DISPATCHED( BindRenderbuffer )
+#define glBindTexture              THREE_GL_DISPATCHED( BindTexture )
+#define glBlendEquation            THREE_GL_DISPATCHED( BlendEquation )
+#define glBlendEquationSeparate    THREE_GL_DISPATCHED( BlendEquationSeparate )
+#define glBlendFunc                THREE_GL_DISPATCHED( BlendFunc )
+#define glBlendFuncSeparate        THREE_GL_DISPATCHED( BlendFuncSeparate )
+#define glBufferData               THREE_GL_DISPATCHED( BufferData )
+#define glBufferSubData            THREE_GL_DISPATCHED( BufferSubData )
+#define glClear                    THREE_GL_DISPATCHED( Clear )
+#define glClearColor               THREE_GL_DISPATCHED( ClearColor )
+#define glClearDepth               THREE_GL_DISPATCHED( ClearDepth )
+#define glClearStencil             THREE_GL_DISPATCHED( ClearStencil )
+#define glCompileShader            THREE_GL_DISPATCHED( CompileShader )
+#define glCreateProgram            THREE_GL_DISPATCHED( CreateProgram )
+#define glCreateShader             THREE_GL_DISPATCHED( CreateShader )
+#define glCullFace                 THREE_GL_DISPATCHED( CullFace )
+#define glDeleteBuffers            THREE_GL_DISPATCHED( DeleteBuffers )
+#define glDeleteFramebuffers       THREE_GL_DISPATCHED( DeleteFramebuffers )
+#define glDeleteProgram            THREE_GL_DISPATCHED( DeleteProgram )
+#define glDeleteRenderbuffers      THREE_GL_DISPATCHED( DeleteRenderbuffers )
+#define glDeleteShader             THREE_GL_DISPATCHED( DeleteShader )
+#define glDeleteTextures           THREE_GL_DISPATCHED( DeleteTextures )
+#define glDepthFunc                THREE_GL_DISPATCHED( DepthFunc )
+#define glDepthMask                THREE_GL_DISPATCHED( DepthMask )
+#define glDisable                  THREE_GL_DISPATCHED( Disable )
+#define glDisableVertexAttribArray THREE_GL_DISPATCHED( DisableVertexAttribArray )
+#define glDrawArrays               THREE_GL_DISPATCHED( DrawArrays )
+#define glDrawElements             THREE_GL_DISPATCHED( DrawElements )
+#define glDrawElementsInstanced    THREE_GL_DISPATCHED( DrawElementsInstanced )
+#define glEnable                   THREE_GL_DISPATCHED( Enable )
+#define glEnableVertexAttribArray  THREE_GL_DISPATCHED( EnableVertexAttribArray )
+#define glFinish                   THREE_GL_DISPATCHED( Finish )
+#define glFramebufferRenderbuffer  THREE_GL_DISPATCHED( FramebufferRenderbuffer )
+#define glFramebufferTexture2D     THREE_GL_DISPATCHED( FramebufferTexture2D )
+#define glFrontFace                THREE_GL_DISPATCHED( FrontFace )
+#define glGenBuffers               THREE_GL_DISPATCHED( GenBuffers )
+#define glGenFramebuffers          THREE_GL_DISPATCHED( GenFramebuffers )
+#define glGenRenderbuffers         THREE_GL_DISPATCHED( GenRenderbuffers )
+#define glGenTextures              THREE_GL_DISPATCHED( GenTextures )
+#define glGenerateMipmap           THREE_GL_DISPATCHED( GenerateMipmap )
+#define glGetAttribLocation        THREE_GL_DISPATCHED( GetAttribLocation )
+#define glGetError                 THREE_GL_DISPATCHED( GetError )
+#define glGetFloatv                THREE_GL_DISPATCHED( GetFloatv )
+#define glGetIntegerv              THREE_GL_DISPATCHED( GetIntegerv )
+#define glGetProgramInfoLog        THREE_GL_DISPATCHED( GetProgramInfoLog )
+#define glGetProgramiv             THREE_GL_DISPATCHED( GetProgramiv )
+#define glGetShaderInfoLog         THREE_GL_DISPATCHED( GetShaderInfoLog )
+#define glGetShaderiv              THREE_GL_DISPATCHED( GetShaderiv )
+#define glGetTexParameterfv        THREE_GL_DISPATCHED( GetTexParameterfv )
+#define glGetTexParameteriv        THREE_GL_DISPATCHED( GetTexParameteriv )
+#define glGetUniformLocation       THREE_GL_DISPATCHED( GetUniformLocation )
+#define glLineWidth                THREE_GL_DISPATCHED( LineWidth )
+#define glLinkProgram              THREE_GL_DISPATCHED( LinkProgram )
+#define glPixelStorei              THREE_GL_DISPATCHED( PixelStorei )
+#define glPolygonOffset            THREE_GL_DISPATCHED( PolygonOffset )
+#define glRenderbufferStorage      THREE_GL_DISPATCHED( RenderbufferStorage )
+#define glScissor                  THREE_GL_DISPATCHED( Scissor )
+#define glShaderSource             THREE_GL_DISPATCHED( ShaderSource )
+#define glTexEnvi                  THREE_GL_DISPATCHED( TexEnvi )
+#define glTexImage2D               THREE_GL_DISPATCHED( TexImage2D )
+#define glTexParameterf            THREE_GL_DISPATCHED( TexParameterf )
+#define glTexParameteri            THREE_GL_DISPATCHED( TexParameteri )
+#define glUniform1f                THREE_GL_DISPATCHED( Uniform1f )
+#define glUniform1fv               THREE_GL_DISPATCHED( Uniform1fv )
+#define glUniform1i                THREE_GL_DISPATCHED( Uniform1i )
+#define glUniform1iv               THREE_GL_DISPATCHED( Uniform1iv )
+#define glUniform2f                THREE_GL_DISPATCHED( Uniform2f )
+#define glUniform2fv               THREE_GL_DISPATCHED( Uniform2fv )
+#define glUniform3f                THREE_GL_DISPATCHED( Uniform3f )
+#define glUniform3fv               THREE_GL_DISPATCHED( Uniform3fv )
+#define glUniform3iv               THREE_GL_DISPATCHED( Uniform3iv )
+#define glUniform4f                THREE_GL_DISPATCHED( Uniform4f )
+#define glUniform4fv               THREE_GL_DISPATCHED( Uniform4fv )
+#define glUniformMatrix3fv         THREE_GL_DISPATCHED( UniformMatrix3fv )
+#define glUniformMatrix4fv         THREE_GL_DISPATCHED( UniformMatrix4fv )
+#define glUseProgram               THREE_GL_DISPATCHED( UseProgram )
+#define glVertexAttribDivisor      THREE_GL_DISPATCHED( VertexAttribDivisor )
+#define glVertexAttribPointer      THREE_GL_DISPATCHED( VertexAttribPointer )
+#define glViewport                 THREE_GL_DISPATCHED( Viewport )
+
+#endif // defined(THREE_GL_DISPATCH)
+
+#endif // THREE_GL_DISPATCH_HPP
@@ -15,15 +15,24 @@
 #include <three/core/impl/object3d.ipp>
 #include <three/core/impl/projector.ipp>
 #include <three/core/impl/quaternion.ipp>
+#include <three/core/impl/transform_kernels.ipp>
+#include <three/core/impl/transform_store.ipp>
+#include <three/core/impl/bvh.ipp>
+#include <three/core/impl/ray_batch.ipp>
 
 #include <three/objects/impl/mesh.ipp>
+#include <three/objects/impl/skinned_mesh.ipp>
 
 #include <three/materials/impl/material.ipp>
 #include <three/materials/impl/text_2d_material.ipp>
 #include <three/materials/impl/uniform.ipp>
 
+#include <three/renderers/impl/gl_buffer_stream.ipp>
+#include <three/renderers/impl/gl_program_cache.ipp>
+#include <three/renderers/impl/gl_recorder.ipp>
 #include <three/renderers/impl/gl_shaders.ipp>
 #include <three/renderers/impl/gl_renderer.ipp>
+#include <three/renderers/impl/particle_sorter.ipp>
 
 #include <three/scenes/impl/scene.ipp>
 
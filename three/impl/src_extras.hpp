@@ -11,7 +11,10 @@
 
 #include <three/extras/utils/impl/font.ipp>
 
+#include <three/extras/impl/geometry_utils.ipp>
 #include <three/extras/impl/image_utils.ipp>
+#include <three/extras/impl/static_batcher.ipp>
+#include <three/extras/impl/particle_engine.ipp>
 #include <three/extras/impl/sdl.ipp>
 #include <three/extras/impl/anim.ipp>
 #include <three/extras/impl/stats.ipp>
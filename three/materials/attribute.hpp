@@ -84,7 +84,7 @@ struct FillerImpl {
   inline void fill( const std::vector<T>& src, const SortArray& sortArray, std::vector<float>& dst ) {
     const auto count = src.size();
     for ( size_t i = 0, offset = 0; i < count; ++i, offset += Stride ) {
-      const auto& index = sortArray[ i ].second;
+      const auto index = sortArray[ i ];
       for ( int j = 0; j < Stride; ++j ) {
         dst[ offset + j ] = src[ index ][ j ];
       }
@@ -104,7 +104,7 @@ struct FillerImpl<T, true> {
     static_assert( std::is_same<T,float>::value, "Only float targets are supported" );
     const auto count = src.size();
     for ( size_t i = 0; i < count; i++ ) {
-      const auto& index = sortArray[ i ].second;
+      const auto index = sortArray[ i ];
       dst[ i ] = src[ index ];
     }
   }
@@ -150,11 +150,11 @@ namespace AttributeKey {
   DECLARE_ATTRIBUTE_KEY(uv)
   DECLARE_ATTRIBUTE_KEY(uv2)
   DECLARE_ATTRIBUTE_KEY(tangent)
-  DECLARE_ATTRIBUTE_KEY(skinVertexA)
-  DECLARE_ATTRIBUTE_KEY(skinVertexB)
   DECLARE_ATTRIBUTE_KEY(skinWeight)
   DECLARE_ATTRIBUTE_KEY(skinIndex)
   DECLARE_ATTRIBUTE_KEY(morphTarget)
+  DECLARE_ATTRIBUTE_KEY(instanceMatrix)
+  DECLARE_ATTRIBUTE_KEY(instanceColor)
 
 #undef DECLARE_ATTRIBUTE_KEY
 
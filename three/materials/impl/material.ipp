@@ -139,6 +139,7 @@ Material::Material( )
     numSupportedMorphNormals( 0 ),
     fragmentShader( "void main() { }" ),
     vertexShader( "void main() { }" ),
+    refreshedUniforms(),
     bumpScale( 1 ),
     normalScale( 1, 1, 1 ),
     fog( false ),
@@ -39,43 +39,58 @@ Uniform& Uniform::swap( Uniform& other ) {
 
 /////////////////////////////////////////////////////////////////////////
 
+// Each load casts the value once; with a slot, values matching the slot's
+// last upload are not uploaded again
+
+template < typename T >
+inline bool uniformChanged( UniformSlot* slot, const T* data, size_t count = 1 ) {
+  return !slot || slot->update( data, count * sizeof( T ) );
+}
+
 template < typename T, typename F >
-void load1( const F& f, int location, const any& value ) {
+void load1( const F& f, int location, const any& value, UniformSlot* slot ) {
   const auto& t = value.cast<T>();
+  if ( !uniformChanged( slot, &t ) ) return;
   GL_CALL( f( location, t ) );
 }
 template < typename T, typename F >
-void load2( const F& f, int location, const any& value ) {
+void load2( const F& f, int location, const any& value, UniformSlot* slot ) {
   const auto& t = value.cast<T>();
+  if ( !uniformChanged( slot, &t ) ) return;
   GL_CALL( f( location, t[ 0 ], t[ 1 ] ) );
 }
 template < typename T, typename F >
-void load3( const F& f, int location, const any& value ) {
+void load3( const F& f, int location, const any& value, UniformSlot* slot ) {
   const auto& t = value.cast<T>();
+  if ( !uniformChanged( slot, &t ) ) return;
   GL_CALL( f( location, t[ 0 ], t[ 1 ], t[ 2 ] ) );
 }
 template < typename T, typename F >
-void load4( const F& f, int location, const any& value ) {
+void load4( const F& f, int location, const any& value, UniformSlot* slot ) {
   const auto& t = value.cast<T>();
+  if ( !uniformChanged( slot, &t ) ) return;
   GL_CALL( f( location, t[ 0 ], t[ 1 ], t[ 2 ], t[ 3 ] ) );
 }
 template < typename V, typename T, typename F>
-void loadv( const F& f, int location, const any& value, int stride = 1 ) {
+void loadv( const F& f, int location, const any& value, UniformSlot* slot, int stride = 1 ) {
   const auto& v = value.cast<V>();
+  if ( !uniformChanged( slot, v.data(), v.size() ) ) return;
   const int count = ( int )v.size() / stride;
   const auto pv = reinterpret_cast<const T*>( v.data() );
   GL_CALL( f( location, count, pv ) );
 }
 template < typename T, typename F >
-void loadm( const F& f, int location, const any& value ) {
+void loadm( const F& f, int location, const any& value, UniformSlot* slot ) {
   const auto& t = value.cast<T>();
+  if ( !uniformChanged( slot, &t ) ) return;
   const int count = 1;
   const auto pv = reinterpret_cast<const float*>( &t );
   GL_CALL( f( location, count, false, pv ) );
 }
 template < typename V, typename F>
-void loadmv( const F& f, int location, const any& value ) {
+void loadmv( const F& f, int location, const any& value, UniformSlot* slot ) {
   const auto& v = value.cast<V>();
+  if ( !uniformChanged( slot, v.data(), v.size() ) ) return;
   const int count = ( int )v.size();
   const auto pv = reinterpret_cast<const float*>( v.data() );
   GL_CALL( f( location, count, false, pv ) );
@@ -85,18 +100,18 @@ void loadmv( const F& f, int location, const any& value ) {
 
 template < int UniformType > struct UniformToType { };
 
-#define DECLARE_UNIFORM(UNIFORM_TYPE, TYPE, FUNC, FUNC_IMPL) \
-  template <> struct UniformToType<THREE:: UNIFORM_TYPE>   { \
-    static void load( int location, const any& value ) {     \
-      FUNC_IMPL < TYPE > ( FUNC, location, value );        \
-    }                                                        \
+#define DECLARE_UNIFORM(UNIFORM_TYPE, TYPE, FUNC, FUNC_IMPL)                     \
+  template <> struct UniformToType<THREE:: UNIFORM_TYPE>   {                     \
+    static void load( int location, const any& value, UniformSlot* slot ) {      \
+      FUNC_IMPL < TYPE > ( FUNC, location, value, slot );                        \
+    }                                                                            \
   };
 
-#define DECLARE_UNIFORM_V(UNIFORM_TYPE, TYPE, ELEM_TYPE, FUNC, STRIDE) \
-  template <> struct UniformToType<THREE:: UNIFORM_TYPE>   {         \
-    static void load( int location, const any& value ) {             \
-      loadv < TYPE, ELEM_TYPE > ( FUNC, location, value, STRIDE ); \
-    }                                                                \
+#define DECLARE_UNIFORM_V(UNIFORM_TYPE, TYPE, ELEM_TYPE, FUNC, STRIDE)           \
+  template <> struct UniformToType<THREE:: UNIFORM_TYPE>   {                     \
+    static void load( int location, const any& value, UniformSlot* slot ) {      \
+      loadv < TYPE, ELEM_TYPE > ( FUNC, location, value, slot, STRIDE );         \
+    }                                                                            \
   };
 
 DECLARE_UNIFORM( c,  Color,   glUniform3f, load3 )
@@ -123,41 +138,49 @@ DECLARE_UNIFORM_V( v4v, std::vector<Vector4>, float, glUniform4fv, 1 );
 #undef DECLARE_UNIFORM_V
 
 void Uniform::load( int location ) {
+  load( location, nullptr );
+}
+
+void Uniform::load( UniformSlot& slot ) {
+  load( slot.location, &slot );
+}
+
+void Uniform::load( int location, UniformSlot* slot ) {
 
   try {
 
     switch ( type ) {
 
     case THREE::i: // single integer
-      UniformToType<THREE::i>::load( location, value ); break;
+      UniformToType<THREE::i>::load( location, value, slot ); break;
     case THREE::f: // single float
-      UniformToType<THREE::f>::load( location, value ); break;
+      UniformToType<THREE::f>::load( location, value, slot ); break;
     case THREE::v2: // single THREE::Vector2
-      UniformToType<THREE::v2>::load( location, value ); break;
+      UniformToType<THREE::v2>::load( location, value, slot ); break;
     case THREE::v3: // single THREE::Vector3
-      UniformToType<THREE::v3>::load( location, value ); break;
+      UniformToType<THREE::v3>::load( location, value, slot ); break;
     case THREE::v4: // single THREE::Vector4
-      UniformToType<THREE::v4>::load( location, value ); break;
+      UniformToType<THREE::v4>::load( location, value, slot ); break;
     case THREE::c: // single THREE::Color
-      UniformToType<THREE::c>::load( location, value ); break;
+      UniformToType<THREE::c>::load( location, value, slot ); break;
     case THREE::iv1: // flat array of integers (JS or typed array)
-      UniformToType<THREE::iv1>::load( location, value ); break;
+      UniformToType<THREE::iv1>::load( location, value, slot ); break;
     case THREE::iv: // flat array of integers with 3 x N size (JS or typed array)
-      UniformToType<THREE::iv>::load( location, value ); break;
+      UniformToType<THREE::iv>::load( location, value, slot ); break;
     case THREE::fv1: // flat array of floats (JS or typed array)
-      UniformToType<THREE::fv1>::load( location, value ); break;
+      UniformToType<THREE::fv1>::load( location, value, slot ); break;
     case THREE::fv: // flat array of floats with 3 x N size (JS or typed array)
-      UniformToType<THREE::fv>::load( location, value ); break;
+      UniformToType<THREE::fv>::load( location, value, slot ); break;
     case THREE::v2v: // array of THREE::Vector2
-      UniformToType<THREE::v2v>::load( location, value ); break;
+      UniformToType<THREE::v2v>::load( location, value, slot ); break;
     case THREE::v3v: // array of THREE::Vector3
-      UniformToType<THREE::v3v>::load( location, value ); break;
+      UniformToType<THREE::v3v>::load( location, value, slot ); break;
     case THREE::v4v: // array of THREE::Vector4
-      UniformToType<THREE::v4v>::load( location, value ); break;
+      UniformToType<THREE::v4v>::load( location, value, slot ); break;
     case THREE::m4: // single THREE::Matrix4
-      UniformToType<THREE::m4>::load( location, value ); break;
+      UniformToType<THREE::m4>::load( location, value, slot ); break;
     case THREE::m4v: // array of THREE::Matrix4
-      UniformToType<THREE::m4v>::load( location, value ); break;
+      UniformToType<THREE::m4v>::load( location, value, slot ); break;
     case THREE::t: // single THREE::Texture (2d or cube)
       break;
       //UniformToType<THREE::t>::load( location, value ); break;
@@ -16,6 +16,7 @@
 #include <three/utils/noncopyable.hpp>
 #include <three/utils/properties.hpp>
 
+#include <array>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -97,12 +98,17 @@ public:
   int numSupportedMorphNormals;
 
   Program::Ptr program;
+  // Variant for instanced draws, built when first needed
+  Program::Ptr instancedProgram;
 
   std::string fragmentShader;
   std::string vertexShader;
 
   Uniforms uniforms;
   UniformsList uniformsList;
+  UniformsList instancedUniformsList;
+  // Entries of uniforms refreshed by the renderer, resolved with uniformsList
+  MaterialUniforms refreshedUniforms;
 
   Texture::Ptr map, envMap, lightMap, bumpMap, specularMap;
   float bumpScale;
@@ -3,12 +3,14 @@
 
 #include <three/common.hpp>
 
+#include <three/utils/hash.hpp>
 #include <three/utils/memory.hpp>
 #include <three/utils/noncopyable.hpp>
 
 #include <three/materials/attribute.hpp>
 #include <three/materials/uniform.hpp>
 
+#include <array>
 #include <map>
 #include <string>
 
@@ -28,13 +30,38 @@ public:
   UniformLocations uniforms;
   AttributeLocations attributes;
 
+  // Active uniforms, a slot each, resolved when the program is linked
+  UniformSlots slots;
+
+  // Slot of each BuiltinUniform, -1 if inactive
+  std::array<int, BuiltinUniform::Count> builtins;
+
+  // Slot of the named uniform, -1 if inactive
+  int slot( const std::string& name ) const {
+    for ( size_t i = 0; i < slots.size(); ++i ) {
+      if ( slots[ i ].name == name )
+        return ( int )i;
+    }
+    return -1;
+  }
+
+  UniformSlot* builtin( BuiltinUniform::Slot uniform ) {
+    const auto index = builtins[ uniform ];
+    return index != -1 ? &slots[ index ] : nullptr;
+  }
+
   Buffer program;
   int id;
 
+  // Identifies the sources and parameters the program was built from
+  Fingerprint key;
+
 protected:
 
   Program( Buffer program, int id )
-    : program( program ), id( id ) { }
+    : program( program ), id( id ) {
+    builtins.fill( -1 );
+  }
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -7,10 +7,15 @@
 #include <three/utils/index.hpp>
 #include <three/utils/properties.hpp>
 
+#include <algorithm>
+#include <array>
 #include <string>
+#include <vector>
 
 namespace three {
 
+class UniformSlot;
+
 class Uniform {
 public:
 
@@ -24,6 +29,9 @@ public:
 
   THREE_DECL void load( int location );
 
+  // As above, skipped if the value matches the slot's last upload
+  THREE_DECL void load( UniformSlot& slot );
+
   //////////////////////////////////////////////////////////////////////////
 
   THREE::UniformType type;
@@ -32,14 +40,197 @@ public:
   //////////////////////////////////////////////////////////////////////////
 
 private:
+  THREE_DECL void load( int location, UniformSlot* slot );
   THREE_DECL Uniform& swap( Uniform& other );
 };
 
 /////////////////////////////////////////////////////////////////////////
 
+// An active uniform of a linked program: its location, and a copy of the
+// last value uploaded there so that unchanged values can be skipped
+class UniformSlot {
+public:
+
+  explicit UniformSlot( std::string name = std::string(), int location = -1 )
+    : name( std::move( name ) ), location( location ) { }
+
+  // Records data as the uploaded value; false if it was already
+  bool update( const void* data, size_t size ) {
+    const auto bytes = static_cast<const unsigned char*>( data );
+    if ( !value.empty() && value.size() == size &&
+         std::equal( bytes, bytes + size, value.begin() ) )
+      return false;
+    value.assign( bytes, bytes + size );
+    return true;
+  }
+
+  // Forgets the last value, so the next update() uploads
+  void invalidate() { value.clear(); }
+
+  std::string name;
+  int location;
+  std::vector<unsigned char> value;
+
+};
+
+/////////////////////////////////////////////////////////////////////////
+
+// Uniforms the renderer sets itself, with a slot resolved per program
+namespace BuiltinUniform {
+
+enum Slot {
+  viewMatrix,
+  modelViewMatrix,
+  projectionMatrix,
+  normalMatrix,
+  modelMatrix,
+  cameraPosition,
+  morphTargetInfluences,
+  boneTexture,
+  boneGlobalMatrices,
+  Count
+};
+
+inline const char* name( Slot slot ) {
+  static const char* names[ Count ] = {
+    "viewMatrix",
+    "modelViewMatrix",
+    "projectionMatrix",
+    "normalMatrix",
+    "modelMatrix",
+    "cameraPosition",
+    "morphTargetInfluences",
+    "boneTexture",
+    "boneGlobalMatrices"
+  };
+  return names[ slot ];
+}
+
+} // namespace BuiltinUniform
+
+/////////////////////////////////////////////////////////////////////////
+
+// Material uniforms the renderer refreshes from the material's properties,
+// resolved once per program
+namespace MaterialUniform {
+
+enum Slot {
+  opacity,
+  diffuse,
+  map,
+  lightMap,
+  specularMap,
+  bumpMap,
+  bumpScale,
+  offsetRepeat,
+  envMap,
+  flipEnvMap,
+  reflectivity,
+  refractionRatio,
+  combine,
+  useRefract,
+  psColor,
+  size,
+  scale,
+  fogColor,
+  fogNear,
+  fogFar,
+  fogDensity,
+  shininess,
+  ambient,
+  emissive,
+  specular,
+  wrapRGB,
+  mNear,
+  mFar,
+  ambientLightColor,
+  directionalLightColor,
+  directionalLightDirection,
+  pointLightColor,
+  pointLightPosition,
+  pointLightDistance,
+  spotLightColor,
+  spotLightPosition,
+  spotLightDistance,
+  spotLightDirection,
+  spotLightAngle,
+  spotLightExponent,
+  hemisphereLightSkyColor,
+  hemisphereLightGroundColor,
+  hemisphereLightPosition,
+  Count
+};
+
+inline const char* name( Slot slot ) {
+  static const char* names[ Count ] = {
+    "opacity",
+    "diffuse",
+    "map",
+    "lightMap",
+    "specularMap",
+    "bumpMap",
+    "bumpScale",
+    "offsetRepeat",
+    "envMap",
+    "flipEnvMap",
+    "reflectivity",
+    "refractionRatio",
+    "combine",
+    "useRefract",
+    "psColor",
+    "size",
+    "scale",
+    "fogColor",
+    "fogNear",
+    "fogFar",
+    "fogDensity",
+    "shininess",
+    "ambient",
+    "emissive",
+    "specular",
+    "wrapRGB",
+    "mNear",
+    "mFar",
+    "ambientLightColor",
+    "directionalLightColor",
+    "directionalLightDirection",
+    "pointLightColor",
+    "pointLightPosition",
+    "pointLightDistance",
+    "spotLightColor",
+    "spotLightPosition",
+    "spotLightDistance",
+    "spotLightDirection",
+    "spotLightAngle",
+    "spotLightExponent",
+    "hemisphereLightSkyColor",
+    "hemisphereLightGroundColor",
+    "hemisphereLightPosition"
+  };
+  return names[ slot ];
+}
+
+} // namespace MaterialUniform
+
+/////////////////////////////////////////////////////////////////////////
+
+// A material uniform and its slot in the material's program (-1 if the
+// program does not use it)
+struct UniformBinding {
+  UniformBinding( Uniform* uniform, std::string name, int slot )
+    : uniform( uniform ), name( std::move( name ) ), slot( slot ) { }
+  Uniform* uniform;
+  std::string name;
+  int slot;
+};
+
 typedef Properties<std::string, Uniform> Uniforms;
 typedef std::unordered_map<std::string, Index> UniformLocations;
-typedef std::vector<std::pair<Uniform*, std::string>> UniformsList;
+typedef std::vector<UniformSlot> UniformSlots;
+typedef std::vector<UniformBinding> UniformsList;
+
+// The material's uniform for each MaterialUniform slot, nullptr if it has none
+typedef std::array<Uniform*, MaterialUniform::Count> MaterialUniforms;
 
 /////////////////////////////////////////////////////////////////////////
 
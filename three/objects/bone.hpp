@@ -1,62 +0,0 @@
-/*#ifndef THREE_MESH_HPP
-#define THREE_MESH_HPP
-
-namespace three {
-
-class Bone : public Object3D {
-
-	typedef std::shared_ptr<Mesh>Ptr
-THREE.Bone = function( belongsToSkin ) {
-
-	THREE.Object3D.call( this );
-
-	this.skin = belongsToSkin;
-	this.skinMatrix = new THREE.Matrix4();
-
-};
-
-THREE.Bone.prototype = Object.create( THREE.Object3D.prototype );
-
-THREE.Bone.prototype.update = function( parentSkinMatrix, forceUpdate ) {
-
-	// update local
-
-	if ( this.matrixAutoUpdate ) {
-
-		forceUpdate |= this.updateMatrix();
-
-	}
-
-	// update skin matrix
-
-	if ( forceUpdate || this.matrixWorldNeedsUpdate ) {
-
-		if( parentSkinMatrix ) {
-
-			this.skinMatrix.multiply( parentSkinMatrix, this.matrix );
-
-		} else {
-
-			this.skinMatrix.copy( this.matrix );
-
-		}
-
-		this.matrixWorldNeedsUpdate = false;
-		forceUpdate = true;
-
-	}
-
-	// update children
-
-	var child, i, l = this.children.length;
-
-	for ( i = 0; i < l; i ++ ) {
-
-		this.children[ i ].update( this.skinMatrix, forceUpdate );
-
-	}
-
-};
-
-} // namespace three
-#endif // THREE_MESH_HPP*/
\ No newline at end of file
@@ -22,7 +22,7 @@ int Mesh::getMorphTargetIndexByName( const std::string& name ) {
 
 Mesh::Mesh( const Geometry::Ptr& geometry, const Material::Ptr& material )
   : Object3D( material, geometry ),
-  boundRadius( 0 ), morphTargetBase( -1 ) {
+  boundRadius( 0 ) {
 
   if ( geometry ) {
 
@@ -32,6 +32,10 @@ Mesh::Mesh( const Geometry::Ptr& geometry, const Material::Ptr& material )
 
     boundRadius = geometry->boundingSphere.radius;
 
+    if ( geometry->boundingBox.empty() ) {
+      geometry->computeBoundingBox();
+    }
+
     // setup morph targets
 
     if ( geometry->morphTargets.size() > 0 ) {
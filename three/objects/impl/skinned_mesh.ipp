@@ -0,0 +1,306 @@
+#ifndef THREE_SKINNED_MESH_IPP
+#define THREE_SKINNED_MESH_IPP
+
+#include <three/objects/skinned_mesh.hpp>
+
+#include <three/console.hpp>
+
+#include <three/core/transform_kernels.hpp>
+#include <three/textures/texture.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace three {
+
+namespace detail {
+
+enum { SkinChunk = 16 }; // meshes per update() task
+
+// Side of the square float texture holding the palette, four texels per
+// bone
+inline int boneTextureSize( size_t bones ) {
+  return bones > 256 ? 64 : bones > 64 ? 32 : bones > 16 ? 16 : 8;
+}
+
+// Matrix4::compose, written straight into the elements
+
+inline void composeBone( Matrix4& m, const Bone& bone ) {
+
+  const auto& q = bone.quaternion;
+  const auto& s = bone.scale;
+  const auto& t = bone.position;
+
+  const auto x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+  const auto xx = q.x * x2, xy = q.x * y2, xz = q.x * z2;
+  const auto yy = q.y * y2, yz = q.y * z2, zz = q.z * z2;
+  const auto wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+
+  auto& te = m.elements;
+
+  te[0] = ( 1.f - ( yy + zz ) ) * s.x; te[4] = ( xy - wz ) * s.y;         te[8]  = ( xz + wy ) * s.z;         te[12] = t.x;
+  te[1] = ( xy + wz ) * s.x;         te[5] = ( 1.f - ( xx + zz ) ) * s.y; te[9]  = ( yz - wx ) * s.z;         te[13] = t.y;
+  te[2] = ( xz - wy ) * s.x;         te[6] = ( yz + wx ) * s.y;         te[10] = ( 1.f - ( xx + yy ) ) * s.z; te[14] = t.z;
+  te[3] = 0.f;                       te[7] = 0.f;                       te[11] = 0.f;                       te[15] = 1.f;
+
+}
+
+// Matrix4::multiply for affine matrices, skipping the bottom row
+inline void multiplyAffine( Matrix4& m, const Matrix4& am, const Matrix4& bm ) {
+
+  const auto& a = am.elements;
+  const auto& b = bm.elements;
+  auto& te = m.elements;
+
+  for ( int c = 0; c < 16; c += 4 ) {
+    const auto b0 = b[ c ], b1 = b[ c + 1 ], b2 = b[ c + 2 ];
+    te[ c ]     = a[0] * b0 + a[4] * b1 + a[8]  * b2;
+    te[ c + 1 ] = a[1] * b0 + a[5] * b1 + a[9]  * b2;
+    te[ c + 2 ] = a[2] * b0 + a[6] * b1 + a[10] * b2;
+    te[ c + 3 ] = b[ c + 3 ];
+  }
+
+  te[12] += a[12];
+  te[13] += a[13];
+  te[14] += a[14];
+
+}
+
+} // namespace detail
+
+SkinnedMesh::Ptr SkinnedMesh::create( const Geometry::Ptr& geometry, const Material::Ptr& material, bool useVertexTexture ) {
+  return three::make_shared<SkinnedMesh>( geometry, material, useVertexTexture );
+}
+
+SkinnedMesh::SkinnedMesh( const Geometry::Ptr& geometry, const Material::Ptr& material, bool useVertexTexture )
+  : Mesh( geometry, material ),
+    bonesNeedUpdate( true ),
+    mBoneVersion( 0 ),
+    mSkinVersion( ~0u ),
+    mBVHVersion( ~0u ) {
+
+  this->useVertexTexture = useVertexTexture;
+
+  if ( !geometry )
+    return;
+
+  bones = geometry->bones;
+
+  for ( size_t b = 0; b < bones.size(); ++b ) {
+    if ( bones[ b ].parent >= ( int )b ) {
+      console().warn() << "THREE::SkinnedMesh: bone " << b << " comes before its parent, treating it as a root";
+      bones[ b ].parent = -1;
+    }
+  }
+
+  boneMatrices.resize( bones.size() );
+  boneInverses.resize( bones.size() );
+
+  if ( useVertexTexture && !bones.empty() ) {
+
+    const auto size = detail::boneTextureSize( bones.size() );
+
+    boneTextureWidth = boneTextureHeight = size;
+
+    boneTexture = Texture::create(
+      TextureDesc( Image( std::vector<unsigned char>( size * size * 4 * sizeof( float ) ), size, size ),
+                   THREE::RGBAFormat,
+                   THREE::UVMapping,
+                   THREE::ClampToEdgeWrapping,
+                   THREE::ClampToEdgeWrapping,
+                   THREE::NearestFilter,
+                   THREE::NearestFilter,
+                   THREE::FloatType )
+    );
+
+    boneTexture->generateMipmaps = false;
+    boneTexture->flipY = false;
+
+  }
+
+  // With identity inverses the palette is the rest pose itself
+
+  updateBones();
+
+  for ( size_t b = 0; b < bones.size(); ++b ) {
+    boneInverses[ b ].getInverse( bones[ b ].skinMatrix );
+  }
+
+  bonesNeedUpdate = true;
+
+  // Weights summing to one keep skinned vertices in place at rest; the
+  // geometry may be shared, so skin() reads a normalised copy if needed
+
+  const auto& weights = geometry->skinWeights;
+
+  for ( size_t i = 0; i < weights.size(); ++i ) {
+    const auto sum = weights[ i ].x + weights[ i ].y + weights[ i ].z + weights[ i ].w;
+    if ( sum > 0.f && sum != 1.f ) {
+      mSkinWeights.resize( weights.size() );
+      std::transform( weights.begin(), weights.end(), mSkinWeights.begin(), normalizedWeights );
+      break;
+    }
+  }
+
+}
+
+void SkinnedMesh::pose() {
+
+  if ( !geometry )
+    return;
+
+  const auto& rest = geometry->bones;
+
+  for ( size_t b = 0, bl = std::min( bones.size(), rest.size() ); b < bl; ++b ) {
+    bones[ b ].position   = rest[ b ].position;
+    bones[ b ].quaternion = rest[ b ].quaternion;
+    bones[ b ].scale      = rest[ b ].scale;
+  }
+
+  bonesNeedUpdate = true;
+
+}
+
+void SkinnedMesh::updateBones() {
+
+  if ( !bonesNeedUpdate )
+    return;
+
+  bonesNeedUpdate = false;
+
+  const auto count = std::min( bones.size(), boneInverses.size() );
+
+  // Parents come first, so one pass sees every parent already updated.
+  // Bones are affine throughout.
+
+  Matrix4 local;
+
+  for ( size_t b = 0; b < count; ++b ) {
+
+    auto& bone = bones[ b ];
+
+    if ( bone.parent >= 0 ) {
+      detail::composeBone( local, bone );
+      detail::multiplyAffine( bone.skinMatrix, bones[ bone.parent ].skinMatrix, local );
+    } else {
+      detail::composeBone( bone.skinMatrix, bone );
+    }
+
+    detail::multiplyAffine( boneMatrices[ b ], bone.skinMatrix, boneInverses[ b ] );
+
+  }
+
+  if ( boneTexture && count > 0 ) {
+    auto& data = boneTexture->image[0].data;
+    std::memcpy( data.data(), boneMatrices.data(), std::min( data.size(), count * sizeof( Matrix4 ) ) );
+    boneTexture->needsUpdate = true;
+  }
+
+  ++mBoneVersion;
+
+}
+
+void SkinnedMesh::skin() {
+
+  updateBones();
+
+  if ( mSkinVersion == mBoneVersion || !geometry )
+    return;
+
+  mSkinVersion = mBoneVersion;
+
+  const auto& g = *geometry;
+  const auto count = g.vertices.size();
+
+  // Rest normals per vertex: the faces' vertex normals, or their face
+  // normals where those are unset
+
+  if ( mRestNormals.size() != count ) {
+
+    mRestNormals.assign( count, Vector3() );
+
+    for ( const auto& face : g.faces ) {
+      for ( auto i = 0; i < face.size(); ++i ) {
+        auto normal = face.vertexNormals[ i ];
+        mRestNormals[ face.abcd[ i ] ].addSelf( normal.isZero() ? face.normal : normal );
+      }
+    }
+
+    for ( auto& normal : mRestNormals ) {
+      normal.normalize();
+    }
+
+  }
+
+  mSkinnedVertices.resize( count );
+  mSkinnedNormals.resize( count );
+
+  if ( count == 0 )
+    return;
+
+  if ( boneMatrices.empty() || g.skinIndices.size() < count || g.skinWeights.size() < count ) {
+    std::copy( g.vertices.begin(), g.vertices.end(), mSkinnedVertices.begin() );
+    std::copy( mRestNormals.begin(), mRestNormals.end(), mSkinnedNormals.begin() );
+    return;
+  }
+
+  const auto& weights = mSkinWeights.size() == count ? mSkinWeights : g.skinWeights;
+
+  simd::skinVertices( boneMatrices.data(), boneMatrices.size(),
+                      &g.skinIndices[ 0 ].x, &weights[ 0 ].x,
+                      &g.vertices[ 0 ].x, sizeof( Vertex ),
+                      &mSkinnedVertices[ 0 ].x, sizeof( Vertex ),
+                      &mRestNormals[ 0 ].x, sizeof( Vector3 ),
+                      &mSkinnedNormals[ 0 ].x, sizeof( Vector3 ),
+                      count );
+
+  for ( auto& normal : mSkinnedNormals ) {
+    normal.normalize();
+  }
+
+}
+
+const GeometryBVH& SkinnedMesh::skinnedBVH() {
+
+  skin();
+
+  if ( !mBVH && geometry ) {
+    mBVH = GeometryBVH::create( *geometry );
+    mBVHVersion = ~0u;
+  }
+
+  if ( mBVHVersion != mSkinVersion ) {
+    if ( !mBVH->refit( *geometry, mSkinnedVertices ) ) {
+      mBVH = GeometryBVH::create( *geometry );
+      mBVH->refit( *geometry, mSkinnedVertices );
+    }
+    mBVHVersion = mSkinVersion;
+  }
+
+  return *mBVH;
+
+}
+
+void SkinnedMesh::update( SkinnedMesh* const* meshes, size_t count, ThreadPool& pool, bool skin ) {
+
+  const auto chunks = ( count + detail::SkinChunk - 1 ) / detail::SkinChunk;
+
+  pool.parallelFor( chunks, [&]( size_t chunk, size_t ) {
+
+    const auto end = std::min( count, ( chunk + 1 ) * detail::SkinChunk );
+
+    for ( auto i = chunk * detail::SkinChunk; i < end; ++i ) {
+      if ( skin ) {
+        meshes[ i ]->skin();
+      } else {
+        meshes[ i ]->updateBones();
+      }
+    }
+
+  } );
+
+}
+
+} // namespace three
+
+#endif // THREE_SKINNED_MESH_IPP
@@ -0,0 +1,49 @@
+#ifndef THREE_INSTANCED_MESH_HPP
+#define THREE_INSTANCED_MESH_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/color.hpp>
+#include <three/core/matrix4.hpp>
+#include <three/objects/mesh.hpp>
+
+#include <vector>
+
+namespace three {
+
+// A mesh drawn once per element of instanceMatrices, in one instanced draw
+// call (GL 3.3; one draw per instance otherwise). frustumCulled applies to
+// each instance: the geometry's bounds under matrixWorld * instanceMatrix.
+
+class InstancedMesh : public Mesh {
+public:
+
+  typedef std::shared_ptr<InstancedMesh> Ptr;
+
+  static Ptr create( const Geometry::Ptr& geometry, const Material::Ptr& material ) {
+    return three::make_shared<InstancedMesh>( geometry, material );
+  }
+
+  /////////////////////////////////////////////////////////////////////////
+
+  virtual InstancedMesh* instanced() { return this; }
+
+  /////////////////////////////////////////////////////////////////////////
+
+  // Transform of each instance, relative to the mesh
+  std::vector<Matrix4> instanceMatrices;
+
+  // Optional color of each instance, multiplied with the material's;
+  // instances past the end are white
+  std::vector<Color> instanceColors;
+
+protected:
+
+  InstancedMesh( const Geometry::Ptr& geometry, const Material::Ptr& material )
+    : Mesh( geometry, material ) { }
+
+};
+
+} // namespace three
+
+#endif // THREE_INSTANCED_MESH_HPP
@@ -25,13 +25,17 @@ namespace three {
     virtual void visit( Visitor& v ) { v( *this ); }
     virtual void visit( ConstVisitor& v ) const { v( *this ); }
 
+    // Non-null if this mesh draws many instances of its geometry
+    virtual InstancedMesh* instanced() { return nullptr; }
+
+    // Non-null if this mesh is deformed by bones
+    virtual SkinnedMesh* skinned() { return nullptr; }
+    const SkinnedMesh* skinned() const { return const_cast<Mesh*>( this )->skinned(); }
+
     /////////////////////////////////////////////////////////////////////////
 
     float boundRadius;
-    int morphTargetBase;
 
-    std::vector<int> morphTargetForcedOrder;
-    std::vector<int> morphTargetInfluences;
     std::unordered_map<std::string, int> morphTargetDictionary;
 
     /////////////////////////////////////////////////////////////////////////
@@ -34,6 +34,10 @@ protected:
         geometry->computeBoundingSphere();
       }
       boundRadius = geometry->boundingSphere.radius;
+
+      if ( geometry->boundingBox.empty() ) {
+        geometry->computeBoundingBox();
+      }
     }
 
     frustumCulled = false;
@@ -1,201 +1,108 @@
 #ifndef THREE_SKINNED_MESH_HPP
 #define THREE_SKINNED_MESH_HPP
 
+#include <three/common.hpp>
+
+#include <three/core/bone.hpp>
+#include <three/core/bvh.hpp>
+#include <three/core/matrix4.hpp>
+#include <three/core/vector4.hpp>
 #include <three/objects/mesh.hpp>
 
-#ifdef TODO_SKINNED_MESH
+#include <three/utils/thread_pool.hpp>
+
+#include <vector>
 
 namespace three {
 
+// A mesh deformed by a skeleton, with up to four bones per vertex from
+// Geometry::skinIndices and skinWeights. The bones are a flat array in
+// Object3D::bones, copied from Geometry::bones with each bone after its
+// parent; move them and set bonesNeedUpdate.
+//
+// updateBones() walks the array once, caching each bone's skinMatrix, and
+// writes the palette (skinMatrix times the inverse of the rest pose) to
+// boneMatrices and boneTexture, which the renderer skins with on the GPU.
+// skin() blends the same palette on the CPU for the Projector and Ray,
+// which see the skinned pose. Both do nothing while the bones are
+// unchanged; update() runs them over many meshes in parallel.
+//
+// Weights are scaled to sum to one where they are read, leaving the
+// geometry as given. Culling uses the bounds of the rest pose.
+
 class SkinnedMesh : public Mesh {
+public:
 
   typedef std::shared_ptr<SkinnedMesh> Ptr;
 
-  static Ptr create( const Geometry::Ptr& geometry, const Material::Ptr& material, bool useVertexTexture = true ) {
-    return three::make_shared<SkinnedMesh>( geometry, material, useVertexTexture );
-  }
-
-  //
-
-  bool useVertexTexture;
-  Matrix4 offsetMatrix;
-  std::vector<Matrix4> boneInverses;
-
-  Bone& addBone( Bone& bone = Bone() ) {
-    /*if ( !bone ) {
-      bone.reset( Bone::create( this ) );
-    }*/
-
-    bones.push_back( bone );
-    return bone;
-  }
-
-  void updateMatrixWorld ( bool force ) {
-
-    if ( matrixAutoUpdate ) updateMatrix();
-
-    // update matrixWorld
-    if ( matrixWorldNeedsUpdate || force ) {
-      if ( parent ) {
-        matrixWorld.multiply( parent.matrixWorld, matrix );
-      } else {
-        matrixWorld.copy( this.matrix );
-      }
-      matrixWorldNeedsUpdate = false;
-      force = true;
-    }
-
-    // update children
-    for ( size_t i = 0, l = children.size(); i < l; i ++ ) {
-      auto& child = children[ i ];
-      if ( child->type() == THREE.Bone ) {
-        child->update( identityMatrix, false );
-      } else {
-        child->updateMatrixWorld( true );
-      }
-    }
-
-    // make a snapshot of the bones' rest position
-    if ( boneInverses.size() == 0 ) {
-      for ( const auto& bone : bones ) {
-        Matrix4 inverse;
-        inverse.getInverse( bone->skinMatrix );
-        boneInverses.push_back( inverse );
-      }
-    }
-
-    // flatten bone matrices to array
-    for ( size_t b = 0, bl = bones.size(); b < bl; b ++ ) {
-      // compute the offset between the current and the original transform;
-
-      //TODO: we could get rid of this multiplication step if the skinMatrix
-      // was already representing the offset; however, this requires some
-      // major changes to the animation system
-      offsetMatrix.multiply( bones[ b ].skinMatrix, boneInverses[ b ] );
-      //offsetMatrix.flattenToArrayOffset( boneMatrices, b * 16 );
-      boneMatrices[ b ] = offsetMatrix;
-    }
-
-    if ( this.useVertexTexture ) {
-      boneTexture.needsUpdate = true;
-    }
-
-  }
-
-  /*
-   * Pose
-   */
-
-  void pose () {
-
-    this.updateMatrixWorld( true );
-    for ( size_t i = 0; i < geometry.skinIndices.size(); i ++ ) {
-      // normalize weights
-      const auto& sw = geometry->skinWeights[ i ];
-      const auto scale = 1.0.f / sw.lengthManhattan();
-      if ( scale != Math::Inf() ) {
-        sw.multiplyScalar( scale );
-      } else {
-        sw.set( 1 ); // this will be normalized by the shader anyway
-      }
-    }
-  }
-
-protected:
-
-  // init bones
-  SkinnedMesh( const Geometry::Ptr& geometry, const Material::Ptr& material, bool useVertexTexture )
-    : Mesh( geometry, material ), useVertexTexture( useVertexTexture ) {
-
-    Matrix4 identityMatrix;
-
-    if ( geometry && geometry->bones.size() > 0 ) {
-
-    	for ( auto& gbone : geometry->bones ) {
-
-        const auto& p = gbone.pos;
-        const auto& q = gbone.rotq;
-        const auto& s = gbone.scl;
-
-        auto& bone = addBone();
-
-        bone.name = gbone.name;
-        bone.position.set( p[0], p[1], p[2] );
-        bone.quaternion.set( q[0], q[1], q[2], q[3] );
-        bone.useQuaternion = true;
+  // useVertexTexture keeps the palette in a float texture where vertex
+  // textures are supported, which allows more bones than uniforms do
+  THREE_DECL static Ptr create( const Geometry::Ptr& geometry, const Material::Ptr& material, bool useVertexTexture = true );
 
-        bone.scale.set( s[0], s[1], s[2] );
-        //bone.scale.set( 1, 1, 1 );
+  /////////////////////////////////////////////////////////////////////////
 
-      }
+  virtual SkinnedMesh* skinned() { return this; }
 
-      for ( size_t b = 0; b < bones.size(); b ++ ) {
+  /////////////////////////////////////////////////////////////////////////
 
-        auto& gbone = geometry.bones[ b ];
-        auto& bone = bones[ b ];
-
-        if ( gbone.parent == -1 ) {
-
-          add( bone );
-
-        } else {
-
-          bones[ gbone.parent ].add( bone );
+  // Inverse of each bone's skinMatrix in the rest pose
+  std::vector<Matrix4> boneInverses;
 
-        }
+  bool bonesNeedUpdate;
 
-      }
+  /////////////////////////////////////////////////////////////////////////
 
-      //
+  // Moves the bones back to the geometry's rest pose
+  THREE_DECL void pose();
 
-      const auto nBones = bones.size();
+  // Recomputes the palette if bonesNeedUpdate
+  THREE_DECL void updateBones();
 
-      if ( this.useVertexTexture ) {
+  // Skins the geometry's vertices and normals, unless the palette is
+  // unchanged since the last call. Normals are per vertex, averaged from
+  // the faces' vertex normals of the rest pose.
+  THREE_DECL void skin();
 
-        // layout (1 matrix = 4 pixels)
-        //  RGBA RGBA RGBA RGBA (=> column1, column2, column3, column4)
-        //  with  8x8  pixel texture max   16 bones  (8 * 8  / 4)
-        //     16x16 pixel texture max   64 bones (16 * 16 / 4)
-        //     32x32 pixel texture max  256 bones (32 * 32 / 4)
-        //     64x64 pixel texture max 1024 bones (64 * 64 / 4)
+  // Output of skin(), in object space and the geometry's vertex order
+  const std::vector<Vertex>& skinnedVertices() const { return mSkinnedVertices; }
+  const std::vector<Vector3>& skinnedNormals() const { return mSkinnedNormals; }
 
-        var size;
+  // Triangle BVH of the skinned pose, refit on demand
+  THREE_DECL const GeometryBVH& skinnedBVH();
 
-        if ( nBones > 256 )
-          size = 64;
-        else if ( nBones > 64 )
-          size = 32;
-        else if ( nBones > 16 )
-          size = 16;
-        else
-          size = 8;
+  // Bumped by each palette change
+  unsigned boneVersion() const { return mBoneVersion; }
 
-        this.boneTextureWidth = size;
-        this.boneTextureHeight = size;
+  // weights scaled to sum to one; all-zero weights are kept
+  static Vector4 normalizedWeights( const Vector4& weights ) {
+    const auto sum = weights.x + weights.y + weights.z + weights.w;
+    return sum > 0.f && sum != 1.f ? Vector4( weights ).multiplyScalar( 1.f / sum ) : weights;
+  }
 
-        this.boneMatrices = new Float32Array( this.boneTextureWidth * this.boneTextureHeight * 4 ); // 4 floats per RGBA pixel
-        this.boneTexture = new THREE.DataTexture( this.boneMatrices, this.boneTextureWidth, this.boneTextureHeight, THREE.RGBAFormat, THREE.FloatType );
-        this.boneTexture.minFilter = THREE.NearestFilter;
-        this.boneTexture.magFilter = THREE.NearestFilter;
-        this.boneTexture.generateMipmaps = false;
-        this.boneTexture.flipY = false;
+  // updateBones(), or skin() if asked, over count meshes
+  static THREE_DECL void update( SkinnedMesh* const* meshes, size_t count, ThreadPool& pool, bool skin = false );
 
-      } else {
+protected:
 
-        this.boneMatrices = new Float32Array( 16 * nBones );
+  THREE_DECL SkinnedMesh( const Geometry::Ptr& geometry, const Material::Ptr& material, bool useVertexTexture );
 
-      }
+private:
 
-      this.pose();
+  std::vector<Vector3> mRestNormals;
+  std::vector<Vector4> mSkinWeights; // normalised, if the geometry's aren't
+  std::vector<Vertex> mSkinnedVertices;
+  std::vector<Vector3> mSkinnedNormals;
 
-    }
+  GeometryBVH::Ptr mBVH;
 
-  }
+  unsigned mBoneVersion, mSkinVersion, mBVHVersion;
 
-}; // SkinnedMesh
+};
 
 } // namespace three
 
-#endif // TODO_SKINNED_MESH
+#if defined(THREE_HEADER_ONLY)
+# include <three/objects/impl/skinned_mesh.ipp>
+#endif // defined(THREE_HEADER_ONLY)
 
-#endif // THREE_SKINNED_MESH_HPP
\ No newline at end of file
+#endif // THREE_SKINNED_MESH_HPP
@@ -0,0 +1,61 @@
+#ifndef THREE_GL_BUFFER_STREAM_HPP
+#define THREE_GL_BUFFER_STREAM_HPP
+
+#include <three/common.hpp>
+#include <three/constants.hpp>
+#include <three/gl.hpp>
+
+#include <three/utils/noncopyable.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace three {
+
+// Uploads for buffers whose contents are rewritten while they are in use
+// (dynamic geometry). Keeps a copy of what each buffer last received and
+// sends only the byte range that changed, with glBufferSubData; unchanged
+// data is not sent at all. Rewrites of most of a buffer respecify its
+// storage instead, which orphans the old store so the driver need not wait
+// on draws still reading it.
+//
+// A buffer's first upload is sent whole and not copied, so buffers that
+// are never updated again cost nothing extra.
+
+class GLBufferStream : NonCopyable {
+public:
+
+  THREE_DECL GLBufferStream();
+
+  // Uploads size bytes of data to buffer (bound to target); returns the
+  // number of bytes actually sent
+  THREE_DECL size_t upload( GLenum target, Buffer buffer, const void* data, size_t size, GLenum usage );
+
+  // Forgets buffer, e.g. before it is deleted and its name reused
+  THREE_DECL void release( Buffer buffer );
+
+  THREE_DECL void clear();
+
+  // Bytes held in copies of uploaded data
+  size_t footprint() const { return mFootprint; }
+
+private:
+
+  struct Stream {
+    Stream() : size( 0 ) { }
+    size_t size;
+    std::vector<unsigned char> contents;
+  };
+
+  std::unordered_map<Buffer, Stream> mStreams;
+  size_t mFootprint;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/renderers/impl/gl_buffer_stream.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_GL_BUFFER_STREAM_HPP
@@ -0,0 +1,61 @@
+#ifndef THREE_GL_PROGRAM_CACHE_HPP
+#define THREE_GL_PROGRAM_CACHE_HPP
+
+#include <three/common.hpp>
+
+#include <three/materials/program.hpp>
+
+#include <three/utils/hash.hpp>
+#include <three/utils/noncopyable.hpp>
+
+#include <vector>
+
+namespace three {
+
+// Reference-counted programs keyed by Program::key, in an open-addressing
+// table (linear probing, at most half full), so looking a program up or
+// releasing it costs a hash probe instead of a scan.
+
+class GLProgramCache : NonCopyable {
+public:
+
+  THREE_DECL GLProgramCache();
+
+  // The program built for key, with its use count incremented; null if none
+  THREE_DECL Program::Ptr acquire( const Fingerprint& key );
+
+  // Adds a new program, with one use, under program.key
+  THREE_DECL void insert( const Program::Ptr& program );
+
+  // Drops a use; true if that was the last one and the entry was removed
+  THREE_DECL bool release( const Program& program );
+
+  THREE_DECL void clear();
+
+  size_t size() const { return mSize; }
+
+private:
+
+  struct Slot {
+    Slot() : usedTimes( 0 ), deleted( false ) { }
+    Program::Ptr program;
+    int usedTimes;
+    bool deleted;
+  };
+
+  THREE_DECL size_t find( const Fingerprint& key ) const;
+  THREE_DECL void rehash( size_t capacity );
+
+  std::vector<Slot> mSlots;
+  size_t mSize;
+  size_t mDeleted;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/renderers/impl/gl_program_cache.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_GL_PROGRAM_CACHE_HPP
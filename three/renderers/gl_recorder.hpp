@@ -0,0 +1,119 @@
+#ifndef THREE_GL_RECORDER_HPP
+#define THREE_GL_RECORDER_HPP
+
+#include <three/common.hpp>
+#include <three/gl.hpp>
+
+#include <three/utils/memory.hpp>
+#include <three/utils/noncopyable.hpp>
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace three {
+
+// Null GL backend: a GLDispatch table whose functions draw nothing and only
+// count what the renderer asks for. Object names, locations and queries get
+// plausible answers (shaders compile, programs link), so a GLRenderer can be
+// created and run without a context, e.g. for headless CPU benchmarks.
+// Like a real driver, programs only report the uniforms and attributes that
+// survive the shader preprocessor; the rest get location -1.
+//
+// Takes effect only in builds with THREE_GL_DISPATCH; install() before
+// GLRenderer::create(), uninstall() (or destroy the recorder) afterwards.
+
+class GLRecorder : NonCopyable {
+public:
+
+  typedef std::shared_ptr<GLRecorder> Ptr;
+
+  static Ptr create() { return three::make_shared<GLRecorder>(); }
+
+  THREE_DECL ~GLRecorder();
+
+  enum Command {
+#define THREE_GL_COMMAND( ret, name, params, args ) name,
+    THREE_GL_FUNCTIONS( THREE_GL_COMMAND )
+#undef THREE_GL_COMMAND
+    CommandCount
+  };
+
+  // size is the number of bytes passed to GL (buffers, textures, uniforms,
+  // shader sources), or the vertex/index count for draw calls (times the
+  // instance count for instanced draws)
+  struct Entry {
+    unsigned short command;
+    unsigned size;
+  };
+
+  struct Stats {
+    Stats() : calls( 0 ), bytes( 0 ) { }
+    size_t calls;
+    size_t bytes;
+  };
+
+  // Every command in call order, while recording is set
+  std::vector<Entry> commands;
+  bool recording;
+
+  std::array<Stats, CommandCount> stats;
+
+  /////////////////////////////////////////////////////////////////////////
+
+  THREE_DECL void install();
+  THREE_DECL void uninstall();
+  bool installed() const { return current() == this; }
+
+  // Clears stats and commands; object names keep counting
+  THREE_DECL void reset();
+
+  THREE_DECL size_t calls() const;
+  THREE_DECL size_t drawCalls() const;
+  THREE_DECL size_t uploadBytes() const;
+  THREE_DECL size_t stateChanges() const;
+
+  // One line per command issued, most frequent first
+  THREE_DECL std::string report() const;
+
+  const GLDispatch& dispatch() const { return mDispatch; }
+
+  static THREE_DECL const char* name( Command command );
+
+protected:
+
+  THREE_DECL GLRecorder();
+
+private:
+
+  friend struct GLRecorderBackend;
+
+  static THREE_DECL GLRecorder*& current();
+
+  THREE_DECL void record( Command command, size_t size );
+
+  struct Program {
+    Program() : attributes( 0 ), uniforms( 0 ) { }
+    std::vector<GLuint> shaders;
+    std::unordered_set<std::string> identifiers;
+    GLint attributes, uniforms;
+  };
+
+  GLDispatch mDispatch;
+
+  GLuint mNames;
+
+  std::unordered_map<GLuint, std::string> mShaders;
+  std::unordered_map<GLuint, Program> mPrograms;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/renderers/impl/gl_recorder.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_GL_RECORDER_HPP
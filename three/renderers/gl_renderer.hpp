@@ -14,7 +14,14 @@
 #include <three/materials/program.hpp>
 #include <three/textures/texture.hpp>
 
+#include <three/renderers/gl_buffer_stream.hpp>
+#include <three/renderers/gl_program_cache.hpp>
 #include <three/renderers/gl_render_target.hpp>
+#include <three/renderers/particle_sorter.hpp>
+
+#include <three/utils/thread_pool.hpp>
+
+#include <cstdint>
 
 #ifndef TEXTURE_MAX_ANISOTROPY_EXT
 #define TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
@@ -23,6 +30,15 @@
 namespace three {
 
 typedef std::vector<Scene::GLObject> RenderList;
+
+// One GLObject in one pass. Draws are sorted by key, which packs the pass,
+// the state the draw needs and its depth (see GLRenderer::drawKey)
+struct Draw {
+  std::uint64_t key;
+  Scene::GLObject* glObject;
+};
+
+typedef std::vector<Draw>            DrawList;
 typedef std::vector<Object3D*>       RenderListDirect;
 typedef std::vector<Light*>          Lights;
 typedef std::vector<std::string>     Identifiers;
@@ -74,6 +90,34 @@ public:
 
   int maxMorphTargets;
   int maxMorphNormals;
+  // Objects with more active morph targets than the program takes blend
+  // the least influential ones on the CPU into its last slot; otherwise
+  // those are dropped
+  bool blendExcessMorphTargets;
+
+  // vertex layout
+
+  // Static (non-dynamic) meshes share identical vertices between faces
+  bool weldStaticBuffers;
+  // Static (non-dynamic) meshes get one interleaved vertex buffer per
+  // geometry group instead of one per attribute
+  bool interleaveStaticBuffers;
+  // ... with normals, tangents and colors packed into 4 bytes each
+  bool packStaticBuffers;
+
+  // instancing
+
+  // Opaque meshes sharing a geometry group and a material are drawn with
+  // one instanced call, their model matrices in an instance attribute
+  // buffer. Needs GL 3.3; InstancedMesh objects always draw this way.
+  bool instanceMeshes;
+
+  // particles
+
+  // Particle systems with sortParticles set keep their attributes on the
+  // GPU in particle order and are drawn through a sorted index buffer, so
+  // a sort uploads 2 or 4 bytes per particle instead of every attribute
+  bool sortParticlesByIndex;
 
   // flags
 
@@ -84,8 +128,39 @@ public:
 
 public:
 
+  struct Info {
+
+    struct Memory {
+      Memory() : programs( 0 ), geometries( 0 ), textures( 0 ), streams( 0 ) { }
+      int programs;
+      int geometries;
+      int textures;
+      size_t streams; // bytes kept to diff dynamic buffer uploads against
+    } memory;
+
+    struct Render {
+      Render() : calls( 0 ), vertices( 0 ), faces( 0 ), points( 0 ) { }
+      int calls;
+      int vertices;
+      int faces;
+      int points;
+    } render;
+
+    // Buffer uploads in the last render()
+    struct Upload {
+      Upload() : buffers( 0 ), bytes( 0 ), skipped( 0 ) { }
+      int buffers;  // buffers updated
+      size_t bytes; // bytes sent to GL
+      int skipped;  // dynamic buffer updates that changed nothing
+    } upload;
+
+  };
+
+  const Info& info() const { return _info; }
+
   void* getContext() { return _gl; }
   bool supportsVertexTextures() const { return _supportsVertexTextures; }
+  bool supportsInstancing() const { return _supportsInstancing; }
   float getMaxAnisotropy() const { return _maxAnisotropy; }
   int width() const { return _width; }
   int height() const { return _height; }
@@ -115,6 +190,14 @@ public:
   THREE_DECL void deallocateRenderTarget( GLRenderTarget& renderTarget );
   THREE_DECL void deallocateMaterial( Material& material );
 
+  // Threads sorting particle systems with sortParticles set; 0 (the
+  // default) uses every hardware thread, 1 sorts on the calling thread
+  void setParticleSortThreads( size_t threads ) { _particleSorter.setThreads( threads ); }
+
+  // Threads updating the bone palettes of skinned meshes once per frame;
+  // 0 (the default) uses every hardware thread
+  void setSkinningThreads( size_t threads ) { _skinningPool.resize( threads ); }
+
   // Rendering
   THREE_DECL void render( Scene& scene, Camera& camera, const GLRenderTarget::Ptr& renderTarget = GLRenderTarget::Ptr(), bool forceClear = false );
   THREE_DECL void updateShadowMap( const Scene& scene, const Camera& camera );
@@ -135,9 +218,18 @@ private:
 
   // Buffer deallocation
   THREE_DECL void deleteParticleBuffers( Geometry& geometry );
+  THREE_DECL void deleteDirectBuffers( Geometry& geometry );
   THREE_DECL void deleteLineBuffers( Geometry& geometry );
   THREE_DECL void deleteRibbonBuffers( Geometry& geometry );
   THREE_DECL void deleteMeshBuffers( GeometryGroup& geometryGroup );
+  THREE_DECL void deleteBuffer( Buffer& buffer );
+
+  // Dynamic (stream) buffers go through _bufferStream; counted in _info.upload
+  THREE_DECL void uploadBuffer( GLenum target, Buffer buffer, const void* data, size_t size, GLenum usage, bool stream );
+  template < typename C >
+  void uploadBuffer( GLenum target, Buffer buffer, const C& container, GLenum usage, bool stream ) {
+    uploadBuffer( target, buffer, container.data(), container.size() * sizeof( container[0] ), usage, stream );
+  }
 
   // Buffer initialization
   THREE_DECL void initCustomAttributes( Geometry& geometry, Object3D& object );
@@ -161,20 +253,37 @@ private:
   THREE_DECL void setLineBuffers( Geometry& geometry, int hint );
   THREE_DECL void setRibbonBuffers( Geometry& geometry, int hint );
   THREE_DECL void setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object, int hint, bool dispose, Material* material );
+  THREE_DECL void uploadStaticMeshBuffers( GeometryGroup& geometryGroup, int hint );
+  THREE_DECL void uploadIndices( GeometryGroup& geometryGroup, int vertices, int hint, bool stream );
+  THREE_DECL void weldMeshBuffers( GeometryGroup& geometryGroup );
+  THREE_DECL void interleaveMeshBuffers( GeometryGroup& geometryGroup, int hint );
+  THREE_DECL void bindInterleavedBuffers( GeometryGroup& geometryGroup, AttributeLocations& attributes );
   THREE_DECL void setDirectBuffers( Geometry& geometry, int hint, bool dispose );
+  THREE_DECL void setParticleDirectBuffers( Geometry& geometry, int hint );
 
   // Buffer rendering
-  THREE_DECL void renderBuffer( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryGroup& geometryGroup, Object3D& object );
+  // With instances > 0, draws that many copies of the group, one per
+  // element of _instanceArray
+  THREE_DECL void renderBuffer( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryGroup& geometryGroup, Object3D& object, int instances = 0 );
+  THREE_DECL void renderInstances( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryGroup& geometryGroup, InstancedMesh& object );
+  THREE_DECL void bindInstanceBuffer( AttributeLocations& attributes, int instances );
   THREE_DECL void renderBufferImmediate( Object3D& object, Program& program, Material& material );
   THREE_DECL void renderBufferDirect( Camera& camera, Lights& lights, IFog* fog, Material& material, BufferGeometry& geometry, Object3D& object );
 
-  // Sorting
+  // Morph targets
   THREE_DECL void setupMorphTargets( Material& material, GeometryGroup& geometryGroup, Object3D& object );
+  THREE_DECL void selectMorphTargets( Material& material, GeometryGroup& geometryGroup, Object3D& object, Object3D::GLData::MorphState& state );
+  THREE_DECL void blendMorphResidual( GeometryGroup& geometryGroup, Object3D::GLData::MorphState& state, bool normals );
+  THREE_DECL void deleteMorphStates( Object3D& object );
 
   // Rendering
   THREE_DECL void renderPlugins( std::vector<IPlugin::Ptr>& plugins, Scene& scene, Camera& camera );
   THREE_DECL void renderObjects( RenderList& renderList, bool reverse, THREE::RenderType materialType, Camera& camera, Lights& lights, IFog* fog, bool useBlending, Material* overrideMaterial = nullptr );
+  THREE_DECL void renderDraws( const Draw* begin, const Draw* end, THREE::RenderType materialType, Camera& camera, Lights& lights, IFog* fog, bool useBlending );
+  THREE_DECL void renderDraw( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryBuffer& buffer, Object3D& object );
+  THREE_DECL bool canInstance( const Draw& draw ) const;
   THREE_DECL void renderObjectsImmediate( RenderList& renderList, THREE::RenderType materialType, Camera& camera, Lights& lights, IFog* fog, bool useBlending, Material* overrideMaterial = nullptr );
+  THREE_DECL static std::uint64_t drawKey( THREE::RenderType materialType, const Material& material, float z, bool sortByDepth );
   THREE_DECL void renderImmediateObject( Camera& camera, Lights& lights, IFog* fog, Material& material, Object3D& object );
   THREE_DECL void unrollImmediateBufferMaterial( Scene::GLObject& globject );
   THREE_DECL void unrollBufferMaterial( Scene::GLObject& globject );
@@ -196,27 +305,28 @@ private:
   THREE_DECL void clearCustomAttributes( Material& material );
 
   // Objects removal
-  THREE_DECL void removeObject( Object3D& object, Scene& scene );
-  THREE_DECL void removeInstances( RenderList& objlist, Object3D& object );
-  THREE_DECL void removeInstancesDirect( RenderListDirect& objlist, Object3D& object );
+  THREE_DECL void removeObjects( Scene& scene );
+  THREE_DECL void removeInstances( RenderList& objlist );
+  THREE_DECL void removeInstancesDirect( RenderListDirect& objlist );
 
   // Materials
-  THREE_DECL void initMaterial( Material& material, Lights& lights, IFog* fog, Object3D& object );
+  THREE_DECL void initMaterial( Material& material, Lights& lights, IFog* fog, Object3D& object, bool instanced = false );
   THREE_DECL void setMaterialShaders( Material& material, const Shader& shaders );
-  Program& setProgram( Camera& camera, Lights& lights, IFog* fog, Material& material, Object3D& object );
+  Program& setProgram( Camera& camera, Lights& lights, IFog* fog, Material& material, Object3D& object, bool instanced = false );
 
   // Uniforms (refresh uniforms objects)
-  THREE_DECL void refreshUniformsCommon( Uniforms& uniforms, Material& material );
-  THREE_DECL void refreshUniformsLine( Uniforms& uniforms, Material& material );
-  THREE_DECL void refreshUniformsParticle( Uniforms& uniforms, Material& material );
-  THREE_DECL void refreshUniformsFog( Uniforms& uniforms, IFog& fog );
-  THREE_DECL void refreshUniformsPhong( Uniforms& uniforms, Material& material );
-  THREE_DECL void refreshUniformsLambert( Uniforms& uniforms, Material& material );
-  THREE_DECL void refreshUniformsLights( Uniforms& uniforms, InternalLights& lights );
+  THREE_DECL void refreshUniformsCommon( MaterialUniforms& uniforms, Material& material );
+  THREE_DECL void refreshUniformsLine( MaterialUniforms& uniforms, Material& material );
+  THREE_DECL void refreshUniformsParticle( MaterialUniforms& uniforms, Material& material );
+  THREE_DECL void refreshUniformsFog( MaterialUniforms& uniforms, IFog& fog );
+  THREE_DECL void refreshUniformsPhong( MaterialUniforms& uniforms, Material& material );
+  THREE_DECL void refreshUniformsLambert( MaterialUniforms& uniforms, Material& material );
+  THREE_DECL void refreshUniformsLights( MaterialUniforms& uniforms, InternalLights& lights );
   THREE_DECL void refreshUniformsShadow( Uniforms& uniforms, Lights& lights );
 
   // Uniforms (load to GPU)
-  THREE_DECL void loadUniformsMatrices( UniformLocations& uniforms, Object3D& object );
+  THREE_DECL void loadUniformsMatrices( Program& program, Object3D& object );
+  THREE_DECL void loadUniformMatrices( Program& program, BuiltinUniform::Slot uniform, const float* elements, int count = 1 );
   THREE_DECL  int getTextureUnit();
   THREE_DECL void loadUniformsGeneric( Program& program, UniformsList& uniforms, bool warnOnNotFound );
   THREE_DECL void setupMatrices( Object3D& object, Camera& camera );
@@ -331,38 +441,20 @@ private:
 
   // info
 
-  struct Info {
-
-    struct Memory {
-      Memory() : programs( 0 ), geometries( 0 ), textures( 0 ) { }
-      int programs;
-      int geometries;
-      int textures;
-    } memory;
-
-    struct Render {
-      Render() : calls( 0 ), vertices( 0 ), faces( 0 ), points( 0 ) { }
-      int calls;
-      int vertices;
-      int faces;
-      int points;
-    } render;
-
-  } _info;
+  Info _info;
 
   // internal properties
 
-  struct ProgramInfo {
-    ProgramInfo( const Program::Ptr& program, std::string code, int usedTimes )
-      : program( program ), code( code ), usedTimes( usedTimes ) { }
-    ProgramInfo()
-      : program( 0 ), usedTimes( 0 ) { }
-
-    Program::Ptr program;
-    std::string code;
-    int usedTimes;
-  };
-  std::vector<ProgramInfo> _programs;
+  GLProgramCache _programs;
+  GLBufferStream _bufferStream;
+  ParticleSorter _particleSorter;
+  std::vector<ParticleSorter::Stream> _particleStreams;
+  std::vector<uint16_t> _indexScratch;
+  std::vector<std::pair<float, int>> _morphScratch;
+  std::vector<const float*> _morphArrays;
+  std::vector<float> _morphWeights;
+  std::vector<int> _textureUnitScratch;
+  ThreadPool _skinningPool;
   int _programs_counter;
 
   // internal state cache
@@ -402,7 +494,29 @@ private:
   int _currentWidth;
   int _currentHeight;
 
+  // objects removed this frame, sorted
+  std::vector<Object3D*> _removedObjects;
+
   Frustum _frustum;
+  std::vector<Box> _cullBoxes;
+  std::vector<int> _cullPlanes;
+  std::vector<unsigned char> _cullResults;
+  std::vector<Object3D*> _cullObjects;
+  std::vector<size_t> _cullEntries; // entries of Scene::__glObjects to visit
+
+  // per-frame draw order
+  DrawList _drawList;
+  DrawList _drawScratch;
+
+  // instanced draws: per-instance attributes, streamed through one buffer
+  struct InstanceAttributes {
+    float matrix[ 16 ];
+    unsigned char color[ 4 ];
+  };
+  std::vector<InstanceAttributes> _instanceArray;
+  std::vector<std::uint64_t> _instanceRuns;
+  std::vector<int> _instanceBatches;
+  Buffer _instanceBuffer;
 
   // camera matrices cache
   Matrix4 _projScreenMatrix;
@@ -453,6 +567,7 @@ private:
   bool _glExtensionTextureFloat;
   bool _glExtensionStandardDerivatives;
   bool _glExtensionTextureFilterAnisotropic;
+  bool _glExtensionElementIndexUint;
 
   // GPU capabilities
 
@@ -465,6 +580,7 @@ private:
 
   bool _supportsVertexTextures;
   bool _supportsBoneTextures;
+  bool _supportsInstancing;
 
   /*
   // default plugins (order is important)
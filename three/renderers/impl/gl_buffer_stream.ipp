@@ -0,0 +1,109 @@
+#ifndef THREE_GL_BUFFER_STREAM_IPP
+#define THREE_GL_BUFFER_STREAM_IPP
+
+#include <three/renderers/gl_buffer_stream.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace three {
+
+namespace detail {
+
+// memcmp a block at a time, then find the byte within the block
+
+enum { DiffBlock = 256 };
+
+inline size_t firstDifference( const unsigned char* a, const unsigned char* b, size_t size ) {
+  size_t i = 0;
+  while ( i + DiffBlock <= size && std::memcmp( a + i, b + i, DiffBlock ) == 0 )
+    i += DiffBlock;
+  while ( i < size && a[ i ] == b[ i ] )
+    ++i;
+  return i;
+}
+
+// One past the last differing byte; only called when there is one
+inline size_t lastDifference( const unsigned char* a, const unsigned char* b, size_t size ) {
+  size_t i = size;
+  while ( i >= DiffBlock && std::memcmp( a + i - DiffBlock, b + i - DiffBlock, DiffBlock ) == 0 )
+    i -= DiffBlock;
+  while ( a[ i - 1 ] == b[ i - 1 ] )
+    --i;
+  return i;
+}
+
+} // namespace detail
+
+GLBufferStream::GLBufferStream()
+  : mFootprint( 0 ) { }
+
+size_t GLBufferStream::upload( GLenum target, Buffer buffer, const void* data, size_t size, GLenum usage ) {
+
+  const auto bytes = static_cast<const unsigned char*>( data );
+
+  auto& stream = mStreams[ buffer ];
+
+  if ( stream.size == 0 || stream.size != size || stream.contents.size() != size ) {
+
+    // Respecifying the store orphans the old one
+    glBindBuffer( target, buffer );
+    glBufferData( target, size, data, usage );
+
+    // Start keeping a copy once the buffer is uploaded a second time
+    if ( stream.size != 0 ) {
+      mFootprint -= stream.contents.size();
+      stream.contents.assign( bytes, bytes + size );
+      mFootprint += size;
+    }
+    stream.size = size;
+
+    return size;
+
+  }
+
+  auto& contents = stream.contents;
+
+  const auto first = detail::firstDifference( contents.data(), bytes, size );
+
+  if ( first == size ) {
+    return 0;
+  }
+
+  const auto last = detail::lastDifference( contents.data(), bytes, size );
+
+  // Round out to whole 32 bit words
+  const size_t begin = first & ~size_t( 3 );
+  const size_t end   = std::min( size, ( last + 3 ) & ~size_t( 3 ) );
+
+  std::copy( bytes + begin, bytes + end, contents.begin() + begin );
+
+  glBindBuffer( target, buffer );
+
+  if ( end - begin > size / 2 ) {
+    glBufferData( target, size, data, usage );
+    return size;
+  }
+
+  glBufferSubData( target, begin, end - begin, bytes + begin );
+
+  return end - begin;
+
+}
+
+void GLBufferStream::release( Buffer buffer ) {
+  auto stream = mStreams.find( buffer );
+  if ( stream != mStreams.end() ) {
+    mFootprint -= stream->second.contents.size();
+    mStreams.erase( stream );
+  }
+}
+
+void GLBufferStream::clear() {
+  mStreams.clear();
+  mFootprint = 0;
+}
+
+} // namespace three
+
+#endif // THREE_GL_BUFFER_STREAM_IPP
@@ -0,0 +1,112 @@
+#ifndef THREE_GL_PROGRAM_CACHE_IPP
+#define THREE_GL_PROGRAM_CACHE_IPP
+
+#include <three/renderers/gl_program_cache.hpp>
+
+namespace three {
+
+GLProgramCache::GLProgramCache()
+  : mSlots( 64 ), mSize( 0 ), mDeleted( 0 ) { }
+
+size_t GLProgramCache::find( const Fingerprint& key ) const {
+
+  const auto mask = mSlots.size() - 1;
+
+  for ( auto i = key.lo & mask; ; i = ( i + 1 ) & mask ) {
+    const auto& slot = mSlots[ i ];
+    if ( slot.program ) {
+      if ( slot.program->key == key )
+        return i;
+    } else if ( !slot.deleted ) {
+      return mSlots.size();
+    }
+  }
+
+}
+
+Program::Ptr GLProgramCache::acquire( const Fingerprint& key ) {
+
+  const auto i = find( key );
+
+  if ( i == mSlots.size() )
+    return Program::Ptr();
+
+  ++mSlots[ i ].usedTimes;
+  return mSlots[ i ].program;
+
+}
+
+void GLProgramCache::insert( const Program::Ptr& program ) {
+
+  if ( ( mSize + mDeleted + 1 ) * 2 > mSlots.size() ) {
+    rehash( mSize * 4 > mSlots.size() ? mSlots.size() * 2 : mSlots.size() );
+  }
+
+  const auto mask = mSlots.size() - 1;
+
+  auto i = program->key.lo & mask;
+  while ( mSlots[ i ].program )
+    i = ( i + 1 ) & mask;
+
+  auto& slot = mSlots[ i ];
+  if ( slot.deleted ) {
+    slot.deleted = false;
+    --mDeleted;
+  }
+
+  slot.program = program;
+  slot.usedTimes = 1;
+  ++mSize;
+
+}
+
+bool GLProgramCache::release( const Program& program ) {
+
+  const auto i = find( program.key );
+
+  if ( i == mSlots.size() || mSlots[ i ].program.get() != &program )
+    return false;
+
+  auto& slot = mSlots[ i ];
+
+  if ( --slot.usedTimes > 0 )
+    return false;
+
+  slot.program.reset();
+  slot.deleted = true;
+  --mSize;
+  ++mDeleted;
+
+  return true;
+
+}
+
+void GLProgramCache::clear() {
+  mSlots.assign( mSlots.size(), Slot() );
+  mSize = mDeleted = 0;
+}
+
+void GLProgramCache::rehash( size_t capacity ) {
+
+  std::vector<Slot> slots( capacity );
+  slots.swap( mSlots );
+
+  mSize = mDeleted = 0;
+
+  const auto mask = mSlots.size() - 1;
+
+  for ( auto& slot : slots ) {
+    if ( !slot.program )
+      continue;
+    auto i = slot.program->key.lo & mask;
+    while ( mSlots[ i ].program )
+      i = ( i + 1 ) & mask;
+    mSlots[ i ] = std::move( slot );
+    ++mSize;
+  }
+
+}
+
+} // namespace three
+
+#endif // THREE_GL_PROGRAM_CACHE_IPP
@@ -0,0 +1,618 @@
+#ifndef THREE_GL_RECORDER_IPP
+#define THREE_GL_RECORDER_IPP
+
+#include <three/renderers/gl_recorder.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace three {
+
+namespace detail {
+
+// Just enough of the GLSL preprocessor for the renderer's shaders:
+// #define, #ifdef, #ifndef, #if/#elif with defined(), !, &&, ||,
+// comparisons and integers. Collects the identifiers of active lines,
+// with object-like macros replaced by their bodies.
+class ShaderScanner {
+public:
+
+  explicit ShaderScanner( std::unordered_set<std::string>& identifiers )
+    : identifiers( identifiers ), position( 0 ) { }
+
+  void scan( const std::string& source ) {
+
+    std::istringstream lines( source );
+    std::string line;
+
+    while ( std::getline( lines, line ) ) {
+
+      tokenize( line );
+
+      if ( tokens.empty() )
+        continue;
+
+      if ( tokens[ 0 ] != "#" ) {
+        if ( active() ) {
+          for ( const auto& token : tokens )
+            expand( token );
+        }
+        continue;
+      }
+
+      const auto directive = tokens.size() > 1 ? tokens[ 1 ] : std::string();
+      position = 2;
+
+      if ( directive == "ifdef" || directive == "ifndef" ) {
+        const auto defined = tokens.size() > 2 && macros.count( tokens[ 2 ] ) > 0;
+        push( defined == ( directive == "ifdef" ) );
+      } else if ( directive == "if" ) {
+        push( active() && evaluateOr() != 0 );
+      } else if ( directive == "elif" ) {
+        if ( !stack.empty() ) {
+          auto& top = stack.back();
+          top.active = !top.taken && parentActive() && evaluateOr() != 0;
+          top.taken |= top.active;
+        }
+      } else if ( directive == "else" ) {
+        if ( !stack.empty() ) {
+          auto& top = stack.back();
+          top.active = !top.taken && parentActive();
+          top.taken = true;
+        }
+      } else if ( directive == "endif" ) {
+        if ( !stack.empty() )
+          stack.pop_back();
+      } else if ( directive == "define" && active() && tokens.size() > 2 ) {
+        auto& macro = macros[ tokens[ 2 ] ];
+        macro.value = tokens.size() > 3 ? std::atoi( tokens[ 3 ].c_str() ) : 1;
+        macro.body.assign( tokens.begin() + 3, tokens.end() );
+        macro.expanding = false;
+      }
+
+    }
+
+  }
+
+private:
+
+  struct Block {
+    bool active, taken;
+  };
+
+  struct Macro {
+    int value;
+    std::vector<std::string> body;
+    bool expanding;
+  };
+
+  bool active() const { return stack.empty() || stack.back().active; }
+
+  bool parentActive() const {
+    return stack.size() < 2 || stack[ stack.size() - 2 ].active;
+  }
+
+  void push( bool condition ) {
+    Block block = { active() && condition, active() && condition };
+    stack.push_back( block );
+  }
+
+  // A macro is not expanded again inside its own body
+  void expand( const std::string& token ) {
+    auto macro = macros.find( token );
+    if ( macro == macros.end() || macro->second.expanding ) {
+      identifiers.insert( token );
+      return;
+    }
+    macro->second.expanding = true;
+    for ( const auto& t : macro->second.body )
+      expand( t );
+    macro->second.expanding = false;
+  }
+
+  // Identifiers, numbers, and one- or two-character punctuation
+  void tokenize( const std::string& line ) {
+
+    tokens.clear();
+
+    for ( size_t i = 0; i < line.size(); ) {
+
+      const char c = line[ i ];
+
+      if ( c == '/' && i + 1 < line.size() && line[ i + 1 ] == '/' )
+        break;
+
+      if ( std::isspace( (unsigned char)c ) ) {
+        ++i;
+      } else if ( std::isalnum( (unsigned char)c ) || c == '_' ) {
+        auto j = i;
+        while ( j < line.size() && ( std::isalnum( (unsigned char)line[ j ] ) || line[ j ] == '_' ) )
+          ++j;
+        tokens.push_back( line.substr( i, j - i ) );
+        i = j;
+      } else {
+        const auto pair = line.substr( i, 2 );
+        const auto two = pair == "&&" || pair == "||" || pair == "==" ||
+                         pair == "!=" || pair == "<=" || pair == ">=";
+        tokens.push_back( line.substr( i, two ? 2 : 1 ) );
+        i += two ? 2 : 1;
+      }
+
+    }
+
+  }
+
+  bool accept( const char* token ) {
+    if ( position < tokens.size() && tokens[ position ] == token ) {
+      ++position;
+      return true;
+    }
+    return false;
+  }
+
+  int evaluateOr() {
+    auto value = evaluateAnd();
+    while ( accept( "||" ) ) {
+      const auto rhs = evaluateAnd();
+      value = value || rhs;
+    }
+    return value;
+  }
+
+  int evaluateAnd() {
+    auto value = evaluateComparison();
+    while ( accept( "&&" ) ) {
+      const auto rhs = evaluateComparison();
+      value = value && rhs;
+    }
+    return value;
+  }
+
+  int evaluateComparison() {
+    const auto lhs = evaluatePrimary();
+    if ( accept( ">" ) )  return lhs >  evaluatePrimary();
+    if ( accept( "<" ) )  return lhs <  evaluatePrimary();
+    if ( accept( ">=" ) ) return lhs >= evaluatePrimary();
+    if ( accept( "<=" ) ) return lhs <= evaluatePrimary();
+    if ( accept( "==" ) ) return lhs == evaluatePrimary();
+    if ( accept( "!=" ) ) return lhs != evaluatePrimary();
+    return lhs;
+  }
+
+  int evaluatePrimary() {
+
+    if ( accept( "!" ) )
+      return !evaluatePrimary();
+
+    if ( accept( "(" ) ) {
+      const auto value = evaluateOr();
+      accept( ")" );
+      return value;
+    }
+
+    if ( position >= tokens.size() )
+      return 0;
+
+    const auto& token = tokens[ position++ ];
+
+    if ( token == "defined" ) {
+      const auto parenthesized = accept( "(" );
+      const auto defined = position < tokens.size() && macros.count( tokens[ position ] ) > 0;
+      ++position;
+      if ( parenthesized )
+        accept( ")" );
+      return defined;
+    }
+
+    if ( std::isdigit( (unsigned char)token[ 0 ] ) )
+      return std::atoi( token.c_str() );
+
+    const auto macro = macros.find( token );
+    return macro != macros.end() ? macro->second.value : 0;
+
+  }
+
+  std::unordered_set<std::string>& identifiers;
+  std::unordered_map<std::string, Macro> macros;
+  std::vector<Block> stack;
+  std::vector<std::string> tokens;
+  size_t position;
+
+};
+
+} // namespace detail
+
+struct GLRecorderBackend {
+
+  static GLRecorder& recorder() { return *GLRecorder::current(); }
+
+  static void record( GLRecorder::Command command, size_t size = 0 ) {
+    recorder().record( command, size );
+  }
+
+  // Everything not listed below: count the call, return a zero value
+#define THREE_GL_NULL( ret, name, params, args ) \
+  static ret name params { record( GLRecorder::name ); return ret(); }
+  THREE_GL_FUNCTIONS( THREE_GL_NULL )
+#undef THREE_GL_NULL
+
+  static void genNames( GLRecorder::Command command, GLsizei n, GLuint* names ) {
+    record( command );
+    for ( GLsizei i = 0; i < n; ++i )
+      names[ i ] = ++recorder().mNames;
+  }
+
+  static void genBuffers( GLsizei n, GLuint* names )       { genNames( GLRecorder::GenBuffers, n, names ); }
+  static void genFramebuffers( GLsizei n, GLuint* names )  { genNames( GLRecorder::GenFramebuffers, n, names ); }
+  static void genRenderbuffers( GLsizei n, GLuint* names ) { genNames( GLRecorder::GenRenderbuffers, n, names ); }
+  static void genTextures( GLsizei n, GLuint* names )      { genNames( GLRecorder::GenTextures, n, names ); }
+
+  // Programs: remember sources, so locations can follow the preprocessor
+
+  static GLuint createProgram() {
+    record( GLRecorder::CreateProgram );
+    const auto program = ++recorder().mNames;
+    recorder().mPrograms[ program ];
+    return program;
+  }
+
+  static GLuint createShader( GLenum ) {
+    record( GLRecorder::CreateShader );
+    const auto shader = ++recorder().mNames;
+    recorder().mShaders[ shader ];
+    return shader;
+  }
+
+  static void deleteProgram( GLuint program ) {
+    record( GLRecorder::DeleteProgram );
+    recorder().mPrograms.erase( program );
+  }
+
+  static void deleteShader( GLuint shader ) {
+    record( GLRecorder::DeleteShader );
+    recorder().mShaders.erase( shader );
+  }
+
+  static void attachShader( GLuint program, GLuint shader ) {
+    record( GLRecorder::AttachShader );
+    recorder().mPrograms[ program ].shaders.push_back( shader );
+  }
+
+  static void linkProgram( GLuint program ) {
+    record( GLRecorder::LinkProgram );
+    auto& state = recorder().mPrograms[ program ];
+    state.identifiers.clear();
+    for ( auto shader : state.shaders ) {
+      detail::ShaderScanner( state.identifiers ).scan( recorder().mShaders[ shader ] );
+    }
+  }
+
+  static GLint location( GLuint program, const GLchar* name, bool attribute ) {
+    auto& state = recorder().mPrograms[ program ];
+    if ( !state.identifiers.count( name ) )
+      return -1;
+    return attribute ? state.attributes++ : state.uniforms++;
+  }
+
+  static GLint getAttribLocation( GLuint program, const GLchar* name ) {
+    record( GLRecorder::GetAttribLocation );
+    return location( program, name, true );
+  }
+
+  static GLint getUniformLocation( GLuint program, const GLchar* name ) {
+    record( GLRecorder::GetUniformLocation );
+    return location( program, name, false );
+  }
+
+  static GLenum getError() {
+    record( GLRecorder::GetError );
+    return GL_NO_ERROR;
+  }
+
+  static void getIntegerv( GLenum pname, GLint* params ) {
+    record( GLRecorder::GetIntegerv );
+    switch ( pname ) {
+      case GL_MAX_TEXTURE_IMAGE_UNITS:
+      case GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS: *params = 16;   break;
+      case GL_MAX_TEXTURE_SIZE:
+      case GL_MAX_CUBE_MAP_TEXTURE_SIZE:      *params = 8192; break;
+      case GL_MAJOR_VERSION:                  *params = 3;    break;
+      case GL_MINOR_VERSION:                  *params = 3;    break;
+      default:                                *params = 0;
+    }
+  }
+
+  static void getFloatv( GLenum, GLfloat* params ) {
+    record( GLRecorder::GetFloatv );
+    *params = 0;
+  }
+
+  static void getTexParameterfv( GLenum, GLenum, GLfloat* params ) {
+    record( GLRecorder::GetTexParameterfv );
+    *params = 0;
+  }
+
+  static void getTexParameteriv( GLenum, GLenum, GLint* params ) {
+    record( GLRecorder::GetTexParameteriv );
+    *params = 0;
+  }
+
+  // Compile and link always succeed, with empty logs
+  static GLint status( GLenum pname ) {
+    return pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS ? GL_TRUE : 0;
+  }
+
+  static void getProgramiv( GLuint, GLenum pname, GLint* param ) {
+    record( GLRecorder::GetProgramiv );
+    *param = status( pname );
+  }
+
+  static void getShaderiv( GLuint, GLenum pname, GLint* param ) {
+    record( GLRecorder::GetShaderiv );
+    *param = status( pname );
+  }
+
+  static void infoLog( GLsizei bufSize, GLsizei* length, GLchar* infoLog ) {
+    if ( length ) *length = 0;
+    if ( bufSize > 0 ) infoLog[ 0 ] = 0;
+  }
+
+  static void getProgramInfoLog( GLuint, GLsizei bufSize, GLsizei* length, GLchar* log ) {
+    record( GLRecorder::GetProgramInfoLog );
+    infoLog( bufSize, length, log );
+  }
+
+  static void getShaderInfoLog( GLuint, GLsizei bufSize, GLsizei* length, GLchar* log ) {
+    record( GLRecorder::GetShaderInfoLog );
+    infoLog( bufSize, length, log );
+  }
+
+  // Uploads: count the bytes handed over
+
+  static void bufferData( GLenum, GLsizeiptr size, const GLvoid*, GLenum ) {
+    record( GLRecorder::BufferData, size );
+  }
+
+  static void bufferSubData( GLenum, GLintptr, GLsizeiptr size, const GLvoid* ) {
+    record( GLRecorder::BufferSubData, size );
+  }
+
+  static size_t pixelSize( GLenum format, GLenum type ) {
+    switch ( type ) {
+      case GL_UNSIGNED_SHORT_4_4_4_4:
+      case GL_UNSIGNED_SHORT_5_5_5_1:
+      case GL_UNSIGNED_SHORT_5_6_5: return 2;
+      default: break;
+    }
+    size_t components = 4;
+    switch ( format ) {
+      case GL_RGB:             components = 3; break;
+      case GL_LUMINANCE_ALPHA: components = 2; break;
+      case GL_ALPHA:
+      case GL_LUMINANCE:
+      case GL_DEPTH_COMPONENT: components = 1; break;
+      default: break;
+    }
+    switch ( type ) {
+      case GL_SHORT:
+      case GL_UNSIGNED_SHORT: return components * 2;
+      case GL_INT:
+      case GL_UNSIGNED_INT:
+      case GL_FLOAT:          return components * 4;
+      default:                return components;
+    }
+  }
+
+  static void texImage2D( GLenum, GLint, GLint, GLsizei width, GLsizei height, GLint,
+                          GLenum format, GLenum type, const GLvoid* pixels ) {
+    record( GLRecorder::TexImage2D, pixels ? width * height * pixelSize( format, type ) : 0 );
+  }
+
+  static void shaderSource( GLuint shader, GLsizei count, const GLchar** strings, const GLint* lengths ) {
+    auto& source = recorder().mShaders[ shader ];
+    source.clear();
+    for ( GLsizei i = 0; i < count; ++i ) {
+      if ( lengths && lengths[ i ] >= 0 )
+        source.append( strings[ i ], lengths[ i ] );
+      else
+        source.append( strings[ i ] );
+    }
+    record( GLRecorder::ShaderSource, source.size() );
+  }
+
+#define THREE_GL_UNIFORMS( U ) \
+  U( Uniform1f,        ( GLint, GLfloat ),                                  sizeof( GLfloat ) ) \
+  U( Uniform2f,        ( GLint, GLfloat, GLfloat ),                         2 * sizeof( GLfloat ) ) \
+  U( Uniform3f,        ( GLint, GLfloat, GLfloat, GLfloat ),                3 * sizeof( GLfloat ) ) \
+  U( Uniform4f,        ( GLint, GLfloat, GLfloat, GLfloat, GLfloat ),       4 * sizeof( GLfloat ) ) \
+  U( Uniform1i,        ( GLint, GLint ),                                    sizeof( GLint ) ) \
+  U( Uniform1fv,       ( GLint, GLsizei count, const GLfloat* ),            count * sizeof( GLfloat ) ) \
+  U( Uniform2fv,       ( GLint, GLsizei count, const GLfloat* ),            count * 2 * sizeof( GLfloat ) ) \
+  U( Uniform3fv,       ( GLint, GLsizei count, const GLfloat* ),            count * 3 * sizeof( GLfloat ) ) \
+  U( Uniform4fv,       ( GLint, GLsizei count, const GLfloat* ),            count * 4 * sizeof( GLfloat ) ) \
+  U( Uniform1iv,       ( GLint, GLsizei count, const GLint* ),              count * sizeof( GLint ) ) \
+  U( Uniform3iv,       ( GLint, GLsizei count, const GLint* ),              count * 3 * sizeof( GLint ) ) \
+  U( UniformMatrix3fv, ( GLint, GLsizei count, GLboolean, const GLfloat* ), count * 9 * sizeof( GLfloat ) ) \
+  U( UniformMatrix4fv, ( GLint, GLsizei count, GLboolean, const GLfloat* ), count * 16 * sizeof( GLfloat ) )
+
+#define THREE_GL_UNIFORM( name, params, size ) \
+  static void upload##name params { record( GLRecorder::name, size ); }
+  THREE_GL_UNIFORMS( THREE_GL_UNIFORM )
+#undef THREE_GL_UNIFORM
+
+  // Draws: count the vertices or indices
+
+  static void drawArrays( GLenum, GLint, GLsizei count ) {
+    record( GLRecorder::DrawArrays, count );
+  }
+
+  static void drawElements( GLenum, GLsizei count, GLenum, const GLvoid* ) {
+    record( GLRecorder::DrawElements, count );
+  }
+
+  static void drawElementsInstanced( GLenum, GLsizei count, GLenum, const GLvoid*, GLsizei primcount ) {
+    record( GLRecorder::DrawElementsInstanced, count * primcount );
+  }
+
+  static GLDispatch dispatch() {
+
+#define THREE_GL_ENTRY( ret, name, params, args ) &GLRecorderBackend::name,
+    GLDispatch dispatch = { THREE_GL_FUNCTIONS( THREE_GL_ENTRY ) };
+#undef THREE_GL_ENTRY
+
+    dispatch.GenBuffers          = &genBuffers;
+    dispatch.GenFramebuffers     = &genFramebuffers;
+    dispatch.GenRenderbuffers    = &genRenderbuffers;
+    dispatch.GenTextures         = &genTextures;
+    dispatch.CreateProgram       = &createProgram;
+    dispatch.CreateShader        = &createShader;
+    dispatch.DeleteProgram       = &deleteProgram;
+    dispatch.DeleteShader        = &deleteShader;
+    dispatch.AttachShader        = &attachShader;
+    dispatch.LinkProgram         = &linkProgram;
+    dispatch.GetAttribLocation   = &getAttribLocation;
+    dispatch.GetUniformLocation  = &getUniformLocation;
+    dispatch.GetError            = &getError;
+    dispatch.GetIntegerv         = &getIntegerv;
+    dispatch.GetFloatv           = &getFloatv;
+    dispatch.GetTexParameterfv   = &getTexParameterfv;
+    dispatch.GetTexParameteriv   = &getTexParameteriv;
+    dispatch.GetProgramiv        = &getProgramiv;
+    dispatch.GetShaderiv         = &getShaderiv;
+    dispatch.GetProgramInfoLog   = &getProgramInfoLog;
+    dispatch.GetShaderInfoLog    = &getShaderInfoLog;
+    dispatch.BufferData          = &bufferData;
+    dispatch.BufferSubData       = &bufferSubData;
+    dispatch.TexImage2D          = &texImage2D;
+    dispatch.ShaderSource        = &shaderSource;
+    dispatch.DrawArrays          = &drawArrays;
+    dispatch.DrawElements        = &drawElements;
+    dispatch.DrawElementsInstanced = &drawElementsInstanced;
+
+#define THREE_GL_UNIFORM( name, params, size ) dispatch.name = &upload##name;
+    THREE_GL_UNIFORMS( THREE_GL_UNIFORM )
+#undef THREE_GL_UNIFORM
+
+    return dispatch;
+
+  }
+
+#undef THREE_GL_UNIFORMS
+
+};
+
+/////////////////////////////////////////////////////////////////////////
+
+GLRecorder::GLRecorder()
+  : recording( false ),
+    mDispatch( GLRecorderBackend::dispatch() ),
+    mNames( 0 ) { }
+
+GLRecorder::~GLRecorder() {
+  uninstall();
+}
+
+GLRecorder*& GLRecorder::current() {
+  static GLRecorder* recorder = nullptr;
+  return recorder;
+}
+
+void GLRecorder::install() {
+  current() = this;
+  setGLDispatch( &mDispatch );
+}
+
+void GLRecorder::uninstall() {
+  if ( !installed() )
+    return;
+  current() = nullptr;
+  setGLDispatch( nullptr );
+}
+
+void GLRecorder::reset() {
+  commands.clear();
+  stats.fill( Stats() );
+}
+
+void GLRecorder::record( Command command, size_t size ) {
+  auto& entry = stats[ command ];
+  ++entry.calls;
+  entry.bytes += size;
+  if ( recording ) {
+    Entry e = { (unsigned short)command, (unsigned)size };
+    commands.push_back( e );
+  }
+}
+
+size_t GLRecorder::calls() const {
+  size_t calls = 0;
+  for ( const auto& entry : stats )
+    calls += entry.calls;
+  return calls;
+}
+
+size_t GLRecorder::drawCalls() const {
+  return stats[ DrawArrays ].calls + stats[ DrawElements ].calls +
+         stats[ DrawElementsInstanced ].calls;
+}
+
+size_t GLRecorder::uploadBytes() const {
+  size_t bytes = 0;
+  for ( int i = 0; i < CommandCount; ++i ) {
+    if ( i != DrawArrays && i != DrawElements && i != DrawElementsInstanced )
+      bytes += stats[ i ].bytes;
+  }
+  return bytes;
+}
+
+size_t GLRecorder::stateChanges() const {
+  static const Command changes[] = {
+    ActiveTexture, BindBuffer, BindFramebuffer, BindRenderbuffer, BindTexture,
+    BlendEquation, BlendEquationSeparate, BlendFunc, BlendFuncSeparate,
+    CullFace, DepthFunc, DepthMask, Disable, Enable, FrontFace, LineWidth,
+    PolygonOffset, UseProgram
+  };
+  size_t count = 0;
+  for ( auto command : changes )
+    count += stats[ command ].calls;
+  return count;
+}
+
+std::string GLRecorder::report() const {
+
+  std::vector<int> order;
+  for ( int i = 0; i < CommandCount; ++i ) {
+    if ( stats[ i ].calls > 0 )
+      order.push_back( i );
+  }
+
+  std::stable_sort( order.begin(), order.end(), [this]( int a, int b ) {
+    return stats[ a ].calls > stats[ b ].calls;
+  } );
+
+  std::ostringstream ss;
+  for ( auto i : order ) {
+    ss << std::left << std::setw( 28 ) << name( (Command)i )
+       << std::right << std::setw( 10 ) << stats[ i ].calls
+       << std::setw( 14 ) << stats[ i ].bytes << "\n";
+  }
+  return ss.str();
+
+}
+
+const char* GLRecorder::name( Command command ) {
+  static const char* names[] = {
+#define THREE_GL_NAME( ret, name, params, args ) "gl" #name,
+    THREE_GL_FUNCTIONS( THREE_GL_NAME )
+#undef THREE_GL_NAME
+  };
+  return command < CommandCount ? names[ command ] : "";
+}
+
+} // namespace three
+
+#endif // THREE_GL_RECORDER_IPP
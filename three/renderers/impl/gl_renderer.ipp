@@ -9,18 +9,22 @@
 
 #include <three/cameras/camera.hpp>
 
+#include <three/core/bvh.hpp>
 #include <three/core/frustum.hpp>
 #include <three/core/interfaces.hpp>
 #include <three/core/buffer_geometry.hpp>
 #include <three/core/geometry.hpp>
 #include <three/core/geometry_group.hpp>
+#include <three/core/transform_kernels.hpp>
 
 #include <three/lights/spot_light.hpp>
 #include <three/lights/hemisphere_light.hpp>
 
 #include <three/materials/program.hpp>
 
+#include <three/objects/instanced_mesh.hpp>
 #include <three/objects/line.hpp>
+#include <three/objects/skinned_mesh.hpp>
 
 #include <three/renderers/gl_render_target.hpp>
 #include <three/renderers/gl_shaders.hpp>
@@ -35,8 +39,15 @@
 
 #include <three/utils/hash.hpp>
 #include <three/utils/conversion.hpp>
+#include <three/utils/radix_sort.hpp>
 #include <three/utils/template.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
 namespace three {
 
 struct ProgramParameters {
@@ -68,6 +79,8 @@ struct ProgramParameters {
   bool perPixel;
   bool wrapAround;
   bool doubleSided;
+
+  bool instancing;
 };
 
 GLRenderer::Ptr GLRenderer::create( const RendererParameters& parameters /*= Parameters()*/ ) {
@@ -96,6 +109,12 @@ GLRenderer::GLRenderer( const RendererParameters& parameters )
     shadowMapCascade( false ),
     maxMorphTargets( 8 ),
     maxMorphNormals( 4 ),
+    blendExcessMorphTargets( true ),
+    weldStaticBuffers( true ),
+    interleaveStaticBuffers( false ),
+    packStaticBuffers( false ),
+    instanceMeshes( true ),
+    sortParticlesByIndex( true ),
     autoScaleCubemaps( true ),
     _width( parameters.width ),
     _height( parameters.height ),
@@ -109,6 +128,7 @@ GLRenderer::GLRenderer( const RendererParameters& parameters )
     _clearColor( parameters.clearColor ),
     _clearAlpha( parameters.clearAlpha ),
     _maxLights( parameters.maxLights ),
+    _skinningPool( 0 ),
     _programs_counter( 0 ),
     _currentProgram( 0 ),
     _currentFramebuffer( 0 ),
@@ -135,6 +155,7 @@ GLRenderer::GLRenderer( const RendererParameters& parameters )
     _viewportHeight( 0 ),
     _currentWidth( 0 ),
     _currentHeight( 0 ),
+    _instanceBuffer( 0 ),
     _lightsNeedUpdate( true ) {
   console().log() << "THREE::GLRenderer created";
 }
@@ -169,6 +190,19 @@ void GLRenderer::initialize() {
   _supportsVertexTextures = ( _maxVertexTextures > 0 );
   _supportsBoneTextures = _supportsVertexTextures && _glExtensionTextureFloat;
 
+  // glDrawElementsInstanced and glVertexAttribDivisor are core in 3.3
+#if defined(THREE_GLES)
+  _supportsInstancing = false;
+#else
+  const auto majorVersion = glGetParameteri( GL_MAJOR_VERSION );
+  const auto minorVersion = glGetParameteri( GL_MINOR_VERSION );
+  _supportsInstancing = majorVersion > 3 || ( majorVersion == 3 && minorVersion >= 3 );
+#endif
+
+  if ( ! _supportsInstancing ) {
+    console().log( "THREE::GLRenderer: Instanced drawing not supported." );
+  }
+
   console().log() << "THREE::GLRenderer initialized";
 
 }
@@ -189,9 +223,14 @@ void GLRenderer::initGL() {
       console().error( "Error loading OpenGL functions" );
   }*/
 
-  _glExtensionTextureFloat = glewIsExtensionSupported( "ARB_texture_float" ) != 0 ? true : false;
+  _glExtensionTextureFloat = glewIsExtensionSupported( "GL_ARB_texture_float" ) != 0 ? true : false;
   _glExtensionStandardDerivatives = glewIsExtensionSupported( "OES_standard_derivatives" ) != 0 ? true : false;
   _glExtensionTextureFilterAnisotropic = glewIsExtensionSupported( "EXT_texture_filter_anisotropic" ) != 0 ? true : false;
+#if defined(THREE_GLES)
+  _glExtensionElementIndexUint = glewIsExtensionSupported( "OES_element_index_uint" ) != 0 ? true : false;
+#else
+  _glExtensionElementIndexUint = true; // core in desktop GL
+#endif
 
   if ( ! _glExtensionTextureFloat ) {
     console().log( "THREE::GLRenderer: Float textures not supported." );
@@ -310,6 +349,8 @@ void GLRenderer::deallocateObject( Object3D& object ) {
 
   if ( ! object.glData.__glInit ) return;
 
+  deleteMorphStates( object );
+
   object.glData.clear();
 
   if ( !object.geometry ) {
@@ -319,7 +360,9 @@ void GLRenderer::deallocateObject( Object3D& object ) {
 
   auto& geometry = *object.geometry;
 
-  if ( object.type() == THREE::Mesh ) {
+  if ( geometry.type() == THREE::BufferGeometry ) {
+    deleteDirectBuffers( geometry );
+  } else if ( object.type() == THREE::Mesh ) {
     for ( auto& geometryGroup : geometry.geometryGroups ) {
       deleteMeshBuffers( *geometryGroup.second );
     }
@@ -368,31 +411,26 @@ void GLRenderer::deallocateRenderTarget( GLRenderTarget& renderTarget ) {
 
 void GLRenderer::deallocateMaterial( Material& material ) {
 
-  auto program = material.program;
-
-  if ( ! program ) return;
+  // the instanced variant is rebuilt on demand
 
-  // only deallocate GL program if this was the last use of shared program
-  // assumed there is only single copy of any program in the _programs list
-  // (that's how it's constructed)
+  for ( auto program : { material.program, material.instancedProgram } ) {
 
-  auto programCmp = [&]( const ProgramInfo& programInfo ) {
-    return programInfo.program == program;
-  };
+    if ( ! program ) continue;
 
-  auto programIt = std::find_if( _programs.begin(), _programs.end(), programCmp );
+    // only deallocate GL program if this was the last use of shared program
 
-  if ( programIt == _programs.end() )
-    return;
+    if ( _programs.release( *program ) ) {
 
-  if ( --programIt->usedTimes == 0 ) {
+      glDeleteProgram( program->program );
+      _info.memory.programs = ( int )_programs.size();
 
-    glDeleteProgram( program->program );
-    _info.memory.programs --;
-    _programs.erase( std::remove_if(_programs.begin(), _programs.end(), programCmp) );
+    }
 
   }
 
+  material.instancedProgram.reset();
+  material.instancedUniformsList.clear();
+
 }
 
 // Rendering
@@ -422,6 +460,7 @@ void GLRenderer::createParticleBuffers( Geometry& geometry ) {
 
   geometry.__glVertexBuffer = glCreateBuffer();
   geometry.__glColorBuffer = glCreateBuffer();
+  geometry.__glFaceBuffer = glCreateBuffer();
 
   _info.memory.geometries ++;
 
@@ -454,8 +493,6 @@ void GLRenderer::createMeshBuffers( GeometryGroup& geometryGroup ) {
   geometryGroup.__glUVBuffer      = glCreateBuffer();
   geometryGroup.__glUV2Buffer     = glCreateBuffer();
 
-  geometryGroup.__glSkinVertexABuffer = glCreateBuffer();
-  geometryGroup.__glSkinVertexBBuffer = glCreateBuffer();
   geometryGroup.__glSkinIndicesBuffer = glCreateBuffer();
   geometryGroup.__glSkinWeightsBuffer = glCreateBuffer();
 
@@ -490,17 +527,26 @@ void GLRenderer::createMeshBuffers( GeometryGroup& geometryGroup ) {
 
 void GLRenderer::deleteParticleBuffers( Geometry& geometry ) {
 
-  glDeleteBuffer( geometry.__glVertexBuffer );
-  glDeleteBuffer( geometry.__glColorBuffer );
+  deleteBuffer( geometry.__glVertexBuffer );
+  deleteBuffer( geometry.__glColorBuffer );
+  deleteBuffer( geometry.__glFaceBuffer );
 
   _info.memory.geometries --;
 
 }
 
+void GLRenderer::deleteDirectBuffers( Geometry& geometry ) {
+
+  for ( auto& attribute : geometry.attributes ) {
+    deleteBuffer( attribute.second.buffer );
+  }
+
+}
+
 void GLRenderer::deleteLineBuffers( Geometry& geometry ) {
 
-  glDeleteBuffer( geometry.__glVertexBuffer );
-  glDeleteBuffer( geometry.__glColorBuffer );
+  deleteBuffer( geometry.__glVertexBuffer );
+  deleteBuffer( geometry.__glColorBuffer );
 
   _info.memory.geometries --;
 
@@ -508,8 +554,8 @@ void GLRenderer::deleteLineBuffers( Geometry& geometry ) {
 
 void GLRenderer::deleteRibbonBuffers( Geometry& geometry ) {
 
-  glDeleteBuffer( geometry.__glVertexBuffer );
-  glDeleteBuffer( geometry.__glColorBuffer );
+  deleteBuffer( geometry.__glVertexBuffer );
+  deleteBuffer( geometry.__glColorBuffer );
 
   _info.memory.geometries --;
 
@@ -517,35 +563,33 @@ void GLRenderer::deleteRibbonBuffers( Geometry& geometry ) {
 
 void GLRenderer::deleteMeshBuffers( GeometryGroup& geometryGroup ) {
 
-  glDeleteBuffer( geometryGroup.__glVertexBuffer );
-  glDeleteBuffer( geometryGroup.__glNormalBuffer );
-  glDeleteBuffer( geometryGroup.__glTangentBuffer );
-  glDeleteBuffer( geometryGroup.__glColorBuffer );
-  glDeleteBuffer( geometryGroup.__glUVBuffer );
-  glDeleteBuffer( geometryGroup.__glUV2Buffer );
+  deleteBuffer( geometryGroup.__glVertexBuffer );
+  deleteBuffer( geometryGroup.__glNormalBuffer );
+  deleteBuffer( geometryGroup.__glTangentBuffer );
+  deleteBuffer( geometryGroup.__glColorBuffer );
+  deleteBuffer( geometryGroup.__glUVBuffer );
+  deleteBuffer( geometryGroup.__glUV2Buffer );
 
-  glDeleteBuffer( geometryGroup.__glSkinVertexABuffer );
-  glDeleteBuffer( geometryGroup.__glSkinVertexBBuffer );
-  glDeleteBuffer( geometryGroup.__glSkinIndicesBuffer );
-  glDeleteBuffer( geometryGroup.__glSkinWeightsBuffer );
+  deleteBuffer( geometryGroup.__glSkinIndicesBuffer );
+  deleteBuffer( geometryGroup.__glSkinWeightsBuffer );
 
-  glDeleteBuffer( geometryGroup.__glFaceBuffer );
-  glDeleteBuffer( geometryGroup.__glLineBuffer );
+  deleteBuffer( geometryGroup.__glFaceBuffer );
+  deleteBuffer( geometryGroup.__glLineBuffer );
 
   if ( geometryGroup.numMorphTargets > 0 ) {
     for ( int m = 0, ml = geometryGroup.numMorphTargets; m < ml; m ++ ) {
-      glDeleteBuffer( geometryGroup.__glMorphTargetsBuffers[ m ] );
+      deleteBuffer( geometryGroup.__glMorphTargetsBuffers[ m ] );
     }
   }
 
   if ( geometryGroup.numMorphNormals > 0 ) {
     for ( int m = 0, ml = geometryGroup.numMorphNormals; m < ml; m ++ ) {
-      glDeleteBuffer( geometryGroup.__glMorphNormalsBuffers[ m ] );
+      deleteBuffer( geometryGroup.__glMorphNormalsBuffers[ m ] );
     }
   }
 
   for ( auto& attribute : geometryGroup.__glCustomAttributesList ) {
-    glDeleteBuffer( attribute->buffer );
+    deleteBuffer( attribute->buffer );
   }
 
   _info.memory.geometries --;
@@ -553,6 +597,44 @@ void GLRenderer::deleteMeshBuffers( GeometryGroup& geometryGroup ) {
 }
 
 
+void GLRenderer::deleteBuffer( Buffer& buffer ) {
+
+  _bufferStream.release( buffer );
+  glDeleteBuffer( buffer );
+
+  _info.memory.streams = _bufferStream.footprint();
+
+}
+
+void GLRenderer::uploadBuffer( GLenum target, Buffer buffer, const void* data, size_t size, GLenum usage, bool stream ) {
+
+  if ( stream ) {
+
+    const auto bytes = _bufferStream.upload( target, buffer, data, size, usage );
+
+    _info.memory.streams = _bufferStream.footprint();
+
+    if ( bytes == 0 ) {
+      _info.upload.skipped ++;
+      return;
+    }
+
+    _info.upload.bytes += bytes;
+
+  } else {
+
+    glBindBuffer( target, buffer );
+    glBufferData( target, size, data, usage );
+
+    _info.upload.bytes += size;
+
+  }
+
+  _info.upload.buffers ++;
+
+}
+
+
 // Buffer initialization
 
 void GLRenderer::initCustomAttributes( Geometry& geometry, Object3D& object ) {
@@ -614,6 +696,8 @@ void GLRenderer::initParticleBuffers( Geometry& geometry, Object3D& object ) {
   geometry.__colorArray.resize( nvertices * 3 );
 
   geometry.__sortArray.clear();
+  geometry.__glSortIndices = false;
+  geometry.__glSortedAttributes = false;
 
   geometry.__glParticleCount = nvertices;
 
@@ -691,8 +775,6 @@ void GLRenderer::initMeshBuffers( GeometryGroup& geometryGroup, Mesh& object ) {
 
   if ( geometry.skinWeights.size() && geometry.skinIndices.size() ) {
 
-    geometryGroup.__skinVertexAArray.resize( nvertices * 4 );
-    geometryGroup.__skinVertexBArray.resize( nvertices * 4 );
     geometryGroup.__skinIndexArray.resize( nvertices * 4 );
     geometryGroup.__skinWeightArray.resize( nvertices * 4 );
 
@@ -843,9 +925,13 @@ void GLRenderer::initDirectBuffers( Geometry& geometry ) {
                 : GL_ARRAY_BUFFER;
 
     auto& attribute = a.second;
+
+    // shared by another object
+    if ( attribute.buffer ) continue;
+
     attribute.buffer = glCreateBuffer();
 
-    glBindAndBuffer( type, attribute.buffer, attribute.array, GL_STATIC_DRAW );
+    uploadBuffer( type, attribute.buffer, attribute.array, GL_STATIC_DRAW, false );
 
   }
 
@@ -853,6 +939,16 @@ void GLRenderer::initDirectBuffers( Geometry& geometry ) {
 
 // Buffer setting
 
+// A particle attribute gathered into its upload array; attribute types are
+// plain float tuples
+template < typename T >
+static inline ParticleSorter::Stream particleStream( const std::vector<T>& src, std::vector<float>& dst ) {
+  const size_t count = std::min( src.size(), dst.size() / ( sizeof( T ) / sizeof( float ) ) );
+  ParticleSorter::Stream stream = { reinterpret_cast<const float*>( src.data() ), count,
+                                    dst.data(), ( int )( sizeof( T ) / sizeof( float ) ) };
+  return stream;
+}
+
 void GLRenderer::setParticleBuffers( Geometry& geometry, int hint, Object3D& object ) {
 
   auto& vertices = geometry.vertices;
@@ -875,54 +971,40 @@ void GLRenderer::setParticleBuffers( Geometry& geometry, int hint, Object3D& obj
   Vector3 _vector3;
   int offset = 0;
 
-  if ( object.sortParticles ) {
-
-    _projScreenMatrixPS.copy( _projScreenMatrix );
-    _projScreenMatrixPS.multiplySelf( object.matrixWorld );
-    sortArray.resize( vl );
-
-    for ( int v = 0; v < vl; v ++ ) {
-
-      const auto& vertex = vertices[ v ];
-
-      _vector3.copy( vertex );
-      _projScreenMatrixPS.multiplyVector3( _vector3 );
-
-      // push_back ?
-      sortArray[ v ] = std::make_pair( _vector3.z, v );
+  // Sorting by index leaves the attributes in particle order; it needs 32
+  // bit indices past 65536 particles
 
-    }
+  const auto sortByIndex = object.sortParticles && sortParticlesByIndex &&
+                           ( _glExtensionElementIndexUint || geometry.__glParticleCount <= 65536 );
 
-    typedef std::pair<float, int> SortPair;
+  const auto repack = object.sortParticles && !sortByIndex;
 
-    std::sort( sortArray.begin(),
-               sortArray.end(),
-               []( const SortPair & a, const SortPair & b ) {
-      return a.first > b.first;
-    } );
+  // Buffers last filled in sorted order are all stale in particle order
 
-    for ( int v = 0; v < vl; v ++ ) {
+  const auto reorder = !repack && geometry.__glSortedAttributes;
 
-      const auto& vertex = vertices[ sortArray[v].second ];
+  dirtyVertices = dirtyVertices || reorder;
+  dirtyColors = dirtyColors || reorder;
 
-      offset = v * 3;
+  if ( repack ) {
 
-      vertexArray[ offset ]     = vertex.x;
-      vertexArray[ offset + 1 ] = vertex.y;
-      vertexArray[ offset + 2 ] = vertex.z;
+    _projScreenMatrixPS.copy( _projScreenMatrix );
+    _projScreenMatrixPS.multiplySelf( object.matrixWorld );
 
+    if ( vl > 0 ) {
+      _particleSorter.sort( &vertices[ 0 ].x, sizeof( Vertex ), vl, _projScreenMatrixPS, sortArray );
     }
 
-    for ( int c = 0; c < cl; c ++ ) {
-
-      offset = c * 3;
+    // Everything drawn per particle follows the new order, in one pass
 
-      const auto& color = colors[ sortArray[c].second ];
+    _particleStreams.clear();
 
-      colorArray[ offset ]     = color.r;
-      colorArray[ offset + 1 ] = color.g;
-      colorArray[ offset + 2 ] = color.b;
+    if ( vl > 0 ) {
+      _particleStreams.push_back( particleStream<Vertex>( vertices, vertexArray ) );
+    }
 
+    if ( cl > 0 ) {
+      _particleStreams.push_back( particleStream<Color>( colors, colorArray ) );
     }
 
     for ( int i = 0, il = ( int )customAttributes.size(); i < il; i ++ ) {
@@ -931,22 +1013,29 @@ void GLRenderer::setParticleBuffers( Geometry& geometry, int hint, Object3D& obj
 
       if ( !( customAttribute.boundTo.empty() || customAttribute.boundTo == "vertices" ) ) continue;
 
+      const auto& value = customAttribute.value;
+      auto& array = customAttribute.array;
+
       if ( customAttribute.size == 1 ) {
-        fillFromAny<float>( customAttribute.value, sortArray, customAttribute.array );
+        _particleStreams.push_back( particleStream<float>( value.cast<std::vector<float>>(), array ) );
       } else if ( customAttribute.size == 2 ) {
-        fillFromAny<Vector2>( customAttribute.value, sortArray, customAttribute.array );
+        _particleStreams.push_back( particleStream<Vector2>( value.cast<std::vector<Vector2>>(), array ) );
       } else if ( customAttribute.size == 3 ) {
         if ( customAttribute.type == THREE::c ) {
-          fillFromAny<Color>( customAttribute.value, sortArray, customAttribute.array );
+          _particleStreams.push_back( particleStream<Color>( value.cast<std::vector<Color>>(), array ) );
         } else {
-          fillFromAny<Vector3>( customAttribute.value, sortArray, customAttribute.array );
+          _particleStreams.push_back( particleStream<Vector3>( value.cast<std::vector<Vector3>>(), array ) );
         }
       } else if ( customAttribute.size == 4 ) {
-        fillFromAny<Vector4>( customAttribute.value, sortArray, customAttribute.array );
+        _particleStreams.push_back( particleStream<Vector4>( value.cast<std::vector<Vector4>>(), array ) );
       }
 
     }
 
+    if ( !_particleStreams.empty() ) {
+      _particleSorter.gather( sortArray, &_particleStreams[ 0 ], _particleStreams.size() );
+    }
+
   } else {
 
     if ( dirtyVertices ) {
@@ -985,7 +1074,7 @@ void GLRenderer::setParticleBuffers( Geometry& geometry, int hint, Object3D& obj
 
       auto& customAttribute = *customAttributes[ i ];
 
-      if ( customAttribute.needsUpdate &&
+      if ( ( customAttribute.needsUpdate || reorder ) &&
            ( customAttribute.boundTo.empty() ||
              customAttribute.boundTo == "vertices" ) ) {
 
@@ -1011,22 +1100,54 @@ void GLRenderer::setParticleBuffers( Geometry& geometry, int hint, Object3D& obj
 
   }
 
-  if ( vl > 0 && ( dirtyVertices || object.sortParticles ) ) {
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometry.__glVertexBuffer, vertexArray, hint );
+  if ( vl > 0 && ( dirtyVertices || repack ) ) {
+    uploadBuffer( GL_ARRAY_BUFFER, geometry.__glVertexBuffer, vertexArray, hint, geometry.dynamic );
   }
 
-  if ( cl > 0 && ( dirtyColors || object.sortParticles ) ) {
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometry.__glColorBuffer, colorArray, hint );
+  if ( cl > 0 && ( dirtyColors || repack ) ) {
+    uploadBuffer( GL_ARRAY_BUFFER, geometry.__glColorBuffer, colorArray, hint, geometry.dynamic );
   }
 
   for ( int i = 0, il = ( int )customAttributes.size(); i < il; i ++ ) {
 
     auto& customAttribute = *customAttributes[ i ];
 
-    if ( customAttribute.needsUpdate || object.sortParticles ) {
-      glBindAndBuffer( GL_ARRAY_BUFFER, customAttribute.buffer, customAttribute.array, hint );
+    if ( customAttribute.needsUpdate || repack || reorder ) {
+      uploadBuffer( GL_ARRAY_BUFFER, customAttribute.buffer, customAttribute.array, hint, geometry.dynamic );
+    }
+
+  }
+
+  geometry.__glSortedAttributes = repack;
+  geometry.__glSortIndices = false;
+
+  if ( sortByIndex && vl > 0 && geometry.__glParticleCount > 0 ) {
+
+    // Only particles the buffers have room for
+
+    const auto particles = std::min( vl, geometry.__glParticleCount );
+
+    _projScreenMatrixPS.copy( _projScreenMatrix );
+    _projScreenMatrixPS.multiplySelf( object.matrixWorld );
+
+    _particleSorter.sort( &vertices[ 0 ].x, sizeof( Vertex ), particles, _projScreenMatrixPS, sortArray );
+
+    // The order changes every frame: no point diffing it
+
+    if ( particles <= 65536 ) {
+      _indexScratch.assign( sortArray.begin(), sortArray.end() );
+      uploadBuffer( GL_ELEMENT_ARRAY_BUFFER, geometry.__glFaceBuffer, _indexScratch, GL_STREAM_DRAW, false );
+      geometry.__glIndex32 = false;
+    } else {
+      uploadBuffer( GL_ELEMENT_ARRAY_BUFFER, geometry.__glFaceBuffer, sortArray, GL_STREAM_DRAW, false );
+      geometry.__glIndex32 = true;
     }
 
+    geometry.__glSortIndices = true;
+
+    // The element array binding is not one a cached geometry group expects
+    _currentGeometryGroupHash = -1;
+
   }
 
 }
@@ -1063,7 +1184,7 @@ void GLRenderer::setLineBuffers( Geometry& geometry, int hint ) {
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometry.__glVertexBuffer, vertexArray, hint );
+    uploadBuffer( GL_ARRAY_BUFFER, geometry.__glVertexBuffer, vertexArray, hint, geometry.dynamic );
 
   }
 
@@ -1081,7 +1202,7 @@ void GLRenderer::setLineBuffers( Geometry& geometry, int hint ) {
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometry.__glColorBuffer, colorArray, hint );
+    uploadBuffer( GL_ARRAY_BUFFER, geometry.__glColorBuffer, colorArray, hint, geometry.dynamic );
 
   }
 
@@ -1107,7 +1228,7 @@ void GLRenderer::setLineBuffers( Geometry& geometry, int hint ) {
         fillFromAny<Vector4>( customAttribute.value, customAttribute.array );
       }
 
-      glBindAndBuffer( GL_ARRAY_BUFFER, customAttribute.buffer, customAttribute.array, hint );
+      uploadBuffer( GL_ARRAY_BUFFER, customAttribute.buffer, customAttribute.array, hint, geometry.dynamic );
 
     }
 
@@ -1145,7 +1266,7 @@ void GLRenderer::setRibbonBuffers( Geometry& geometry, int hint ) {
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometry.__glVertexBuffer, vertexArray, hint );
+    uploadBuffer( GL_ARRAY_BUFFER, geometry.__glVertexBuffer, vertexArray, hint, geometry.dynamic );
 
   }
 
@@ -1163,7 +1284,7 @@ void GLRenderer::setRibbonBuffers( Geometry& geometry, int hint ) {
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometry.__glColorBuffer, colorArray, hint );
+    uploadBuffer( GL_ARRAY_BUFFER, geometry.__glColorBuffer, colorArray, hint, geometry.dynamic );
 
   }
 
@@ -1206,8 +1327,6 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
   auto& tangentArray = geometryGroup.__tangentArray;
   auto& colorArray   = geometryGroup.__colorArray;
 
-  auto& skinVertexAArray = geometryGroup.__skinVertexAArray;
-  auto& skinVertexBArray = geometryGroup.__skinVertexBArray;
   auto& skinIndexArray   = geometryGroup.__skinIndexArray;
   auto& skinWeightArray  = geometryGroup.__skinWeightArray;
 
@@ -1221,6 +1340,12 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
   Geometry& geometry = *object.geometry;
 
+  // Static groups without morph targets are uploaded once all attributes
+  // are packed, so they can be welded and interleaved first (see
+  // uploadStaticMeshBuffers)
+  const bool deferUploads = dispose && geometryGroup.numMorphTargets == 0 &&
+                            ( weldStaticBuffers || interleaveStaticBuffers );
+
   const bool dirtyVertices     = geometry.verticesNeedUpdate,
              dirtyElements     = geometry.elementsNeedUpdate,
              dirtyUvs          = geometry.uvsNeedUpdate,
@@ -1239,8 +1364,6 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
   // UNUSED: auto& obj_colors = geometry.colors;
 
-  auto& obj_skinVerticesA = geometry.skinVerticesA;
-  auto& obj_skinVerticesB = geometry.skinVerticesB;
   auto& obj_skinIndices   = geometry.skinIndices;
   auto& obj_skinWeights   = geometry.skinWeights;
 
@@ -1302,7 +1425,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glVertexBuffer, vertexArray, hint );
+    if ( !deferUploads ) {
+      uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glVertexBuffer, vertexArray, hint, !dispose );
+    }
 
   }
 
@@ -1310,6 +1435,10 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     for ( size_t vk = 0, vkl = morphTargets.size(); vk < vkl; vk ++ ) {
 
+      // geometries without morph normals leave the normals unmorphed
+      const bool dirtyMorphNormals = material && material->morphNormals &&
+                                     vk < morphNormals.size() && vk < morphNormalsArrays.size();
+
       offset_morphTarget = 0;
 
       for ( const auto& chf : chunk_faces3 ) {
@@ -1338,14 +1467,13 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
         // morph normals
 
-        if ( material && material->morphNormals ) {
+        if ( dirtyMorphNormals ) {
 
           Vector3 n1, n2, n3;
 
           if ( needsSmoothNormals ) {
 
-            // TODO: FIgure out where the vertexNormals array comes from
-            const auto& faceVertexNormals = morphNormals[ vk ].vertexNormals;//[ chf ];
+            const auto& faceVertexNormals = morphNormals[ vk ].vertexNormals[ chf ];
 
             n1 = faceVertexNormals[0];
             n2 = faceVertexNormals[1];
@@ -1353,9 +1481,7 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
           } else {
 
-            // TODO: FIgure out where the faceNormals array comes from
-            //n1 = morphNormals[ vk ].faceNormals[ chf ];
-            n1 = morphNormals[ vk ].normal;//faceNormals[ chf ];
+            n1 = morphNormals[ vk ].faceNormals[ chf ];
             n2 = n1;
             n3 = n1;
 
@@ -1414,15 +1540,13 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
         // morph normals
 
-        if ( material && material->morphNormals ) {
+        if ( dirtyMorphNormals ) {
 
           Vector3 n1, n2, n3, n4;
 
           if ( needsSmoothNormals ) {
 
-            // TODO: Figure out if vector needed
-            //const auto& faceVertexNormals = morphNormals[ vk ].vertexNormals[ chf ];
-            const auto& faceVertexNormals = morphNormals[ vk ].vertexNormals;//[ chf ];
+            const auto& faceVertexNormals = morphNormals[ vk ].vertexNormals[ chf ];
 
             n1 = faceVertexNormals[0];
             n2 = faceVertexNormals[1];
@@ -1431,9 +1555,7 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
           } else {
 
-            // TODO: Figure out if vector needed
-            //n1 = morphNormals[ vk ].faceNormals[ chf ];
-            n1 = morphNormals[ vk ].normal;//faceNormals[ chf ];
+            n1 = morphNormals[ vk ].faceNormals[ chf ];
             n2 = n1;
             n3 = n1;
             n4 = n1;
@@ -1466,15 +1588,15 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
       }
 
-      glBindAndBuffer( GL_ARRAY_BUFFER,
-                       geometryGroup.__glMorphTargetsBuffers[ vk ],
-                       morphTargetsArrays[ vk ], hint );
+      uploadBuffer( GL_ARRAY_BUFFER,
+                    geometryGroup.__glMorphTargetsBuffers[ vk ],
+                    morphTargetsArrays[ vk ], hint, !dispose );
 
-      if ( material && material->morphNormals ) {
+      if ( dirtyMorphNormals ) {
 
-        glBindAndBuffer( GL_ARRAY_BUFFER,
-                         geometryGroup.__glMorphNormalsBuffers[ vk ],
-                         morphNormalsArrays[ vk ], hint );
+        uploadBuffer( GL_ARRAY_BUFFER,
+                      geometryGroup.__glMorphNormalsBuffers[ vk ],
+                      morphNormalsArrays[ vk ], hint, !dispose );
 
       }
 
@@ -1482,6 +1604,13 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
   }
 
+  if ( geometryGroup.numMorphTargets > 0 && ( dirtyVertices || dirtyNormals || dirtyMorphTargets ) ) {
+
+    // residuals blended from the previous arrays are stale (see setupMorphTargets)
+    ++ geometryGroup.__glMorphVersion;
+
+  }
+
   if ( obj_skinWeights.size() ) {
 
     for ( const auto& fi : chunk_faces3 ) {
@@ -1490,9 +1619,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
       // weights
 
-      const auto& sw1 = obj_skinWeights[ face.a ];
-      const auto& sw2 = obj_skinWeights[ face.b ];
-      const auto& sw3 = obj_skinWeights[ face.c ];
+      const auto sw1 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.a ] );
+      const auto sw2 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.b ] );
+      const auto sw3 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.c ] );
 
       skinWeightArray[ offset_skin ]     = sw1.x;
       skinWeightArray[ offset_skin + 1 ] = sw1.y;
@@ -1530,48 +1659,6 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
       skinIndexArray[ offset_skin + 10 ] = si3.z;
       skinIndexArray[ offset_skin + 11 ] = si3.w;
 
-      // vertices A
-
-      const auto& sa1 = obj_skinVerticesA[ face.a ];
-      const auto& sa2 = obj_skinVerticesA[ face.b ];
-      const auto& sa3 = obj_skinVerticesA[ face.c ];
-
-      skinVertexAArray[ offset_skin ]     = sa1.x;
-      skinVertexAArray[ offset_skin + 1 ] = sa1.y;
-      skinVertexAArray[ offset_skin + 2 ] = sa1.z;
-      skinVertexAArray[ offset_skin + 3 ] = 1; // pad for faster vertex shader
-
-      skinVertexAArray[ offset_skin + 4 ] = sa2.x;
-      skinVertexAArray[ offset_skin + 5 ] = sa2.y;
-      skinVertexAArray[ offset_skin + 6 ] = sa2.z;
-      skinVertexAArray[ offset_skin + 7 ] = 1;
-
-      skinVertexAArray[ offset_skin + 8 ]  = sa3.x;
-      skinVertexAArray[ offset_skin + 9 ]  = sa3.y;
-      skinVertexAArray[ offset_skin + 10 ] = sa3.z;
-      skinVertexAArray[ offset_skin + 11 ] = 1;
-
-      // vertices B
-
-      const auto& sb1 = obj_skinVerticesB[ face.a ];
-      const auto& sb2 = obj_skinVerticesB[ face.b ];
-      const auto& sb3 = obj_skinVerticesB[ face.c ];
-
-      skinVertexBArray[ offset_skin ]     = sb1.x;
-      skinVertexBArray[ offset_skin + 1 ] = sb1.y;
-      skinVertexBArray[ offset_skin + 2 ] = sb1.z;
-      skinVertexBArray[ offset_skin + 3 ] = 1; // pad for faster vertex shader
-
-      skinVertexBArray[ offset_skin + 4 ] = sb2.x;
-      skinVertexBArray[ offset_skin + 5 ] = sb2.y;
-      skinVertexBArray[ offset_skin + 6 ] = sb2.z;
-      skinVertexBArray[ offset_skin + 7 ] = 1;
-
-      skinVertexBArray[ offset_skin + 8 ]  = sb3.x;
-      skinVertexBArray[ offset_skin + 9 ]  = sb3.y;
-      skinVertexBArray[ offset_skin + 10 ] = sb3.z;
-      skinVertexBArray[ offset_skin + 11 ] = 1;
-
       offset_skin += 12;
 
     }
@@ -1582,10 +1669,10 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
       // weights
 
-      const auto& sw1 = obj_skinWeights[ face.a ];
-      const auto& sw2 = obj_skinWeights[ face.b ];
-      const auto& sw3 = obj_skinWeights[ face.c ];
-      const auto& sw4 = obj_skinWeights[ face.d ];
+      const auto sw1 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.a ] );
+      const auto sw2 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.b ] );
+      const auto sw3 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.c ] );
+      const auto sw4 = SkinnedMesh::normalizedWeights( obj_skinWeights[ face.d ] );
 
       skinWeightArray[ offset_skin ]     = sw1.x;
       skinWeightArray[ offset_skin + 1 ] = sw1.y;
@@ -1634,70 +1721,14 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
       skinIndexArray[ offset_skin + 14 ] = si4.z;
       skinIndexArray[ offset_skin + 15 ] = si4.w;
 
-      // vertices A
-
-      const auto& sa1 = obj_skinVerticesA[ face.a ];
-      const auto& sa2 = obj_skinVerticesA[ face.b ];
-      const auto& sa3 = obj_skinVerticesA[ face.c ];
-      const auto& sa4 = obj_skinVerticesA[ face.d ];
-
-      skinVertexAArray[ offset_skin ]     = sa1.x;
-      skinVertexAArray[ offset_skin + 1 ] = sa1.y;
-      skinVertexAArray[ offset_skin + 2 ] = sa1.z;
-      skinVertexAArray[ offset_skin + 3 ] = 1; // pad for faster vertex shader
-
-      skinVertexAArray[ offset_skin + 4 ] = sa2.x;
-      skinVertexAArray[ offset_skin + 5 ] = sa2.y;
-      skinVertexAArray[ offset_skin + 6 ] = sa2.z;
-      skinVertexAArray[ offset_skin + 7 ] = 1;
-
-      skinVertexAArray[ offset_skin + 8 ]  = sa3.x;
-      skinVertexAArray[ offset_skin + 9 ]  = sa3.y;
-      skinVertexAArray[ offset_skin + 10 ] = sa3.z;
-      skinVertexAArray[ offset_skin + 11 ] = 1;
-
-      skinVertexAArray[ offset_skin + 12 ] = sa4.x;
-      skinVertexAArray[ offset_skin + 13 ] = sa4.y;
-      skinVertexAArray[ offset_skin + 14 ] = sa4.z;
-      skinVertexAArray[ offset_skin + 15 ] = 1;
-
-      // vertices B
-
-      const auto& sb1 = obj_skinVerticesB[ face.a ];
-      const auto& sb2 = obj_skinVerticesB[ face.b ];
-      const auto& sb3 = obj_skinVerticesB[ face.c ];
-      const auto& sb4 = obj_skinVerticesB[ face.d ];
-
-      skinVertexBArray[ offset_skin ]     = sb1.x;
-      skinVertexBArray[ offset_skin + 1 ] = sb1.y;
-      skinVertexBArray[ offset_skin + 2 ] = sb1.z;
-      skinVertexBArray[ offset_skin + 3 ] = 1; // pad for faster vertex shader
-
-      skinVertexBArray[ offset_skin + 4 ] = sb2.x;
-      skinVertexBArray[ offset_skin + 5 ] = sb2.y;
-      skinVertexBArray[ offset_skin + 6 ] = sb2.z;
-      skinVertexBArray[ offset_skin + 7 ] = 1;
-
-      skinVertexBArray[ offset_skin + 8 ]  = sb3.x;
-      skinVertexBArray[ offset_skin + 9 ]  = sb3.y;
-      skinVertexBArray[ offset_skin + 10 ] = sb3.z;
-      skinVertexBArray[ offset_skin + 11 ] = 1;
-
-      skinVertexBArray[ offset_skin + 12 ] = sb4.x;
-      skinVertexBArray[ offset_skin + 13 ] = sb4.y;
-      skinVertexBArray[ offset_skin + 14 ] = sb4.z;
-      skinVertexBArray[ offset_skin + 15 ] = 1;
-
       offset_skin += 16;
 
     }
 
-    if ( offset_skin > 0 ) {
+    if ( offset_skin > 0 && !deferUploads ) {
 
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinVertexABuffer, skinVertexAArray, hint );
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinVertexBBuffer, skinVertexBArray, hint );
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinIndicesBuffer, skinIndexArray, hint );
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinWeightsBuffer, skinWeightArray, hint );
+      uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinIndicesBuffer, skinIndexArray, hint, !dispose );
+      uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinWeightsBuffer, skinWeightArray, hint, !dispose );
 
     }
 
@@ -1787,7 +1818,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     if ( offset_color > 0 ) {
 
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glColorBuffer, colorArray, hint );
+      if ( !deferUploads ) {
+        uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glColorBuffer, colorArray, hint, !dispose );
+      }
 
     }
 
@@ -1859,7 +1892,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glTangentBuffer, tangentArray, hint );
+    if ( !deferUploads ) {
+      uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glTangentBuffer, tangentArray, hint, !dispose );
+    }
 
   }
 
@@ -1941,7 +1976,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glNormalBuffer, normalArray, hint );
+    if ( !deferUploads ) {
+      uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glNormalBuffer, normalArray, hint, !dispose );
+    }
 
   }
 
@@ -1989,7 +2026,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     if ( offset_uv > 0 ) {
 
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUVBuffer, uvArray, hint );
+      if ( !deferUploads ) {
+        uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUVBuffer, uvArray, hint, !dispose );
+      }
 
     }
 
@@ -2039,7 +2078,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     if ( offset_uv2 > 0 ) {
 
-      glBindAndBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUV2Buffer, uv2Array, hint );
+      if ( !deferUploads ) {
+        uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUV2Buffer, uv2Array, hint, !dispose );
+      }
 
     }
 
@@ -2104,8 +2145,9 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     }
 
-    glBindAndBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glFaceBuffer, faceArray, hint );
-    glBindAndBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glLineBuffer, lineArray, hint );
+    if ( !deferUploads ) {
+      uploadIndices( geometryGroup, ( int )vertexArray.size() / 3, hint, !dispose );
+    }
 
   }
 
@@ -2650,199 +2692,510 @@ void GLRenderer::setMeshBuffers( GeometryGroup& geometryGroup, Object3D& object,
 
     }
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, customAttribute.buffer, customAttribute.array, hint );
+    uploadBuffer( GL_ARRAY_BUFFER, customAttribute.buffer, customAttribute.array, hint, !dispose );
 
   }
 
-  if ( dispose ) {
+  if ( deferUploads ) {
 
-    geometryGroup.dispose();
+    // uv arrays are allocated for every channel the geometry declares, but
+    // only filled for those with coordinates
+    if ( obj_uvs.empty() )  uvArray.clear();
+    if ( obj_uvs2.empty() ) uv2Array.clear();
+
+    uploadStaticMeshBuffers( geometryGroup, hint );
 
   }
 
-}
+  if ( dispose ) {
 
+    geometryGroup.dispose();
 
-void GLRenderer::setDirectBuffers( Geometry& geometry, int hint, bool dispose ) {
+  }
 
-  auto& attributes = geometry.attributes;
+}
 
-  if ( geometry.elementsNeedUpdate && attributes.contains( AttributeKey::index() ) ) {
 
-    auto& index = attributes[ AttributeKey::index() ];
-    glBindAndBuffer( GL_ELEMENT_ARRAY_BUFFER, index.buffer, index.array, hint );
+void GLRenderer::uploadStaticMeshBuffers( GeometryGroup& geometryGroup, int hint ) {
 
+  // Custom attributes are uploaded as packed, per face corner
+  if ( weldStaticBuffers && geometryGroup.__glCustomAttributesList.empty() ) {
+    weldMeshBuffers( geometryGroup );
   }
 
-  if ( geometry.verticesNeedUpdate && attributes.contains( AttributeKey::position() ) ) {
+  if ( interleaveStaticBuffers ) {
 
-    auto& position = attributes[ AttributeKey::position() ];
-    glBindAndBuffer( GL_ARRAY_BUFFER, position.buffer, position.array, hint );
+    interleaveMeshBuffers( geometryGroup, hint );
 
-  }
+  } else {
 
-  if ( geometry.normalsNeedUpdate && attributes.contains( AttributeKey::normal() ) ) {
+    auto upload = [&]( Buffer buffer, const std::vector<float>& array ) {
+      if ( !array.empty() ) uploadBuffer( GL_ARRAY_BUFFER, buffer, array, hint, false );
+    };
 
-    auto& normal   = attributes[ AttributeKey::normal() ];
-    glBindAndBuffer( GL_ARRAY_BUFFER, normal.buffer, normal.array, hint );
+    upload( geometryGroup.__glVertexBuffer,  geometryGroup.__vertexArray );
+    upload( geometryGroup.__glNormalBuffer,  geometryGroup.__normalArray );
+    upload( geometryGroup.__glTangentBuffer, geometryGroup.__tangentArray );
+    upload( geometryGroup.__glColorBuffer,   geometryGroup.__colorArray );
+    upload( geometryGroup.__glUVBuffer,      geometryGroup.__uvArray );
+    upload( geometryGroup.__glUV2Buffer,     geometryGroup.__uv2Array );
 
   }
 
-  if ( geometry.uvsNeedUpdate && attributes.contains( AttributeKey::uv() ) ) {
+  if ( !geometryGroup.__skinIndexArray.empty() ) {
 
-    auto& uv       = attributes[ AttributeKey::uv() ];
-    glBindAndBuffer( GL_ARRAY_BUFFER, uv.buffer, uv.array, hint );
+    uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinIndicesBuffer, geometryGroup.__skinIndexArray, hint, false );
+    uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinWeightsBuffer, geometryGroup.__skinWeightArray, hint, false );
 
   }
 
-  if ( geometry.colorsNeedUpdate && attributes.contains( AttributeKey::color() ) ) {
+  uploadIndices( geometryGroup, ( int )geometryGroup.__vertexArray.size() / 3, hint, false );
 
-    auto& color    = attributes[ AttributeKey::color() ];
-    glBindAndBuffer( GL_ARRAY_BUFFER, color.buffer, color.array, hint );
+}
 
-  }
+void GLRenderer::uploadIndices( GeometryGroup& geometryGroup, int vertices, int hint, bool stream ) {
 
-  if ( geometry.tangentsNeedUpdate && attributes.contains( AttributeKey::tangent() ) ) {
+  // 16 bit indices where they suffice, which halves index memory
 
-    auto& tangent  = attributes[ AttributeKey::tangent() ];
-    glBindAndBuffer( GL_ARRAY_BUFFER, tangent.buffer, tangent.array, hint );
+  if ( vertices <= 65536 ) {
 
-  }
+    auto narrow = [this, &geometryGroup, hint, stream]( Buffer buffer, const std::vector<uint32_t>& indices ) {
+      _indexScratch.assign( indices.begin(), indices.end() );
+      uploadBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer, _indexScratch, hint, stream );
+    };
 
-  if ( dispose ) {
+    narrow( geometryGroup.__glFaceBuffer, geometryGroup.__faceArray );
+    narrow( geometryGroup.__glLineBuffer, geometryGroup.__lineArray );
 
-for ( auto& attribute : geometry.attributes ) {
+    geometryGroup.__glIndex32 = false;
 
-      attribute.second.array.clear();
+  } else {
 
-    }
+    uploadBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glFaceBuffer, geometryGroup.__faceArray, hint, stream );
+    uploadBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glLineBuffer, geometryGroup.__lineArray, hint, stream );
+
+    geometryGroup.__glIndex32 = true;
 
   }
 
 }
 
-// Buffer rendering
+void GLRenderer::weldMeshBuffers( GeometryGroup& geometryGroup ) {
 
+  const auto count = geometryGroup.__vertexArray.size() / 3;
 
-void GLRenderer::renderBufferImmediate( Object3D& object, Program& program, Material& material ) {
+  if ( count == 0 ) return;
 
-  if ( object.glImmediateData.hasPositions && ! object.glImmediateData.__glVertexBuffer ) object.glImmediateData.__glVertexBuffer = glCreateBuffer();
-  if ( object.glImmediateData.hasNormals   && ! object.glImmediateData.__glNormalBuffer ) object.glImmediateData.__glNormalBuffer = glCreateBuffer();
-  if ( object.glImmediateData.hasUvs       && ! object.glImmediateData.__glUvBuffer )     object.glImmediateData.__glUvBuffer     = glCreateBuffer();
-  if ( object.glImmediateData.hasColors    && ! object.glImmediateData.__glColorBuffer )  object.glImmediateData.__glColorBuffer  = glCreateBuffer();
+  // Every per-corner array, as raw rows of equal width
 
-  if ( object.glImmediateData.hasPositions ) {
+  struct Stream {
+    unsigned char* data;
+    size_t row;
+  };
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glVertexBuffer, object.glImmediateData.positionArray, GL_DYNAMIC_DRAW );
-    glEnableVertexAttribArray( program.attributes[AttributeKey::position()] );
-    glVertexAttribPointer( program.attributes[AttributeKey::position()], 3, GL_FLOAT, false, 0, 0 );
+  std::vector<Stream> streams;
 
-  }
+  auto add = [&]( void* data, size_t size, size_t element ) {
+    if ( size != 0 && size % count == 0 ) {
+      Stream stream = { static_cast<unsigned char*>( data ), size / count * element };
+      streams.push_back( stream );
+    }
+  };
 
-  if ( object.glImmediateData.hasNormals ) {
+  add( geometryGroup.__vertexArray.data(),      geometryGroup.__vertexArray.size(),      sizeof( float ) );
+  add( geometryGroup.__normalArray.data(),      geometryGroup.__normalArray.size(),      sizeof( float ) );
+  add( geometryGroup.__tangentArray.data(),     geometryGroup.__tangentArray.size(),     sizeof( float ) );
+  add( geometryGroup.__colorArray.data(),       geometryGroup.__colorArray.size(),       sizeof( float ) );
+  add( geometryGroup.__uvArray.data(),          geometryGroup.__uvArray.size(),          sizeof( float ) );
+  add( geometryGroup.__uv2Array.data(),         geometryGroup.__uv2Array.size(),         sizeof( float ) );
+  add( geometryGroup.__skinIndexArray.data(),   geometryGroup.__skinIndexArray.size(),   sizeof( float ) );
+  add( geometryGroup.__skinWeightArray.data(),  geometryGroup.__skinWeightArray.size(),  sizeof( float ) );
+
+  // Rows are whole 32 bit words; fold them in, then mix once
+  auto hashOf = [&]( size_t corner ) {
+    std::uint64_t hash = 0;
+    for ( const auto& stream : streams ) {
+      const auto row = stream.data + corner * stream.row;
+      for ( size_t i = 0; i < stream.row; i += 4 ) {
+        std::uint32_t word;
+        std::memcpy( &word, row + i, 4 );
+        hash = ( hash ^ word ) * 0x100000001b3ull;
+      }
+    }
+    return Fingerprint::mix( hash );
+  };
 
-    if ( material.shading == THREE::FlatShading ) {
+  auto equal = [&]( size_t a, size_t b ) {
+    for ( const auto& stream : streams ) {
+      if ( std::memcmp( stream.data + a * stream.row, stream.data + b * stream.row, stream.row ) != 0 )
+        return false;
+    }
+    return true;
+  };
 
-      auto& normalArray = object.glImmediateData.normalArray;
+  // Open addressing over welded indices, at most half full. A new corner's
+  // row moves down to its welded index (never past its own, so rows move
+  // in place); later corners compare against it there.
 
-      for ( int i = 0, il = object.glImmediateData.count; i < il; i += 9 ) {
+  size_t capacity = 1;
+  while ( capacity < count * 2 ) capacity <<= 1;
 
-        const auto nax  = normalArray[ i ];
-        const auto nay  = normalArray[ i + 1 ];
-        const auto naz  = normalArray[ i + 2 ];
+  std::vector<uint32_t> table( capacity, ~0u );
+  std::vector<uint32_t> remap( count );
 
-        const auto nbx  = normalArray[ i + 3 ];
-        const auto nby  = normalArray[ i + 4 ];
-        const auto nbz  = normalArray[ i + 5 ];
+  uint32_t unique = 0;
 
-        const auto ncx  = normalArray[ i + 6 ];
-        const auto ncy  = normalArray[ i + 7 ];
-        const auto ncz  = normalArray[ i + 8 ];
+  for ( size_t corner = 0; corner < count; ++corner ) {
 
-        const auto nx = ( nax + nbx + ncx ) / 3;
-        const auto ny = ( nay + nby + ncy ) / 3;
-        const auto nz = ( naz + nbz + ncz ) / 3;
+    auto slot = hashOf( corner ) & ( capacity - 1 );
 
-        normalArray[ i ]     = nx;
-        normalArray[ i + 1 ] = ny;
-        normalArray[ i + 2 ] = nz;
+    while ( table[ slot ] != ~0u && !equal( table[ slot ], corner ) ) {
+      slot = ( slot + 1 ) & ( capacity - 1 );
+    }
 
-        normalArray[ i + 3 ] = nx;
-        normalArray[ i + 4 ] = ny;
-        normalArray[ i + 5 ] = nz;
+    if ( table[ slot ] == ~0u ) {
 
-        normalArray[ i + 6 ] = nx;
-        normalArray[ i + 7 ] = ny;
-        normalArray[ i + 8 ] = nz;
+      table[ slot ] = unique;
+      remap[ corner ] = unique;
 
+      for ( const auto& stream : streams ) {
+        std::memmove( stream.data + unique * stream.row, stream.data + corner * stream.row, stream.row );
       }
 
-    }
-
-    glBindAndBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glNormalBuffer, object.glImmediateData.normalArray, GL_DYNAMIC_DRAW );
-    glEnableVertexAttribArray( program.attributes[AttributeKey::normal()] );
-    glVertexAttribPointer( program.attributes[AttributeKey::normal()], 3, GL_FLOAT, false, 0, 0 );
+      ++unique;
 
-  }
+    } else {
 
-  if ( object.glImmediateData.hasUvs && material.map ) {
+      remap[ corner ] = table[ slot ];
 
-    glBindAndBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glUvBuffer, object.glImmediateData.uvArray, GL_DYNAMIC_DRAW );
-    glEnableVertexAttribArray( program.attributes[AttributeKey::uv()] );
-    glVertexAttribPointer( program.attributes[AttributeKey::uv()], 2, GL_FLOAT, false, 0, 0 );
+    }
 
   }
 
-  if ( object.glImmediateData.hasColors && material.vertexColors != THREE::NoColors ) {
-
-    glBindAndBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glColorBuffer, object.glImmediateData.colorArray, GL_DYNAMIC_DRAW );
-    glEnableVertexAttribArray( program.attributes[AttributeKey::color()] );
-    glVertexAttribPointer( program.attributes[AttributeKey::color()], 3, GL_FLOAT, false, 0, 0 );
+  if ( unique == count ) return;
 
-  }
+  for ( auto& index : geometryGroup.__faceArray ) index = remap[ index ];
+  for ( auto& index : geometryGroup.__lineArray ) index = remap[ index ];
 
-  glDrawArrays( GL_TRIANGLES, 0, object.glImmediateData.count );
+  auto shrink = [unique, count]( std::vector<float>& array ) {
+    array.resize( array.size() / count * unique );
+  };
 
-  object.glImmediateData.count = 0;
+  shrink( geometryGroup.__vertexArray );
+  shrink( geometryGroup.__normalArray );
+  shrink( geometryGroup.__tangentArray );
+  shrink( geometryGroup.__colorArray );
+  shrink( geometryGroup.__uvArray );
+  shrink( geometryGroup.__uv2Array );
+  shrink( geometryGroup.__skinIndexArray );
+  shrink( geometryGroup.__skinWeightArray );
 
 }
 
-void GLRenderer::renderBufferDirect( Camera& camera, Lights& lights, IFog* fog, Material& material, BufferGeometry& geometry, Object3D& object ) {
+void GLRenderer::interleaveMeshBuffers( GeometryGroup& geometryGroup, int hint ) {
 
-  if ( material.visible == false ) return;
+  const auto count = geometryGroup.__vertexArray.size() / 3;
 
-  auto& program = setProgram( camera, lights, fog, material, object );
+  if ( count == 0 ) return;
 
-  auto& attributes = program.attributes;
+  const auto packed = packStaticBuffers;
 
-  auto updateBuffers = false;
-  auto wireframeBit = material.wireframe ? 1 : 0;
-  auto geometryHash = ( geometry.id * 0xffffff ) + ( program.id * 2 ) + wireframeBit;
+  auto has = [count]( const std::vector<float>& array, size_t size ) {
+    return array.size() == count * size;
+  };
 
-  if ( geometryHash != _currentGeometryGroupHash ) {
+  // Layout: position, normal, tangent, color, uv, uv2, each only if present;
+  // packed normals, tangents and colors take 4 bytes instead of 12-16
 
-    _currentGeometryGroupHash = geometryHash;
-    updateBuffers = true;
+  auto& layout = geometryGroup.__glInterleaved;
+  layout = GeometryBuffer::InterleavedLayout();
+  layout.packed = packed;
 
-  }
+  int stride = 0;
+  auto place = [&stride]( int& offset, int bytes ) {
+    offset = stride;
+    stride += bytes;
+  };
 
-  // render mesh
+  place( layout.position, 12 );
+  if ( has( geometryGroup.__normalArray, 3 ) )  place( layout.normal,  packed ? 4 : 12 );
+  if ( has( geometryGroup.__tangentArray, 4 ) ) place( layout.tangent, packed ? 4 : 16 );
+  if ( has( geometryGroup.__colorArray, 3 ) )   place( layout.color,   packed ? 4 : 12 );
+  if ( has( geometryGroup.__uvArray, 2 ) )      place( layout.uv,  8 );
+  if ( has( geometryGroup.__uv2Array, 2 ) )     place( layout.uv2, 8 );
 
-  if ( object.type() == THREE::Mesh ) {
+  layout.stride = stride;
 
-    const auto& offsets = geometry.offsets;
+  std::vector<unsigned char> interleaved( count * stride );
 
-    // if there is more than 1 chunk
-    // must set attribute pointers to use new offsets for each chunk
-    // even if geometry and materials didn't change
+  auto copy = [&]( int offset, const std::vector<float>& array, size_t size ) {
+    if ( offset < 0 ) return;
+    for ( size_t i = 0; i < count; ++i ) {
+      std::memcpy( &interleaved[ i * stride + offset ], &array[ i * size ], size * sizeof( float ) );
+    }
+  };
 
-    if ( offsets.size() > 1 ) updateBuffers = true;
+  auto pack = [&]( int offset, const std::vector<float>& array, size_t size, bool isSigned ) {
+    if ( offset < 0 ) return;
+    for ( size_t i = 0; i < count; ++i ) {
+      auto out = &interleaved[ i * stride + offset ];
+      for ( size_t c = 0; c < 4; ++c ) {
+        const auto v = c < size ? array[ i * size + c ] : 1.f;
+        out[ c ] = isSigned ? ( unsigned char )( signed char )Math::round( Math::clamp( v, -1.f, 1.f ) * 127.f )
+                            : ( unsigned char )Math::round( Math::clamp( v, 0.f, 1.f ) * 255.f );
+      }
+    }
+  };
 
-    for ( size_t i = 0, il = offsets.size(); i < il; ++ i ) {
+  copy( layout.position, geometryGroup.__vertexArray, 3 );
 
-      const auto startIndex = offsets[ i ].index;
+  if ( packed ) {
+    pack( layout.normal,  geometryGroup.__normalArray, 3, true );
+    pack( layout.tangent, geometryGroup.__tangentArray, 4, true );
+    pack( layout.color,   geometryGroup.__colorArray, 3, false );
+  } else {
+    copy( layout.normal,  geometryGroup.__normalArray, 3 );
+    copy( layout.tangent, geometryGroup.__tangentArray, 4 );
+    copy( layout.color,   geometryGroup.__colorArray, 3 );
+  }
 
-      if ( updateBuffers ) {
+  copy( layout.uv,  geometryGroup.__uvArray, 2 );
+  copy( layout.uv2, geometryGroup.__uv2Array, 2 );
+
+  uploadBuffer( GL_ARRAY_BUFFER, geometryGroup.__glVertexBuffer, interleaved, hint, false );
+
+  // The interleaved buffer takes over __glVertexBuffer; drop the rest
+
+  deleteBuffer( geometryGroup.__glNormalBuffer );
+  deleteBuffer( geometryGroup.__glTangentBuffer );
+  deleteBuffer( geometryGroup.__glColorBuffer );
+  deleteBuffer( geometryGroup.__glUVBuffer );
+  deleteBuffer( geometryGroup.__glUV2Buffer );
+
+  geometryGroup.__glNormalBuffer = geometryGroup.__glTangentBuffer = geometryGroup.__glColorBuffer = 0;
+  geometryGroup.__glUVBuffer = geometryGroup.__glUV2Buffer = 0;
+
+  if ( geometryGroup.__skinIndexArray.empty() ) {
+
+    deleteBuffer( geometryGroup.__glSkinIndicesBuffer );
+    deleteBuffer( geometryGroup.__glSkinWeightsBuffer );
+
+    geometryGroup.__glSkinIndicesBuffer = geometryGroup.__glSkinWeightsBuffer = 0;
+
+  }
+
+}
+
+void GLRenderer::setDirectBuffers( Geometry& geometry, int hint, bool dispose ) {
+
+  auto& attributes = geometry.attributes;
+
+  if ( geometry.elementsNeedUpdate && attributes.contains( AttributeKey::index() ) ) {
+
+    auto& index = attributes[ AttributeKey::index() ];
+    uploadBuffer( GL_ELEMENT_ARRAY_BUFFER, index.buffer, index.array, hint, !dispose );
+
+  }
+
+  if ( geometry.verticesNeedUpdate && attributes.contains( AttributeKey::position() ) ) {
+
+    auto& position = attributes[ AttributeKey::position() ];
+    uploadBuffer( GL_ARRAY_BUFFER, position.buffer, position.array, hint, !dispose );
+
+  }
+
+  if ( geometry.normalsNeedUpdate && attributes.contains( AttributeKey::normal() ) ) {
+
+    auto& normal   = attributes[ AttributeKey::normal() ];
+    uploadBuffer( GL_ARRAY_BUFFER, normal.buffer, normal.array, hint, !dispose );
+
+  }
+
+  if ( geometry.uvsNeedUpdate && attributes.contains( AttributeKey::uv() ) ) {
+
+    auto& uv       = attributes[ AttributeKey::uv() ];
+    uploadBuffer( GL_ARRAY_BUFFER, uv.buffer, uv.array, hint, !dispose );
+
+  }
+
+  if ( geometry.colorsNeedUpdate && attributes.contains( AttributeKey::color() ) ) {
+
+    auto& color    = attributes[ AttributeKey::color() ];
+    uploadBuffer( GL_ARRAY_BUFFER, color.buffer, color.array, hint, !dispose );
+
+  }
+
+  if ( geometry.tangentsNeedUpdate && attributes.contains( AttributeKey::tangent() ) ) {
+
+    auto& tangent  = attributes[ AttributeKey::tangent() ];
+    uploadBuffer( GL_ARRAY_BUFFER, tangent.buffer, tangent.array, hint, !dispose );
+
+  }
+
+  if ( dispose ) {
+
+for ( auto& attribute : geometry.attributes ) {
+
+      attribute.second.array.clear();
+
+    }
+
+  }
+
+}
+
+// Arrays written directly, e.g. by ParticleEngine: they change every frame
+// and grow and shrink with the particles, so they are uploaded whole and
+// without diffing
+
+void GLRenderer::setParticleDirectBuffers( Geometry& geometry, int hint ) {
+
+  for ( auto& a : geometry.attributes ) {
+
+    auto& attribute = a.second;
+
+    const auto dirty = a.first == AttributeKey::position() ? geometry.verticesNeedUpdate :
+                       a.first == AttributeKey::color()    ? geometry.colorsNeedUpdate :
+                       attribute.needsUpdate;
+
+    if ( ! dirty ) continue;
+
+    // added since the geometry was first drawn
+    if ( ! attribute.buffer ) attribute.buffer = glCreateBuffer();
+
+    uploadBuffer( GL_ARRAY_BUFFER, attribute.buffer, attribute.array, hint, false );
+
+    attribute.needsUpdate = false;
+
+  }
+
+  geometry.verticesNeedUpdate = false;
+  geometry.colorsNeedUpdate = false;
+
+}
+
+// Buffer rendering
+
+
+void GLRenderer::renderBufferImmediate( Object3D& object, Program& program, Material& material ) {
+
+  if ( object.glImmediateData.hasPositions && ! object.glImmediateData.__glVertexBuffer ) object.glImmediateData.__glVertexBuffer = glCreateBuffer();
+  if ( object.glImmediateData.hasNormals   && ! object.glImmediateData.__glNormalBuffer ) object.glImmediateData.__glNormalBuffer = glCreateBuffer();
+  if ( object.glImmediateData.hasUvs       && ! object.glImmediateData.__glUvBuffer )     object.glImmediateData.__glUvBuffer     = glCreateBuffer();
+  if ( object.glImmediateData.hasColors    && ! object.glImmediateData.__glColorBuffer )  object.glImmediateData.__glColorBuffer  = glCreateBuffer();
+
+  if ( object.glImmediateData.hasPositions ) {
+
+    uploadBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glVertexBuffer, object.glImmediateData.positionArray, GL_DYNAMIC_DRAW, false );
+    glEnableVertexAttribArray( program.attributes[AttributeKey::position()] );
+    glVertexAttribPointer( program.attributes[AttributeKey::position()], 3, GL_FLOAT, false, 0, 0 );
+
+  }
+
+  if ( object.glImmediateData.hasNormals ) {
+
+    if ( material.shading == THREE::FlatShading ) {
+
+      auto& normalArray = object.glImmediateData.normalArray;
+
+      for ( int i = 0, il = object.glImmediateData.count; i < il; i += 9 ) {
+
+        const auto nax  = normalArray[ i ];
+        const auto nay  = normalArray[ i + 1 ];
+        const auto naz  = normalArray[ i + 2 ];
+
+        const auto nbx  = normalArray[ i + 3 ];
+        const auto nby  = normalArray[ i + 4 ];
+        const auto nbz  = normalArray[ i + 5 ];
+
+        const auto ncx  = normalArray[ i + 6 ];
+        const auto ncy  = normalArray[ i + 7 ];
+        const auto ncz  = normalArray[ i + 8 ];
+
+        const auto nx = ( nax + nbx + ncx ) / 3;
+        const auto ny = ( nay + nby + ncy ) / 3;
+        const auto nz = ( naz + nbz + ncz ) / 3;
+
+        normalArray[ i ]     = nx;
+        normalArray[ i + 1 ] = ny;
+        normalArray[ i + 2 ] = nz;
+
+        normalArray[ i + 3 ] = nx;
+        normalArray[ i + 4 ] = ny;
+        normalArray[ i + 5 ] = nz;
+
+        normalArray[ i + 6 ] = nx;
+        normalArray[ i + 7 ] = ny;
+        normalArray[ i + 8 ] = nz;
+
+      }
+
+    }
+
+    uploadBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glNormalBuffer, object.glImmediateData.normalArray, GL_DYNAMIC_DRAW, false );
+    glEnableVertexAttribArray( program.attributes[AttributeKey::normal()] );
+    glVertexAttribPointer( program.attributes[AttributeKey::normal()], 3, GL_FLOAT, false, 0, 0 );
+
+  }
+
+  if ( object.glImmediateData.hasUvs && material.map ) {
+
+    uploadBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glUvBuffer, object.glImmediateData.uvArray, GL_DYNAMIC_DRAW, false );
+    glEnableVertexAttribArray( program.attributes[AttributeKey::uv()] );
+    glVertexAttribPointer( program.attributes[AttributeKey::uv()], 2, GL_FLOAT, false, 0, 0 );
+
+  }
+
+  if ( object.glImmediateData.hasColors && material.vertexColors != THREE::NoColors ) {
+
+    uploadBuffer( GL_ARRAY_BUFFER, object.glImmediateData.__glColorBuffer, object.glImmediateData.colorArray, GL_DYNAMIC_DRAW, false );
+    glEnableVertexAttribArray( program.attributes[AttributeKey::color()] );
+    glVertexAttribPointer( program.attributes[AttributeKey::color()], 3, GL_FLOAT, false, 0, 0 );
+
+  }
+
+  glDrawArrays( GL_TRIANGLES, 0, object.glImmediateData.count );
+
+  object.glImmediateData.count = 0;
+
+}
+
+void GLRenderer::renderBufferDirect( Camera& camera, Lights& lights, IFog* fog, Material& material, BufferGeometry& geometry, Object3D& object ) {
+
+  if ( material.visible == false ) return;
+
+  auto& program = setProgram( camera, lights, fog, material, object );
+
+  auto& attributes = program.attributes;
+
+  auto updateBuffers = false;
+  auto wireframeBit = material.wireframe ? 1 : 0;
+  auto geometryHash = ( geometry.id * 0xffffff ) + ( program.id * 2 ) + wireframeBit;
+
+  if ( geometryHash != _currentGeometryGroupHash ) {
+
+    _currentGeometryGroupHash = geometryHash;
+    updateBuffers = true;
+
+  }
+
+  // render mesh
+
+  if ( object.type() == THREE::Mesh ) {
+
+    const auto& offsets = geometry.offsets;
+
+    // if there is more than 1 chunk
+    // must set attribute pointers to use new offsets for each chunk
+    // even if geometry and materials didn't change
+
+    if ( offsets.size() > 1 ) updateBuffers = true;
+
+    for ( size_t i = 0, il = offsets.size(); i < il; ++ i ) {
+
+      const auto startIndex = offsets[ i ].index;
+
+      if ( updateBuffers ) {
 
         // vertices
 
@@ -2929,15 +3282,87 @@ void GLRenderer::renderBufferDirect( Camera& camera, Lights& lights, IFog* fog,
 
     }
 
+    // render particles
+
+  } else if ( object.type() == THREE::ParticleSystem ) {
+
+    if ( updateBuffers ) {
+
+      // every attribute the program reads, by name
+
+      for ( const auto& a : geometry.attributes ) {
+
+        const auto location = attributes.find( a.first );
+
+        if ( location == attributes.end() || ! location->second.valid() || ! a.second.buffer ) continue;
+
+        glBindBuffer( GL_ARRAY_BUFFER, a.second.buffer );
+        glVertexAttribPointer( location->second, a.second.itemSize, GL_FLOAT, false, 0, 0 );
+
+      }
+
+    }
+
+#ifndef THREE_GLES
+    glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    glEnable(GL_POINT_SPRITE);
+    glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
+#endif
+
+    const auto position = geometry.attributes.get( AttributeKey::position() );
+    const auto count = position ? ( int )( position->array.size() / 3 ) : 0;
+
+    glDrawArrays( GL_POINTS, 0, count );
+
+    _info.render.calls ++;
+    _info.render.points += count;
+
   }
 
 }
 
-void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryGroup& geometryGroup, Object3D& object ) {
+void GLRenderer::bindInterleavedBuffers( GeometryGroup& geometryGroup, AttributeLocations& attributes ) {
+
+  const auto& layout = geometryGroup.__glInterleaved;
+  const auto  packed = layout.packed;
+
+  glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glVertexBuffer );
+
+  auto pointer = [&]( const std::string& key, int offset, int size, GLenum type, bool normalized ) {
+    auto attribute = attributes.find( key );
+    if ( attribute == attributes.end() || !attribute->second.valid() || offset < 0 ) return;
+    glVertexAttribPointer( attribute->second, size, type, normalized, layout.stride,
+                           reinterpret_cast<const GLvoid*>( ( size_t )offset ) );
+  };
+
+  // uvs are enabled per group, as in renderBuffer
+  auto enable = [&]( const std::string& key, int offset ) {
+    auto attribute = attributes.find( key );
+    if ( attribute == attributes.end() || !attribute->second.valid() ) return;
+    if ( offset < 0 ) {
+      glDisableVertexAttribArray( attribute->second );
+    } else {
+      glEnableVertexAttribArray( attribute->second );
+    }
+  };
+
+  pointer( AttributeKey::position(), layout.position, 3, GL_FLOAT, false );
+  pointer( AttributeKey::normal(),   layout.normal,  packed ? 4 : 3, packed ? GL_BYTE : GL_FLOAT, packed );
+  pointer( AttributeKey::tangent(),  layout.tangent, 4, packed ? GL_BYTE : GL_FLOAT, packed );
+  pointer( AttributeKey::color(),    layout.color,   packed ? 4 : 3, packed ? GL_UNSIGNED_BYTE : GL_FLOAT, packed );
+  pointer( AttributeKey::uv(),       layout.uv,  2, GL_FLOAT, false );
+  pointer( AttributeKey::uv2(),      layout.uv2, 2, GL_FLOAT, false );
+
+  enable( AttributeKey::uv(),  layout.uv );
+  enable( AttributeKey::uv2(), layout.uv2 );
+
+}
+
+void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryGroup& geometryGroup, Object3D& object, int instances /*= 0*/ ) {
 
   if ( material.visible == false ) return;
 
-  auto& program = setProgram( camera, lights, fog, material, object );
+  auto& program = setProgram( camera, lights, fog, material, object, instances > 0 );
 
   auto& attributes = program.attributes;
 
@@ -2952,9 +3377,15 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
 
   }
 
+  const auto& layout = geometryGroup.__glInterleaved;
+
   // vertices
 
-  if ( !material.morphTargets && attributes[AttributeKey::position()].valid() ) {
+  if ( layout.stride ) {
+
+    // bound with the other interleaved attributes below
+
+  } else if ( !material.morphTargets && attributes[AttributeKey::position()].valid() ) {
 
     if ( updateBuffers ) {
 
@@ -2963,13 +3394,9 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
 
     }
 
-  } else {
-
-    if ( object.morphTargetBase != -1 ) {
+  } else if ( material.morphTargets ) {
 
-      setupMorphTargets( material, geometryGroup, object );
-
-    }
+    setupMorphTargets( material, geometryGroup, object );
 
   }
 
@@ -2994,79 +3421,80 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
 
     int index = -1;
 
-    // colors
+    if ( layout.stride ) {
 
-    if ( (index = attributes[AttributeKey::color()]) >= 0 ) {
+      bindInterleavedBuffers( geometryGroup, attributes );
 
-      glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glColorBuffer );
-      glVertexAttribPointer( index, 3, GL_FLOAT, false, 0, 0 );
+    } else {
 
-    }
+      // colors
 
-    // normals
+      if ( (index = attributes[AttributeKey::color()]) >= 0 ) {
 
-    if ( attributes[AttributeKey::normal()].valid() ) {
+        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glColorBuffer );
+        glVertexAttribPointer( index, 3, GL_FLOAT, false, 0, 0 );
 
-      glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glNormalBuffer );
-      glVertexAttribPointer( attributes[AttributeKey::normal()], 3, GL_FLOAT, false, 0, 0 );
+      }
 
-    }
+      // normals
 
-    // tangents
+      if ( attributes[AttributeKey::normal()].valid() ) {
 
-    if ( attributes[AttributeKey::tangent()].valid() ) {
+        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glNormalBuffer );
+        glVertexAttribPointer( attributes[AttributeKey::normal()], 3, GL_FLOAT, false, 0, 0 );
 
-      glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glTangentBuffer );
-      glVertexAttribPointer( attributes[AttributeKey::tangent()], 4, GL_FLOAT, false, 0, 0 );
+      }
 
-    }
+      // tangents
 
-    // uvs
+      if ( attributes[AttributeKey::tangent()].valid() ) {
 
-    if ( attributes[AttributeKey::uv()].valid() ) {
+        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glTangentBuffer );
+        glVertexAttribPointer( attributes[AttributeKey::tangent()], 4, GL_FLOAT, false, 0, 0 );
 
-      if ( geometryGroup.__glUVBuffer ) {
+      }
 
-        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUVBuffer );
-        glVertexAttribPointer( attributes[AttributeKey::uv()], 2, GL_FLOAT, false, 0, 0 );
+      // uvs
 
-        glEnableVertexAttribArray( attributes[AttributeKey::uv()] );
+      if ( attributes[AttributeKey::uv()].valid() ) {
 
-      } else {
+        if ( geometryGroup.__glUVBuffer ) {
+
+          glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUVBuffer );
+          glVertexAttribPointer( attributes[AttributeKey::uv()], 2, GL_FLOAT, false, 0, 0 );
 
-        glDisableVertexAttribArray( attributes[AttributeKey::uv()] );
+          glEnableVertexAttribArray( attributes[AttributeKey::uv()] );
+
+        } else {
+
+          glDisableVertexAttribArray( attributes[AttributeKey::uv()] );
+
+        }
 
       }
 
-    }
+      if ( attributes[AttributeKey::uv2()].valid() ) {
 
-    if ( attributes[AttributeKey::uv2()].valid() ) {
+        if ( geometryGroup.__glUV2Buffer ) {
 
-      if ( geometryGroup.__glUV2Buffer ) {
+          glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUV2Buffer );
+          glVertexAttribPointer( attributes[AttributeKey::uv2()], 2, GL_FLOAT, false, 0, 0 );
 
-        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glUV2Buffer );
-        glVertexAttribPointer( attributes[AttributeKey::uv2()], 2, GL_FLOAT, false, 0, 0 );
+          glEnableVertexAttribArray( attributes[AttributeKey::uv2()] );
 
-        glEnableVertexAttribArray( attributes[AttributeKey::uv2()] );
+        } else {
 
-      } else {
+          glDisableVertexAttribArray( attributes[AttributeKey::uv2()] );
 
-        glDisableVertexAttribArray( attributes[AttributeKey::uv2()] );
+        }
 
       }
 
     }
 
     if ( material.skinning &&
-         attributes[AttributeKey::skinVertexA()].valid() && attributes[AttributeKey::skinVertexB()].valid() &&
          attributes[AttributeKey::skinIndex()].valid() && attributes[AttributeKey::skinWeight()].valid() ) {
 
-      glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinVertexABuffer );
-      glVertexAttribPointer( attributes[AttributeKey::skinVertexA()], 4, GL_FLOAT, false, 0, 0 );
-
-      glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinVertexBBuffer );
-      glVertexAttribPointer( attributes[AttributeKey::skinVertexB()], 4, GL_FLOAT, false, 0, 0 );
-
       glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glSkinIndicesBuffer );
       glVertexAttribPointer( attributes[AttributeKey::skinIndex()], 4, GL_FLOAT, false, 0, 0 );
 
@@ -3081,6 +3509,14 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
 
   if ( object.type() == THREE::Mesh ) {
 
+    const auto indexType = geometryGroup.__glIndex32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+    if ( instances > 0 ) {
+
+      bindInstanceBuffer( attributes, instances );
+
+    }
+
     // wireframe
 
     if ( material.wireframe ) {
@@ -3088,20 +3524,50 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
       setLineWidth( material.wireframeLinewidth );
 
       if ( updateBuffers ) glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glLineBuffer );
-      glDrawElements( GL_LINES, geometryGroup.__glLineCount, GL_UNSIGNED_SHORT, 0 );
+
+      if ( instances > 0 ) {
+        glDrawElementsInstanced( GL_LINES, geometryGroup.__glLineCount, indexType, 0, instances );
+      } else {
+        glDrawElements( GL_LINES, geometryGroup.__glLineCount, indexType, 0 );
+      }
 
       // triangles
 
     } else {
 
       if ( updateBuffers ) glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glFaceBuffer );
-      glDrawElements( GL_TRIANGLES, geometryGroup.__glFaceCount, GL_UNSIGNED_SHORT, 0 );
+
+      if ( instances > 0 ) {
+        glDrawElementsInstanced( GL_TRIANGLES, geometryGroup.__glFaceCount, indexType, 0, instances );
+      } else {
+        glDrawElements( GL_TRIANGLES, geometryGroup.__glFaceCount, indexType, 0 );
+      }
 
     }
 
+    const auto copies = std::max( instances, 1 );
+
     _info.render.calls ++;
-    _info.render.vertices += geometryGroup.__glFaceCount;
-    _info.render.faces += geometryGroup.__glFaceCount / 3;
+    _info.render.vertices += geometryGroup.__glFaceCount * copies;
+    _info.render.faces += geometryGroup.__glFaceCount / 3 * copies;
+
+    if ( instances > 0 ) {
+
+      // Attribute state is shared by all programs; other programs may use
+      // these locations for per-vertex attributes
+
+      const auto matrix = attributes[ AttributeKey::instanceMatrix() ];
+      const auto color  = attributes[ AttributeKey::instanceColor() ];
+
+      for ( int i = 0; matrix.valid() && i < 4; ++i ) {
+        glVertexAttribDivisor( matrix.value + i, 0 );
+      }
+
+      if ( color.valid() ) {
+        glVertexAttribDivisor( color, 0 );
+      }
+
+    }
 
     // render lines
 
@@ -3126,7 +3592,19 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
     glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
 #endif
 
-    glDrawArrays( GL_POINTS, 0, geometryGroup.__glParticleCount );
+    if ( geometryGroup.__glSortIndices ) {
+
+      const auto indexType = geometryGroup.__glIndex32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+      const auto count = ( int )geometryGroup.__sortArray.size();
+
+      glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, geometryGroup.__glFaceBuffer );
+      glDrawElements( GL_POINTS, count, indexType, 0 );
+
+    } else {
+
+      glDrawArrays( GL_POINTS, 0, geometryGroup.__glParticleCount );
+
+    }
 
     _info.render.calls ++;
     _info.render.points += geometryGroup.__glParticleCount;
@@ -3143,158 +3621,430 @@ void GLRenderer::renderBuffer( Camera& camera, Lights& lights, IFog* fog, Materi
 
 }
 
-// Sorting
+void GLRenderer::bindInstanceBuffer( AttributeLocations& attributes, int instances ) {
 
-struct NumericalSort {
-  template < typename T, typename U >
-  bool operator()( const std::pair<T, U>& a, const std::pair<T, U>& b ) {
-    return a.second > b.second;
+  if ( ! _instanceBuffer ) {
+    _instanceBuffer = glCreateBuffer();
   }
-};
 
-void GLRenderer::setupMorphTargets( Material& material, GeometryGroup& geometryGroup, Object3D& object ) {
+  // Respecified for every batch, so the driver can orphan the previous store
 
-#ifndef TODO_MORPH_TARGETS
+  uploadBuffer( GL_ARRAY_BUFFER, _instanceBuffer, _instanceArray.data(), instances * sizeof( InstanceAttributes ), GL_STREAM_DRAW, false );
 
-  console().warn( "GLRenderer::setupMorphTargets: Not implemented" );
+  const auto stride = ( GLsizei )sizeof( InstanceAttributes );
 
-#else
+  const auto matrix = attributes[ AttributeKey::instanceMatrix() ];
+
+  for ( int i = 0; matrix.valid() && i < 4; ++i ) {
+
+    // one column per location
+
+    glEnableVertexAttribArray( matrix.value + i );
+    glVertexAttribPointer( matrix.value + i, 4, GL_FLOAT, false, stride, ( const GLvoid* )( offsetof( InstanceAttributes, matrix ) + i * 4 * sizeof( float ) ) );
+    glVertexAttribDivisor( matrix.value + i, 1 );
+
+  }
+
+  const auto color = attributes[ AttributeKey::instanceColor() ];
+
+  if ( color.valid() ) {
+
+    glEnableVertexAttribArray( color );
+    glVertexAttribPointer( color, 3, GL_UNSIGNED_BYTE, true, stride, ( const GLvoid* )offsetof( InstanceAttributes, color ) );
+    glVertexAttribDivisor( color, 1 );
+
+  }
+
+}
+
+void GLRenderer::renderInstances( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryGroup& geometryGroup, InstancedMesh& object ) {
+
+  const auto count = object.instanceMatrices.size();
+
+  if ( count == 0 || !object.geometry ) return;
+
+  const auto& geometry = *object.geometry;
+
+  _instanceArray.resize( count );
+
+  if ( object.frustumCulled ) {
+    _cullBoxes.resize( count );
+    _cullResults.resize( count );
+  }
+
+  Matrix4 matrix;
+
+  for ( size_t i = 0; i < count; ++i ) {
+
+    auto& instance = _instanceArray[ i ];
+
+    matrix.multiply( object.matrixWorld, object.instanceMatrices[ i ] );
+    std::copy( matrix.elements, matrix.elements + 16, instance.matrix );
+
+    const auto color = i < object.instanceColors.size() ? object.instanceColors[ i ] : Color( 0xffffff );
+    instance.color[ 0 ] = ( unsigned char )( Math::clamp( color.r, 0.f, 1.f ) * 255.f + .5f );
+    instance.color[ 1 ] = ( unsigned char )( Math::clamp( color.g, 0.f, 1.f ) * 255.f + .5f );
+    instance.color[ 2 ] = ( unsigned char )( Math::clamp( color.b, 0.f, 1.f ) * 255.f + .5f );
+    instance.color[ 3 ] = 255;
+
+    if ( object.frustumCulled ) {
+      _cullBoxes[ i ] = Frustum::worldBox( geometry, matrix );
+    }
+
+  }
+
+  // cull each instance, keeping the visible ones in order
+
+  if ( object.frustumCulled ) {
+
+    _frustum.intersectsBoxes( &_cullBoxes[ 0 ], count, &_cullResults[ 0 ] );
+
+    size_t visible = 0;
+
+    for ( size_t i = 0; i < count; ++i ) {
+      if ( _cullResults[ i ] != Frustum::Outside ) {
+        _instanceArray[ visible++ ] = _instanceArray[ i ];
+      }
+    }
+
+    _instanceArray.resize( visible );
+
+  }
+
+  if ( _instanceArray.empty() ) return;
+
+  if ( _supportsInstancing ) {
+
+    renderBuffer( camera, lights, fog, material, geometryGroup, object, ( int )_instanceArray.size() );
+
+  } else {
+
+    // one draw per instance, without instance colors
+
+    const auto matrixWorld = object.matrixWorld;
+
+    for ( const auto& instance : _instanceArray ) {
+      std::copy( instance.matrix, instance.matrix + 16, object.matrixWorld.elements );
+      setupMatrices( object, camera );
+      renderBuffer( camera, lights, fog, material, geometryGroup, object );
+    }
+
+    object.matrixWorld = matrixWorld;
+
+  }
+
+}
+
+// Morph targets
+
+// "morphTarget0", "morphNormal0" and so on, built once since they are
+// looked up for every draw
+static inline const std::string& morphAttributeKey( std::vector<std::string>& keys, const char* base, int slot ) {
+  while ( ( int )keys.size() <= slot ) {
+    keys.push_back( toString( base, keys.size() ) );
+  }
+  return keys[ slot ];
+}
+
+static inline const std::string& morphTargetKey( int slot ) {
+  static std::vector<std::string> keys;
+  return morphAttributeKey( keys, "morphTarget", slot );
+}
+
+static inline const std::string& morphNormalKey( int slot ) {
+  static std::vector<std::string> keys;
+  return morphAttributeKey( keys, "morphNormal", slot );
+}
+
+static inline int morphBase( const GeometryGroup& geometryGroup, const Object3D& object ) {
+  const auto base = object.morphTargetBase;
+  return base >= 0 && base < ( int )geometryGroup.__glMorphTargetsBuffers.size() ? base : -1;
+}
+
+static inline const std::vector<float>& morphBasePositions( const GeometryGroup& geometryGroup, int base ) {
+  return base != -1 ? geometryGroup.__morphTargetsArrays[ base ] : geometryGroup.__vertexArray;
+}
+
+// The program's morphTarget slots hold the most influential targets. When
+// there are more active targets than slots, the last slot instead holds the
+// rest blended on the CPU (a "residual" target with influence 1), which the
+// shader then adds like any other target. Selections and residuals are kept
+// per object and group, and only redone when the influences change.
+
+void GLRenderer::setupMorphTargets( Material& material, GeometryGroup& geometryGroup, Object3D& object ) {
+
+  typedef Object3D::GLData::MorphState MorphState;
+
+  auto& program = *material.program;
+  auto& attributes = program.attributes;
 
   // set base
 
-  auto& attributes = material.program.attributes;
+  const auto base = morphBase( geometryGroup, object );
+  const auto baseBuffer = base != -1 ? geometryGroup.__glMorphTargetsBuffers[ base ] : geometryGroup.__glVertexBuffer;
 
-  if ( object.morphTargetBase != -1 ) {
+  if ( attributes[AttributeKey::position()].valid() ) {
 
-    glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glMorphTargetsBuffers[ object.morphTargetBase ] );
+    glBindBuffer( GL_ARRAY_BUFFER, baseBuffer );
     glVertexAttribPointer( attributes[AttributeKey::position()], 3, GL_FLOAT, false, 0, 0 );
 
-  } else if ( attributes[AttributeKey::position()].valid() ) {
+  }
 
-  glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glVertexBuffer );
-    glVertexAttribPointer( attributes[AttributeKey::position()], 3, GL_FLOAT, false, 0, 0 );
+  const auto slots = material.numSupportedMorphTargets;
+
+  if ( slots == 0 ) return;
+
+  auto& state = object.glData.__glMorphStates[ geometryGroup.id ];
+
+  if ( state.influences != object.morphTargetInfluences ||
+       state.base != base ||
+       state.slots != slots ||
+       state.morphNormals != material.morphNormals ||
+       state.blendExcess != blendExcessMorphTargets ||
+       state.version != geometryGroup.__glMorphVersion ||
+       !object.morphTargetForcedOrder.empty() ) {
+
+    selectMorphTargets( material, geometryGroup, object, state );
 
   }
 
-  if ( object.morphTargetForcedOrder.size() ) {
+  // bind the selected targets; unused slots get the base, with influence 0
 
-  // set forced order
+  const auto normalSlots = material.morphNormals ? material.numSupportedMorphNormals : 0;
 
-  auto m = 0;
-  auto& order = object.morphTargetForcedOrder;
-  auto& influences = object.glData.morphTargetInfluences;
+  for ( int m = 0; m < slots; m ++ ) {
 
-  while ( m < material.numSupportedMorphTargets && m < order.size() ) {
+    const auto target = state.targets[ m ];
 
-      glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glMorphTargetsBuffers[ order[ m ] ] );
-      glVertexAttribPointer( attributes[ "morphTarget" + m ], 3, GL_FLOAT, false, 0, 0 );
+    glBindBuffer( GL_ARRAY_BUFFER, target >= 0 ? geometryGroup.__glMorphTargetsBuffers[ target ] :
+                                   target == MorphState::Residual ? state.__glResidualBuffer : baseBuffer );
+    glVertexAttribPointer( attributes[ morphTargetKey( m ) ], 3, GL_FLOAT, false, 0, 0 );
 
-      if ( material.morphNormals ) {
+    if ( m < normalSlots ) {
 
-        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glMorphNormalsBuffers[ order[ m ] ] );
-        glVertexAttribPointer( attributes[ "morphNormal" + m ], 3, GL_FLOAT, false, 0, 0 );
+      auto normals = geometryGroup.__glNormalBuffer;
 
+      if ( target >= 0 && target < ( int )geometryGroup.__glMorphNormalsBuffers.size() ) {
+        normals = geometryGroup.__glMorphNormalsBuffers[ target ];
+      } else if ( target == MorphState::Residual && state.__glResidualNormalBuffer ) {
+        normals = state.__glResidualNormalBuffer;
       }
 
-      object.glData.__glMorphTargetInfluences[ m ] = influences[ order[ m ] ];
+      glBindBuffer( GL_ARRAY_BUFFER, normals );
+      glVertexAttribPointer( attributes[ morphNormalKey( m ) ], 3, GL_FLOAT, false, 0, 0 );
 
-      m ++;
     }
 
-  } else {
+  }
+
+  // load updated influences uniform
+
+  if ( auto slot = program.builtin( BuiltinUniform::morphTargetInfluences ) ) {
+    if ( slot->update( state.weights.data(), state.weights.size() * sizeof( float ) ) ) {
+      glUniform1fv( slot->location, ( GLsizei )state.weights.size(), state.weights.data() );
+    }
+  }
+
+}
+
+void GLRenderer::selectMorphTargets( Material& material, GeometryGroup& geometryGroup, Object3D& object, Object3D::GLData::MorphState& state ) {
 
-    // find the most influencing
+  typedef Object3D::GLData::MorphState MorphState;
+
+  const auto& influences = object.morphTargetInfluences;
+  const auto targetCount = std::min( ( int )influences.size(), ( int )geometryGroup.__glMorphTargetsBuffers.size() );
+  const auto slots = material.numSupportedMorphTargets;
+  const auto base = morphBase( geometryGroup, object );
+
+  // a residual blended from another base or without normals is of no use
+  if ( state.base != base || state.morphNormals != material.morphNormals ) {
+    state.residual.clear();
+  }
 
-    typedef std::pair<int, int> IndexedInfluence;
-    std::vector<IndexedInfluence> activeInfluenceIndices;
-    auto& influences = object.morphTargetInfluences;
+  state.influences = influences;
+  state.base = base;
+  state.slots = slots;
+  state.morphNormals = material.morphNormals;
+  state.blendExcess = blendExcessMorphTargets;
+  state.version = geometryGroup.__glMorphVersion;
 
-    for ( size_t i = 0, il = influences.size(); i < il; i ++ ) {
+  state.targets.assign( slots, MorphState::Unused );
+  state.weights.assign( slots, 0.f );
 
-      auto& influence = influences[ i ];
+  if ( ! object.morphTargetForcedOrder.empty() ) {
 
-      if ( influence > 0 ) {
+    // set forced order
 
-        activeInfluenceIndices.push_back( IndexedInfluence( i, influence ) );
+    const auto& order = object.morphTargetForcedOrder;
 
+    for ( int m = 0; m < slots && m < ( int )order.size(); m ++ ) {
+      if ( order[ m ] >= 0 && order[ m ] < targetCount ) {
+        state.targets[ m ] = order[ m ];
+        state.weights[ m ] = influences[ order[ m ] ];
       }
+    }
+
+    return;
+
+  }
+
+  // find the most influential, partitioning a scratch list rather than
+  // sorting a new one
+
+  auto& active = _morphScratch;
+  active.clear();
 
+  for ( int t = 0; t < targetCount; t ++ ) {
+    if ( influences[ t ] != 0 ) {
+      active.emplace_back( std::abs( influences[ t ] ), t );
     }
+  }
 
-    if ( activeInfluenceIndices.size() > material.numSupportedMorphTargets ) {
+  const auto activeCount = ( int )active.size();
 
-      std::sort( activeInfluenceIndices.begin(),
-                 activeInfluenceIndices.end(),
-                 NumericalSort() );
-      activeInfluenceIndices.resize( material.numSupportedMorphTargets );
+  const auto& basePositions = morphBasePositions( geometryGroup, base );
 
-    } else if ( activeInfluenceIndices.size() > material.numSupportedMorphNormals ) {
+  const auto residual = activeCount > slots && blendExcessMorphTargets &&
+                        !basePositions.empty() &&
+                        basePositions.size() == geometryGroup.__morphTargetsArrays[ 0 ].size();
 
-      std::sort( activeInfluenceIndices.begin(),
-                 activeInfluenceIndices.end(),
-                 NumericalSort() );
+  const auto kept = residual ? slots - 1 : std::min( slots, activeCount );
 
-    } else if ( activeInfluenceIndices.size() == 0 ) {
+  if ( activeCount > kept ) {
+    std::nth_element( active.begin(), active.begin() + kept, active.end(),
+                      []( const std::pair<float, int>& a, const std::pair<float, int>& b ) {
+                        return a.first > b.first;
+                      } );
+  }
 
-      activeInfluenceIndices.push_back( IndexedInfluence( 0, 0 ) );
+  // in target order, so the same selection loads the same uniform
 
-    }
+  const auto byTarget = []( const std::pair<float, int>& a, const std::pair<float, int>& b ) {
+    return a.second < b.second;
+  };
 
-    auto influenceIndex, m = 0;
+  std::sort( active.begin(), active.begin() + kept, byTarget );
 
-    while ( m < material.numSupportedMorphTargets ) {
+  for ( int m = 0; m < kept; m ++ ) {
+    state.targets[ m ] = active[ m ].second;
+    state.weights[ m ] = influences[ active[ m ].second ];
+  }
 
-      if ( activeInfluenceIndices[ m ] ) {
+  if ( ! residual ) {
 
-        influenceIndex = activeInfluenceIndices[ m ][ 0 ];
+    // any others are dropped
+    state.residual.clear();
+    return;
 
-        glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glMorphTargetsBuffers[ influenceIndex ] );
+  }
 
-        glVertexAttribPointer( attributes[ "morphTarget" + m ], 3, GL_FLOAT, false, 0, 0 );
+  state.targets[ slots - 1 ] = MorphState::Residual;
+  state.weights[ slots - 1 ] = 1;
 
-        if ( material.morphNormals ) {
+  std::sort( active.begin() + kept, active.end(), byTarget );
 
-          glBindBuffer( GL_ARRAY_BUFFER, geometryGroup.__glMorphNormalsBuffers[ influenceIndex ] );
-          glVertexAttribPointer( attributes[ "morphNormal" + m ], 3, GL_FLOAT, false, 0, 0 );
+  auto current = state.residualVersion == geometryGroup.__glMorphVersion &&
+                 state.residual.size() == active.size() - kept;
 
-        }
+  for ( size_t i = 0; current && i < state.residual.size(); i ++ ) {
+    const auto target = active[ kept + i ].second;
+    current = state.residual[ i ].first == target && state.residual[ i ].second == influences[ target ];
+  }
 
-        object.__glMorphTargetInfluences[ m ] = influences[ influenceIndex ];
+  if ( current ) return;
 
-      } else {
+  state.residual.clear();
 
-        glVertexAttribPointer( attributes[ "morphTarget" + m ], 3, GL_FLOAT, false, 0, 0 );
+  for ( auto it = active.begin() + kept; it != active.end(); ++it ) {
+    state.residual.emplace_back( it->second, influences[ it->second ] );
+  }
 
-        if ( material.morphNormals ) {
+  state.residualVersion = geometryGroup.__glMorphVersion;
 
-          glVertexAttribPointer( attributes[ "morphNormal" + m ], 3, GL_FLOAT, false, 0, 0 );
+  blendMorphResidual( geometryGroup, state, slots - 1 < material.numSupportedMorphNormals && material.morphNormals );
 
-        }
+}
+
+void GLRenderer::blendMorphResidual( GeometryGroup& geometryGroup, Object3D::GLData::MorphState& state, bool normals ) {
+
+  const auto& basePositions = morphBasePositions( geometryGroup, state.base );
+
+  _morphArrays.clear();
+  _morphWeights.clear();
+
+  for ( const auto& target : state.residual ) {
+    _morphArrays.push_back( geometryGroup.__morphTargetsArrays[ target.first ].data() );
+    _morphWeights.push_back( target.second );
+  }
+
+  state.residualArray.resize( basePositions.size() );
+
+  simd::blendArrays( basePositions.data(), _morphArrays.data(), _morphWeights.data(), _morphArrays.size(),
+                     state.residualArray.data(), basePositions.size() );
+
+  if ( ! state.__glResidualBuffer ) {
+    state.__glResidualBuffer = glCreateBuffer();
+  }
+
+  uploadBuffer( GL_ARRAY_BUFFER, state.__glResidualBuffer, state.residualArray, GL_DYNAMIC_DRAW, false );
+
+  const auto& baseNormals = geometryGroup.__normalArray;
+
+  if ( ! normals || baseNormals.size() != basePositions.size() ) {
+
+    // the slot falls back to the unmorphed normals
+    if ( state.__glResidualNormalBuffer ) {
+      deleteBuffer( state.__glResidualNormalBuffer );
+    }
+
+    return;
+
+  }
+
+  // targets without normals keep the base ones
 
-        object.__glMorphTargetInfluences[ m ] = 0;
+  _morphArrays.clear();
 
-      }
+  for ( const auto& target : state.residual ) {
+    const auto& morphNormals = geometryGroup.__morphNormalsArrays;
+    _morphArrays.push_back( target.first < ( int )morphNormals.size() && morphNormals[ target.first ].size() == baseNormals.size() ?
+                            morphNormals[ target.first ].data() : baseNormals.data() );
+  }
 
-      m ++;
+  state.residualNormalArray.resize( baseNormals.size() );
 
-    }
+  simd::blendArrays( baseNormals.data(), _morphArrays.data(), _morphWeights.data(), _morphArrays.size(),
+                     state.residualNormalArray.data(), baseNormals.size() );
 
+  if ( ! state.__glResidualNormalBuffer ) {
+    state.__glResidualNormalBuffer = glCreateBuffer();
   }
 
-  // load updated influences uniform
+  uploadBuffer( GL_ARRAY_BUFFER, state.__glResidualNormalBuffer, state.residualNormalArray, GL_DYNAMIC_DRAW, false );
 
-  if ( material.program.uniforms.morphTargetInfluences.size() > 0 ) {
+}
 
-  glUniform1fv( material.program.uniforms.morphTargetInfluences, object.__glMorphTargetInfluences );
+void GLRenderer::deleteMorphStates( Object3D& object ) {
 
+  for ( auto& state : object.glData.__glMorphStates ) {
+    if ( state.second.__glResidualBuffer ) deleteBuffer( state.second.__glResidualBuffer );
+    if ( state.second.__glResidualNormalBuffer ) deleteBuffer( state.second.__glResidualNormalBuffer );
   }
 
-#endif // TODO_MORPH_TARGETS
+  object.glData.__glMorphStates.clear();
 
 }
 
 // Rendering
 
+// Objects the renderer frustum culls: instanced meshes cull each instance
+// when they are drawn, and lines and ribbons are always drawn
+
+static inline bool frustumCullable( Object3D& object ) {
+  return ( object.type() == THREE::Mesh && !static_cast<Mesh&>( object ).instanced() ) ||
+         object.type() == THREE::ParticleSystem;
+}
+
 void GLRenderer::render( Scene& scene, Camera& camera, const GLRenderTarget::Ptr& renderTarget /*= GLRenderTarget::Ptr()*/, bool forceClear /*= false*/ ) {
 
   auto& lights = scene.__lights;
@@ -3323,8 +4073,15 @@ void GLRenderer::render( Scene& scene, Camera& camera, const GLRenderTarget::Ptr
 
   // update WebGL objects
 
+  _info.upload = Info::Upload();
+
   if ( autoUpdateObjects ) initGLObjects( scene );
 
+  // bone palettes of every skinned mesh, in parallel, before any pass
+  // draws them
+
+  SkinnedMesh::update( scene.__glSkinned.data(), scene.__glSkinned.size(), _skinningPool );
+
 
   // custom render plugins (pre pass)
 
@@ -3346,22 +4103,107 @@ void GLRenderer::render( Scene& scene, Camera& camera, const GLRenderTarget::Ptr
   // set matrices for regular objects (frustum culled)
 
   auto& renderList = scene.__glObjects;
+  auto& rendered = scene.__glObjectsRendered;
 
-  for ( auto& glObject : renderList ) {
+  // objects in a static batch are drawn by it
+
+  auto isCulled = []( Object3D& object ) {
+    return object.visible && !object.batched && object.frustumCulled && frustumCullable( object );
+  };
+
+  // With a spatial index, visit only the entries of the objects it finds
+  // in the frustum and those never culled, in list order; otherwise cull
+  // all candidates in one batch against world-space boxes
+
+  auto index = scene.spatialIndex.get();
+
+  _cullBoxes.clear();
+  _cullPlanes.clear();
+  _cullEntries.clear();
+
+  if ( index ) {
+
+    index->update( scene );
+
+    for ( auto i : rendered ) {
+      renderList[ i ].render = false;
+    }
+
+    _cullObjects.clear();
+    index->cull( _frustum, _cullObjects );
+
+    for ( auto object : _cullObjects ) {
+      if ( frustumCullable( *object ) ) {
+        const auto& glData = object->glData;
+        for ( size_t i = 0; i < glData.__glObjectsCount; ++i ) {
+          _cullEntries.push_back( glData.__glObjectsBegin + i );
+        }
+      }
+    }
+
+    _cullEntries.insert( _cullEntries.end(), scene.__glObjectsUnculled.begin(), scene.__glObjectsUnculled.end() );
+
+    std::sort( _cullEntries.begin(), _cullEntries.end() );
+
+    // deferred from initGLObjects()
+
+    if ( autoUpdateObjects ) {
+      const Object3D* updated = nullptr;
+      for ( auto i : _cullEntries ) {
+        auto object = renderList[ i ].object;
+        if ( object != updated ) {
+          updateObject( *object );
+          updated = object;
+        }
+      }
+    }
+
+  } else {
+
+    for ( size_t i = 0; i < renderList.size(); ++i ) {
+      auto& object = *renderList[ i ].object;
+      renderList[ i ].render = false;
+      if ( isCulled( object ) ) {
+        _cullBoxes.push_back( Frustum::worldBox( object ) );
+        _cullPlanes.push_back( object.__frustumPlane );
+      }
+      _cullEntries.push_back( i );
+    }
+
+  }
 
+  _cullResults.resize( _cullBoxes.size() );
+
+  if ( !_cullBoxes.empty() ) {
+    _frustum.intersectsBoxes( &_cullBoxes[ 0 ], _cullBoxes.size(), &_cullResults[ 0 ], &_cullPlanes[ 0 ] );
+  }
+
+  size_t cullIndex = 0;
+
+  rendered.clear();
+
+  for ( auto i : _cullEntries ) {
+
+    auto& glObject = renderList[ i ];
     auto& object = *glObject.object;
 
-    glObject.render = false;
+    auto inFrustum = true;
 
-    if ( object.visible ) {
+    if ( !index && isCulled( object ) ) {
+      object.__frustumPlane = _cullPlanes[ cullIndex ];
+      inFrustum = _cullResults[ cullIndex++ ] != Frustum::Outside;
+    }
+
+    if ( object.visible && !object.batched ) {
 
-      if ( !( object.type() == THREE::Mesh || object.type() == THREE::ParticleSystem ) ||
-           !( object.frustumCulled ) || _frustum.contains( object ) ) {
+      if ( inFrustum ) {
         //object.matrixWorld.flattenToArray( object._modelMatrixArray );
 
-        setupMatrices( object, camera );
+        // matrices are set up when drawn; instanced draws don't need them
+
         unrollBufferMaterial( glObject );
         glObject.render = true;
+        rendered.push_back( i );
 
         if ( sortObjects ) {
 
@@ -3381,10 +4223,34 @@ void GLRenderer::render( Scene& scene, Camera& camera, const GLRenderTarget::Ptr
 
   }
 
-  if ( sortObjects ) {
-    std::sort( renderList.begin(), renderList.end(), PainterSort() );
+  // order draws by pass, then state (opaque) or depth (transparent)
+
+  _drawList.clear();
+
+  for ( auto i : rendered ) {
+
+    auto& glObject = renderList[ i ];
+
+    if ( glObject.opaque ) {
+      Draw draw = { drawKey( THREE::Opaque, *glObject.opaque, glObject.z, sortObjects ), &glObject };
+      _drawList.push_back( draw );
+    }
+
+    if ( glObject.transparent ) {
+      Draw draw = { drawKey( THREE::Transparent, *glObject.transparent, glObject.z, sortObjects ), &glObject };
+      _drawList.push_back( draw );
+    }
+
   }
 
+  radixSort( _drawList, _drawScratch, []( const Draw& draw ) { return draw.key; } );
+
+  const auto drawsBegin = _drawList.data();
+  const auto drawsEnd   = drawsBegin + _drawList.size();
+  const auto transparentBegin = std::find_if( drawsBegin, drawsEnd, []( const Draw& draw ) {
+    return draw.key >> 62 != 0;
+  } );
+
   // set matrices for immediate objects
 
   auto& immediateList = scene.__glObjectsImmediate;
@@ -3418,16 +4284,16 @@ void GLRenderer::render( Scene& scene, Camera& camera, const GLRenderTarget::Ptr
 
   } else {
 
-    // opaque pass (front-to-back order)
+    // opaque pass (grouped by state, then front-to-back)
 
     setBlending( THREE::NormalBlending );
 
-    renderObjects( scene.__glObjects, true, THREE::Opaque, camera, lights, fog, false );
+    renderDraws( drawsBegin, transparentBegin, THREE::Opaque, camera, lights, fog, false );
     renderObjectsImmediate( scene.__glObjectsImmediate, THREE::Opaque, camera, lights, fog, false );
 
     // transparent pass (back-to-front order)
 
-    renderObjects( scene.__glObjects, false, THREE::Transparent, camera, lights, fog, true );
+    renderDraws( transparentBegin, drawsEnd, THREE::Transparent, camera, lights, fog, true );
     renderObjectsImmediate( scene.__glObjectsImmediate, THREE::Transparent, camera, lights, fog, true );
 
   }
@@ -3520,18 +4386,191 @@ void GLRenderer::renderObjects( RenderList& renderList, bool reverse, THREE::Ren
 
       setMaterialFaces( *material );
 
-      if ( buffer.type() == THREE::BufferGeometry ) {
-        renderBufferDirect( camera, lights, fog, *material, static_cast<BufferGeometry&>( buffer ), object );
-      } else {
-        renderBuffer( camera, lights, fog, *material, static_cast<GeometryGroup&>( buffer ), object );
+      renderDraw( camera, lights, fog, *material, buffer, object );
+
+    }
+
+  }
+
+}
+
+// Draw keys, most significant first:
+//   opaque:      pass:2 | program:10 | textures:10 | material:12 | depth:30 ascending
+//   transparent: pass:2 | depth:30 descending | program:16 | material:16
+// Ids are truncated to their fields, which only costs some grouping.
+// Without sortByDepth the depth bits are zero, and transparent keys are the
+// pass alone, so the stable sort draws them in list order.
+
+std::uint64_t GLRenderer::drawKey( THREE::RenderType materialType, const Material& material, float z, bool sortByDepth ) {
+
+  const std::uint64_t program = material.program ? (unsigned)material.program->id : 0;
+  const std::uint64_t id      = (unsigned)material.id;
+  const std::uint64_t depth   = sortByDepth ? sortableFloat( z ) >> 2 : 0;
+
+  if ( materialType == THREE::Transparent ) {
+    if ( !sortByDepth ) {
+      return std::uint64_t( 1 ) << 62;
+    }
+    return ( std::uint64_t( 1 ) << 62 ) |
+           ( ( ~depth & 0x3FFFFFFF ) << 32 ) |
+           ( ( program & 0xFFFF ) << 16 ) |
+           ( id & 0xFFFF );
+  }
+
+  std::uint64_t textures = 0;
+  for ( const auto* texture : { material.map.get(), material.envMap.get(), material.lightMap.get(),
+                                material.bumpMap.get(), material.specularMap.get() } ) {
+    textures = textures * 31 + ( texture ? (unsigned)texture->id + 1 : 0 );
+  }
+
+  return ( ( program & 0x3FF ) << 52 ) |
+         ( ( textures & 0x3FF ) << 42 ) |
+         ( ( id & 0xFFF ) << 30 ) |
+         depth;
+
+}
+
+void GLRenderer::renderDraws( const Draw* begin, const Draw* end, THREE::RenderType materialType, Camera& camera, Lights& lights, IFog* fog, bool useBlending ) {
+
+  auto materialOf = [materialType]( const Draw& draw ) -> Material& {
+    return materialType == THREE::Opaque ? *draw.glObject->opaque : *draw.glObject->transparent;
+  };
+
+  for ( auto draw = begin; draw != end; ) {
+
+    // draws of one material are adjacent
+
+    auto& material = materialOf( *draw );
+
+    auto run = draw + 1;
+    while ( run != end && &materialOf( *run ) == &material ) ++run;
+
+    if ( useBlending ) setBlending( material.blending, material.blendEquation, material.blendSrc, material.blendDst );
+
+    setDepthTest( material.depthTest );
+    setDepthWrite( material.depthWrite );
+    setPolygonOffset( material.polygonOffset, material.polygonOffsetFactor, material.polygonOffsetUnits );
+
+    setMaterialFaces( material );
+
+    // Opaque draws of one geometry group become one instanced draw, issued
+    // where the first (nearest) of them would have been. _instanceRuns
+    // holds group id:32 | position in run:32 of each candidate, sorted;
+    // _instanceBatches holds, per position, 0 to draw alone, -1 to skip,
+    // or 1 + the index in _instanceRuns of the batch it starts.
+
+    const auto size = run - draw;
+
+    _instanceRuns.clear();
+
+    if ( materialType == THREE::Opaque && instanceMeshes && _supportsInstancing && size > 1 ) {
+
+      for ( auto i = 0; i < size; ++i ) {
+        if ( canInstance( draw[ i ] ) ) {
+          const auto id = ( std::uint32_t )static_cast<GeometryGroup&>( *draw[ i ].glObject->buffer ).id;
+          _instanceRuns.push_back( ( std::uint64_t( id ) << 32 ) | std::uint64_t( i ) );
+        }
+      }
+
+    }
+
+    _instanceBatches.assign( size, 0 );
+
+    if ( _instanceRuns.size() > 1 ) {
+
+      std::sort( _instanceRuns.begin(), _instanceRuns.end() );
+
+      for ( size_t i = 0, j = 0; i < _instanceRuns.size(); i = j ) {
+
+        while ( j < _instanceRuns.size() && _instanceRuns[ j ] >> 32 == _instanceRuns[ i ] >> 32 ) ++j;
+
+        if ( j - i > 1 ) {
+          _instanceBatches[ _instanceRuns[ i ] & 0xFFFFFFFF ] = ( int )i + 1;
+          for ( auto k = i + 1; k < j; ++k ) {
+            _instanceBatches[ _instanceRuns[ k ] & 0xFFFFFFFF ] = -1;
+          }
+        }
+
+      }
+
+    }
+
+    for ( auto i = 0; i < size; ++i ) {
+
+      const auto batch = _instanceBatches[ i ];
+
+      if ( batch < 0 ) continue;
+
+      auto& glObject = *draw[ i ].glObject;
+
+      if ( batch == 0 ) {
+        renderDraw( camera, lights, fog, material, *glObject.buffer, *glObject.object );
+        continue;
+      }
+
+      _instanceArray.clear();
+
+      const auto group = _instanceRuns[ batch - 1 ] >> 32;
+
+      for ( auto k = ( size_t )batch - 1; k < _instanceRuns.size() && _instanceRuns[ k ] >> 32 == group; ++k ) {
+
+        const auto& object = *draw[ _instanceRuns[ k ] & 0xFFFFFFFF ].glObject->object;
+
+        InstanceAttributes instance;
+        std::copy( object.matrixWorld.elements, object.matrixWorld.elements + 16, instance.matrix );
+        std::fill( instance.color, instance.color + 4, ( unsigned char )255 );
+        _instanceArray.push_back( instance );
+
       }
 
+      renderBuffer( camera, lights, fog, material, static_cast<GeometryGroup&>( *glObject.buffer ), *glObject.object, ( int )_instanceArray.size() );
+
     }
 
+    draw = run;
+
   }
 
 }
 
+void GLRenderer::renderDraw( Camera& camera, Lights& lights, IFog* fog, Material& material, GeometryBuffer& buffer, Object3D& object ) {
+
+  if ( buffer.type() == THREE::BufferGeometry ) {
+
+    setupMatrices( object, camera );
+    renderBufferDirect( camera, lights, fog, material, static_cast<BufferGeometry&>( buffer ), object );
+
+  } else if ( object.type() == THREE::Mesh && static_cast<Mesh&>( object ).instanced() ) {
+
+    renderInstances( camera, lights, fog, material, static_cast<GeometryGroup&>( buffer ), *static_cast<Mesh&>( object ).instanced() );
+
+  } else {
+
+    setupMatrices( object, camera );
+    renderBuffer( camera, lights, fog, material, static_cast<GeometryGroup&>( buffer ), object );
+
+  }
+
+}
+
+// Meshes whose draws can be batched: built-in materials, no per-object
+// vertex animation
+
+bool GLRenderer::canInstance( const Draw& draw ) const {
+
+  const auto& glObject = *draw.glObject;
+  auto& object = *glObject.object;
+  const auto& material = *glObject.opaque;
+
+  return object.type() == THREE::Mesh &&
+         glObject.buffer->type() != THREE::BufferGeometry &&
+         !static_cast<Mesh&>( object ).instanced() &&
+         !static_cast<Mesh&>( object ).skinned() &&
+         material.type() != THREE::ShaderMaterial &&
+         !material.skinning && !material.morphTargets;
+
+}
+
 void GLRenderer::renderObjectsImmediate( RenderList& renderList, THREE::RenderType materialType, Camera& camera, Lights& lights, IFog* fog, bool useBlending, Material* overrideMaterial /*= nullptr*/ ) {
 
   for ( auto& glObject : renderList ) {
@@ -3679,6 +4718,9 @@ void GLRenderer::sortFacesByMaterial( Geometry& geometry ) {
 
   geometry.geometryGroups.clear();
 
+  // Without 32 bit indices, groups are split to stay addressable by 16 bit ones
+  const int maxVertices = _glExtensionElementIndexUint ? std::numeric_limits<int>::max() : 65535;
+
   for ( int f = 0, fl = ( int )geometry.faces.size(); f < fl; ++f ) {
 
     const auto& face = geometry.faces[ f ];
@@ -3700,7 +4742,7 @@ void GLRenderer::sortFacesByMaterial( Geometry& geometry ) {
 
     const auto vertices = face.type() == THREE::Face3 ? 3 : 4;
 
-    if ( geometryGroup->vertices + vertices > 65535 ) {
+    if ( geometryGroup->vertices + vertices > maxVertices ) {
 
       hash_map[ materialHash ].second += 1;
       groupHash = toString( hash_map[ materialHash ] );
@@ -3740,17 +4782,21 @@ void GLRenderer::initGLObjects( Scene& scene ) {
     scene.__glSprites.clear();
     scene.__glFlares.clear();*/
 
-  while ( scene.__objectsAdded.size() ) {
-    addObject( *scene.__objectsAdded[ 0 ], scene );
-    scene.__objectsAdded.erase( scene.__objectsAdded.begin() );
+  for ( auto& object : scene.__objectsAdded ) {
+    addObject( *object, scene );
   }
+  scene.__objectsAdded.clear();
+  scene.__objectsAddedSlots.clear();
 
-  while ( scene.__objectsRemoved.size() ) {
-    removeObject( *scene.__objectsRemoved[ 0 ], scene );
-    scene.__objectsRemoved.erase( scene.__objectsRemoved.begin() );
-  }
+  removeObjects( scene );
+  scene.__objectsRemoved.clear();
+  scene.__objectsRemovedSlots.clear();
 
-  // update must be called after objects adding / removal
+  // update must be called after objects adding / removal; with a spatial
+  // index, render() updates the objects it draws instead
+
+  if ( scene.spatialIndex )
+    return;
 
   for ( auto& glObject : scene.__glObjects ) {
     updateObject( *glObject.object );
@@ -3855,7 +4901,11 @@ void GLRenderer::addObject( Object3D& object, Scene& scene ) {
 
       auto& geometry = *object.geometry;
 
-      if ( ! geometry.__glVertexBuffer ) {
+      if ( geometry.type() == THREE::BufferGeometry ) {
+
+        initDirectBuffers( geometry );
+
+      } else if ( ! geometry.__glVertexBuffer ) {
 
         createParticleBuffers( geometry );
         initParticleBuffers( geometry, object );
@@ -3871,6 +4921,8 @@ void GLRenderer::addObject( Object3D& object, Scene& scene ) {
 
   if ( ! object.glData.__glActive ) {
 
+    const auto begin = scene.__glObjects.size();
+
     if ( object.type() == THREE::Mesh ) {
 
       auto& geometry = *object.geometry;
@@ -3910,6 +4962,21 @@ void GLRenderer::addObject( Object3D& object, Scene& scene ) {
 
     }
 
+    if ( object.type() == THREE::Mesh ) {
+      if ( auto skinned = static_cast<Mesh&>( object ).skinned() ) {
+        scene.__glSkinned.push_back( skinned );
+      }
+    }
+
+    object.glData.__glObjectsBegin = begin;
+    object.glData.__glObjectsCount = scene.__glObjects.size() - begin;
+
+    if ( !frustumCullable( object ) ) {
+      for ( auto i = begin; i < scene.__glObjects.size(); ++i ) {
+        scene.__glObjectsUnculled.push_back( i );
+      }
+    }
+
     object.glData.__glActive = true;
 
   }
@@ -3972,6 +5039,14 @@ void GLRenderer::updateObject( Object3D& object ) {
 
       }
 
+      if ( geometry.verticesNeedUpdate || geometry.elementsNeedUpdate ) {
+        if ( geometry.bvh && geometry.bvh->fitFlagged ) {
+          geometry.bvh->fitFlagged = false;
+        } else {
+          geometry.bvhNeedsUpdate = true;
+        }
+      }
+
       geometry.verticesNeedUpdate     = false;
       geometry.morphTargetsNeedUpdate = false;
       geometry.elementsNeedUpdate     = false;
@@ -4011,6 +5086,11 @@ void GLRenderer::updateObject( Object3D& object ) {
 
   } else if ( object.type() == THREE::ParticleSystem ) {
 
+    if ( geometry.type() == THREE::BufferGeometry ) {
+      setParticleDirectBuffers( geometry, GL_DYNAMIC_DRAW );
+      return;
+    }
+
     auto material = getBufferMaterial( object, geometryGroup );
 
     if ( !material ) return;
@@ -4052,72 +5132,107 @@ void GLRenderer::clearCustomAttributes( Material& material ) {
 
 // Objects removal
 
-void GLRenderer::removeObject( Object3D& object, Scene& scene ) {
+// All of the frame's removals go in one pass over each list, which keeps
+// the order of the remaining objects
+
+void GLRenderer::removeObjects( Scene& scene ) {
 
-  if ( object.type() == THREE::Mesh  ||
-       object.type() == THREE::ParticleSystem ||
-       object.type() == THREE::Ribbon ||
-       object.type() == THREE::Line ) {
-    removeInstances( scene.__glObjects, object );
-  } else if ( object.type() == THREE::Sprite ) {
-    removeInstancesDirect( scene.__glSprites, object );
-  } else if ( object.type() == THREE::LensFlare ) {
-    removeInstancesDirect( scene.__glFlares, object );
-  } else if ( object.type() == THREE::ImmediateRenderObject || object.immediateRenderCallback ) {
-    removeInstances( scene.__glObjectsImmediate, object );
+  if ( scene.__objectsRemoved.empty() )
+    return;
+
+  _removedObjects.clear();
+
+  for ( auto& object : scene.__objectsRemoved ) {
+    _removedObjects.push_back( object.get() );
+    object->glData.__glActive = false;
+    object->glData.__glObjectsCount = 0;
   }
 
-  object.glData.__glActive = false;
+  std::sort( _removedObjects.begin(), _removedObjects.end() );
 
-}
+  removeInstances( scene.__glObjects );
+  removeInstances( scene.__glObjectsImmediate );
+  removeInstancesDirect( scene.__glSprites );
+  removeInstancesDirect( scene.__glFlares );
 
-void GLRenderer::removeInstances( RenderList& objlist, Object3D& object ) {
+  auto& skinned = scene.__glSkinned;
 
-  for ( auto o = (int)objlist.size() - 1; o >= 0; o -- ) {
-    if ( objlist[ o ].object == &object ) {
-      objlist.erase( objlist.begin() + o );
+  skinned.erase( std::remove_if( skinned.begin(), skinned.end(), [this]( SkinnedMesh* mesh ) {
+    return std::binary_search( _removedObjects.begin(), _removedObjects.end(), static_cast<Object3D*>( mesh ) );
+  } ), skinned.end() );
+
+  // The remaining entries moved up: find their objects' ranges again
+
+  auto& renderList = scene.__glObjects;
+
+  scene.__glObjectsRendered.clear();
+  scene.__glObjectsUnculled.clear();
+
+  for ( size_t i = renderList.size(); i-- > 0; ) {
+    renderList[ i ].render = false;
+    renderList[ i ].object->glData.__glObjectsBegin = i;
+  }
+
+  for ( size_t i = 0; i < renderList.size(); ++i ) {
+    if ( !frustumCullable( *renderList[ i ].object ) ) {
+      scene.__glObjectsUnculled.push_back( i );
     }
   }
 
 }
 
-void GLRenderer::removeInstancesDirect( RenderListDirect& objlist, Object3D& object ) {
+void GLRenderer::removeInstances( RenderList& objlist ) {
 
-  for ( auto o = (int)objlist.size() - 1; o >= 0; o -- ) {
-    if ( objlist[ o ] == &object ) {
-      objlist.erase( objlist.begin() + o );
-    }
-  }
+  objlist.erase( std::remove_if( objlist.begin(), objlist.end(), [this]( const Scene::GLObject& glObject ) {
+    return std::binary_search( _removedObjects.begin(), _removedObjects.end(), glObject.object );
+  } ), objlist.end() );
+
+}
+
+void GLRenderer::removeInstancesDirect( RenderListDirect& objlist ) {
+
+  objlist.erase( std::remove_if( objlist.begin(), objlist.end(), [this]( Object3D* object ) {
+    return std::binary_search( _removedObjects.begin(), _removedObjects.end(), object );
+  } ), objlist.end() );
 
 }
 
 // Materials
 
-void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Object3D& object ) {
+void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Object3D& object, bool instanced /*= false*/ ) {
 
   std::string shaderID;
 
+  const Shader* shaders = nullptr;
+
   switch ( material.type() ) {
   case THREE::MeshDepthMaterial:
-    setMaterialShaders( material, ShaderLib::depth() );
+    shaderID = "depth";
+    shaders = &ShaderLib::depth();
     break;
   case THREE::MeshNormalMaterial:
-    setMaterialShaders( material, ShaderLib::normal() );
+    shaderID = "normal";
+    shaders = &ShaderLib::normal();
     break;
   case THREE::MeshBasicMaterial:
-    setMaterialShaders( material, ShaderLib::basic() );
+    shaderID = "basic";
+    shaders = &ShaderLib::basic();
     break;
   case THREE::MeshLambertMaterial:
-    setMaterialShaders( material, ShaderLib::lambert() );
+    shaderID = "lambert";
+    shaders = &ShaderLib::lambert();
     break;
   case THREE::MeshPhongMaterial:
-    setMaterialShaders( material, ShaderLib::phong() );
+    shaderID = "phong";
+    shaders = &ShaderLib::phong();
     break;
   case THREE::LineBasicMaterial:
-    setMaterialShaders( material, ShaderLib::basic() );
+    shaderID = "basic";
+    shaders = &ShaderLib::basic();
     break;
   case THREE::ParticleBasicMaterial:
-    setMaterialShaders( material, ShaderLib::particleBasic() );
+    shaderID = "particleBasic";
+    shaders = &ShaderLib::particleBasic();
     break;
   case THREE::ShaderMaterial:
     break;
@@ -4126,6 +5241,12 @@ void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Ob
     break;
   };
 
+  // the instanced variant shares material.uniforms with material.program
+
+  if ( shaders && !instanced ) {
+    setMaterialShaders( material, *shaders );
+  }
+
   // heuristics to create shader parameters according to lights in the scene
   // (not to blow over maxLights budget)
 
@@ -4151,7 +5272,7 @@ void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Ob
     material.skinning,
     maxBones,
     //_supportsBoneTextures && object && object.useVertexTexture,
-    _supportsBoneTextures && object.useVertexTexture,
+    _supportsBoneTextures && object.useVertexTexture && !!object.boneTexture,
     //object && object.boneTextureWidth,
     object.boneTextureWidth,
     //object && object.boneTextureHeight,
@@ -4176,23 +5297,27 @@ void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Ob
     material.metal,
     material.perPixel,
     material.wrapAround,
-    material.side == THREE::DoubleSide
+    material.side == THREE::DoubleSide,
+
+    instanced
 
   };
 
-  material.program = buildProgram( shaderID,
-                                   material.fragmentShader,
-                                   material.vertexShader,
-                                   material.uniforms,
-                                   material.attributes,
-                                   parameters );
+  auto& program = instanced ? material.instancedProgram : material.program;
 
-  if ( !material.program ) {
+  program = buildProgram( shaderID,
+                          material.fragmentShader,
+                          material.vertexShader,
+                          material.uniforms,
+                          material.attributes,
+                          parameters );
+
+  if ( !program ) {
     console().error() << "Aborting material initialization";
     return;
   }
 
-  auto& attributes = material.program->attributes;
+  auto& attributes = program->attributes;
 
   if ( attributes[AttributeKey::position()].valid() )
     glEnableVertexAttribArray( attributes[AttributeKey::position()] );
@@ -4207,11 +5332,8 @@ void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Ob
     glEnableVertexAttribArray( attributes[AttributeKey::tangent()] );
 
   if ( material.skinning &&
-       attributes[AttributeKey::skinVertexA()].valid() && attributes[AttributeKey::skinVertexB()].valid() &&
        attributes[AttributeKey::skinIndex()].valid() && attributes[AttributeKey::skinWeight()].valid() ) {
 
-    glEnableVertexAttribArray( attributes[AttributeKey::skinVertexA()] );
-    glEnableVertexAttribArray( attributes[AttributeKey::skinVertexB()] );
     glEnableVertexAttribArray( attributes[AttributeKey::skinIndex()] );
     glEnableVertexAttribArray( attributes[AttributeKey::skinWeight()] );
 
@@ -4256,10 +5378,16 @@ void GLRenderer::initMaterial( Material& material, Lights& lights, IFog* fog, Ob
 
   }
 
-  material.uniformsList.clear();
+  auto& uniformsList = instanced ? material.instancedUniformsList : material.uniformsList;
+
+  uniformsList.clear();
 
   for ( auto& u : material.uniforms ) {
-    material.uniformsList.emplace_back( &u.second, u.first );
+    uniformsList.emplace_back( &u.second, u.first, program->slot( u.first ) );
+  }
+
+  for ( int i = 0; i < MaterialUniform::Count; ++i ) {
+    material.refreshedUniforms[ i ] = material.uniforms.get( MaterialUniform::name( ( MaterialUniform::Slot )i ) );
   }
 
 }
@@ -4270,7 +5398,16 @@ void GLRenderer::setMaterialShaders( Material& material, const Shader& shaders )
   material.fragmentShader = shaders.fragmentShader;
 }
 
-Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Material& material, Object3D& object ) {
+// Sets a refreshed material uniform, if the material has it
+
+template < typename T >
+static inline void refresh( MaterialUniforms& uniforms, MaterialUniform::Slot slot, const T& value ) {
+  if ( auto uniform = uniforms[ slot ] ) {
+    uniform->value = value;
+  }
+}
+
+Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Material& material, Object3D& object, bool instanced /*= false*/ ) {
 
   _usedTextureUnits = 0;
 
@@ -4282,15 +5419,14 @@ Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Mate
     material.needsUpdate = false;
   }
 
-  if ( material.morphTargets ) {
-    object.glData.__glMorphTargetInfluences.resize( maxMorphTargets );
+  if ( instanced && !material.instancedProgram ) {
+    initMaterial( material, lights, fog, object, true );
   }
 
   auto refreshMaterial = false;
 
-  auto& program    = *material.program;
-  auto& p_uniforms = program.uniforms;
-  auto& m_uniforms = material.uniforms;
+  auto& program    = instanced ? *material.instancedProgram : *material.program;
+  auto& m_uniforms = material.refreshedUniforms;
 
   if ( &program != _currentProgram ) {
     glUseProgram( program.program );
@@ -4304,7 +5440,7 @@ Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Mate
   }
 
   if ( refreshMaterial || &camera != _currentCamera ) {
-    glUniformMatrix4fv( p_uniforms[UniformKey::projectionMatrix()], 1, false, camera._projectionMatrixArray.data() );
+    loadUniformMatrices( program, BuiltinUniform::projectionMatrix, camera._projectionMatrixArray.data() );
     if ( &camera != _currentCamera ) _currentCamera = &camera;
   }
 
@@ -4343,21 +5479,21 @@ Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Mate
     } else if ( material.type() == THREE::MeshLambertMaterial ) {
       refreshUniformsLambert( m_uniforms, material );
     } else if ( material.type() == THREE::MeshDepthMaterial ) {
-      m_uniforms[UniformKey::mNear()].value = camera.near;
-      m_uniforms[UniformKey::mFar()].value = camera.far;
-      m_uniforms[UniformKey::opacity()].value = material.opacity;
+      refresh( m_uniforms, MaterialUniform::mNear, camera.near );
+      refresh( m_uniforms, MaterialUniform::mFar, camera.far );
+      refresh( m_uniforms, MaterialUniform::opacity, material.opacity );
     } else if ( material.type() == THREE::MeshNormalMaterial ) {
-      m_uniforms[UniformKey::opacity()].value = material.opacity;
+      refresh( m_uniforms, MaterialUniform::opacity, material.opacity );
     }
 
     if ( object.receiveShadow && ! material.shadowPass ) {
-      refreshUniformsShadow( m_uniforms, lights );
+      refreshUniformsShadow( material.uniforms, lights );
     }
 
     // load common uniforms
 
     const bool warnOnNotFound = material.type() == THREE::ShaderMaterial;
-    loadUniformsGeneric( program, material.uniformsList, warnOnNotFound );
+    loadUniformsGeneric( program, instanced ? material.instancedUniformsList : material.uniformsList, warnOnNotFound );
 
     // load material specific uniforms
     // (shader material also gets them for the sake of genericity)
@@ -4366,10 +5502,11 @@ Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Mate
          material.type() == THREE::MeshPhongMaterial ||
          material.envMap ) {
 
-      const auto cameraPositionLocation = uniformLocation( p_uniforms, "cameraPosition" );
-      if ( validUniformLocation( cameraPositionLocation ) ) {
+      if ( auto slot = program.builtin( BuiltinUniform::cameraPosition ) ) {
         auto position = camera.matrixWorld.getPosition();
-        glUniform3f( cameraPositionLocation, position.x, position.y, position.z );
+        if ( slot->update( &position, sizeof( position ) ) ) {
+          glUniform3f( slot->location, position.x, position.y, position.z );
+        }
       }
 
     }
@@ -4377,41 +5514,39 @@ Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Mate
     if ( material.type() == THREE::MeshPhongMaterial ||
          material.type() == THREE::MeshLambertMaterial ||
          material.type() == THREE::ShaderMaterial ||
-         material.skinning ) {
+         material.skinning || instanced ) {
 
-      const auto viewMatrixLocation = uniformLocation( p_uniforms, "viewMatrix" );
-      if ( validUniformLocation( viewMatrixLocation ) ) {
-        glUniformMatrix4fv( viewMatrixLocation, 1, false, camera._viewMatrixArray.data() );
-      }
+      loadUniformMatrices( program, BuiltinUniform::viewMatrix, camera._viewMatrixArray.data() );
 
     }
   }
 
   if ( material.skinning ) {
-    if ( _supportsBoneTextures && object.useVertexTexture ) {
-      const auto boneTextureLocation = uniformLocation( p_uniforms, "boneTexture" );
-      if ( validUniformLocation( boneTextureLocation ) ) {
+    if ( _supportsBoneTextures && object.useVertexTexture && object.boneTexture ) {
+      if ( auto slot = program.builtin( BuiltinUniform::boneTexture ) ) {
         auto textureUnit = getTextureUnit();
-        glUniform1i( boneTextureLocation, textureUnit );
+        if ( slot->update( &textureUnit, sizeof( textureUnit ) ) ) {
+          glUniform1i( slot->location, textureUnit );
+        }
         setTexture( *object.boneTexture, textureUnit );
       }
-    } else {
-      const auto boneMatricesLocation = uniformLocation( p_uniforms, "boneGlobalMatrices" );
-      if ( validUniformLocation( boneMatricesLocation ) ) {
-        glUniformMatrix4fv( boneMatricesLocation,
-                            ( int )object.boneMatrices.size(),
-                            false,
-                            reinterpret_cast<const float*>( &object.boneMatrices[0] ) );
-      }
+    } else if ( !object.boneMatrices.empty() ) {
+      loadUniformMatrices( program,
+                           BuiltinUniform::boneGlobalMatrices,
+                           reinterpret_cast<const float*>( &object.boneMatrices[0] ),
+                           ( int )object.boneMatrices.size() );
     }
 
   }
 
-  loadUniformsMatrices( p_uniforms, object );
+  // instanced programs take the model matrix from an attribute
+
+  if ( !instanced ) {
+
+    loadUniformsMatrices( program, object );
+
+    loadUniformMatrices( program, BuiltinUniform::modelMatrix, object.matrixWorld.elements );
 
-  const auto modelMatrixLocation = uniformLocation( p_uniforms, "modelMatrix" );
-  if ( validUniformLocation( modelMatrixLocation ) ) {
-    glUniformMatrix4fv( modelMatrixLocation, 1, false, object.matrixWorld.elements );
   }
 
   return program;
@@ -4421,23 +5556,23 @@ Program& GLRenderer::setProgram( Camera& camera, Lights& lights, IFog* fog, Mate
 
 // Uniforms (refresh uniforms objects)
 
-void GLRenderer::refreshUniformsCommon( Uniforms& uniforms, Material& material ) {
+void GLRenderer::refreshUniformsCommon( MaterialUniforms& uniforms, Material& material ) {
 
-  uniforms[UniformKey::opacity()].value = material.opacity;
+  refresh( uniforms, MaterialUniform::opacity, material.opacity );
 
   if ( gammaInput ) {
-    uniforms[UniformKey::diffuse()].value = Color().copyGammaToLinear( material.color );
+    refresh( uniforms, MaterialUniform::diffuse, Color().copyGammaToLinear( material.color ) );
   } else {
-    uniforms[UniformKey::diffuse()].value = material.color;
+    refresh( uniforms, MaterialUniform::diffuse, material.color );
   }
 
-  uniforms[UniformKey::map()].value         = material.map.get();
-  uniforms[UniformKey::lightMap()].value    = material.lightMap.get();
-  uniforms[UniformKey::specularMap()].value = material.specularMap.get();
+  refresh( uniforms, MaterialUniform::map, material.map.get() );
+  refresh( uniforms, MaterialUniform::lightMap, material.lightMap.get() );
+  refresh( uniforms, MaterialUniform::specularMap, material.specularMap.get() );
 
   if ( material.bumpMap ) {
-    uniforms[UniformKey::bumpMap()].value   = material.bumpMap.get();
-    uniforms[UniformKey::bumpScale()].value = material.bumpScale;
+    refresh( uniforms, MaterialUniform::bumpMap, material.bumpMap.get() );
+    refresh( uniforms, MaterialUniform::bumpScale, material.bumpScale );
   }
 
   // uv repeat and offset setting priorities
@@ -4459,119 +5594,119 @@ void GLRenderer::refreshUniformsCommon( Uniforms& uniforms, Material& material )
     const auto& offset = uvScaleMap->offset;
     const auto& repeat = uvScaleMap->repeat;
 
-    uniforms[UniformKey::offsetRepeat()].value = Vector4( offset.x, offset.y, repeat.x, repeat.y );
+    refresh( uniforms, MaterialUniform::offsetRepeat, Vector4( offset.x, offset.y, repeat.x, repeat.y ) );
   }
 
-  uniforms[UniformKey::envMap()].value     = material.envMap.get();
-  uniforms[UniformKey::flipEnvMap()].value = ( material.envMap && material.envMap->type() == THREE::GLRenderTargetCube ) ? 1 : -1;
+  refresh( uniforms, MaterialUniform::envMap, material.envMap.get() );
+  refresh( uniforms, MaterialUniform::flipEnvMap, ( material.envMap && material.envMap->type() == THREE::GLRenderTargetCube ) ? 1 : -1 );
 
   if ( gammaInput ) {
     //uniforms.reflectivity.value = material.reflectivity * material.reflectivity;
-    uniforms[UniformKey::reflectivity()].value = material.reflectivity;
+    refresh( uniforms, MaterialUniform::reflectivity, material.reflectivity );
   } else {
-    uniforms[UniformKey::reflectivity()].value = material.reflectivity;
+    refresh( uniforms, MaterialUniform::reflectivity, material.reflectivity );
   }
 
-  uniforms[UniformKey::refractionRatio()].value = material.refractionRatio;
-  uniforms[UniformKey::combine()].value         = ( int )material.combine;
-  uniforms[UniformKey::useRefract()].value      = material.envMap && material.envMap->mapping == THREE::CubeRefractionMapping;
+  refresh( uniforms, MaterialUniform::refractionRatio, material.refractionRatio );
+  refresh( uniforms, MaterialUniform::combine, ( int )material.combine );
+  refresh( uniforms, MaterialUniform::useRefract, material.envMap && material.envMap->mapping == THREE::CubeRefractionMapping );
 
 }
 
-void GLRenderer::refreshUniformsLine( Uniforms& uniforms, Material& material ) {
+void GLRenderer::refreshUniformsLine( MaterialUniforms& uniforms, Material& material ) {
 
-  uniforms[UniformKey::diffuse()].value = material.color;
-  uniforms[UniformKey::opacity()].value = material.opacity;
+  refresh( uniforms, MaterialUniform::diffuse, material.color );
+  refresh( uniforms, MaterialUniform::opacity, material.opacity );
 
 }
 
-void GLRenderer::refreshUniformsParticle( Uniforms& uniforms, Material& material ) {
+void GLRenderer::refreshUniformsParticle( MaterialUniforms& uniforms, Material& material ) {
 
-  uniforms[UniformKey::psColor()].value = material.color;
-  uniforms[UniformKey::opacity()].value = material.opacity;
-  uniforms[UniformKey::size()].value    = material.size;
-  uniforms[UniformKey::scale()].value   = _height / 2.0f; // TODO: Cache
+  refresh( uniforms, MaterialUniform::psColor, material.color );
+  refresh( uniforms, MaterialUniform::opacity, material.opacity );
+  refresh( uniforms, MaterialUniform::size, material.size );
+  refresh( uniforms, MaterialUniform::scale, _height / 2.0f ); // TODO: Cache
 
-  uniforms[UniformKey::map()].value = material.map.get();
+  refresh( uniforms, MaterialUniform::map, material.map.get() );
 
 }
 
-void GLRenderer::refreshUniformsFog( Uniforms& uniforms, IFog& fog ) {
+void GLRenderer::refreshUniformsFog( MaterialUniforms& uniforms, IFog& fog ) {
 
   if ( fog.type() == THREE::Fog ) {
 
     auto& f = static_cast<Fog&>(fog);
-    uniforms[UniformKey::fogColor()].value = f.color;
-    uniforms[UniformKey::fogNear()].value  = f.near;
-    uniforms[UniformKey::fogFar()].value   = f.far;
+    refresh( uniforms, MaterialUniform::fogColor, f.color );
+    refresh( uniforms, MaterialUniform::fogNear, f.near );
+    refresh( uniforms, MaterialUniform::fogFar, f.far );
 
   } else if ( fog.type() == THREE::FogExp2 ) {
 
     auto& f = static_cast<FogExp2&>(fog);
-    uniforms[UniformKey::fogColor()].value   = f.color;
-    uniforms[UniformKey::fogDensity()].value = f.density;
+    refresh( uniforms, MaterialUniform::fogColor, f.color );
+    refresh( uniforms, MaterialUniform::fogDensity, f.density );
 
   }
 
 }
 
-void GLRenderer::refreshUniformsPhong( Uniforms& uniforms, Material& material ) {
+void GLRenderer::refreshUniformsPhong( MaterialUniforms& uniforms, Material& material ) {
 
-  uniforms[UniformKey::shininess()].value = material.shininess;
+  refresh( uniforms, MaterialUniform::shininess, material.shininess );
 
   if ( gammaInput ) {
-    uniforms[UniformKey::ambient()].value  = Color().copyGammaToLinear( material.ambient );
-    uniforms[UniformKey::emissive()].value = Color().copyGammaToLinear( material.emissive );
-    uniforms[UniformKey::specular()].value = Color().copyGammaToLinear( material.specular );
+    refresh( uniforms, MaterialUniform::ambient, Color().copyGammaToLinear( material.ambient ) );
+    refresh( uniforms, MaterialUniform::emissive, Color().copyGammaToLinear( material.emissive ) );
+    refresh( uniforms, MaterialUniform::specular, Color().copyGammaToLinear( material.specular ) );
   } else {
-    uniforms[UniformKey::ambient()].value  = material.ambient;
-    uniforms[UniformKey::emissive()].value = material.emissive;
-    uniforms[UniformKey::specular()].value = material.specular;
+    refresh( uniforms, MaterialUniform::ambient, material.ambient );
+    refresh( uniforms, MaterialUniform::emissive, material.emissive );
+    refresh( uniforms, MaterialUniform::specular, material.specular );
   }
 
   if ( material.wrapAround ) {
-    uniforms[UniformKey::wrapRGB()].value = material.wrapRGB;
+    refresh( uniforms, MaterialUniform::wrapRGB, material.wrapRGB );
   }
 
 }
 
-void GLRenderer::refreshUniformsLambert( Uniforms& uniforms, Material& material ) {
+void GLRenderer::refreshUniformsLambert( MaterialUniforms& uniforms, Material& material ) {
 
   if ( gammaInput ) {
-    uniforms[UniformKey::ambient()].value  = Color().copyGammaToLinear( material.ambient );
-    uniforms[UniformKey::emissive()].value = Color().copyGammaToLinear( material.emissive );
+    refresh( uniforms, MaterialUniform::ambient, Color().copyGammaToLinear( material.ambient ) );
+    refresh( uniforms, MaterialUniform::emissive, Color().copyGammaToLinear( material.emissive ) );
   } else {
-    uniforms[UniformKey::ambient()].value  = material.ambient;
-    uniforms[UniformKey::emissive()].value = material.emissive;
+    refresh( uniforms, MaterialUniform::ambient, material.ambient );
+    refresh( uniforms, MaterialUniform::emissive, material.emissive );
   }
 
   if ( material.wrapAround ) {
-    uniforms[UniformKey::wrapRGB()].value = material.wrapRGB;
+    refresh( uniforms, MaterialUniform::wrapRGB, material.wrapRGB );
   }
 
 }
 
-void GLRenderer::refreshUniformsLights( Uniforms& uniforms, InternalLights& lights ) {
+void GLRenderer::refreshUniformsLights( MaterialUniforms& uniforms, InternalLights& lights ) {
 
-  uniforms[UniformKey::ambientLightColor()].value         = lights.ambient;
+  refresh( uniforms, MaterialUniform::ambientLightColor, lights.ambient );
 
-  uniforms[UniformKey::directionalLightColor()].value     = lights.directional.colors;
-  uniforms[UniformKey::directionalLightDirection()].value = lights.directional.positions;
+  refresh( uniforms, MaterialUniform::directionalLightColor, lights.directional.colors );
+  refresh( uniforms, MaterialUniform::directionalLightDirection, lights.directional.positions );
 
-  uniforms[UniformKey::pointLightColor()].value           = lights.point.colors;
-  uniforms[UniformKey::pointLightPosition()].value        = lights.point.positions;
-  uniforms[UniformKey::pointLightDistance()].value        = lights.point.distances;
+  refresh( uniforms, MaterialUniform::pointLightColor, lights.point.colors );
+  refresh( uniforms, MaterialUniform::pointLightPosition, lights.point.positions );
+  refresh( uniforms, MaterialUniform::pointLightDistance, lights.point.distances );
 
-  uniforms[UniformKey::spotLightColor()].value            = lights.spot.colors;
-  uniforms[UniformKey::spotLightPosition()].value         = lights.spot.positions;
-  uniforms[UniformKey::spotLightDistance()].value         = lights.spot.distances;
-  uniforms[UniformKey::spotLightDirection()].value        = lights.spot.directions;
-  uniforms[UniformKey::spotLightAngle()].value            = lights.spot.angles;
-  uniforms[UniformKey::spotLightExponent()].value         = lights.spot.exponents;
+  refresh( uniforms, MaterialUniform::spotLightColor, lights.spot.colors );
+  refresh( uniforms, MaterialUniform::spotLightPosition, lights.spot.positions );
+  refresh( uniforms, MaterialUniform::spotLightDistance, lights.spot.distances );
+  refresh( uniforms, MaterialUniform::spotLightDirection, lights.spot.directions );
+  refresh( uniforms, MaterialUniform::spotLightAngle, lights.spot.angles );
+  refresh( uniforms, MaterialUniform::spotLightExponent, lights.spot.exponents );
 
-  uniforms[UniformKey::hemisphereLightSkyColor()].value   = lights.hemi.skyColors;
-  uniforms[UniformKey::hemisphereLightGroundColor()].value = lights.hemi.groundColors;
-  uniforms[UniformKey::hemisphereLightPosition()].value   = lights.hemi.positions;
+  refresh( uniforms, MaterialUniform::hemisphereLightSkyColor, lights.hemi.skyColors );
+  refresh( uniforms, MaterialUniform::hemisphereLightGroundColor, lights.hemi.groundColors );
+  refresh( uniforms, MaterialUniform::hemisphereLightPosition, lights.hemi.positions );
 
 }
 
@@ -4615,12 +5750,25 @@ void GLRenderer::refreshUniformsShadow( Uniforms& uniforms, Lights& lights ) {
 
 // Uniforms (load to GPU)
 
-void GLRenderer::loadUniformsMatrices( UniformLocations& uniforms, Object3D& object ) {
+void GLRenderer::loadUniformsMatrices( Program& program, Object3D& object ) {
+
+  loadUniformMatrices( program, BuiltinUniform::modelViewMatrix, object.glData._modelViewMatrix.elements );
+
+  if ( auto slot = program.builtin( BuiltinUniform::normalMatrix ) ) {
+    const auto& elements = object.glData._normalMatrix.elements;
+    if ( slot->update( elements, sizeof( elements ) ) ) {
+      glUniformMatrix3fv( slot->location, 1, false, elements );
+    }
+  }
+
+}
+
+void GLRenderer::loadUniformMatrices( Program& program, BuiltinUniform::Slot uniform, const float* elements, int count /*= 1*/ ) {
 
-  glUniformMatrix4fv( uniforms[UniformKey::modelViewMatrix()], 1, false, object.glData._modelViewMatrix.elements );
-  const auto normalMatrixLocation = uniformLocation( uniforms, "normalMatrix" );
-  if ( validUniformLocation( normalMatrixLocation ) ) {
-    glUniformMatrix3fv( normalMatrixLocation, 1, false, object.glData._normalMatrix.elements );
+  if ( auto slot = program.builtin( uniform ) ) {
+    if ( slot->update( elements, count * 16 * sizeof( float ) ) ) {
+      glUniformMatrix4fv( slot->location, count, false, elements );
+    }
   }
 
 }
@@ -4639,28 +5787,29 @@ int GLRenderer::getTextureUnit() {
 
 void GLRenderer::loadUniformsGeneric( Program& program, UniformsList& uniforms, bool warnIfNotFound ) {
 
-  for ( const auto& uniformAndKey: uniforms ) {//( size_t j = 0, jl = uniforms.size(); j < jl; j ++ ) {
-
-    const auto& location = program.uniforms[ uniformAndKey.second ];
+  for ( const auto& binding : uniforms ) {
 
-    if ( !location.valid() ) {
+    if ( binding.slot == -1 ) {
       if ( warnIfNotFound )
         console().warn() << "three::GLRenderer::loadUniformsGeneric: Expected uniform \""
-                         << uniformAndKey.second
+                         << binding.name
                          << "\" location does not exist";
       continue;
     }
 
-    auto& uniform = *uniformAndKey.first;
+    auto& slot    = program.slots[ binding.slot ];
+    auto& uniform = *binding.uniform;
 
-    uniform.load( location );
+    uniform.load( slot );
 
     if ( uniform.type == THREE::t ) { // single THREE::Texture (2d or cube)
 
       const auto& texture = uniform.value.cast<Texture*>();
       const auto  textureUnit = getTextureUnit();
 
-      glUniform1i( location, textureUnit );
+      if ( slot.update( &textureUnit, sizeof( textureUnit ) ) ) {
+        glUniform1i( slot.location, textureUnit );
+      }
 
       if ( !texture ) continue;
 
@@ -4676,12 +5825,15 @@ void GLRenderer::loadUniformsGeneric( Program& program, UniformsList& uniforms,
 
       const auto& textures = uniform.value.cast<std::vector<Texture*>>();
 
-      std::vector<int> textureUnits;
+      auto& textureUnits = _textureUnitScratch;
+      textureUnits.clear();
       for ( size_t i = 0; i < textures.size(); ++i ) {
         textureUnits.push_back( getTextureUnit() );
       }
 
-      glUniform1iv( location, (int)textureUnits.size(), textureUnits.data() );
+      if ( slot.update( textureUnits.data(), textureUnits.size() * sizeof( int ) ) ) {
+        glUniform1iv( slot.location, (int)textureUnits.size(), textureUnits.data() );
+      }
 
       for ( size_t i = 0; i < textures.size(); ++i ) {
 
@@ -5155,28 +6307,42 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
                                        ProgramParameters& parameters ) {
 
 
-  // Generate code
-  std::hash<std::string> hash;
-  std::stringstream chunks;
+  // Fingerprint the sources and everything that goes into the prefixes
+
+  Fingerprint key;
+
+  key.add( shaderID.empty() );
 
   if ( !shaderID.empty() ) {
-    chunks << shaderID;
+    key.add( shaderID.data(), shaderID.size() );
   } else {
-    chunks << hash( fragmentShader );
-    chunks << hash( vertexShader );
-  }
-  chunks << jenkins_hash( &parameters );
-
-  auto code = chunks.str();
+    key.add( fragmentShader.data(), fragmentShader.size() );
+    key.add( vertexShader.data(), vertexShader.size() );
+  }
+
+  const int fogType = parameters.useFog && parameters.fog ? ( int )parameters.fog->type() : -1;
+
+  key.add( parameters.map ).add( parameters.envMap ).add( parameters.lightMap )
+     .add( parameters.bumpMap ).add( parameters.specularMap )
+     .add( parameters.vertexColors )
+     .add( fogType )
+     .add( parameters.sizeAttenuation )
+     .add( parameters.skinning ).add( parameters.maxBones ).add( parameters.useVertexTexture )
+     .add( parameters.boneTextureWidth ).add( parameters.boneTextureHeight )
+     .add( parameters.morphTargets ).add( parameters.morphNormals )
+     .add( parameters.maxMorphTargets ).add( parameters.maxMorphNormals )
+     .add( parameters.maxDirLights ).add( parameters.maxPointLights ).add( parameters.maxSpotLights )
+     .add( parameters.maxShadows ).add( parameters.shadowMapEnabled ).add( parameters.shadowMapSoft )
+     .add( parameters.shadowMapDebug ).add( parameters.shadowMapCascade )
+     .add( &parameters.alphaTest, sizeof( parameters.alphaTest ) )
+     .add( parameters.metal ).add( parameters.perPixel ).add( parameters.wrapAround )
+     .add( parameters.doubleSided ).add( parameters.instancing )
+     .add( gammaInput ).add( gammaOutput ).add( physicallyBasedShading );
 
   // Check if code has been already compiled
 
-  for ( auto& programInfo : _programs ) {
-    if ( programInfo.code == code ) {
-      console().log( "Code already compiled." /*: \n\n" + code*/ );
-      programInfo.usedTimes ++;
-      return programInfo.program;
-    }
+  if ( auto program = _programs.acquire( key ) ) {
+    return program;
   }
 
   //console().log( "building new program " );
@@ -5213,8 +6379,8 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
 
     if ( parameters.skinning )          ss << "#define USE_SKINNING" << std::endl;
     if ( parameters.useVertexTexture )  ss << "#define BONE_TEXTURE" << std::endl;
-    if ( parameters.boneTextureWidth )  ss << "#define N_BONE_PIXEL_X " << parameters.boneTextureWidth << std::endl;
-    if ( parameters.boneTextureHeight ) ss << "#define N_BONE_PIXEL_Y " << parameters.boneTextureHeight << std::endl;
+    if ( parameters.boneTextureWidth )  ss << "#define N_BONE_PIXEL_X " << parameters.boneTextureWidth << ".0" << std::endl;
+    if ( parameters.boneTextureHeight ) ss << "#define N_BONE_PIXEL_Y " << parameters.boneTextureHeight << ".0" << std::endl;
 
     if ( parameters.morphTargets ) ss << "#define USE_MORPHTARGETS" << std::endl;
     if ( parameters.morphNormals ) ss << "#define USE_MORPHNORMALS" << std::endl;
@@ -5229,13 +6395,22 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
 
     if ( parameters.sizeAttenuation ) ss << "#define USE_SIZEATTENUATION" << std::endl;
 
+    if ( parameters.instancing ) ss << "#define USE_INSTANCING" << std::endl;
+
+    if ( !parameters.instancing ) {
+
+      ss <<
+
+      "uniform mat4 modelMatrix;" << std::endl <<
+      "uniform mat4 modelViewMatrix;" << std::endl <<
+      "uniform mat3 normalMatrix;" << std::endl;
+
+    }
+
     ss <<
 
-    "uniform mat4 modelMatrix;" << std::endl <<
-    "uniform mat4 modelViewMatrix;" << std::endl <<
     "uniform mat4 projectionMatrix;" << std::endl <<
     "uniform mat4 viewMatrix;" << std::endl <<
-    "uniform mat3 normalMatrix;" << std::endl <<
     "uniform vec3 cameraPosition;" << std::endl <<
 
     "attribute vec3 position;" << std::endl <<
@@ -5276,13 +6451,40 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
 
     "#ifdef USE_SKINNING" << std::endl <<
 
-    "attribute vec4 skinVertexA;" << std::endl <<
-    "attribute vec4 skinVertexB;" << std::endl <<
     "attribute vec4 skinIndex;" << std::endl <<
     "attribute vec4 skinWeight;" << std::endl <<
 
     "#endif" << std::endl;
 
+    // Per-instance model matrix and color. The normal matrix is the
+    // cofactor matrix of the model-view matrix (its inverse transpose up to
+    // scale; normals are normalized later). Without vertex colors, the
+    // instance color is the only one.
+
+    if ( parameters.instancing ) {
+
+      ss <<
+
+      "attribute mat4 instanceMatrix;" << std::endl <<
+      "attribute vec3 instanceColor;" << std::endl <<
+
+      "mat3 instanceNormalMatrix( mat4 m ) {" << std::endl <<
+      "  vec3 a = m[ 0 ].xyz, b = m[ 1 ].xyz, c = m[ 2 ].xyz;" << std::endl <<
+      "  vec3 bc = cross( b, c );" << std::endl <<
+      "  return ( dot( a, bc ) < 0.0 ? -1.0 : 1.0 ) * mat3( bc, cross( c, a ), cross( a, b ) );" << std::endl <<
+      "}" << std::endl <<
+
+      "#define modelMatrix instanceMatrix" << std::endl <<
+      "#define modelViewMatrix ( viewMatrix * instanceMatrix )" << std::endl <<
+      "#define normalMatrix instanceNormalMatrix( modelViewMatrix )" << std::endl <<
+
+      "#ifndef USE_COLOR" << std::endl <<
+      "#define USE_COLOR" << std::endl <<
+      "#define color vec3( 1.0 )" << std::endl <<
+      "#endif" << std::endl;
+
+    }
+
     return ss.str();
 
   }();
@@ -5319,7 +6521,7 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
     if ( parameters.lightMap )     ss << "#define USE_LIGHTMAP" <<  std::endl;
     if ( parameters.bumpMap )      ss << "#define USE_BUMPMAP" <<  std::endl;
     if ( parameters.specularMap )  ss << "#define USE_SPECULARMAP" <<  std::endl;
-    if ( parameters.vertexColors ) ss << "#define USE_COLOR" <<  std::endl;
+    if ( parameters.vertexColors || parameters.instancing ) ss << "#define USE_COLOR" <<  std::endl;
 
     if ( parameters.metal )       ss << "#define METAL" <<  std::endl;
     if ( parameters.perPixel )    ss << "#define PHONG_PER_PIXEL" <<  std::endl;
@@ -5377,24 +6579,14 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
   {
     // cache uniform locations
 
-    std::array<std::string, 7> identifiersArray = {
-
-      "viewMatrix",
-      "modelViewMatrix",
-      "projectionMatrix",
-      "normalMatrix",
-      "modelMatrix",
-      "cameraPosition",
-      "morphTargetInfluences"
-
-    };
-
-    Identifiers identifiers( identifiersArray.begin(), identifiersArray.end() );
+    Identifiers identifiers;
 
-    if ( parameters.useVertexTexture ) {
-      identifiers.push_back( "boneTexture" );
-    } else {
-      identifiers.push_back( "boneGlobalMatrices" );
+    for ( int i = 0; i < BuiltinUniform::Count; ++i ) {
+      const auto uniform = ( BuiltinUniform::Slot )i;
+      if ( uniform == ( parameters.useVertexTexture ? BuiltinUniform::boneGlobalMatrices
+                                                    : BuiltinUniform::boneTexture ) )
+        continue;
+      identifiers.push_back( BuiltinUniform::name( uniform ) );
     }
 
     for ( const auto& u : uniforms ) {
@@ -5408,13 +6600,12 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
   {
     // cache attributes locations
 
-    std::array<std::string, 10> identifiersArray = {
+    std::array<std::string, 8> identifiersArray = {
 
       AttributeKey::position(), AttributeKey::normal(),
       AttributeKey::uv(), AttributeKey::uv2(),
       AttributeKey::tangent(),
       AttributeKey::color(),
-      AttributeKey::skinVertexA(), AttributeKey::skinVertexB(),
       AttributeKey::skinIndex(), AttributeKey::skinWeight()
 
     };
@@ -5437,6 +6628,11 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
 
     }
 
+    if ( parameters.instancing ) {
+      identifiers.push_back( AttributeKey::instanceMatrix() );
+      identifiers.push_back( AttributeKey::instanceColor() );
+    }
+
     for ( const auto& a : attributes ) {
       identifiers.push_back( a.first );
     }
@@ -5445,7 +6641,8 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
 
   }
 
-  _programs.push_back( ProgramInfo( program, code, 1 ) );
+  program->key = key;
+  _programs.insert( program );
 
   _info.memory.programs = ( int )_programs.size();
 
@@ -5457,7 +6654,14 @@ Program::Ptr GLRenderer::buildProgram( const std::string& shaderID,
 
 void GLRenderer::cacheUniformLocations( Program& program, const Identifiers& identifiers ) {
   for ( const auto& id : identifiers ) {
-    program.uniforms[ id ] = GL_CALL( glGetUniformLocation( program.program, id.c_str() ) );
+    const auto location = GL_CALL( glGetUniformLocation( program.program, id.c_str() ) );
+    program.uniforms[ id ] = location;
+    if ( validUniformLocation( location ) && program.slot( id ) == -1 ) {
+      program.slots.emplace_back( id, location );
+    }
+  }
+  for ( int i = 0; i < BuiltinUniform::Count; ++i ) {
+    program.builtins[ i ] = program.slot( BuiltinUniform::name( ( BuiltinUniform::Slot )i ) );
   }
 }
 
@@ -5542,7 +6746,15 @@ void GLRenderer::setTexture( const Texture& texture, int slot ) {
 
     //if ( texture.type() == THREE::DataTexture ) {
 
-    glTexImage2D( GL_TEXTURE_2D, 0, glFormat, image.width, image.height, 0, glFormat, glType, image.data.data() );
+    // Float data keeps its precision only with a float internal format
+    auto glInternalFormat = glFormat;
+#ifndef THREE_GLES
+    if ( texture.dataType == THREE::FloatType && texture.format == THREE::RGBAFormat ) {
+      glInternalFormat = GL_RGBA32F;
+    }
+#endif
+
+    glTexImage2D( GL_TEXTURE_2D, 0, glInternalFormat, image.width, image.height, 0, glFormat, glType, image.data.data() );
 
     //} else {
 
@@ -5912,7 +7124,7 @@ int GLRenderer::paramThreeToGL( int p ) {
 
 int GLRenderer::allocateBones( Object3D& object ) {
 
-  if ( _supportsBoneTextures && object.useVertexTexture ) {
+  if ( _supportsBoneTextures && object.useVertexTexture && object.boneTexture ) {
 
     return 1024;
 
@@ -5931,7 +7143,7 @@ int GLRenderer::allocateBones( Object3D& object ) {
 
     auto maxBones = nVertexMatrices;
 
-    if ( object.type() == THREE::SkinnedMesh ) {
+    if ( object.type() == THREE::Mesh && static_cast<Mesh&>( object ).skinned() ) {
 
       maxBones = Math::min( ( int )object.bones.size(), maxBones );
 
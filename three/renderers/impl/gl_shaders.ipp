@@ -842,6 +842,13 @@ const char* ShaderChunk::color_vertex() {
     "#else\n"
     "vColor = color;\n"
     "#endif\n"
+    "#ifdef USE_INSTANCING\n"
+    "#ifdef GAMMA_INPUT\n"
+    "vColor *= instanceColor * instanceColor;\n"
+    "#else\n"
+    "vColor *= instanceColor;\n"
+    "#endif\n"
+    "#endif\n"
     "#endif\n";
 
 }
@@ -859,7 +866,7 @@ const char* ShaderChunk::skinning_pars_vertex() {
     "mat4 getBoneMatrix( const in float i ) {\n"
 
     "float j = i * 4.0;\n"
-    "float x = mod( j N_BONE_PIXEL_X );\n"
+    "float x = mod( j, N_BONE_PIXEL_X );\n"
     "float y = floor( j / N_BONE_PIXEL_X );\n"
 
     "const float dx = 1.0 / N_BONE_PIXEL_X;\n"
@@ -899,6 +906,8 @@ const char* ShaderChunk::skinbase_vertex() {
     "#ifdef USE_SKINNING\n"
     "mat4 boneMatX = getBoneMatrix( skinIndex.x );\n"
     "mat4 boneMatY = getBoneMatrix( skinIndex.y );\n"
+    "mat4 boneMatZ = getBoneMatrix( skinIndex.z );\n"
+    "mat4 boneMatW = getBoneMatrix( skinIndex.w );\n"
     "#endif\n";
 
 }
@@ -908,8 +917,11 @@ const char* ShaderChunk::skinning_vertex() {
   return
 
     "#ifdef USE_SKINNING\n"
-    "vec4 skinned  = boneMatX * skinVertexA * skinWeight.x;\n"
-    "skinned      += boneMatY * skinVertexB * skinWeight.y;\n"
+    "vec4 skinVertex = vec4( position, 1.0 );\n"
+    "vec4 skinned  = boneMatX * skinVertex * skinWeight.x;\n"
+    "skinned      += boneMatY * skinVertex * skinWeight.y;\n"
+    "skinned      += boneMatZ * skinVertex * skinWeight.z;\n"
+    "skinned      += boneMatW * skinVertex * skinWeight.w;\n"
     "gl_Position   = projectionMatrix * modelViewMatrix * skinned;\n"
     "#endif\n";
 
@@ -994,6 +1006,8 @@ const char* ShaderChunk::skinnormal_vertex() {
     "#ifdef USE_SKINNING\n"
     "mat4 skinMatrix = skinWeight.x * boneMatX;\n"
     "skinMatrix   += skinWeight.y * boneMatY;\n"
+    "skinMatrix   += skinWeight.z * boneMatZ;\n"
+    "skinMatrix   += skinWeight.w * boneMatW;\n"
     "vec4 skinnedNormal = skinMatrix * vec4( normal, 0.0 );\n"
     "#endif\n";
 
@@ -1301,7 +1315,7 @@ Uniforms UniformsLib::common() {
           .add( "refractionRatio",       Uniform( THREE::f, 0.98f ) )
           .add( "combine",               Uniform( THREE::i, 0 ) )
 
-          .add( "morphTargetInfluences", Uniform( THREE::f, 0 ) );
+          .add( "morphTargetInfluences", Uniform( THREE::f, 0.f ) );
 
   return uniforms;
 }
@@ -0,0 +1,270 @@
+#ifndef THREE_PARTICLE_SORTER_IPP
+#define THREE_PARTICLE_SORTER_IPP
+
+#include <three/renderers/particle_sorter.hpp>
+
+#include <three/utils/radix_sort.hpp>
+
+#include <algorithm>
+
+namespace three {
+
+namespace detail {
+
+enum { SortChunk = 1 << 14, SortDigits = 256 };
+
+inline size_t sortChunks( size_t count, size_t chunk ) {
+  return ( count + chunk - 1 ) / chunk;
+}
+
+inline std::uint32_t sortKey( std::uint64_t item ) {
+  return ( std::uint32_t )( item >> 32 );
+}
+
+// Insertion sort by key, giving up after budget moves; items stay a
+// permutation either way
+inline bool refineOrder( std::uint64_t* items, size_t count, size_t budget ) {
+
+  size_t moves = 0;
+
+  for ( size_t i = 1; i < count; ++i ) {
+
+    const auto item = items[ i ];
+    const auto key = sortKey( item );
+
+    auto j = i;
+
+    while ( j > 0 && sortKey( items[ j - 1 ] ) > key ) {
+      items[ j ] = items[ j - 1 ];
+      --j;
+      if ( ++moves > budget ) {
+        items[ j ] = item;
+        return false;
+      }
+    }
+
+    items[ j ] = item;
+
+  }
+
+  return true;
+
+}
+
+template < int Size >
+inline void gatherStream( const ParticleSorter::Stream& stream, const std::uint32_t* order, size_t begin, size_t end ) {
+  end = std::min( end, stream.count );
+  for ( auto i = begin; i < end; ++i ) {
+    const auto s = order[ i ];
+    if ( s >= stream.count ) continue;
+    const auto src = stream.src + s * Size;
+    const auto dst = stream.dst + i * Size;
+    for ( int j = 0; j < Size; ++j ) {
+      dst[ j ] = src[ j ];
+    }
+  }
+}
+
+} // namespace detail
+
+ParticleSorter::ParticleSorter()
+  : mPool( 0 ),
+    mRefined( false ) { }
+
+void ParticleSorter::setThreads( size_t threads ) {
+  mPool.resize( threads );
+}
+
+void ParticleSorter::sort( const float* positions, size_t stride, size_t count,
+                           const Matrix4& matrix, std::vector<std::uint32_t>& order ) {
+
+  mRefined = false;
+
+  if ( order.size() != count ) {
+    order.resize( count );
+    for ( size_t i = 0; i < count; ++i ) {
+      order[ i ] = ( std::uint32_t )i;
+    }
+  }
+
+  if ( count < 2 )
+    return;
+
+  // Keys in particle order, which reads positions front to back
+
+  const auto& e = matrix.elements;
+  const auto bytes = reinterpret_cast<const unsigned char*>( positions );
+
+  // Under a perspective projection the depth after the divide grows with w,
+  // the distance along the view axis; sorting by w gives the same order
+  // without the divide, and without the precision the divide loses far from
+  // the camera. Without one, w is constant and z is the depth.
+
+  const auto perspective = e[3] != 0 || e[7] != 0 || e[11] != 0;
+  const auto row = perspective ? 3 : 2;
+
+  const auto chunks = detail::sortChunks( count, detail::SortChunk );
+
+  mKeys.resize( count );
+
+  mPool.parallelFor( chunks, [&]( size_t chunk, size_t ) {
+
+    const auto begin = chunk * detail::SortChunk;
+    const auto end = std::min( count, begin + detail::SortChunk );
+
+    for ( auto p = begin; p < end; ++p ) {
+      const auto v = reinterpret_cast<const float*>( bytes + p * stride );
+      const auto depth = e[ row ] * v[0] + e[ row + 4 ] * v[1] + e[ row + 8 ] * v[2] + e[ row + 12 ];
+      // farthest first
+      mKeys[ p ] = ~three::sortableFloat( depth );
+    }
+
+  } );
+
+  // Keys laid out in the previous order, counting where that is out of order
+
+  mItems.resize( count );
+  mDescents.assign( chunks, 0 );
+
+  mPool.parallelFor( chunks, [&]( size_t chunk, size_t ) {
+
+    const auto begin = chunk * detail::SortChunk;
+    const auto end = std::min( count, begin + detail::SortChunk );
+
+    std::uint32_t last = 0;
+    size_t descents = 0;
+
+    for ( auto i = begin; i < end; ++i ) {
+      const auto p = order[ i ];
+      const auto key = mKeys[ p ];
+      descents += key < last;
+      last = key;
+      mItems[ i ] = ( std::uint64_t )key << 32 | p;
+    }
+
+    mDescents[ chunk ] = descents;
+
+  } );
+
+  size_t descents = 0;
+  for ( auto d : mDescents ) descents += d;
+
+  // Nearly sorted: a few particles crossed each other since the last frame
+
+  if ( descents <= count / 64 ) {
+    mRefined = detail::refineOrder( &mItems[ 0 ], count, count );
+  }
+
+  if ( !mRefined ) {
+    sortItems();
+  }
+
+  for ( size_t i = 0; i < count; ++i ) {
+    order[ i ] = ( std::uint32_t )mItems[ i ];
+  }
+
+}
+
+void ParticleSorter::sortItems() {
+
+  const auto count = mItems.size();
+  const auto threads = mPool.size();
+
+  if ( threads == 1 || count < 4 * detail::SortChunk ) {
+    three::radixSort( mItems, mScratch, []( std::uint64_t item ) { return detail::sortKey( item ); } );
+    return;
+  }
+
+  // Per chunk histograms give each chunk its own range of every bucket,
+  // so the scatter is parallel and still stable
+
+  const auto chunk = std::max<size_t>( detail::SortChunk, count / ( threads * 4 ) + 1 );
+  const auto chunks = detail::sortChunks( count, chunk );
+
+  mScratch.resize( count );
+  mHistograms.resize( chunks * detail::SortDigits );
+
+  auto src = &mItems[ 0 ];
+  auto dst = &mScratch[ 0 ];
+
+  for ( int shift = 32; shift < 64; shift += 8 ) {
+
+    mPool.parallelFor( chunks, [&]( size_t c, size_t ) {
+      auto histogram = &mHistograms[ c * detail::SortDigits ];
+      std::fill( histogram, histogram + detail::SortDigits, 0 );
+      const auto end = std::min( count, ( c + 1 ) * chunk );
+      for ( auto i = c * chunk; i < end; ++i ) {
+        ++histogram[ src[ i ] >> shift & 0xFF ];
+      }
+    } );
+
+    // Skip digits that are the same for every key
+
+    size_t first = 0;
+    for ( size_t c = 0; c < chunks; ++c ) {
+      first += mHistograms[ c * detail::SortDigits + ( src[ 0 ] >> shift & 0xFF ) ];
+    }
+
+    if ( first == count )
+      continue;
+
+    size_t offset = 0;
+    for ( size_t digit = 0; digit < detail::SortDigits; ++digit ) {
+      for ( size_t c = 0; c < chunks; ++c ) {
+        auto& n = mHistograms[ c * detail::SortDigits + digit ];
+        const auto next = offset + n;
+        n = offset;
+        offset = next;
+      }
+    }
+
+    mPool.parallelFor( chunks, [&]( size_t c, size_t ) {
+      auto histogram = &mHistograms[ c * detail::SortDigits ];
+      const auto end = std::min( count, ( c + 1 ) * chunk );
+      for ( auto i = c * chunk; i < end; ++i ) {
+        const auto item = src[ i ];
+        dst[ histogram[ item >> shift & 0xFF ]++ ] = item;
+      }
+    } );
+
+    std::swap( src, dst );
+
+  }
+
+  if ( src != &mItems[ 0 ] ) {
+    mItems.swap( mScratch );
+  }
+
+}
+
+void ParticleSorter::gather( const std::vector<std::uint32_t>& order, const Stream* streams, size_t count ) {
+
+  const auto particles = order.size();
+  const auto chunks = detail::sortChunks( particles, detail::SortChunk );
+
+  mPool.parallelFor( chunks, [&]( size_t chunk, size_t ) {
+
+    const auto begin = chunk * detail::SortChunk;
+    const auto end = std::min( particles, begin + detail::SortChunk );
+
+    for ( size_t s = 0; s < count; ++s ) {
+
+      const auto& stream = streams[ s ];
+
+      switch ( stream.size ) {
+      case 1:  detail::gatherStream<1>( stream, &order[ 0 ], begin, end ); break;
+      case 2:  detail::gatherStream<2>( stream, &order[ 0 ], begin, end ); break;
+      case 3:  detail::gatherStream<3>( stream, &order[ 0 ], begin, end ); break;
+      case 4:  detail::gatherStream<4>( stream, &order[ 0 ], begin, end ); break;
+      default: break;
+      }
+
+    }
+
+  } );
+
+}
+
+} // namespace three
+
+#endif // THREE_PARTICLE_SORTER_IPP
@@ -0,0 +1,78 @@
+#ifndef THREE_PARTICLE_SORTER_HPP
+#define THREE_PARTICLE_SORTER_HPP
+
+#include <three/common.hpp>
+
+#include <three/core/matrix4.hpp>
+
+#include <three/utils/noncopyable.hpp>
+#include <three/utils/thread_pool.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace three {
+
+// Back to front ordering of particles. Depths are mapped to 32 bit keys and
+// sorted with an LSD radix sort, split across threads. The order from the
+// previous frame is the starting point: if the particles are still nearly
+// in order it is refined in place by insertion sort instead, which costs
+// about one pass over the keys.
+//
+// The result is a permutation, order[ i ] being the particle drawn i-th;
+// gather() applies it to any number of attribute arrays in one pass.
+
+class ParticleSorter : NonCopyable {
+public:
+
+  THREE_DECL ParticleSorter();
+
+  // A float attribute array gathered into another, size floats per particle
+  struct Stream {
+    const float* src;
+    size_t count; // particles src and dst have room for; others are skipped
+    float* dst;
+    int size;
+  };
+
+  // Sorts count particles, positions being strided float triples (stride
+  // in bytes), by depth under matrix, farthest first. order holds the last
+  // order on entry (or anything of another size) and the new one on exit.
+  THREE_DECL void sort( const float* positions, size_t stride, size_t count,
+                        const Matrix4& matrix, std::vector<std::uint32_t>& order );
+
+  // dst[ i ] = src[ order[ i ] ] for each stream
+  THREE_DECL void gather( const std::vector<std::uint32_t>& order, const Stream* streams, size_t count );
+
+  // Worker threads; 0 (the default) uses every hardware thread, 1 sorts on
+  // the calling thread. On one thread a full sort of a million particles
+  // takes some 30-40 ms.
+  THREE_DECL void setThreads( size_t threads );
+  size_t threads() const { return mPool.size(); }
+
+  // Whether the last sort() only had to refine the previous order
+  bool refined() const { return mRefined; }
+
+private:
+
+  THREE_DECL void sortItems();
+
+  ThreadPool mPool;
+
+  std::vector<std::uint32_t> mKeys;    // per particle
+  std::vector<std::uint64_t> mItems;   // key << 32 | particle
+  std::vector<std::uint64_t> mScratch;
+  std::vector<size_t> mHistograms;
+  std::vector<size_t> mDescents;
+
+  bool mRefined;
+
+};
+
+} // namespace three
+
+#if defined(THREE_HEADER_ONLY)
+# include <three/renderers/impl/particle_sorter.ipp>
+#endif // defined(THREE_HEADER_ONLY)
+
+#endif // THREE_PARTICLE_SORTER_HPP
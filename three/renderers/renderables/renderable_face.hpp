@@ -6,18 +6,31 @@
 #include <three/renderers/renderables/renderable.hpp>
 #include <three/renderers/renderables/renderable_vertex.hpp>
 
+#include <array>
+
 namespace three {
 
 class RenderableFace : public Renderable {
 public:
 
   RenderableFace( THREE::FaceType type = THREE::Face3 )
-    : Renderable( 0 ), material( nullptr ), faceMaterial( nullptr ),
-      mType( type ), mSize( type == THREE::Face3 ? 3 : 4 ) { }
+    : Renderable( 0 ), vertices( nullptr ), a( 0 ), b( 0 ), c( 0 ), d( 0 ),
+      material( nullptr ), faceMaterial( nullptr ) {
+    setType( type );
+    uvs.fill( nullptr );
+  }
 
   /////////////////////////////////////////////////////////////////////////
 
-  RenderableVertex v1, v2, v3, v4;
+  // Corners, as indices into vertices (the projector's vertex pool, valid
+  // until the next projection)
+  const RenderableVertex* vertices;
+  int a, b, c, d;
+
+  const RenderableVertex& v1() const { return vertices[ a ]; }
+  const RenderableVertex& v2() const { return vertices[ b ]; }
+  const RenderableVertex& v3() const { return vertices[ c ]; }
+  const RenderableVertex& v4() const { return vertices[ d ]; }
 
   Vector3 centroidWorld;
   Vector3 centroidScreen;
@@ -28,12 +41,18 @@ public:
   Material* material;
   Material* faceMaterial;
 
-  std::array<std::vector<UV>, 4> uvs;
+  // Per uv layer, the face's uvs in the source geometry (or nullptr)
+  std::array<const std::array<UV, 4>*, 4> uvs;
 
   THREE::FaceType type() const { return mType; }
 
   int size() { return mSize; }
 
+  void setType( THREE::FaceType type ) {
+    mType = type;
+    mSize = type == THREE::Face3 ? 3 : 4;
+  }
+
 private:
 
   THREE::FaceType mType;
@@ -3,6 +3,8 @@
 
 #include <three/scenes/scene.hpp>
 
+#include <three/core/bvh.hpp>
+
 #include <three/visitor.hpp>
 
 #include <three/objects/particle.hpp>
@@ -38,20 +40,46 @@ struct FallbackVisitor : public Visitor {
   virtual void operator()( Line& o )     { fallback(o); }
 };
 
+inline const Object3D* slotKey( const Object3D* o )     { return o; }
+inline const Object3D* slotKey( const Object3D::Ptr& o ) { return o.get(); }
+
+template < typename C, typename T >
+inline bool insertSlot( C& c, Scene::Slots& slots, const T& elem ) {
+  if ( !slots.insert( std::make_pair( slotKey( elem ), c.size() ) ).second )
+    return false;
+  c.push_back( elem );
+  return true;
+}
+
+template < typename C, typename T >
+inline bool eraseSlot( C& c, Scene::Slots& slots, const T& elem ) {
+  auto i = slots.find( slotKey( elem ) );
+  if ( i == slots.end() )
+    return false;
+  const auto slot = i->second;
+  slots.erase( i );
+  if ( slot + 1 != c.size() ) {
+    c[ slot ] = std::move( c.back() );
+    slots[ slotKey( c[ slot ] ) ] = slot;
+  }
+  c.pop_back();
+  return true;
+}
+
 struct Add : public FallbackVisitor {
   Add( Scene& s, const Object3D::Ptr& o )
     : s( s ), object( o ) { }
 
   void operator()( Object3D& o ) {
-    if ( push_unique( s.__objects, &o ) ) {
+    if ( insertSlot( s.__objects, s.__objectsSlots, &o ) ) {
 
-      s.__objectsAdded.push_back( object );
+      insertSlot( s.__objectsAdded, s.__objectsAddedSlots, object );
 
-      erase( s.__objectsRemoved, object );
+      eraseSlot( s.__objectsRemoved, s.__objectsRemovedSlots, object );
     }
   }
   void operator()( Light& l ) {
-    push_unique( s.__lights, &l );
+    insertSlot( s.__lights, s.__lightsSlots, &l );
     if ( l.target && l.target->parent == nullptr ) {
       s.add( l.target );
     }
@@ -66,13 +94,13 @@ struct Add : public FallbackVisitor {
 struct Remove : public FallbackVisitor {
   Remove( Scene& s, const Object3D::Ptr& o ) : s( s ), object( o ) { }
   void operator()( Object3D& o ) {
-    if ( erase( s.__objects, &o ) ) {
-      s.__objectsRemoved.push_back( object );
-      erase( s.__objectsAdded, object );
+    if ( eraseSlot( s.__objects, s.__objectsSlots, &o ) ) {
+      insertSlot( s.__objectsRemoved, s.__objectsRemovedSlots, object );
+      eraseSlot( s.__objectsAdded, s.__objectsAddedSlots, object );
     }
   }
 
-  void operator()( Light& o ) { erase( s.__lights, &o ); }
+  void operator()( Light& o ) { eraseSlot( s.__lights, s.__lightsSlots, &o ); }
   void operator()( Camera& o ) { }
 
   Scene& s;
@@ -85,6 +113,10 @@ void Scene::__addObject( const Object3D::Ptr& object ) {
   if ( !object )
     return;
 
+  if ( spatialIndex ) {
+    spatialIndex->invalidate();
+  }
+
   detail::Add objectAdd( *this, object );
   object->visit( objectAdd );
 
@@ -97,6 +129,10 @@ void Scene::__removeObject( const Object3D::Ptr& object ) {
   if ( !object )
     return;
 
+  if ( spatialIndex ) {
+    spatialIndex->invalidate();
+  }
+
   detail::Remove objectRemove( *this, object );
   object->visit( objectRemove );
 
@@ -7,6 +7,8 @@
 
 #include <three/renderers/renderables/renderable_object.hpp>
 
+#include <unordered_map>
+
 namespace three {
 
 class Scene : public Object3D {
@@ -48,12 +50,38 @@ public:
   std::vector<Object3D*> __glSprites;
   std::vector<Object3D*> __glFlares;
 
+  // Skinned meshes among __glObjects, whose palettes the renderer updates
+  // once per frame
+  std::vector<SkinnedMesh*> __glSkinned;
+
+  // Entries of __glObjects drawn in the last frame, and those the renderer
+  // never frustum culls (lines, ribbons, instanced meshes)
+  std::vector<size_t> __glObjectsRendered;
+  std::vector<size_t> __glObjectsUnculled;
+
   std::vector<Object3D*> __objects;
   std::vector<Light*>    __lights;
 
   std::vector<Object3D::Ptr> __objectsAdded;
   std::vector<Object3D::Ptr> __objectsRemoved;
 
+  // Slot of each object in the registries above; entries are removed by
+  // swapping with the last element, so membership changes are O(1).
+  typedef std::unordered_map<const Object3D*, size_t> Slots;
+
+  Slots __objectsSlots;
+  Slots __lightsSlots;
+  Slots __objectsAddedSlots;
+  Slots __objectsRemovedSlots;
+
+  // Optional hierarchy used for frustum culling by the renderer and the
+  // projector. Set to SceneBVH::create() for large scenes; it is rebuilt
+  // when objects are added or removed and refit as they move. Call
+  // invalidate() on it after changing a geometry's bounding box or an
+  // object's frustumCulled. With it the renderer only visits the objects
+  // it draws, and uploads changed geometry when an object is drawn.
+  std::shared_ptr<SceneBVH> spatialIndex;
+
   //////////////////////////////////////////////////////////////////////////
 
 protected:
@@ -7,6 +7,7 @@
 #include <three/cameras/orthographic_camera.hpp>
 #include <three/cameras/perspective_camera.hpp>
 
+#include <three/core/bvh.hpp>
 #include <three/core/buffer_geometry.hpp>
 #include <three/core/geometry.hpp>
 #include <three/core/geometry_buffer.hpp>
@@ -22,8 +23,10 @@
 #include <three/core/projector.hpp>
 #include <three/core/quaternion.hpp>
 #include <three/core/ray.hpp>
+#include <three/core/ray_batch.hpp>
 #include <three/core/rectangle.hpp>
 #include <three/core/spline.hpp>
+#include <three/core/transform_store.hpp>
 #include <three/core/uv.hpp>
 #include <three/core/vector2.hpp>
 #include <three/core/vector3.hpp>
@@ -50,14 +53,20 @@
 #include <three/materials/particle_basic_material.hpp>
 #include <three/materials/shader_material.hpp>
 
+#include <three/objects/instanced_mesh.hpp>
 #include <three/objects/line.hpp>
 #include <three/objects/mesh.hpp>
 #include <three/objects/particle.hpp>
 #include <three/objects/particle_system.hpp>
+#include <three/objects/skinned_mesh.hpp>
 
 #include <three/renderers/renderer_parameters.hpp>
+#include <three/renderers/gl_buffer_stream.hpp>
+#include <three/renderers/gl_program_cache.hpp>
+#include <three/renderers/gl_recorder.hpp>
 #include <three/renderers/gl_renderer.hpp>
 #include <three/renderers/gl_shaders.hpp>
+#include <three/renderers/particle_sorter.hpp>
 
 #include <three/renderers/renderables/renderable_face.hpp>
 #include <three/renderers/renderables/renderable_line.hpp>
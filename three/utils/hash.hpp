@@ -1,7 +1,9 @@
 #ifndef THREE_HASH_HPP
 #define THREE_HASH_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace three {
 
@@ -69,6 +71,45 @@ static unsigned jenkins_hash(const T& value, unsigned initval = 0) {
 #undef JENKINS_MIX
 #undef JENKINS_32
 
+// Incremental 128-bit fingerprint: two independently mixed 64-bit lanes.
+// Meant for cache keys, where a collision would be a bug rather than a
+// slowdown; add() fixed-size values, not structs with padding.
+struct Fingerprint {
+
+  Fingerprint() : hi( 0x9e3779b97f4a7c15ull ), lo( 0xc2b2ae3d27d4eb4full ) { }
+
+  static std::uint64_t mix( std::uint64_t x ) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    return x ^ ( x >> 31 );
+  }
+
+  Fingerprint& add( std::uint64_t value ) {
+    hi = mix( hi ^ value ) + 0x165667b19e3779f9ull;
+    lo = mix( lo + value * 0xff51afd7ed558ccdull ) ^ ( lo >> 17 );
+    return *this;
+  }
+
+  Fingerprint& add( const void* data, size_t size ) {
+    const auto bytes = static_cast<const unsigned char*>( data );
+    size_t i = 0;
+    for ( ; i + 8 <= size; i += 8 ) {
+      std::uint64_t word;
+      std::memcpy( &word, bytes + i, 8 );
+      add( word );
+    }
+    std::uint64_t tail = 0;
+    std::memcpy( &tail, bytes + i, size - i );
+    return add( tail ).add( size );
+  }
+
+  bool operator==( const Fingerprint& other ) const { return hi == other.hi && lo == other.lo; }
+  bool operator!=( const Fingerprint& other ) const { return !( *this == other ); }
+
+  std::uint64_t hi, lo;
+
+};
+
 }
 
 #endif // THREE_HASH_HPP
\ No newline at end of file
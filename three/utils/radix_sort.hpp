@@ -0,0 +1,82 @@
+#ifndef THREE_RADIX_SORT_HPP
+#define THREE_RADIX_SORT_HPP
+
+#include <three/config.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace three {
+
+// Maps a float to an unsigned key with the same ordering (negative values
+// included), for radix sorting by depth
+inline std::uint32_t sortableFloat( float f ) {
+  std::uint32_t bits;
+  std::memcpy( &bits, &f, sizeof( bits ) );
+  return bits ^ ( ( bits & 0x80000000u ) ? 0xFFFFFFFFu : 0x80000000u );
+}
+
+// Stable LSD radix sort of items by an unsigned integer key, a byte per
+// pass. Bytes that are equal across all keys are skipped, so narrow keys in
+// a wide type cost nothing extra. scratch is resized as needed; keep it
+// around between calls and the sort allocates nothing.
+template < typename T, typename KeyFn >
+void radixSort( std::vector<T>& items, std::vector<T>& scratch, KeyFn key ) {
+
+  typedef decltype( key( items[ 0 ] ) ) Key;
+
+  const auto count = items.size();
+
+  if ( count < 2 )
+    return;
+
+  enum { Passes = sizeof( Key ) };
+
+  // All histograms in one read over the keys; 16KB of stack for 64 bit keys
+  std::array<size_t, Passes * 256> histograms;
+  histograms.fill( 0 );
+
+  for ( const auto& item : items ) {
+    auto k = key( item );
+    for ( size_t pass = 0; pass < Passes; ++pass, k >>= 8 ) {
+      ++histograms[ pass * 256 + ( k & 0xFF ) ];
+    }
+  }
+
+  scratch.resize( count );
+
+  auto* src = &items;
+  auto* dst = &scratch;
+
+  for ( size_t pass = 0; pass < Passes; ++pass ) {
+
+    auto* histogram = &histograms[ pass * 256 ];
+
+    if ( histogram[ key( ( *src )[ 0 ] ) >> ( pass * 8 ) & 0xFF ] == count )
+      continue;
+
+    size_t offset = 0;
+    for ( size_t i = 0; i < 256; ++i ) {
+      const auto n = histogram[ i ];
+      histogram[ i ] = offset;
+      offset += n;
+    }
+
+    for ( const auto& item : *src ) {
+      ( *dst )[ histogram[ key( item ) >> ( pass * 8 ) & 0xFF ]++ ] = item;
+    }
+
+    std::swap( src, dst );
+
+  }
+
+  if ( src != &items )
+    items.swap( scratch );
+
+}
+
+} // namespace three
+
+#endif // THREE_RADIX_SORT_HPP
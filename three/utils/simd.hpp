@@ -0,0 +1,111 @@
+#ifndef THREE_SIMD_HPP
+#define THREE_SIMD_HPP
+
+#include <three/config.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define THREE_SIMD_X86 1
+#else
+#  define THREE_SIMD_X86 0
+#endif
+
+#if THREE_SIMD_X86
+#  include <immintrin.h>
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  endif
+#endif
+
+// Kernels are compiled per instruction set and selected at runtime, so the
+// library itself does not need to be built with -mavx.
+#if THREE_SIMD_X86 && ( defined(__GNUC__) || defined(__clang__) )
+#  define THREE_TARGET_SSE __attribute__((target("sse2")))
+#  define THREE_TARGET_AVX __attribute__((target("avx")))
+#else
+#  define THREE_TARGET_SSE
+#  define THREE_TARGET_AVX
+#endif
+
+namespace three {
+
+namespace simd {
+
+enum Level {
+  Scalar = 0,
+  SSE    = 1,
+  AVX    = 2
+};
+
+inline Level detect() {
+
+#if THREE_SIMD_X86
+#  if defined(_MSC_VER)
+
+  int info[4];
+  __cpuid( info, 1 );
+
+  const bool sse2    = ( info[3] & ( 1 << 26 ) ) != 0;
+  const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+  const bool avx     = ( info[2] & ( 1 << 28 ) ) != 0;
+
+  if ( avx && osxsave && ( _xgetbv( 0 ) & 0x6 ) == 0x6 )
+    return AVX;
+  if ( sse2 )
+    return SSE;
+
+#  elif defined(__GNUC__) || defined(__clang__)
+
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx" ) )
+    return AVX;
+  if ( __builtin_cpu_supports( "sse2" ) )
+    return SSE;
+
+#  endif
+#endif // THREE_SIMD_X86
+
+  return Scalar;
+
+}
+
+// The active instruction set; may be lowered (e.g. for benchmarking the
+// scalar fallback) but never raised above what detect() reports.
+inline Level& level() {
+  static Level sLevel = detect();
+  return sLevel;
+}
+
+inline void setLevel( Level l ) {
+  level() = l < detect() ? l : detect();
+}
+
+#if THREE_SIMD_X86
+
+// Contiguous xyz triples <-> SoA registers, four points at a time:
+// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+
+THREE_TARGET_SSE inline void unpackXYZ( __m128 a, __m128 b, __m128 c, __m128& x, __m128& y, __m128& z ) {
+  x = _mm_shuffle_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 0, 3, 0 ) ),
+                      _mm_shuffle_ps( b, c, _MM_SHUFFLE( 1, 1, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 1, 0 ) );
+  y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 0, 0, 1, 1 ) ),
+                      _mm_shuffle_ps( b, c, _MM_SHUFFLE( 2, 2, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 1, 1, 2, 2 ) ),
+                      _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 0, 3, 0 ) ), _MM_SHUFFLE( 1, 0, 2, 0 ) );
+}
+
+THREE_TARGET_SSE inline void packXYZ( __m128 x, __m128 y, __m128 z, __m128& a, __m128& b, __m128& c ) {
+  a = _mm_shuffle_ps( _mm_shuffle_ps( x, y, _MM_SHUFFLE( 0, 0, 0, 0 ) ),
+                      _mm_shuffle_ps( z, x, _MM_SHUFFLE( 1, 1, 0, 0 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  b = _mm_shuffle_ps( _mm_shuffle_ps( y, z, _MM_SHUFFLE( 1, 1, 1, 1 ) ),
+                      _mm_shuffle_ps( x, y, _MM_SHUFFLE( 2, 2, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+  c = _mm_shuffle_ps( _mm_shuffle_ps( z, x, _MM_SHUFFLE( 3, 3, 2, 2 ) ),
+                      _mm_shuffle_ps( y, z, _MM_SHUFFLE( 3, 3, 3, 3 ) ), _MM_SHUFFLE( 2, 0, 2, 0 ) );
+}
+
+#endif // THREE_SIMD_X86
+
+} // namespace simd
+
+} // namespace three
+
+#endif // THREE_SIMD_HPP
@@ -0,0 +1,156 @@
+#ifndef THREE_THREAD_POOL_HPP
+#define THREE_THREAD_POOL_HPP
+
+#include <three/config.hpp>
+
+#include <three/utils/noncopyable.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace three {
+
+// Fixed set of worker threads for data-parallel loops. parallelFor blocks
+// until every index has been processed; the calling thread takes part as
+// thread 0, so a pool of size 1 runs everything inline. Not reentrant: one
+// parallelFor at a time per pool.
+
+class ThreadPool : NonCopyable {
+public:
+
+  explicit ThreadPool( size_t threads = 1 )
+    : mCount( 0 ), mPending( 0 ), mGeneration( 0 ), mStop( false ) {
+    mNext = 0;
+    resize( threads );
+  }
+
+  ~ThreadPool() { join(); }
+
+  static size_t hardwareThreads() {
+    const auto count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+  }
+
+  size_t size() const { return mWorkers.size() + 1; }
+
+  // 0 uses one thread per hardware thread
+  void resize( size_t threads ) {
+
+    if ( threads == 0 )
+      threads = hardwareThreads();
+
+    if ( threads == size() )
+      return;
+
+    join();
+
+    mStop = false;
+
+    for ( size_t i = 1; i < threads; ++i ) {
+      mWorkers.push_back( std::thread( [this, i] { run( i ); } ) );
+    }
+
+  }
+
+  // Calls f( index, thread ) for each index in [0, count), with thread in
+  // [0, size()). Indices are handed out one at a time, so keep them coarse.
+  template < typename F >
+  void parallelFor( size_t count, F&& f ) {
+
+    if ( mWorkers.empty() || count <= 1 ) {
+      for ( size_t i = 0; i < count; ++i ) {
+        f( i, 0 );
+      }
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock( mMutex );
+      mTask    = [&f]( size_t index, size_t thread ) { f( index, thread ); };
+      mCount   = count;
+      mNext    = 0;
+      mPending = mWorkers.size();
+      ++mGeneration;
+    }
+
+    mWake.notify_all();
+
+    work( 0 );
+
+    std::unique_lock<std::mutex> lock( mMutex );
+    mDone.wait( lock, [this] { return mPending == 0; } );
+    mTask = nullptr;
+
+  }
+
+private:
+
+  void work( size_t thread ) {
+    for ( size_t i = mNext++; i < mCount; i = mNext++ ) {
+      mTask( i, thread );
+    }
+  }
+
+  void run( size_t thread ) {
+
+    unsigned generation = 0;
+
+    for ( ;; ) {
+
+      {
+        std::unique_lock<std::mutex> lock( mMutex );
+        mWake.wait( lock, [&] { return mStop || mGeneration != generation; } );
+        if ( mStop )
+          return;
+        generation = mGeneration;
+      }
+
+      work( thread );
+
+      std::lock_guard<std::mutex> lock( mMutex );
+      if ( --mPending == 0 )
+        mDone.notify_one();
+
+    }
+
+  }
+
+  void join() {
+
+    {
+      std::lock_guard<std::mutex> lock( mMutex );
+      mStop = true;
+    }
+
+    mWake.notify_all();
+
+    for ( auto& worker : mWorkers ) {
+      worker.join();
+    }
+
+    mWorkers.clear();
+
+  }
+
+  std::vector<std::thread> mWorkers;
+
+  std::function<void( size_t, size_t )> mTask;
+  std::atomic<size_t> mNext;
+  size_t mCount;
+  size_t mPending;
+  unsigned mGeneration;
+  bool mStop;
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mDone;
+
+};
+
+} // namespace three
+
+#endif // THREE_THREAD_POOL_HPP